@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "arith.h"
+#include <string.h>
+
+/* Lowering of multiplies, divides and modulos by constants.  Each function
+ * builds every applicable instruction sequence and keeps the one with the
+ * fewest cycles according to the DCPU-16 cycle table (ties go to the shorter
+ * sequence).  On the DCPU-16, MUL costs 2 cycles and DIV/MOD cost 3, while
+ * shifts and masks cost 1, so most rewrites only pay off for powers of two;
+ * the table makes that call rather than a fixed rule.  Sequences that need a
+ * scratch register are only considered if 'scratch' is a register (>= 0). */
+
+static void cc_seq_add(cc_seq * self, int op, cc_operand b, cc_operand a) {
+    cc_inst * inst = self->insts + self->count++;
+    memset(inst, 0, sizeof(*inst));
+    inst->op = op;
+    inst->b = b;
+    inst->a = a;
+}
+
+int cc_seq_cycles(cc_seq * self) {
+    int cycles = 0;
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        cycles += cc_inst_cycles(self->insts + i);
+    }
+    return cycles;
+}
+
+int cc_seq_words(cc_seq * self) {
+    int words = 0;
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        words += cc_inst_words(self->insts + i);
+    }
+    return words;
+}
+
+/* Replaces 'self' with 'other' if 'other' is cheaper */
+static void cc_seq_pick(cc_seq * self, cc_seq * other) {
+    int cycles = cc_seq_cycles(other);
+    if (cycles < cc_seq_cycles(self) || (cycles == cc_seq_cycles(self)
+        && cc_seq_words(other) < cc_seq_words(self))) {
+        *self = *other;
+    }
+}
+
+/* Returns k if 'value' is 2^k, or -1 */
+static int cc_arith_log2(unsigned value) {
+    int k = 0;
+    if (!value || (value & (value - 1))) {
+        return -1;
+    }
+    while (value > 1) {
+        value >>= 1;
+        k++;
+    }
+    return k;
+}
+
+/* reg = reg * value */
+void cc_arith_mul(cc_seq * self, int reg, int value, int scratch) {
+    cc_operand r = cc_opd_reg(reg);
+    cc_operand s = cc_opd_reg(scratch);
+    unsigned c = value & 0xffff;
+    cc_seq seq;
+    int a = 0;
+    int b = 0;
+
+    self->count = 0;
+    cc_seq_add(self, CC_OP_MUL, r, cc_opd_lit(value));
+    if (0 == c) {
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_SET, r, cc_opd_lit(0));
+        cc_seq_pick(self, &seq);
+        return;
+    }
+    if (1 == c) {
+        self->count = 0;
+        return;
+    }
+    if ((a = cc_arith_log2(c)) >= 0) {
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_SHL, r, cc_opd_lit(a));
+        cc_seq_pick(self, &seq);
+    }
+    if ((a = cc_arith_log2((-(int)c) & 0xffff)) >= 0) {
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_SHL, r, cc_opd_lit(a));
+        cc_seq_add(&seq, CC_OP_MLI, r, cc_opd_lit(-1));
+        cc_seq_pick(self, &seq);
+    }
+    if (scratch < 0) {
+        return;
+    }
+    /* 2^a + 2^b and 2^a - 2^b */
+    for (a = 1; a < 16; ++a) {
+        for (b = 0; b < a; ++b) {
+            unsigned sum = ((1u << a) + (1u << b)) & 0xffff;
+            unsigned diff = ((1u << a) - (1u << b)) & 0xffff;
+            if (c != sum && c != diff) {
+                continue;
+            }
+            seq.count = 0;
+            cc_seq_add(&seq, CC_OP_SET, s, r);
+            cc_seq_add(&seq, CC_OP_SHL, r, cc_opd_lit(a));
+            if (b) {
+                cc_seq_add(&seq, CC_OP_SHL, s, cc_opd_lit(b));
+            }
+            cc_seq_add(&seq, c == sum ? CC_OP_ADD : CC_OP_SUB, r, s);
+            cc_seq_pick(self, &seq);
+        }
+    }
+}
+
+/* reg = reg / value */
+void cc_arith_div(cc_seq * self, int reg, int value, int sign, int scratch) {
+    cc_operand r = cc_opd_reg(reg);
+    cc_operand s = cc_opd_reg(scratch);
+    unsigned c = value & 0xffff;
+    cc_seq seq;
+    int mul = 0;
+    int shift = 0;
+    int k = 0;
+
+    self->count = 0;
+    cc_seq_add(self, sign ? CC_OP_DVI : CC_OP_DIV, r, cc_opd_lit(value));
+    if (1 == c) {
+        self->count = 0;
+        return;
+    }
+    if (!c) {
+        return;
+    }
+    if (sign) {
+        if (0xffff == c) {
+            seq.count = 0;
+            cc_seq_add(&seq, CC_OP_MLI, r, cc_opd_lit(-1));
+            cc_seq_pick(self, &seq);
+        }
+        if ((k = cc_arith_log2(c)) > 0 && k < 15 && scratch >= 0) {
+            /* Round toward zero: add 2^k - 1 to negative dividends */
+            seq.count = 0;
+            cc_seq_add(&seq, CC_OP_SET, s, r);
+            cc_seq_add(&seq, CC_OP_ASR, s, cc_opd_lit(15));
+            cc_seq_add(&seq, CC_OP_SHR, s, cc_opd_lit(16 - k));
+            cc_seq_add(&seq, CC_OP_ADD, r, s);
+            cc_seq_add(&seq, CC_OP_ASR, r, cc_opd_lit(k));
+            cc_seq_pick(self, &seq);
+        }
+        return;
+    }
+    if ((k = cc_arith_log2(c)) >= 0) {
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_SHR, r, cc_opd_lit(k));
+        cc_seq_pick(self, &seq);
+    }
+    if (cc_arith_magic(c, &mul, &shift)) {
+        /* MUL leaves the high word of the product in EX */
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_MUL, r, cc_opd_lit(mul));
+        cc_seq_add(&seq, CC_OP_SET, r, cc_opd_special(CC_VAL_EX));
+        if (shift) {
+            cc_seq_add(&seq, CC_OP_SHR, r, cc_opd_lit(shift));
+        }
+        cc_seq_pick(self, &seq);
+    }
+}
+
+/* reg = reg % value */
+void cc_arith_mod(cc_seq * self, int reg, int value, int sign, int scratch) {
+    cc_operand r = cc_opd_reg(reg);
+    cc_operand s = cc_opd_reg(scratch);
+    unsigned c = value & 0xffff;
+    cc_seq seq;
+    int mul = 0;
+    int shift = 0;
+    int k = 0;
+
+    self->count = 0;
+    cc_seq_add(self, sign ? CC_OP_MDI : CC_OP_MOD, r, cc_opd_lit(value));
+    if (!c) {
+        return;
+    }
+    if (1 == c || (sign && 0xffff == c)) {
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_SET, r, cc_opd_lit(0));
+        cc_seq_pick(self, &seq);
+        return;
+    }
+    if (sign) {
+        return;
+    }
+    if ((k = cc_arith_log2(c)) >= 0) {
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_AND, r, cc_opd_lit(c - 1));
+        cc_seq_pick(self, &seq);
+    }
+    if (scratch >= 0 && cc_arith_magic(c, &mul, &shift)) {
+        /* x - (x / c) * c, with the quotient from a reciprocal multiply */
+        seq.count = 0;
+        cc_seq_add(&seq, CC_OP_SET, s, r);
+        cc_seq_add(&seq, CC_OP_MUL, s, cc_opd_lit(mul));
+        cc_seq_add(&seq, CC_OP_SET, s, cc_opd_special(CC_VAL_EX));
+        if (shift) {
+            cc_seq_add(&seq, CC_OP_SHR, s, cc_opd_lit(shift));
+        }
+        cc_seq_add(&seq, CC_OP_MUL, s, cc_opd_lit(value));
+        cc_seq_add(&seq, CC_OP_SUB, r, s);
+        cc_seq_pick(self, &seq);
+    }
+}
+
+/* Finds a 16-bit multiplier 'mul' and shift such that for every unsigned
+ * 16-bit x, x / value == ((x * mul) >> 16) >> shift.  The high word of the
+ * product is what MUL leaves in EX.  Returns zero if no such pair exists
+ * (the divisor needs a 17-bit multiplier). */
+int cc_arith_magic(int value, int * mul, int * shift) {
+    unsigned long c = value & 0xffff;
+    int s = 0;
+    if (c < 2) {
+        return 0;
+    }
+    for (s = 0; s < 16; ++s) {
+        unsigned long p = 1ul << (16 + s);
+        unsigned long m = (p + c - 1) / c;
+        if (m > 0xffff) {
+            break;
+        }
+        if (m * c - p <= (1ul << s)) {
+            *mul = (int)m;
+            *shift = s;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_ARITH_H
+#define CC_ARITH_H
+
+#include "code.h"
+
+/* Candidate instruction sequence for an arithmetic operation */
+typedef struct cc_seq {
+    cc_inst insts[8];
+    int count;
+} cc_seq;
+
+void cc_arith_mul(cc_seq * self, int reg, int value, int scratch);
+void cc_arith_div(cc_seq * self, int reg, int value, int sign, int scratch);
+void cc_arith_mod(cc_seq * self, int reg, int value, int sign, int scratch);
+int cc_arith_magic(int value, int * mul, int * shift);
+int cc_seq_cycles(cc_seq * self);
+int cc_seq_words(cc_seq * self);
+
+#endif
@@ -0,0 +1,441 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "asm.h"
+#include <stdlib.h>
+#include <string.h>
+
+cc_asm * cc_asm_init(cc_env * env) {
+    cc_asm * self = calloc(1, sizeof(cc_asm));
+    self->env = env;
+    return self;
+}
+
+void cc_asm_free(cc_asm * self) {
+    while (self->syms) {
+        cc_asym * next = self->syms->next;
+        free(self->syms);
+        self->syms = next;
+    }
+    while (self->fixups) {
+        cc_fixup * next = self->fixups->next;
+        free(self->fixups);
+        self->fixups = next;
+    }
+    free(self->words);
+    free(self->sections);
+    free(self->lines);
+    free(self);
+}
+
+/* Appends one word to the image */
+void cc_asm_word(cc_asm * self, int word) {
+    if (self->count >= self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 1024;
+        self->words = realloc(self->words,
+            self->capacity * sizeof(unsigned short));
+    }
+    if (self->count >= CC_DCPU_WORDS) {
+        if (self->count == CC_DCPU_WORDS) {
+            fprintf(stderr, "Program is larger than 64K words\n");
+            self->errors++;
+        }
+    }
+    self->words[self->count++] = word & 0xffff;
+    if (self->nsections) {
+        self->sections[self->nsections - 1].size++;
+    }
+}
+
+/* Records that the word at 'at' holds the address of 'id' plus 'addend' */
+static void cc_asm_fixup(cc_asm * self, cc_id * id, int addend, int at) {
+    cc_fixup * fixup = calloc(1, sizeof(cc_fixup));
+    fixup->id = id;
+    fixup->addend = addend;
+    fixup->at = at;
+    fixup->section = self->nsections - 1;
+    fixup->next = self->fixups;
+    self->fixups = fixup;
+}
+
+/* Appends a word holding the address of 'id' plus 'addend' */
+void cc_asm_ref(cc_asm * self, cc_id * id, int addend) {
+    cc_asm_fixup(self, id, addend, self->count);
+    cc_asm_word(self, 0);
+}
+
+/* Starts a new section of kind 'kind' at the end of the image (or, for
+ * CC_OBJ_BSS, at the end of the BSS region) */
+void cc_asm_section(cc_asm * self, int kind) {
+    cc_asect * section = 0;
+    if (self->nsections >= self->capsections) {
+        self->capsections = self->capsections ? self->capsections * 2 : 64;
+        self->sections = realloc(self->sections,
+            self->capsections * sizeof(cc_asect));
+    }
+    section = self->sections + self->nsections++;
+    section->kind = kind;
+    section->start = self->count + (CC_OBJ_BSS == kind ? self->bss : 0);
+    section->size = 0;
+}
+
+/* Marks the current section as the startup code */
+void cc_asm_entry(cc_asm * self) {
+    self->sections[self->nsections - 1].kind |= CC_OBJ_ENTRY;
+}
+
+/* Marks the current section as a tentative definition */
+void cc_asm_common(cc_asm * self) {
+    self->sections[self->nsections - 1].kind |= CC_OBJ_COMMON;
+}
+
+/* Reserves 'count' words in the BSS region, and defines 'id' as their
+ * address.  Must be called once the image is complete. */
+void cc_asm_bss(cc_asm * self, cc_id * id, int count) {
+    cc_asm_section(self, CC_OBJ_BSS);
+    cc_asm_define(self, id, self->count + self->bss);
+    self->sections[self->nsections - 1].size = count;
+    self->bss += count;
+    if (self->count + self->bss > CC_DCPU_WORDS
+        && self->count + self->bss - count <= CC_DCPU_WORDS) {
+        fprintf(stderr, "Program is larger than 64K words\n");
+        self->errors++;
+    }
+}
+
+void cc_asm_define(cc_asm * self, cc_id * id, int addr) {
+    cc_asym * sym = 0;
+    if (cc_asm_lookup(self, id) >= 0) {
+        fprintf(stderr, "Duplicate symbol '%s'\n", id->str);
+        self->errors++;
+        return;
+    }
+    sym = calloc(1, sizeof(cc_asym));
+    sym->id = id;
+    sym->addr = addr;
+    sym->section = self->nsections - 1;
+    sym->next = self->syms;
+    self->syms = sym;
+}
+
+/* Returns the address of 'id', or -1 if it isn't defined yet */
+int cc_asm_lookup(cc_asm * self, cc_id * id) {
+    cc_asym * sym = 0;
+    for (sym = self->syms; sym; sym = sym->next) {
+        if (sym->id == id) {
+            return sym->addr;
+        }
+    }
+    return -1;
+}
+
+/* Returns the encoding of an operand, and appends its extra word to 'extra'
+ * (incrementing 'count').  Label offsets from the start of 'code' are taken
+ * from 'labels'.  Symbol and label references are recorded as fixups at
+ * 'at', the address of the extra word; a label is relative to the code's
+ * own symbol, so that the code can be moved by the linker. */
+static int cc_asm_operand(cc_asm * self, cc_code * code, cc_operand * opd,
+    int a, int * labels, unsigned short * extra, int * count, int at) {
+
+    int value = opd->value;
+    if (opd->label) {
+        value += labels[opd->label];
+        cc_asm_fixup(self, code->id, value, at);
+    } else if (opd->sym && (CC_VAL_LIT == opd->mode
+        || CC_VAL_MEM == opd->mode || CC_VAL_OFF == opd->mode)) {
+        cc_asm_fixup(self, opd->sym, value, at);
+    }
+    switch (opd->mode) {
+    case CC_VAL_REG:
+    case CC_VAL_IND:
+        return opd->mode + opd->reg;
+    case CC_VAL_OFF:
+        extra[(*count)++] = value;
+        return opd->mode + opd->reg;
+    case CC_VAL_PICK:
+    case CC_VAL_MEM:
+        extra[(*count)++] = value;
+        return opd->mode;
+    case CC_VAL_LIT:
+        if (cc_operand_words(opd, a)) {
+            extra[(*count)++] = value;
+            return CC_VAL_LIT;
+        }
+        return CC_VAL_SHORT + ((value + 1) & 0x1f);
+    default:
+        return opd->mode;
+    }
+}
+
+/* Adds a row to the line table if the next word comes from a different
+ * source line, or starts a function */
+static void cc_asm_line(cc_asm * self, int line, int start) {
+    cc_aline * last = self->nlines ? self->lines + self->nlines - 1 : 0;
+    if (last && last->line == line && !start) {
+        return;
+    }
+    if (last && last->addr == self->count) {
+        last->line = line;
+        return;
+    }
+    if (self->nlines >= self->caplines) {
+        self->caplines = self->caplines ? self->caplines * 2 : 256;
+        self->lines = realloc(self->lines,
+            self->caplines * sizeof(cc_aline));
+    }
+    self->lines[self->nlines].addr = self->count;
+    self->lines[self->nlines].line = line;
+    self->nlines++;
+}
+
+/* Appends the code for one function to the image, and defines its symbol.
+ * Instruction sizes don't depend on label values (label references always
+ * use a next word), so label offsets are computed up front. */
+void cc_asm_code(cc_asm * self, cc_code * code) {
+    int * labels = calloc(code->labels + 1, sizeof(int));
+    int addr = 0;
+    int start = 1;
+    int i = 0;
+
+    cc_asm_section(self, CC_OBJ_CODE);
+    cc_asm_define(self, code->id, self->count);
+    for (i = 0; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        if (CC_INST_LABEL == inst->op) {
+            labels[inst->a.label] = addr;
+        }
+        addr += cc_inst_words(inst);
+    }
+    for (i = 0; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        unsigned short extra[2];
+        int count = 0;
+        int a = 0;
+        int b = 0;
+        int j = 0;
+        if (CC_INST_LABEL == inst->op) {
+            continue;
+        }
+        cc_asm_line(self, inst->line, start);
+        start = 0;
+        a = cc_asm_operand(self, code, &inst->a, 1, labels, extra, &count,
+            self->count + 1);
+        if (inst->op > CC_OP_SPECIAL) {
+            cc_asm_word(self, (a << 10) | ((inst->op - CC_OP_SPECIAL) << 5));
+        } else {
+            b = cc_asm_operand(self, code, &inst->b, 0, labels, extra,
+                &count, self->count + 1 + count);
+            cc_asm_word(self, (a << 10) | (b << 5) | inst->op);
+        }
+        for (j = 0; j < count; ++j) {
+            cc_asm_word(self, extra[j]);
+        }
+    }
+    free(labels);
+}
+
+/* Appends a block of data words to the current section, and defines its
+ * symbol */
+void cc_asm_data(cc_asm * self, cc_id * id, unsigned short * words, int count) {
+    int i = 0;
+    if (id) {
+        cc_asm_define(self, id, self->count);
+    }
+    for (i = 0; i < count; ++i) {
+        cc_asm_word(self, words[i]);
+    }
+}
+
+/* Patches every symbol reference in the image */
+void cc_asm_link(cc_asm * self) {
+    cc_fixup * fixup = 0;
+    for (fixup = self->fixups; fixup; fixup = fixup->next) {
+        int addr = cc_asm_lookup(self, fixup->id);
+        if (addr < 0) {
+            fprintf(stderr, "Undefined symbol '%s'\n", fixup->id->str);
+            self->errors++;
+            continue;
+        }
+        self->words[fixup->at] = (fixup->addend + addr) & 0xffff;
+    }
+}
+
+/* Writes the image as big-endian 16-bit words */
+void cc_asm_write(cc_asm * self, FILE * out) {
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        fputc(self->words[i] >> 8, out);
+        fputc(self->words[i] & 0xff, out);
+    }
+}
+
+static void cc_asm_put(FILE * out, int word) {
+    fputc((word >> 8) & 0xff, out);
+    fputc(word & 0xff, out);
+}
+
+/* Returns the index of 'id' in the symbol table 'ids', adding it if it
+ * isn't there yet */
+static int cc_asm_index(cc_id *** ids, int * count, cc_id * id) {
+    int i = 0;
+    for (i = 0; i < *count; ++i) {
+        if ((*ids)[i] == id) {
+            return i;
+        }
+    }
+    *ids = realloc(*ids, (*count + 1) * sizeof(cc_id *));
+    (*ids)[*count] = id;
+    return (*count)++;
+}
+
+static int cc_asm_compare(void const * left, void const * right) {
+    cc_fixup const * l = *(cc_fixup * const *)left;
+    cc_fixup const * r = *(cc_fixup * const *)right;
+    if (l->section != r->section) {
+        return l->section - r->section;
+    }
+    return l->at - r->at;
+}
+
+/* Writes the image unlinked, as a relocatable object.  Every fixup becomes
+ * a relocation, including those against symbols defined in the image. */
+void cc_asm_object(cc_asm * self, FILE * out) {
+    cc_id ** ids = 0;
+    cc_fixup ** relocs = 0;
+    cc_fixup * fixup = 0;
+    cc_asym * sym = 0;
+    int nids = 0;
+    int ndefs = 0;
+    int nrelocs = 0;
+    int nnames = 0;
+    int first = 0;
+    int i = 0;
+
+    for (sym = self->syms; sym; sym = sym->next) {
+        cc_asm_index(&ids, &nids, sym->id);
+    }
+    ndefs = nids;
+    for (fixup = self->fixups; fixup; fixup = fixup->next) {
+        nrelocs++;
+    }
+    relocs = calloc(nrelocs + 1, sizeof(cc_fixup *));
+    for (fixup = self->fixups; fixup; fixup = fixup->next) {
+        relocs[i++] = fixup;
+        cc_asm_index(&ids, &nids, fixup->id);
+    }
+    qsort(relocs, nrelocs, sizeof(cc_fixup *), cc_asm_compare);
+    for (i = 0; i < nids; ++i) {
+        nnames += strlen(ids[i]->str) + 1;
+    }
+    nnames += nnames & 1;
+    if (self->nsections > 0xffff || nids > 0xffff || nrelocs > 0xffff
+        || nnames > 0xffff) {
+        fprintf(stderr, "Object is too large\n");
+        self->errors++;
+    }
+
+    cc_asm_put(out, CC_OBJ_MAGIC);
+    cc_asm_put(out, CC_OBJ_VERSION);
+    cc_asm_put(out, self->nsections);
+    cc_asm_put(out, nids);
+    cc_asm_put(out, nrelocs);
+    cc_asm_put(out, self->count);
+    cc_asm_put(out, nnames);
+    for (i = 0; i < self->nsections; ++i) {
+        cc_asect * section = self->sections + i;
+        int count = 0;
+        while (first + count < nrelocs && relocs[first + count]->section == i) {
+            count++;
+        }
+        cc_asm_put(out, section->kind);
+        cc_asm_put(out, section->size);
+        cc_asm_put(out, CC_OBJ_BSS == (section->kind & CC_OBJ_KIND)
+            ? 0 : section->start);
+        cc_asm_put(out, first);
+        cc_asm_put(out, count);
+        first += count;
+    }
+    nnames = 0;
+    sym = self->syms;
+    for (i = 0; i < nids; ++i) {
+        /* The defined symbols come first, in the order of 'syms' */
+        if (i < ndefs) {
+            cc_asm_put(out, nnames);
+            cc_asm_put(out, sym->section);
+            cc_asm_put(out, sym->addr - self->sections[sym->section].start);
+            sym = sym->next;
+        } else {
+            cc_asm_put(out, nnames);
+            cc_asm_put(out, CC_OBJ_UNDEF);
+            cc_asm_put(out, 0);
+        }
+        cc_asm_put(out, cc_obj_global(ids[i]->str) ? CC_OBJ_GLOBAL : 0);
+        nnames += strlen(ids[i]->str) + 1;
+    }
+    for (i = 0; i < nrelocs; ++i) {
+        cc_fixup * reloc = relocs[i];
+        cc_asm_put(out, reloc->at - self->sections[reloc->section].start);
+        cc_asm_put(out, cc_asm_index(&ids, &nids, reloc->id));
+        cc_asm_put(out, reloc->addend);
+    }
+    for (i = 0; i < self->count; ++i) {
+        cc_asm_put(out, self->words[i]);
+    }
+    for (i = 0; i < nids; ++i) {
+        fwrite(ids[i]->str, 1, strlen(ids[i]->str) + 1, out);
+    }
+    if (nnames & 1) {
+        fputc(0, out);
+    }
+    free(relocs);
+    free(ids);
+}
+
+/* Writes the line table of a linked image: the address range of each
+ * function, then the address where each run of code from one source line
+ * starts.  The format is line-oriented text:
+ *
+ *   dcpu16-lines 1 <source>
+ *   F <start> <end> <name>
+ *   L <addr> <line>
+ */
+void cc_asm_lines(cc_asm * self, FILE * out, char const * source) {
+    cc_asym * sym = 0;
+    int i = 0;
+    fprintf(out, "dcpu16-lines 1 %s\n", source);
+    for (i = 0; i < self->nsections; ++i) {
+        cc_asect * section = self->sections + i;
+        if (CC_OBJ_CODE != (section->kind & CC_OBJ_KIND)) {
+            continue;
+        }
+        for (sym = self->syms; sym; sym = sym->next) {
+            if (sym->section == i && sym->addr == section->start) {
+                fprintf(out, "F %d %d %s\n", section->start,
+                    section->start + section->size, sym->id->str);
+                break;
+            }
+        }
+    }
+    for (i = 0; i < self->nlines; ++i) {
+        fprintf(out, "L %d %d\n", self->lines[i].addr, self->lines[i].line);
+    }
+}
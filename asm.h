@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_ASM_H
+#define CC_ASM_H
+
+#include "code.h"
+#include "env.h"
+#include "obj.h"
+#include <stdio.h>
+
+/* Address assigned to a global symbol */
+typedef struct cc_asym {
+    cc_id * id;
+    int addr;
+    int section; /* Index of the section that holds 'addr' */
+    struct cc_asym * next;
+} cc_asym;
+
+/* Word that must be patched with the address of 'id' plus 'addend' once all
+ * symbols are known */
+typedef struct cc_fixup {
+    cc_id * id;
+    int addend;
+    int at;
+    int section; /* Index of the section that holds 'at' */
+    struct cc_fixup * next;
+} cc_fixup;
+
+/* Run of the image that is placed as a unit when objects are linked.
+ * Every function, global and literal pool starts a section. */
+typedef struct cc_asect {
+    int kind; /* CC_OBJ_CODE, CC_OBJ_DATA or CC_OBJ_BSS, plus flags */
+    int start; /* Address of the first word */
+    int size;
+} cc_asect;
+
+/* Row of the line table: code from 'addr' on comes from source 'line' */
+typedef struct cc_aline {
+    int addr;
+    int line;
+} cc_aline;
+
+/* Assembler.  Lays out code and data in one image, starting at address 0,
+ * and resolves references between them.  The BSS region follows the image;
+ * it takes no space in it, and is cleared at startup.  The image can also
+ * be written unlinked, as a relocatable object (see obj.h). */
+typedef struct cc_asm {
+    cc_env * env;
+    unsigned short * words;
+    int count;
+    int capacity;
+    int bss; /* Words reserved past the end of the image */
+    cc_asym * syms;
+    cc_fixup * fixups;
+    cc_asect * sections;
+    int nsections;
+    int capsections;
+    cc_aline * lines; /* One row each time the source line changes */
+    int nlines;
+    int caplines;
+    int errors;
+} cc_asm;
+
+cc_asm * cc_asm_init(cc_env * env);
+void cc_asm_free(cc_asm * self);
+void cc_asm_section(cc_asm * self, int kind);
+void cc_asm_entry(cc_asm * self);
+void cc_asm_common(cc_asm * self);
+void cc_asm_code(cc_asm * self, cc_code * code);
+void cc_asm_data(cc_asm * self, cc_id * id, unsigned short * words, int count);
+void cc_asm_word(cc_asm * self, int word);
+void cc_asm_ref(cc_asm * self, cc_id * id, int addend);
+void cc_asm_bss(cc_asm * self, cc_id * id, int count);
+void cc_asm_define(cc_asm * self, cc_id * id, int addr);
+int cc_asm_lookup(cc_asm * self, cc_id * id);
+void cc_asm_link(cc_asm * self);
+void cc_asm_write(cc_asm * self, FILE * out);
+void cc_asm_object(cc_asm * self, FILE * out);
+void cc_asm_lines(cc_asm * self, FILE * out, char const * source);
+
+#endif
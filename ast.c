@@ -0,0 +1,396 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "ast.h"
+#include "check.h"
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Header of a block allocated by cc_ast_alloc, aligned for any member */
+typedef union cc_astblock {
+    union cc_astblock * next;
+    long align;
+    double falign;
+    void * palign;
+} cc_astblock;
+
+static cc_astblock * cc_ast_blocks = 0;
+
+/* Allocates a zeroed node, type or string of the unit being compiled.
+ * Passes share types and subtrees freely, so nodes aren't owned by their
+ * parents; instead every block is listed here and cc_ast_free releases
+ * them all once the unit is emitted.  Nodes are only made before code
+ * generation forks threads (see par.h), so the list needs no lock. */
+void * cc_ast_alloc(size_t size) {
+    cc_astblock * block = calloc(1, sizeof(cc_astblock) + size);
+    block->next = cc_ast_blocks;
+    cc_ast_blocks = block;
+    return block + 1;
+}
+
+char * cc_ast_strdup(char const * str) {
+    return strcpy(cc_ast_alloc(strlen(str) + 1), str);
+}
+
+/* Frees everything allocated by cc_ast_alloc */
+void cc_ast_free() {
+    while (cc_ast_blocks) {
+        cc_astblock * next = cc_ast_blocks->next;
+        free(cc_ast_blocks);
+        cc_ast_blocks = next;
+    }
+}
+
+cc_func * cc_find_func(cc_func * func, cc_id * id) {
+    for (; func; func = func->next) {
+        if (func->id == id) {
+            return func;
+        }
+    }
+    return 0;
+}
+
+cc_var * cc_find_var(cc_var * var, cc_id * id) {
+    for (; var; var = var->next) {
+        if (var->id == id) {
+            return var;
+        }
+    }
+    return 0;
+}
+
+/* The constructors below are used by passes that synthesize new AST nodes.
+ * The parser fills in its nodes directly. */
+cc_type * cc_type_init(int flags, cc_type * nested, cc_id * id) {
+    cc_type * type = cc_ast_alloc(sizeof(cc_type));
+    type->flags = flags;
+    type->nested = nested;
+    type->id = id;
+    return type;
+}
+
+cc_ref * cc_ref_init(int line, cc_id * id) {
+    cc_ref * ref = cc_ast_alloc(sizeof(cc_ref));
+    ref->node.node.line = line;
+    ref->node.node.type = CC_REF;
+    ref->id = id;
+    return ref;
+}
+
+cc_number * cc_number_init(int line, int value) {
+    cc_number * number = cc_ast_alloc(sizeof(cc_number));
+    char buf[16];
+    sprintf(buf, "%d", value);
+    number->node.node.line = line;
+    number->node.node.type = CC_NUMBER;
+    number->value = cc_ast_strdup(buf);
+    return number;
+}
+
+cc_binary * cc_binary_init(int line, int op, cc_expr * left, cc_expr * right) {
+    cc_binary * binary = cc_ast_alloc(sizeof(cc_binary));
+    binary->node.node.line = line;
+    binary->node.node.type = CC_BINARY;
+    binary->node.type = left->type;
+    binary->op = op;
+    binary->left = left;
+    binary->right = right;
+    return binary;
+}
+
+cc_simple * cc_simple_init(int line, cc_expr * expr) {
+    cc_simple * simple = cc_ast_alloc(sizeof(cc_simple));
+    simple->node.node.line = line;
+    simple->node.node.type = CC_SIMPLE;
+    simple->expr = expr;
+    return simple;
+}
+
+cc_var * cc_var_init(int line, cc_type * type, cc_id * id) {
+    cc_var * var = cc_ast_alloc(sizeof(cc_var));
+    var->node.line = line;
+    var->node.type = CC_VAR;
+    var->type = type;
+    var->id = id;
+    return var;
+}
+
+cc_block * cc_block_init(int line) {
+    cc_block * block = cc_ast_alloc(sizeof(cc_block));
+    block->node.node.line = line;
+    block->node.node.type = CC_BLOCK;
+    return block;
+}
+
+/* Returns a deep copy of 'self'.  The 'next' link of the copy is cleared, but
+ * lists owned by the node (e.g., call arguments) are copied in full.  Types
+ * and identifiers are shared, since they are never modified. */
+cc_expr * cc_expr_copy(cc_expr * self) {
+    cc_expr * copy = 0;
+    if (!self) {
+        return 0;
+    }
+    switch (self->node.type) {
+    case CC_MEMBER: {
+        cc_member * member = cc_ast_alloc(sizeof(cc_member));
+        *member = *(cc_member *)self;
+        member->expr = cc_expr_copy(member->expr);
+        copy = (cc_expr *)member;
+        break;
+    }
+    case CC_BINARY: {
+        cc_binary * binary = cc_ast_alloc(sizeof(cc_binary));
+        *binary = *(cc_binary *)self;
+        binary->left = cc_expr_copy(binary->left);
+        binary->right = cc_expr_copy(binary->right);
+        copy = (cc_expr *)binary;
+        break;
+    }
+    case CC_UNARY: {
+        cc_unary * unary = cc_ast_alloc(sizeof(cc_unary));
+        *unary = *(cc_unary *)self;
+        unary->expr = cc_expr_copy(unary->expr);
+        copy = (cc_expr *)unary;
+        break;
+    }
+    case CC_CALL: {
+        cc_call * call = cc_ast_alloc(sizeof(cc_call));
+        cc_expr * arg = 0;
+        cc_expr ** link = 0;
+        *call = *(cc_call *)self;
+        call->expr = cc_expr_copy(call->expr);
+        link = &call->args;
+        for (arg = ((cc_call *)self)->args; arg; arg = arg->next) {
+            *link = cc_expr_copy(arg);
+            link = &(*link)->next;
+        }
+        copy = (cc_expr *)call;
+        break;
+    }
+    case CC_REF:
+        copy = cc_ast_alloc(sizeof(cc_ref));
+        *(cc_ref *)copy = *(cc_ref *)self;
+        break;
+    case CC_NUMBER:
+        copy = cc_ast_alloc(sizeof(cc_number));
+        *(cc_number *)copy = *(cc_number *)self;
+        break;
+    case CC_STRING:
+        copy = cc_ast_alloc(sizeof(cc_string));
+        *(cc_string *)copy = *(cc_string *)self;
+        break;
+    default:
+        fprintf(stderr, "Invalid expression code\n");
+        return 0;
+    }
+    copy->next = 0;
+    return copy;
+}
+
+/* Returns a deep copy of the statement 'self', with the 'next' link cleared */
+cc_stmt * cc_stmt_copy(cc_stmt * self) {
+    cc_stmt * copy = 0;
+    if (!self) {
+        return 0;
+    }
+    switch (self->node.type) {
+    case CC_BLOCK:
+        copy = (cc_stmt *)cc_block_copy((cc_block *)self);
+        break;
+    case CC_IF: {
+        cc_if * stmt = cc_ast_alloc(sizeof(cc_if));
+        *stmt = *(cc_if *)self;
+        stmt->guard = cc_expr_copy(stmt->guard);
+        stmt->yes = cc_stmt_copy(stmt->yes);
+        stmt->no = cc_stmt_copy(stmt->no);
+        copy = (cc_stmt *)stmt;
+        break;
+    }
+    case CC_FOR:
+    case CC_WHILE: {
+        cc_loop * loop = cc_ast_alloc(sizeof(cc_loop));
+        *loop = *(cc_loop *)self;
+        loop->init = cc_expr_copy(loop->init);
+        loop->guard = cc_expr_copy(loop->guard);
+        loop->update = cc_expr_copy(loop->update);
+        loop->block = cc_block_copy(loop->block);
+        copy = (cc_stmt *)loop;
+        break;
+    }
+    case CC_SIMPLE: {
+        cc_simple * simple = cc_ast_alloc(sizeof(cc_simple));
+        *simple = *(cc_simple *)self;
+        simple->expr = cc_expr_copy(simple->expr);
+        copy = (cc_stmt *)simple;
+        break;
+    }
+    case CC_RETURN: {
+        cc_return * ret = cc_ast_alloc(sizeof(cc_return));
+        *ret = *(cc_return *)self;
+        ret->expr = cc_expr_copy(ret->expr);
+        copy = (cc_stmt *)ret;
+        break;
+    }
+    default:
+        fprintf(stderr, "Invalid statement code\n");
+        return 0;
+    }
+    copy->next = 0;
+    return copy;
+}
+
+/* Returns a deep copy of a block, including its variables and statements */
+cc_block * cc_block_copy(cc_block * self) {
+    cc_block * copy = 0;
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    cc_var ** vlink = 0;
+    cc_stmt ** slink = 0;
+    if (!self) {
+        return 0;
+    }
+    copy = cc_block_init(self->node.node.line);
+    vlink = &copy->vars;
+    for (var = self->vars; var; var = var->next) {
+        *vlink = cc_ast_alloc(sizeof(cc_var));
+        **vlink = *var;
+        (*vlink)->init = cc_expr_copy(var->init);
+        (*vlink)->next = 0;
+        vlink = &(*vlink)->next;
+    }
+    slink = &copy->stmts;
+    for (stmt = self->stmts; stmt; stmt = stmt->next) {
+        *slink = cc_stmt_copy(stmt);
+        slink = &(*slink)->next;
+    }
+    return copy;
+}
+
+/* Returns non-zero if the two expressions are structurally identical.  Since
+ * identifiers are interned, refs can be compared by pointer. */
+int cc_expr_equal(cc_expr * self, cc_expr * other) {
+    if (!self || !other) {
+        return self == other;
+    }
+    if (self->node.type != other->node.type) {
+        return 0;
+    }
+    switch (self->node.type) {
+    case CC_MEMBER:
+        return ((cc_member *)self)->id == ((cc_member *)other)->id
+            && cc_expr_equal(((cc_member *)self)->expr,
+                ((cc_member *)other)->expr);
+    case CC_BINARY:
+        return ((cc_binary *)self)->op == ((cc_binary *)other)->op
+            && cc_expr_equal(((cc_binary *)self)->left,
+                ((cc_binary *)other)->left)
+            && cc_expr_equal(((cc_binary *)self)->right,
+                ((cc_binary *)other)->right);
+    case CC_UNARY:
+        return ((cc_unary *)self)->op == ((cc_unary *)other)->op
+            && cc_expr_equal(((cc_unary *)self)->expr,
+                ((cc_unary *)other)->expr);
+    case CC_REF:
+        return ((cc_ref *)self)->id == ((cc_ref *)other)->id;
+    case CC_NUMBER:
+        return !strcmp(((cc_number *)self)->value,
+            ((cc_number *)other)->value);
+    case CC_STRING:
+        return !strcmp(((cc_string *)self)->value,
+            ((cc_string *)other)->value);
+    default:
+        return 0; /* Calls are never considered equal */
+    }
+}
+
+/* Truncates 'value' to a signed 16-bit machine word */
+int cc_word(int value) {
+    return ((value & 0xffff) ^ 0x8000) - 0x8000;
+}
+
+/* Evaluates 'self' at compile time if it is built only from integer literals
+ * and side-effect free operators.  Returns non-zero and stores the result in
+ * 'value' on success.  Arithmetic wraps at 16 bits, like the target, so
+ * nothing that involves a long is folded here (see cc_long_const). */
+int cc_expr_const(cc_expr * self, int * value) {
+    int left = 0;
+    int right = 0;
+    if (!self || cc_type_islong(self->type)) {
+        return 0;
+    }
+    if (CC_NUMBER == self->node.type) {
+        *value = cc_word(atoi(((cc_number *)self)->value));
+        return 1;
+    } else if (CC_UNARY == self->node.type) {
+        cc_unary * unary = (cc_unary *)self;
+        if (!cc_expr_const(unary->expr, &left)) {
+            return 0;
+        }
+        switch (unary->op) {
+        case '-': *value = cc_word(-left); return 1;
+        case '~': *value = cc_word(~left); return 1;
+        case '!': *value = !left; return 1;
+        default: return 0;
+        }
+    } else if (CC_BINARY == self->node.type) {
+        cc_binary * binary = (cc_binary *)self;
+        if (!cc_expr_const(binary->left, &left)) {
+            return 0;
+        }
+        if (!cc_expr_const(binary->right, &right)) {
+            return 0;
+        }
+        switch (binary->op) {
+        case '+': *value = cc_word(left + right); return 1;
+        case '-': *value = cc_word(left - right); return 1;
+        case '*': *value = cc_word(left * right); return 1;
+        case '/': *value = right ? cc_word(left / right) : 0; return 1;
+        case '%': *value = right ? cc_word(left % right) : 0; return 1;
+        case '&': *value = cc_word(left & right); return 1;
+        case '|': *value = cc_word(left | right); return 1;
+        case '^': *value = cc_word(left ^ right); return 1;
+        case '<': *value = left < right; return 1;
+        case '>': *value = left > right; return 1;
+        case CC_TOK_AND: *value = left && right; return 1;
+        case CC_TOK_OR: *value = left || right; return 1;
+        case CC_TOK_EQ: *value = left == right; return 1;
+        case CC_TOK_NE: *value = left != right; return 1;
+        case CC_TOK_LE: *value = left <= right; return 1;
+        case CC_TOK_GE: *value = left >= right; return 1;
+        case CC_TOK_LSHIFT: *value = cc_word(left << (right & 0xf)); return 1;
+        case CC_TOK_RSHIFT: *value = cc_word(left >> (right & 0xf)); return 1;
+        default: return 0;
+        }
+    }
+    return 0;
+}
+
+/* Returns the object a chain of member accesses selects from, so that s.a.b
+ * yields s. */
+cc_expr * cc_expr_root(cc_expr * self) {
+    while (self && CC_MEMBER == self->node.type) {
+        self = ((cc_member *)self)->expr;
+    }
+    return self;
+}
@@ -23,6 +23,8 @@
 #ifndef CC_AST_H
 #define CC_AST_H
 
+#include <stddef.h>
+
 /* Used to identify the type of AST node, as declared below. */
 typedef enum cc_asttype {
     CC_FUNC,
@@ -39,7 +41,8 @@ typedef enum cc_asttype {
     CC_NUMBER,
     CC_STRING,
     CC_RETURN,
-    CC_VAR
+    CC_VAR,
+    CC_STRUCT
 } cc_asttype;
 
 static int const CC_TYPE_PTR = 1;
@@ -54,7 +57,6 @@ typedef struct cc_astnode {
 
 /* Identifier.  These are cached in a global identifier table */
 typedef struct cc_id {
-    struct cc_id * next;
     char const * str;
 } cc_id;
 
@@ -65,6 +67,7 @@ typedef struct cc_type {
     int flags; 
     struct cc_type * nested;
     cc_id * id;
+    struct cc_struct * record; /* Definition of 'id' for a struct type */
 } cc_type;
 
 typedef struct cc_expr {
@@ -97,6 +100,7 @@ typedef struct cc_var {
     cc_expr * init; /* Initializer expr */
     cc_type * type;
     cc_id * id;
+    int offset; /* Offset of a struct field, in words */
     struct cc_var * next;
 } cc_var;
 
@@ -124,6 +128,7 @@ typedef struct cc_if {
     cc_expr * guard;
     cc_stmt * yes;
     cc_stmt * no;
+    int site; /* First profile counter (see pgo.h), or 0 */
 } cc_if;
 
 /* Used for all loop types.  If it's a while or do-while, then 'init' and
@@ -134,6 +139,8 @@ typedef struct cc_loop {
     cc_expr * guard;
     cc_expr * update;
     cc_block * block;
+    int unroll; /* Number of iterations per pass through 'block' if unrolled */
+    int site; /* First profile counter (see pgo.h), or 0 */
 } cc_loop;
 
 typedef struct cc_return {
@@ -143,10 +150,18 @@ typedef struct cc_return {
 
 
 /* Struct definition.  The 'var' field is a linked list of attributes of the
- * struct. */
+ * struct.  There is one per struct name, created when the name is first
+ * seen, so that pointers to it may be declared before the definition.  The
+ * layout is computed on first use and cached in 'size' and in the fields'
+ * offsets. */
 typedef struct cc_struct {
     cc_astnode node;
+    cc_id * id;
     cc_var * vars; 
+    int defined;
+    int size; /* In words, once laid out */
+    int laid; /* 1 once laid out, -1 while being laid out */
+    struct cc_struct * next;
 } cc_struct;
 
 /* Struct member dereference. 'left' is the expression to the left of the '.'
@@ -189,7 +204,24 @@ typedef struct cc_func {
     struct cc_func * next;
 } cc_func;
 
+void * cc_ast_alloc(size_t size);
+char * cc_ast_strdup(char const * str);
+void cc_ast_free();
 cc_func* cc_find_func(cc_func* func, cc_id * id);
 cc_var* cc_find_var(cc_var* var, cc_id * id);
+cc_type * cc_type_init(int flags, cc_type * nested, cc_id * id);
+cc_ref * cc_ref_init(int line, cc_id * id);
+cc_number * cc_number_init(int line, int value);
+cc_binary * cc_binary_init(int line, int op, cc_expr * left, cc_expr * right);
+cc_simple * cc_simple_init(int line, cc_expr * expr);
+cc_var * cc_var_init(int line, cc_type * type, cc_id * id);
+cc_block * cc_block_init(int line);
+cc_expr * cc_expr_copy(cc_expr * self);
+cc_stmt * cc_stmt_copy(cc_stmt * self);
+cc_block * cc_block_copy(cc_block * self);
+int cc_expr_equal(cc_expr * self, cc_expr * other);
+int cc_expr_const(cc_expr * self, int * value);
+cc_expr * cc_expr_root(cc_expr * self);
+int cc_word(int value);
 
 #endif
@@ -0,0 +1,40 @@
+/* Emulator benchmark, run by 'make bench'.  A mix of the loops, calls,
+ * arithmetic and memory traffic that compiled code spends its time in. */
+int * data = 32768;
+
+int mix(int x, int y) {
+    return (x * 3 + y) & 255;
+}
+
+int sieve(int n) {
+    int i;
+    int k;
+    int count;
+    for (i = 0; i < n; i = i + 1) {
+        *(data + i) = 1;
+    }
+    count = 0;
+    for (i = 2; i < n; i = i + 1) {
+        if (*(data + i)) {
+            count = count + 1;
+            for (k = i + i; k < n; k = k + i) {
+                *(data + k) = 0;
+            }
+        }
+    }
+    return count;
+}
+
+int main() {
+    int round;
+    int i;
+    int sum;
+    sum = 0;
+    for (round = 0; round < 30000; round = round + 1) {
+        sum = sum + sieve(256);
+        for (i = 0; i < 64; i = i + 1) {
+            sum = mix(sum, i) + (sum >> 3);
+        }
+    }
+    return sum;
+}
@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "burs.h"
+#include "check.h"
+#include "frame.h"
+#include <stdlib.h>
+
+/* The grammar.  Each row is a rule: name, nonterminal, operator (NONE for
+ * a chain rule), the nonterminals of the operands, and the cost in cycles
+ * of the code the rule emits, including the next word of the operand it
+ * forms. */
+#define CC_BURS_GRAMMAR(R) \
+    R(CONST, IMM, CON, NONE, NONE, 0)     /* imm: CON */ \
+    R(SYMBOL, ADR, SYM, NONE, NONE, 0)    /* adr: SYM */ \
+    R(REGVAR, REG, RVAR, NONE, NONE, 0)   /* reg: RVAR */ \
+    R(MEMVAR, MEM, MVAR, NONE, NONE, 1)   /* mem: MVAR */ \
+    R(OTHER, REG, OTHER, NONE, NONE, 0)   /* reg: OTHER */ \
+    R(FOLD, IMM, ADD, IMM, IMM, 0)        /* imm: ADD(imm, imm) */ \
+    R(SYMOFF, ADR, ADD, ADR, IMM, 0)      /* adr: ADD(adr, imm) */ \
+    R(INDEX, IDX, ADD, REG, IMM, 0)       /* idx: ADD(reg, imm) */ \
+    R(INDEXSYM, IDX, ADD, REG, ADR, 0)    /* idx: ADD(reg, adr) */ \
+    R(INDEXADD, IDX, ADD, IDX, IMM, 0)    /* idx: ADD(idx, imm) */ \
+    R(ADDREG, REG, ADD, REG, REG, 2)      /* reg: ADD(reg, reg) */ \
+    R(ADDMEM, REG, ADD, REG, MEM, 2)      /* reg: ADD(reg, mem) */ \
+    R(ADDIMM, REG, ADD, REG, IMM, 3)      /* reg: ADD(reg, imm) */ \
+    R(IND, MEM, DEREF, REG, NONE, 0)      /* mem: DEREF(reg) */ \
+    R(OFF, MEM, DEREF, IDX, NONE, 1)      /* mem: DEREF(idx) */ \
+    R(ABS, MEM, DEREF, IMM, NONE, 1)      /* mem: DEREF(imm) */ \
+    R(ABSSYM, MEM, DEREF, ADR, NONE, 1)   /* mem: DEREF(adr) */ \
+    R(LOADMEM, REG, NONE, MEM, NONE, 1)   /* reg: mem */ \
+    R(LOADIMM, REG, NONE, IMM, NONE, 2)   /* reg: imm */ \
+    R(LOADADR, REG, NONE, ADR, NONE, 2)   /* reg: adr */ \
+    R(LOADIDX, REG, NONE, IDX, NONE, 3)   /* reg: idx */
+
+#define CC_BURS_NUMBER(name, nt, op, left, right, cost) CC_BURS_RULE_##name,
+#define CC_BURS_ENTRY(name, nt, op, left, right, cost) \
+    { CC_BURS_##nt, CC_BURS_##op, { CC_BURS_##left, CC_BURS_##right }, cost },
+
+enum {
+    CC_BURS_GRAMMAR(CC_BURS_NUMBER)
+    CC_BURS_RULES
+};
+
+static cc_bursrule const cc_burs_rules[CC_BURS_RULES] = {
+    CC_BURS_GRAMMAR(CC_BURS_ENTRY)
+};
+
+static cc_bursnode * cc_burs_node(int op, cc_bursnode * left,
+    cc_bursnode * right) {
+
+    cc_bursnode * self = calloc(1, sizeof(cc_bursnode));
+    self->op = op;
+    self->kids[0] = left;
+    self->kids[1] = right;
+    return self;
+}
+
+static cc_bursnode * cc_burs_con(int value) {
+    cc_bursnode * self = cc_burs_node(CC_BURS_CON, 0, 0);
+    self->value = cc_word(value);
+    return self;
+}
+
+static cc_bursnode * cc_burs_other(cc_expr * expr) {
+    cc_bursnode * self = cc_burs_node(CC_BURS_OTHER, 0, 0);
+    self->expr = expr;
+    return self;
+}
+
+/* Builds the subject tree for the lvalue 'expr', or returns null if it
+ * isn't a variable, a '*' or a field access */
+cc_bursnode * cc_burs_tree(cc_gen * gen, cc_expr * expr) {
+    cc_bursnode * self = 0;
+    cc_var * field = 0;
+    if (CC_REF == expr->node.type) {
+        cc_id * id = ((cc_ref *)expr)->id;
+        cc_local * local = cc_gen_local(gen, id);
+        if (!local && !cc_env_var(gen->env, id)) {
+            return 0;
+        }
+        self = cc_burs_node(local && local->reg >= 0 ? CC_BURS_RVAR
+            : CC_BURS_MVAR, 0, 0);
+        self->id = id;
+        return self;
+    } else if (CC_UNARY == expr->node.type && '*' == ((cc_unary *)expr)->op) {
+        cc_unary * unary = (cc_unary *)expr;
+        if (CC_UNARY == unary->expr->node.type
+            && '&' == ((cc_unary *)unary->expr)->op) {
+            return cc_burs_tree(gen, ((cc_unary *)unary->expr)->expr);
+        }
+        return cc_burs_node(CC_BURS_DEREF, cc_burs_value(gen, unary->expr), 0);
+    } else if (CC_MEMBER != expr->node.type) {
+        return 0;
+    }
+    self = cc_burs_tree(gen, ((cc_member *)expr)->expr);
+    field = cc_type_field(((cc_member *)expr)->expr->type,
+        ((cc_member *)expr)->id);
+    if (!self || !field || !field->offset) {
+        return self;
+    }
+    if (CC_BURS_MVAR == self->op) {
+        self->value += field->offset;
+    } else if (CC_BURS_DEREF == self->op) {
+        self->kids[0] = cc_burs_node(CC_BURS_ADD, self->kids[0],
+            cc_burs_con(field->offset));
+    }
+    return self;
+}
+
+/* Builds the subject tree for the address of the lvalue 'expr' */
+static cc_bursnode * cc_burs_addr(cc_gen * gen, cc_expr * expr) {
+    cc_bursnode * self = cc_burs_tree(gen, expr);
+    cc_bursnode * kid = 0;
+    if (self && CC_BURS_MVAR == self->op && !cc_gen_local(gen, self->id)) {
+        self->op = CC_BURS_SYM;
+        return self;
+    } else if (self && CC_BURS_DEREF == self->op) {
+        kid = self->kids[0];
+        free(self);
+        return kid;
+    }
+    cc_burs_free(self);
+    return 0;
+}
+
+/* Builds the subject tree for the value of 'expr'.  Pointer arithmetic is
+ * scaled here, and constants are put on the right of an ADD. */
+cc_bursnode * cc_burs_value(cc_gen * gen, cc_expr * expr) {
+    cc_bursnode * self = 0;
+    cc_binary * binary = (cc_binary *)expr;
+    cc_expr * left = 0;
+    cc_expr * right = 0;
+    int size = 1;
+    int value = 0;
+
+    if (cc_expr_const(expr, &value)) {
+        return cc_burs_con(value);
+    }
+    switch (expr->node.type) {
+    case CC_REF:
+    case CC_MEMBER:
+        self = cc_burs_tree(gen, expr);
+        break;
+    case CC_UNARY:
+        if ('*' == ((cc_unary *)expr)->op) {
+            self = cc_burs_tree(gen, expr);
+        } else if ('&' == ((cc_unary *)expr)->op) {
+            self = cc_burs_addr(gen, ((cc_unary *)expr)->expr);
+        }
+        break;
+    case CC_BINARY:
+        left = binary->left;
+        right = binary->right;
+        if ('+' == binary->op && cc_type_isptr(right->type)) {
+            left = binary->right;
+            right = binary->left;
+        }
+        if (cc_type_isptr(right->type)
+            || ('+' != binary->op && '-' != binary->op)) {
+            break;
+        }
+        if (cc_type_isptr(left->type)) {
+            size = cc_type_size(left->type->nested);
+        }
+        if (cc_expr_const(right, &value)) {
+            value = '-' == binary->op ? -value : value;
+            self = cc_burs_node(CC_BURS_ADD, cc_burs_value(gen, left),
+                cc_burs_con(value * size));
+        } else if ('+' == binary->op && 1 == size) {
+            self = cc_burs_node(CC_BURS_ADD, cc_burs_value(gen, left),
+                cc_burs_value(gen, right));
+            if (CC_BURS_SYM == self->kids[0]->op) {
+                cc_bursnode * kid = self->kids[0];
+                self->kids[0] = self->kids[1];
+                self->kids[1] = kid;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+    return self ? self : cc_burs_other(expr);
+}
+
+/* Finds the cheapest rule deriving each nonterminal at 'node', after its
+ * operands.  Chain rules are applied until no cost improves. */
+void cc_burs_label(cc_bursnode * node) {
+    cc_bursrule const * rule = 0;
+    int changed = 1;
+    int cost = 0;
+    int i = 0;
+    int k = 0;
+
+    for (k = 0; k < 2; ++k) {
+        if (node->kids[k]) {
+            cc_burs_label(node->kids[k]);
+        }
+    }
+    for (i = 0; i < CC_BURS_NTS; ++i) {
+        node->cost[i] = CC_BURS_INF;
+        node->rule[i] = -1;
+    }
+    for (i = 0; i < CC_BURS_RULES; ++i) {
+        rule = cc_burs_rules + i;
+        if (rule->op != node->op) {
+            continue;
+        }
+        cost = rule->cost;
+        for (k = 0; k < 2; ++k) {
+            if (CC_BURS_NONE != rule->kids[k]) {
+                cost += node->kids[k] ? node->kids[k]->cost[rule->kids[k]]
+                    : CC_BURS_INF;
+            }
+        }
+        if (cost < node->cost[rule->nt]) {
+            node->cost[rule->nt] = cost;
+            node->rule[rule->nt] = i;
+        }
+    }
+    while (changed) {
+        changed = 0;
+        for (i = 0; i < CC_BURS_RULES; ++i) {
+            rule = cc_burs_rules + i;
+            if (CC_BURS_NONE != rule->op) {
+                continue;
+            }
+            cost = node->cost[rule->kids[0]] + rule->cost;
+            if (cost < node->cost[rule->nt]) {
+                node->cost[rule->nt] = cost;
+                node->rule[rule->nt] = i;
+                changed = 1;
+            }
+        }
+    }
+}
+
+/* Returns the operand that holds variable 'node', plus its field offset */
+static cc_operand cc_burs_home(cc_gen * gen, cc_bursnode * node) {
+    cc_local * local = cc_gen_local(gen, node->id);
+    cc_operand opd = local ? cc_frame_home(gen, local)
+        : cc_opd_mem(node->id, 0);
+    if (!node->value) {
+        return opd;
+    }
+    switch (opd.mode) {
+    case CC_VAL_IND:
+    case CC_VAL_OFF:
+        return cc_opd_off(opd.reg, opd.value + node->value);
+    default:
+        opd.value += node->value;
+        return opd;
+    }
+}
+
+/* Emits the code for the tiling of 'node' that derives 'nt', and returns
+ * the operand that holds the result.  An 'idx' is returned as an OFF
+ * operand, even when the offset is zero. */
+cc_operand cc_burs_reduce(cc_gen * gen, cc_bursnode * node, int nt) {
+    int rule = node->rule[nt];
+    cc_bursrule const * r = cc_burs_rules + rule;
+    cc_operand left;
+    cc_operand right;
+
+    switch (rule) {
+    case CC_BURS_RULE_CONST:
+        return cc_opd_lit(node->value);
+    case CC_BURS_RULE_SYMBOL:
+        left = cc_opd_sym(node->id);
+        left.value = node->value;
+        return left;
+    case CC_BURS_RULE_REGVAR:
+    case CC_BURS_RULE_MEMVAR:
+        return cc_burs_home(gen, node);
+    case CC_BURS_RULE_OTHER:
+        return cc_gen_load(gen, cc_gen_expr(gen, node->expr));
+    case CC_BURS_RULE_FOLD:
+    case CC_BURS_RULE_SYMOFF:
+    case CC_BURS_RULE_INDEX:
+    case CC_BURS_RULE_INDEXSYM:
+    case CC_BURS_RULE_INDEXADD:
+        left = cc_burs_reduce(gen, node->kids[0], r->kids[0]);
+        right = cc_burs_reduce(gen, node->kids[1], r->kids[1]);
+        if (CC_BURS_RULE_INDEX == rule || CC_BURS_RULE_INDEXSYM == rule) {
+            left.mode = CC_VAL_OFF;
+            left.value = 0;
+        }
+        left.value = cc_word(left.value + right.value);
+        left.sym = left.sym ? left.sym : right.sym;
+        return left;
+    case CC_BURS_RULE_ADDREG:
+    case CC_BURS_RULE_ADDMEM:
+    case CC_BURS_RULE_ADDIMM:
+        left = cc_gen_load(gen, cc_burs_reduce(gen, node->kids[0], r->kids[0]));
+        right = cc_burs_reduce(gen, node->kids[1], r->kids[1]);
+        cc_gen_emit(gen, CC_OP_ADD, left, right);
+        cc_gen_release(gen, right);
+        return left;
+    case CC_BURS_RULE_IND:
+        left = cc_burs_reduce(gen, node->kids[0], r->kids[0]);
+        return cc_opd_ind(left.reg);
+    case CC_BURS_RULE_OFF:
+        left = cc_burs_reduce(gen, node->kids[0], r->kids[0]);
+        if (!left.value && !left.sym) {
+            left.mode = CC_VAL_IND;
+        }
+        return left;
+    case CC_BURS_RULE_ABS:
+    case CC_BURS_RULE_ABSSYM:
+        left = cc_burs_reduce(gen, node->kids[0], r->kids[0]);
+        left.mode = CC_VAL_MEM;
+        return left;
+    case CC_BURS_RULE_LOADIDX:
+        left = cc_burs_reduce(gen, node, r->kids[0]);
+        right = cc_opd_lit(left.value);
+        right.sym = left.sym;
+        left = cc_gen_load(gen, cc_opd_reg(left.reg));
+        if (right.value || right.sym) {
+            cc_gen_emit(gen, CC_OP_ADD, left, right);
+        }
+        return left;
+    default:
+        /* Loads */
+        return cc_gen_load(gen, cc_burs_reduce(gen, node, r->kids[0]));
+    }
+}
+
+void cc_burs_free(cc_bursnode * node) {
+    if (node) {
+        cc_burs_free(node->kids[0]);
+        cc_burs_free(node->kids[1]);
+        free(node);
+    }
+}
+
+/* Selects the operand for the lvalue 'expr' by tiling, and stores it in
+ * 'opd'.  Returns 0 if 'expr' isn't covered by the grammar. */
+int cc_burs_lvalue(cc_gen * gen, cc_expr * expr, cc_operand * opd) {
+    cc_bursnode * tree = cc_burs_tree(gen, expr);
+    int nt = CC_BURS_MEM;
+    if (!tree) {
+        return 0;
+    }
+    cc_burs_label(tree);
+    if (CC_BURS_RVAR == tree->op) {
+        nt = CC_BURS_REG;
+    }
+    *opd = cc_burs_reduce(gen, tree, nt);
+    cc_burs_free(tree);
+    gen->tiled++;
+    return 1;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_BURS_H
+#define CC_BURS_H
+
+#include "gen.h"
+
+/* Bottom-up rewrite selector for memory operands.  A DCPU-16 operand can
+ * be a register, [register], [register + next word], [next word] or a
+ * literal, so the address computations under a '*' or a field access
+ * often fold into the operand itself.  The expression is turned into a
+ * subject tree of the operators below, labeled bottom up with the cheapest
+ * way to derive each nonterminal at each node, and then reduced top down,
+ * which emits the code of the cheapest tiling in time linear in the size
+ * of the tree.  Subtrees the grammar doesn't cover are OTHER leaves, and
+ * are generated by the simple selector in gen.c.
+ *
+ * The rules are listed in burs.c as a single table, one row per rule of
+ * the form
+ *
+ *     nonterminal: OPERATOR(nonterminal, nonterminal)  cost
+ *
+ * from which the rule numbers and the matcher's rule array are generated.
+ * Costs are in cycles, counting the next word of an operand. */
+
+/* Operators of the subject tree */
+#define CC_BURS_CON 0 /* Constant */
+#define CC_BURS_SYM 1 /* Address of a global plus a constant */
+#define CC_BURS_RVAR 2 /* Variable held in a register */
+#define CC_BURS_MVAR 3 /* Variable in memory, plus a field offset */
+#define CC_BURS_ADD 4
+#define CC_BURS_DEREF 5
+#define CC_BURS_OTHER 6 /* Any other expression */
+#define CC_BURS_OPS 7
+
+/* Nonterminals: what a subtree can be reduced to.  'idx' is a register
+ * plus a constant, which is only an operand as [register + next word]. */
+#define CC_BURS_NONE -1
+#define CC_BURS_REG 0
+#define CC_BURS_MEM 1
+#define CC_BURS_IMM 2
+#define CC_BURS_ADR 3
+#define CC_BURS_IDX 4
+#define CC_BURS_NTS 5
+
+/* Cost of a nonterminal that can't be derived */
+#define CC_BURS_INF 0x7fff
+
+typedef struct cc_bursnode {
+    int op;
+    cc_expr * expr; /* For OTHER, the expression */
+    cc_id * id; /* For SYM and the variables */
+    int value; /* For CON and SYM, the constant; for MVAR, the offset */
+    struct cc_bursnode * kids[2];
+    int cost[CC_BURS_NTS];
+    int rule[CC_BURS_NTS];
+} cc_bursnode;
+
+typedef struct cc_bursrule {
+    int nt; /* Nonterminal the rule derives */
+    int op; /* Operator it matches, or CC_BURS_NONE for a chain rule */
+    int kids[2]; /* Nonterminals of the operands, or of a chain's source */
+    int cost;
+} cc_bursrule;
+
+int cc_burs_lvalue(cc_gen * gen, cc_expr * expr, cc_operand * opd);
+cc_bursnode * cc_burs_tree(cc_gen * gen, cc_expr * expr);
+cc_bursnode * cc_burs_value(cc_gen * gen, cc_expr * expr);
+void cc_burs_label(cc_bursnode * node);
+cc_operand cc_burs_reduce(cc_gen * gen, cc_bursnode * node, int nt);
+void cc_burs_free(cc_bursnode * node);
+
+#endif
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "check.h"
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Creates a new checker for the program in 'env' */
+cc_check * cc_check_init(cc_env * env) {
+    cc_check * self = calloc(1, sizeof(cc_check));
+    cc_type * chr = cc_type_init(0, 0, cc_env_id(env, "char"));
+    self->env = env;
+    self->int_type = cc_type_init(0, 0, cc_env_id(env, "int"));
+    self->unsigned_type = cc_type_init(0, 0, cc_env_id(env, "unsigned"));
+    self->long_type = cc_type_init(0, 0, cc_env_id(env, "long"));
+    self->string_type = cc_type_init(CC_TYPE_PTR, chr, 0);
+    return self;
+}
+
+/* Checks every struct, global initializer and function in the program */
+void cc_check_env(cc_check * self) {
+    cc_struct * record = 0;
+    cc_func * func = 0;
+    cc_var * var = 0;
+    for (record = self->env->structs; record; record = record->next) {
+        if (!record->defined) {
+            continue;
+        }
+        for (var = record->vars; var; var = var->next) {
+            cc_check_type(self, var->node.line, var->type);
+        }
+        if (cc_struct_layout(record) < 0) {
+            cc_check_err(self, record->node.line, "Struct contains itself");
+        }
+    }
+    for (var = self->env->vars; var; var = var->next) {
+        cc_check_type(self, var->node.line, var->type);
+        if (var->init) {
+            cc_check_expr(self, var->init);
+        }
+    }
+    for (func = self->env->funcs; func; func = func->next) {
+        cc_check_func(self, func);
+    }
+}
+
+/* Leaves the scopes entered since the head of the chain was 'syms' */
+static void cc_check_pop(cc_check * self, cc_sym * syms) {
+    while (self->syms != syms) {
+        cc_sym * next = self->syms->next;
+        free(self->syms);
+        self->syms = next;
+    }
+}
+
+void cc_check_free(cc_check * self) {
+    cc_check_pop(self, 0);
+    free(self);
+}
+
+void cc_check_func(cc_check * self, cc_func * func) {
+    cc_formal * formal = 0;
+    cc_sym * syms = self->syms;
+    if (!func->block) {
+        return;
+    }
+    self->func = func;
+    for (formal = func->formals; formal; formal = formal->next) {
+        if (cc_type_size(formal->type) != 1) {
+            cc_check_err(self, func->node.line,
+                "Parameters must be one word wide");
+        }
+        cc_check_push(self, formal->id, formal->type);
+    }
+    if (cc_type_size(func->type) != 1) {
+        cc_check_err(self, func->node.line, "Results must be one word wide");
+    }
+    cc_check_block(self, func->block);
+    cc_check_pop(self, syms);
+    self->func = 0;
+}
+
+void cc_check_block(cc_check * self, cc_block * block) {
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    cc_sym * syms = self->syms;
+    for (var = block->vars; var; var = var->next) {
+        cc_check_type(self, var->node.line, var->type);
+        if (var->init) {
+            cc_check_expr(self, var->init);
+        }
+        cc_check_push(self, var->id, var->type);
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_check_stmt(self, stmt);
+    }
+    cc_check_pop(self, syms);
+}
+
+void cc_check_stmt(cc_check * self, cc_stmt * stmt) {
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_check_block(self, (cc_block *)stmt);
+        break;
+    case CC_IF: {
+        cc_if * stmt_if = (cc_if *)stmt;
+        cc_check_expr(self, stmt_if->guard);
+        if (stmt_if->yes) {
+            cc_check_stmt(self, stmt_if->yes);
+        }
+        if (stmt_if->no) {
+            cc_check_stmt(self, stmt_if->no);
+        }
+        break;
+    }
+    case CC_FOR:
+    case CC_WHILE: {
+        cc_loop * loop = (cc_loop *)stmt;
+        cc_check_expr(self, loop->init);
+        cc_check_expr(self, loop->guard);
+        cc_check_expr(self, loop->update);
+        if (loop->block) {
+            cc_check_block(self, loop->block);
+        }
+        break;
+    }
+    case CC_SIMPLE:
+        cc_check_expr(self, ((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN:
+        cc_check_expr(self, ((cc_return *)stmt)->expr);
+        break;
+    default:
+        fprintf(stderr, "Invalid statement code\n");
+        break;
+    }
+}
+
+/* Annotates 'expr' and all of its subexpressions with their types.  Pointer
+ * arithmetic yields the pointer type, and arithmetic on a long yields a
+ * long; everything else is a word-sized int.  A literal is a long if it has
+ * an 'L' suffix or is larger than the largest int, as in C90 with 16-bit
+ * ints. */
+void cc_check_expr(cc_check * self, cc_expr * expr) {
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER: {
+        cc_member * member = (cc_member *)expr;
+        cc_var * field = 0;
+        cc_check_expr(self, member->expr);
+        field = cc_type_field(member->expr->type, member->id);
+        if (!field) {
+            cc_check_err(self, expr->node.line, "No such field");
+        }
+        expr->type = field ? field->type : self->int_type;
+        break;
+    }
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        cc_check_expr(self, binary->left);
+        cc_check_expr(self, binary->right);
+        if ('=' == binary->op || ',' == binary->op) {
+            expr->type = ('=' == binary->op)
+                ? binary->left->type : binary->right->type;
+        } else if (('+' == binary->op || '-' == binary->op)
+            && cc_type_isptr(binary->left->type)) {
+            expr->type = binary->left->type;
+            if ('-' == binary->op && cc_type_isptr(binary->right->type)) {
+                expr->type = self->int_type;
+            }
+        } else if ('+' == binary->op && cc_type_isptr(binary->right->type)) {
+            expr->type = binary->right->type;
+        } else if (cc_check_iscompare(binary->op)) {
+            expr->type = self->int_type;
+        } else if (CC_TOK_LSHIFT == binary->op
+            || CC_TOK_RSHIFT == binary->op) {
+            /* A shift has the type of its left operand alone */
+            expr->type = cc_type_islong(binary->left->type) ? self->long_type
+                : cc_type_isunsigned(binary->left->type) ? self->unsigned_type
+                : self->int_type;
+        } else if (cc_type_islong(binary->left->type)
+            || cc_type_islong(binary->right->type)) {
+            expr->type = self->long_type;
+        } else if (cc_type_isunsigned(binary->left->type)
+            || cc_type_isunsigned(binary->right->type)) {
+            expr->type = self->unsigned_type;
+        } else {
+            expr->type = self->int_type;
+        }
+        break;
+    }
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        cc_check_expr(self, unary->expr);
+        if ('*' == unary->op && cc_type_isptr(unary->expr->type)) {
+            expr->type = unary->expr->type->nested;
+        } else if ('&' == unary->op) {
+            expr->type = cc_type_init(CC_TYPE_PTR, unary->expr->type, 0);
+        } else if ('!' != unary->op && cc_type_islong(unary->expr->type)) {
+            expr->type = self->long_type;
+        } else if ('!' != unary->op && cc_type_isunsigned(unary->expr->type)) {
+            expr->type = self->unsigned_type;
+        } else {
+            expr->type = self->int_type;
+        }
+        break;
+    }
+    case CC_CALL: {
+        cc_call * call = (cc_call *)expr;
+        cc_expr * arg = 0;
+        if (CC_REF == call->expr->node.type) {
+            /* An undeclared callee is an external function returning an
+             * int, as in K&R C */
+            call->expr->type = cc_check_lookup(self,
+                ((cc_ref *)call->expr)->id);
+            if (!call->expr->type) {
+                call->expr->type = self->int_type;
+            }
+        } else {
+            cc_check_expr(self, call->expr);
+        }
+        for (arg = call->args; arg; arg = arg->next) {
+            cc_check_expr(self, arg);
+        }
+        expr->type = call->expr->type;
+        break;
+    }
+    case CC_REF:
+        expr->type = cc_check_lookup(self, ((cc_ref *)expr)->id);
+        if (!expr->type) {
+            cc_check_err(self, expr->node.line, "Undeclared identifier");
+            expr->type = self->int_type;
+        }
+        break;
+    case CC_NUMBER: {
+        char const * value = ((cc_number *)expr)->value;
+        expr->type = self->int_type;
+        if (strchr(value, 'L') || strtol(value, 0, 10) > 0x7fff) {
+            expr->type = self->long_type;
+        }
+        break;
+    }
+    case CC_STRING:
+        expr->type = self->string_type;
+        break;
+    default:
+        fprintf(stderr, "Invalid expression code\n");
+        break;
+    }
+}
+
+/* Returns the type bound to 'id' in the innermost scope, falling back to
+ * globals and then functions.  A function name has the function's return
+ * type, so that calls through it are typed correctly.  Returns 0 if 'id'
+ * isn't declared. */
+cc_type * cc_check_lookup(cc_check * self, cc_id * id) {
+    cc_sym * sym = 0;
+    cc_var * var = 0;
+    cc_func * func = 0;
+    for (sym = self->syms; sym; sym = sym->next) {
+        if (sym->id == id) {
+            return sym->type;
+        }
+    }
+    if ((var = cc_find_var(self->env->vars, id))) {
+        return var->type;
+    }
+    if ((func = cc_find_func(self->env->funcs, id))) {
+        return func->type;
+    }
+    return 0;
+}
+
+/* Reports an error if values of 'type' can't be stored, because it is a
+ * struct that isn't defined */
+void cc_check_type(cc_check * self, int line, cc_type * type) {
+    if (type->record && !type->flags && !type->record->defined) {
+        cc_check_err(self, line, "Struct is not defined");
+    }
+}
+
+void cc_check_push(cc_check * self, cc_id * id, cc_type * type) {
+    cc_sym * sym = calloc(1, sizeof(cc_sym));
+    sym->id = id;
+    sym->type = type;
+    sym->next = self->syms;
+    self->syms = sym;
+}
+
+/* Returns non-zero if 'op' is a comparison or logical operator, which
+ * always yields an int */
+int cc_check_iscompare(int op) {
+    switch (op) {
+    case '<': case '>': case CC_TOK_LE: case CC_TOK_GE:
+    case CC_TOK_EQ: case CC_TOK_NE: case CC_TOK_AND: case CC_TOK_OR:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Returns non-zero if values of 'type' are addresses */
+int cc_type_isptr(cc_type * type) {
+    return type && (type->flags & (CC_TYPE_PTR | CC_TYPE_ARRAY));
+}
+
+/* Returns non-zero if values of 'type' compare and divide as unsigned
+ * numbers.  Addresses are unsigned. */
+int cc_type_isunsigned(cc_type * type) {
+    if (!type) {
+        return 0;
+    }
+    if (cc_type_isptr(type)) {
+        return 1;
+    }
+    return type->id && !strcmp(type->id->str, "unsigned");
+}
+
+/* Returns non-zero if 'type' and 'other' are the same type */
+int cc_type_equal(cc_type * type, cc_type * other) {
+    if (!type || !other) {
+        return type == other;
+    }
+    return type->flags == other->flags && type->record == other->record
+        && cc_type_equal(type->nested, other->nested)
+        && (type->id == other->id || (type->id && other->id
+            && !strcmp(type->id->str, other->id->str)));
+}
+
+/* Returns non-zero if values of 'type' are 32-bit integers */
+int cc_type_islong(cc_type * type) {
+    return type && !type->flags && type->id && !strcmp(type->id->str, "long");
+}
+
+/* Returns the size of a value of 'type' in 16-bit words.  Every scalar type
+ * except long, including char, occupies one word on the DCPU-16. */
+int cc_type_size(cc_type * type) {
+    if (type && type->record && !type->flags) {
+        int size = cc_struct_layout(type->record);
+        return size > 0 ? size : 0;
+    }
+    return cc_type_islong(type) ? 2 : 1;
+}
+
+/* Returns the field 'id' of values of 'type', or 0 if 'type' isn't a struct
+ * with such a field.  The field's offset is valid. */
+cc_var * cc_type_field(cc_type * type, cc_id * id) {
+    cc_var * field = 0;
+    if (!type || !type->record || type->flags) {
+        return 0;
+    }
+    cc_struct_layout(type->record);
+    for (field = type->record->vars; field; field = field->next) {
+        if (field->id == id) {
+            return field;
+        }
+    }
+    return 0;
+}
+
+/* Lays out the fields of 'record' one after another, with no padding, since
+ * every type is a whole number of words.  The result is cached.  Returns
+ * the size in words, or -1 if the struct contains itself. */
+int cc_struct_layout(cc_struct * record) {
+    cc_var * field = 0;
+    int size = 0;
+    if (record->laid) {
+        return record->laid < 0 ? -1 : record->size;
+    }
+    record->laid = -1;
+    for (field = record->vars; field; field = field->next) {
+        field->offset = size;
+        if (field->type->record && !field->type->flags
+            && cc_struct_layout(field->type->record) < 0) {
+            return -1;
+        }
+        size += cc_type_size(field->type);
+    }
+    record->size = size;
+    record->laid = 1;
+    return size;
+}
+
+void cc_check_err(cc_check * self, int line, char const * msg) {
+    fprintf(stderr, "%d: %s\n", line, msg);
+    self->errors++;
+}
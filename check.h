@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_CHECK_H
+#define CC_CHECK_H
+
+#include "env.h"
+#include "ast.h"
+
+/* Entry in the scope chain.  Scopes are a stack: entering a block pushes its
+ * variables, and leaving it restores the previous head of the list. */
+typedef struct cc_sym {
+    cc_id * id;
+    cc_type * type;
+    struct cc_sym * next;
+} cc_sym;
+
+/* Semantic checker.  Resolves identifiers and annotates each expression with
+ * its type, which later passes use for pointer arithmetic and temporaries. */
+typedef struct cc_check {
+    cc_env * env;
+    cc_func * func; /* Function being checked */
+    cc_sym * syms; /* Innermost scope first */
+    cc_type * int_type;
+    cc_type * unsigned_type;
+    cc_type * long_type;
+    cc_type * string_type;
+    int errors;
+} cc_check;
+
+cc_check * cc_check_init(cc_env * env);
+void cc_check_free(cc_check * self);
+void cc_check_env(cc_check * self);
+void cc_check_func(cc_check * self, cc_func * func);
+void cc_check_block(cc_check * self, cc_block * block);
+void cc_check_stmt(cc_check * self, cc_stmt * stmt);
+void cc_check_expr(cc_check * self, cc_expr * expr);
+cc_type * cc_check_lookup(cc_check * self, cc_id * id);
+void cc_check_type(cc_check * self, int line, cc_type * type);
+void cc_check_push(cc_check * self, cc_id * id, cc_type * type);
+int cc_check_iscompare(int op);
+int cc_type_isptr(cc_type * type);
+int cc_type_isunsigned(cc_type * type);
+int cc_type_islong(cc_type * type);
+int cc_type_equal(cc_type * type, cc_type * other);
+int cc_type_size(cc_type * type);
+cc_var * cc_type_field(cc_type * type, cc_id * id);
+int cc_struct_layout(cc_struct * record);
+void cc_check_err(cc_check * self, int line, char const * msg);
+
+#endif
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "code.h"
+#include <stdlib.h>
+#include <string.h>
+
+cc_code * cc_code_init(cc_id * id) {
+    cc_code * self = calloc(1, sizeof(cc_code));
+    self->id = id;
+    self->weight = 1;
+    return self;
+}
+
+/* Frees the buffer and the ones linked after it */
+void cc_code_free(cc_code * self) {
+    while (self) {
+        cc_code * next = self->next;
+        free(self->insts);
+        free(self);
+        self = next;
+    }
+}
+
+/* Appends an instruction to the buffer, and returns it */
+cc_inst * cc_code_emit(cc_code * self, int op, cc_operand b, cc_operand a) {
+    return cc_code_insert(self, self->count, op, b, a);
+}
+
+/* Inserts an instruction before instruction 'index' */
+cc_inst * cc_code_insert(cc_code * self, int index, int op, cc_operand b,
+    cc_operand a) {
+
+    cc_inst * inst = 0;
+    if (self->count >= self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 64;
+        self->insts = realloc(self->insts, self->capacity * sizeof(cc_inst));
+    }
+    memmove(self->insts + index + 1, self->insts + index,
+        (self->count - index) * sizeof(cc_inst));
+    self->count++;
+    inst = self->insts + index;
+    inst->op = op;
+    inst->b = b;
+    inst->a = a;
+    inst->line = self->line;
+    inst->weight = self->weight;
+    return inst;
+}
+
+void cc_code_remove(cc_code * self, int index) {
+    memmove(self->insts + index, self->insts + index + 1,
+        (self->count - index - 1) * sizeof(cc_inst));
+    self->count--;
+}
+
+/* Allocates a new local label.  Labels are numbered from 1. */
+int cc_code_label(cc_code * self) {
+    return ++self->labels;
+}
+
+/* Places 'label' at the current end of the buffer */
+void cc_code_place(cc_code * self, int label) {
+    cc_code_emit(self, CC_INST_LABEL, cc_opd_lit(0), cc_opd_label(label));
+}
+
+/* Returns the size of the code, in words */
+int cc_code_words(cc_code * self) {
+    int words = 0;
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        words += cc_inst_words(self->insts + i);
+    }
+    return words;
+}
+
+/* Returns the number of extra words the operand needs.  'a' is non-zero if
+ * the operand is in the 'a' position, where small literals fit in the
+ * instruction word. */
+int cc_operand_words(cc_operand * self, int a) {
+    switch (self->mode) {
+    case CC_VAL_OFF:
+    case CC_VAL_PICK:
+    case CC_VAL_MEM:
+        return 1;
+    case CC_VAL_LIT:
+        if (a && !self->sym && !self->label
+            && self->value >= -1 && self->value <= 30) {
+            return 0;
+        }
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+int cc_operand_equal(cc_operand * self, cc_operand * other) {
+    return self->mode == other->mode && self->reg == other->reg
+        && self->value == other->value && self->sym == other->sym
+        && self->label == other->label && self->frame == other->frame;
+}
+
+int cc_inst_words(cc_inst * self) {
+    if (CC_INST_LABEL == self->op) {
+        return 0;
+    } else if (self->op > CC_OP_SPECIAL) {
+        return 1 + cc_operand_words(&self->a, 1);
+    } else {
+        return 1 + cc_operand_words(&self->a, 1)
+            + cc_operand_words(&self->b, 0);
+    }
+}
+
+/* Returns the number of cycles needed to execute the instruction, including
+ * a cycle for each extra word.  Failed IF* tests cost one more cycle than
+ * this. */
+int cc_inst_cycles(cc_inst * self) {
+    if (CC_INST_LABEL == self->op) {
+        return 0;
+    }
+    return cc_op_cycles(self->op) + cc_inst_words(self) - 1;
+}
+
+cc_operand cc_opd_reg(int reg) {
+    cc_operand self;
+    memset(&self, 0, sizeof(self));
+    self.mode = CC_VAL_REG;
+    self.reg = reg;
+    return self;
+}
+
+cc_operand cc_opd_ind(int reg) {
+    cc_operand self = cc_opd_reg(reg);
+    self.mode = CC_VAL_IND;
+    return self;
+}
+
+/* [reg + value].  An offset of zero is [reg], which is one word shorter. */
+cc_operand cc_opd_off(int reg, int value) {
+    cc_operand self = cc_opd_reg(reg);
+    self.mode = value ? CC_VAL_OFF : CC_VAL_IND;
+    self.value = value;
+    return self;
+}
+
+cc_operand cc_opd_lit(int value) {
+    cc_operand self;
+    memset(&self, 0, sizeof(self));
+    self.mode = CC_VAL_LIT;
+    self.value = value;
+    return self;
+}
+
+/* Address of 'sym' as a literal */
+cc_operand cc_opd_sym(cc_id * sym) {
+    cc_operand self = cc_opd_lit(0);
+    self.sym = sym;
+    return self;
+}
+
+/* [sym + value]; 'sym' may be null for an absolute address */
+cc_operand cc_opd_mem(cc_id * sym, int value) {
+    cc_operand self = cc_opd_lit(value);
+    self.mode = CC_VAL_MEM;
+    self.sym = sym;
+    return self;
+}
+
+/* Address of local label 'label' as a literal */
+cc_operand cc_opd_label(int label) {
+    cc_operand self = cc_opd_lit(0);
+    self.label = label;
+    return self;
+}
+
+/* PUSH/POP, PEEK, SP, PC or EX */
+cc_operand cc_opd_special(int mode) {
+    cc_operand self = cc_opd_lit(0);
+    self.mode = mode;
+    return self;
+}
+
+/* [SP + value] */
+cc_operand cc_opd_pick(int value) {
+    cc_operand self = cc_opd_lit(value);
+    self.mode = value ? CC_VAL_PICK : CC_VAL_PEEK;
+    return self;
+}
+
+/* Prints a literal value or address */
+static void cc_operand_value(cc_code * code, cc_operand * self, FILE * out) {
+    if (self->sym) {
+        fprintf(out, "%s", self->sym->str);
+        if (self->value) {
+            fprintf(out, "+%d", self->value);
+        }
+    } else if (self->label) {
+        fprintf(out, "%s.L%d", code->id->str, self->label);
+    } else if (self->value < 0 || self->value > 0xff) {
+        fprintf(out, "0x%04x", self->value & 0xffff);
+    } else {
+        fprintf(out, "%d", self->value);
+    }
+}
+
+static void cc_operand_print(cc_code * code, cc_operand * self, int a,
+    FILE * out) {
+
+    switch (self->mode) {
+    case CC_VAL_REG:
+        fprintf(out, "%s", cc_reg_name(self->reg));
+        break;
+    case CC_VAL_IND:
+        fprintf(out, "[%s]", cc_reg_name(self->reg));
+        break;
+    case CC_VAL_OFF:
+        if (self->sym) {
+            fprintf(out, "[%s+", cc_reg_name(self->reg));
+            cc_operand_value(code, self, out);
+            fprintf(out, "]");
+        } else if (cc_word(self->value) < 0) {
+            fprintf(out, "[%s-%d]", cc_reg_name(self->reg),
+                -cc_word(self->value));
+        } else {
+            fprintf(out, "[%s+%d]", cc_reg_name(self->reg), self->value);
+        }
+        break;
+    case CC_VAL_PUSHPOP:
+        fprintf(out, a ? "POP" : "PUSH");
+        break;
+    case CC_VAL_PEEK:
+        fprintf(out, "PEEK");
+        break;
+    case CC_VAL_PICK:
+        fprintf(out, "PICK %d", self->value);
+        break;
+    case CC_VAL_SP:
+        fprintf(out, "SP");
+        break;
+    case CC_VAL_PC:
+        fprintf(out, "PC");
+        break;
+    case CC_VAL_EX:
+        fprintf(out, "EX");
+        break;
+    case CC_VAL_MEM:
+        fprintf(out, "[");
+        cc_operand_value(code, self, out);
+        fprintf(out, "]");
+        break;
+    default:
+        cc_operand_value(code, self, out);
+        break;
+    }
+}
+
+/* Prints a single instruction in assembler syntax */
+void cc_inst_print(cc_code * code, cc_inst * self, FILE * out) {
+    if (CC_INST_LABEL == self->op) {
+        fprintf(out, ":%s.L%d\n", code->id->str, self->a.label);
+        return;
+    }
+    fprintf(out, "    %s ", cc_op_name(self->op));
+    if (self->op < CC_OP_SPECIAL) {
+        cc_operand_print(code, &self->b, 0, out);
+        fprintf(out, ", ");
+    }
+    cc_operand_print(code, &self->a, 1, out);
+    fprintf(out, "\n");
+}
+
+void cc_code_print(cc_code * self, FILE * out) {
+    int i = 0;
+    fprintf(out, ":%s\n", self->id->str);
+    for (i = 0; i < self->count; ++i) {
+        cc_inst_print(self, self->insts + i, out);
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_CODE_H
+#define CC_CODE_H
+
+#include "ast.h"
+#include "dcpu.h"
+#include <stdio.h>
+
+/* Pseudo-opcode that marks the position of local label 'a.label' */
+#define CC_INST_LABEL 0
+
+/* Instruction operand.  'mode' is one of the CC_VAL_* encodings from dcpu.h.
+ * The short literal form is chosen when the instruction is encoded, so
+ * literals always use CC_VAL_LIT here. */
+typedef struct cc_operand {
+    int mode;
+    int reg; /* For CC_VAL_REG, CC_VAL_IND and CC_VAL_OFF */
+    int value; /* Literal, address, or offset from 'reg' or SP */
+    cc_id * sym; /* If set, the address of 'sym' is added to 'value' */
+    int label; /* If non-zero, the address of local label 'label' */
+    int frame; /* CC_OPD_LOCAL or CC_OPD_FORMAL if 'value' is fixed up once
+                * the frame layout is known */
+} cc_operand;
+
+/* Kinds of SP-relative operands that are fixed up by the frame size */
+#define CC_OPD_LOCAL 1
+#define CC_OPD_FORMAL 2
+
+typedef struct cc_inst {
+    int op; /* cc_op, or CC_INST_LABEL */
+    cc_operand b;
+    cc_operand a;
+    int line; /* Source line that produced the instruction */
+    double weight; /* Estimated executions per call of the function */
+} cc_inst;
+
+/* Instruction buffer for a single function (or other code symbol) */
+typedef struct cc_code {
+    cc_id * id;
+    cc_inst * insts;
+    int count;
+    int capacity;
+    int labels; /* Number of local labels allocated */
+    int line; /* Source line attached to new instructions */
+    double weight; /* Weight attached to new instructions */
+    struct cc_code * next;
+} cc_code;
+
+cc_code * cc_code_init(cc_id * id);
+void cc_code_free(cc_code * self);
+cc_inst * cc_code_emit(cc_code * self, int op, cc_operand b, cc_operand a);
+cc_inst * cc_code_insert(cc_code * self, int index, int op, cc_operand b,
+    cc_operand a);
+void cc_code_remove(cc_code * self, int index);
+int cc_code_label(cc_code * self);
+void cc_code_place(cc_code * self, int label);
+int cc_code_words(cc_code * self);
+void cc_code_print(cc_code * self, FILE * out);
+int cc_inst_words(cc_inst * self);
+int cc_inst_cycles(cc_inst * self);
+void cc_inst_print(cc_code * code, cc_inst * self, FILE * out);
+int cc_operand_words(cc_operand * self, int a);
+int cc_operand_equal(cc_operand * self, cc_operand * other);
+cc_operand cc_opd_reg(int reg);
+cc_operand cc_opd_ind(int reg);
+cc_operand cc_opd_off(int reg, int value);
+cc_operand cc_opd_lit(int value);
+cc_operand cc_opd_sym(cc_id * sym);
+cc_operand cc_opd_mem(cc_id * sym, int value);
+cc_operand cc_opd_label(int label);
+cc_operand cc_opd_special(int mode);
+cc_operand cc_opd_pick(int value);
+
+#endif
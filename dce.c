@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "dce.h"
+#include "check.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void cc_dce_block(cc_dce * self, cc_block * block, int dead);
+
+/* Visits the references in 'expr'.  In live code they are marked; in dead
+ * code, the string literals are counted instead. */
+static void cc_dce_expr(cc_dce * self, cc_expr * expr, int dead) {
+    cc_env * env = self->opt->env;
+    cc_expr * arg = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_REF: {
+        cc_id * id = ((cc_ref *)expr)->id;
+        if (!dead && (cc_env_var(env, id) || cc_env_func(env, id))) {
+            cc_dce_mark(self, id);
+        }
+        break;
+    }
+    case CC_STRING:
+        if (dead) {
+            self->strings++;
+            self->words += strlen(((cc_string *)expr)->value) + 1;
+        }
+        break;
+    case CC_MEMBER:
+        cc_dce_expr(self, ((cc_member *)expr)->expr, dead);
+        break;
+    case CC_BINARY:
+        cc_dce_expr(self, ((cc_binary *)expr)->left, dead);
+        cc_dce_expr(self, ((cc_binary *)expr)->right, dead);
+        break;
+    case CC_UNARY:
+        cc_dce_expr(self, ((cc_unary *)expr)->expr, dead);
+        break;
+    case CC_CALL:
+        cc_dce_expr(self, ((cc_call *)expr)->expr, dead);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            cc_dce_expr(self, arg, dead);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_dce_stmt(cc_dce * self, cc_stmt * stmt, int dead) {
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_dce_block(self, (cc_block *)stmt, dead);
+        break;
+    case CC_IF:
+        cc_dce_expr(self, ((cc_if *)stmt)->guard, dead);
+        cc_dce_stmt(self, ((cc_if *)stmt)->yes, dead);
+        cc_dce_stmt(self, ((cc_if *)stmt)->no, dead);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_dce_expr(self, ((cc_loop *)stmt)->init, dead);
+        cc_dce_expr(self, ((cc_loop *)stmt)->guard, dead);
+        cc_dce_expr(self, ((cc_loop *)stmt)->update, dead);
+        if (((cc_loop *)stmt)->block) {
+            cc_dce_block(self, ((cc_loop *)stmt)->block, dead);
+        }
+        break;
+    case CC_SIMPLE:
+        cc_dce_expr(self, ((cc_simple *)stmt)->expr, dead);
+        break;
+    case CC_RETURN:
+        cc_dce_expr(self, ((cc_return *)stmt)->expr, dead);
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_dce_block(cc_dce * self, cc_block * block, int dead) {
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    for (var = block->vars; var; var = var->next) {
+        cc_dce_expr(self, var->init, dead);
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_dce_stmt(self, stmt, dead);
+    }
+}
+
+/* Removes the dead functions and globals from the program.  Only useful
+ * for a whole program: an object's functions may be called from other
+ * objects, so there the linker's --gc-sections does the job instead. */
+void cc_dce_env(cc_opt * opt) {
+    cc_dce * self = 0;
+    cc_id * main = cc_env_id(opt->env, "main");
+    int i = 0;
+    if (opt->object || !cc_env_func(opt->env, main)) {
+        return;
+    }
+    self = calloc(1, sizeof(cc_dce));
+    self->opt = opt;
+    cc_dce_mark(self, main);
+    for (i = 0; i < opt->roots.count; ++i) {
+        cc_dce_mark(self, opt->roots.ids[i]);
+    }
+    for (i = 0; i < self->live.count; ++i) {
+        cc_id * id = self->live.ids[i];
+        cc_func * func = 0;
+        cc_var * var = cc_env_var(opt->env, id);
+        for (func = opt->env->funcs; func; func = func->next) {
+            if (func->id == id && func->block) {
+                cc_dce_block(self, func->block, 0);
+            }
+        }
+        if (var) {
+            cc_dce_expr(self, var->init, 0);
+        }
+    }
+    cc_dce_sweep(self);
+    if (opt->verbose) {
+        fprintf(stderr, "dce: %d functions, %d globals, %d strings removed, "
+            "~%d words reclaimed\n", self->funcs, self->globals,
+            self->strings, self->words);
+    }
+    free(self->live.ids);
+    free(self);
+}
+
+/* Marks 'id' as live, queueing it to have its references visited */
+void cc_dce_mark(cc_dce * self, cc_id * id) {
+    cc_idset_add(&self->live, id);
+}
+
+/* Unlinks the functions (with their declarations) and the globals that
+ * weren't marked, and adds up what they would have cost */
+void cc_dce_sweep(cc_dce * self) {
+    cc_env * env = self->opt->env;
+    cc_func ** func = &env->funcs;
+    cc_var ** var = &env->vars;
+    while (*func) {
+        if (cc_idset_has(&self->live, (*func)->id)) {
+            func = &(*func)->next;
+            continue;
+        }
+        if ((*func)->block) {
+            cc_cost cost;
+            cost.words = 0;
+            cost.cycles = 0;
+            cc_opt_block_cost((*func)->block, &cost);
+            cc_dce_block(self, (*func)->block, 1);
+            self->words += cost.words + 1;
+            self->funcs++;
+        }
+        *func = (*func)->next;
+    }
+    while (*var) {
+        if (cc_idset_has(&self->live, (*var)->id)) {
+            var = &(*var)->next;
+            continue;
+        }
+        cc_dce_expr(self, (*var)->init, 1);
+        self->words += cc_type_size((*var)->type);
+        self->globals++;
+        *var = (*var)->next;
+    }
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_DCE_H
+#define CC_DCE_H
+
+#include "opt.h"
+
+/* Whole-program dead function and data elimination.  Functions and globals
+ * are marked from the roots (main, and the names given with -fexport) by
+ * following every reference in the live function bodies and global
+ * initializers: calls, function addresses and uses of globals.  The rest
+ * is removed from the environment before code generation, which also
+ * drops the string literals that only dead code used.  The 'live' set
+ * doubles as the worklist: ids are processed in the order they were
+ * marked. */
+typedef struct cc_dce {
+    cc_opt * opt;
+    cc_idset live;
+    int funcs; /* Functions removed */
+    int globals; /* Globals removed */
+    int strings; /* String literals removed with them */
+    int words; /* Estimated words reclaimed */
+} cc_dce;
+
+void cc_dce_env(cc_opt * opt);
+void cc_dce_mark(cc_dce * self, cc_id * id);
+void cc_dce_sweep(cc_dce * self);
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "dcpu.h"
+
+/* Cycle counts for each opcode, not counting the extra cycle for operands
+ * that read a 'next word', or the extra cycle paid by a failed IF* test.
+ * Values are from the DCPU-16 1.7 specification. */
+static int const cycles[CC_OP_COUNT] = {
+    0, 1, 2, 2, 2, 2, 3, 3, 3, 3, 1, 1, 1, 1, 1, 1, /* 0x00-0x0f */
+    2, 2, 2, 2, 2, 2, 2, 2, 0, 0, 3, 3, 0, 0, 2, 2, /* 0x10-0x1f */
+    0, 3, 0, 0, 0, 0, 0, 0, 4, 1, 1, 3, 2, 0, 0, 0, /* 0x20-0x2f */
+    2, 4, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, /* 0x30-0x3f */
+};
+
+static char const * names[CC_OP_COUNT] = {
+    0, "SET", "ADD", "SUB", "MUL", "MLI", "DIV", "DVI",
+    "MOD", "MDI", "AND", "BOR", "XOR", "SHR", "ASR", "SHL",
+    "IFB", "IFC", "IFE", "IFN", "IFG", "IFA", "IFL", "IFU",
+    0, 0, "ADX", "SBX", 0, 0, "STI", "STD",
+    0, "JSR", 0, 0, 0, 0, 0, 0, "INT", "IAG", "IAS", "RFI", "IAQ", 0, 0, 0,
+    "HWN", "HWQ", "HWI", 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+static char const * regs[CC_REG_COUNT] = {
+    "A", "B", "C", "X", "Y", "Z", "I", "J"
+};
+
+/* Returns the base cycle count for 'op' */
+int cc_op_cycles(cc_op op) {
+    return cycles[op];
+}
+
+/* Returns non-zero if 'op' is one of the conditional-skip instructions */
+int cc_op_isif(cc_op op) {
+    return op >= CC_OP_IFB && op <= CC_OP_IFU;
+}
+
+char const * cc_op_name(cc_op op) {
+    return names[op];
+}
+
+char const * cc_reg_name(cc_reg reg) {
+    return regs[reg];
+}
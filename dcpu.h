@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_DCPU_H
+#define CC_DCPU_H
+
+/* DCPU-16 opcodes.  Basic opcodes use their encoding directly; special
+ * opcodes (which are encoded with a zero basic opcode and the special opcode
+ * in the 'b' field) are offset by CC_OP_SPECIAL so that both can live in one
+ * enum. */
+typedef enum cc_op {
+    CC_OP_SET = 0x01,
+    CC_OP_ADD = 0x02,
+    CC_OP_SUB = 0x03,
+    CC_OP_MUL = 0x04,
+    CC_OP_MLI = 0x05,
+    CC_OP_DIV = 0x06,
+    CC_OP_DVI = 0x07,
+    CC_OP_MOD = 0x08,
+    CC_OP_MDI = 0x09,
+    CC_OP_AND = 0x0a,
+    CC_OP_BOR = 0x0b,
+    CC_OP_XOR = 0x0c,
+    CC_OP_SHR = 0x0d,
+    CC_OP_ASR = 0x0e,
+    CC_OP_SHL = 0x0f,
+    CC_OP_IFB = 0x10,
+    CC_OP_IFC = 0x11,
+    CC_OP_IFE = 0x12,
+    CC_OP_IFN = 0x13,
+    CC_OP_IFG = 0x14,
+    CC_OP_IFA = 0x15,
+    CC_OP_IFL = 0x16,
+    CC_OP_IFU = 0x17,
+    CC_OP_ADX = 0x1a,
+    CC_OP_SBX = 0x1b,
+    CC_OP_STI = 0x1e,
+    CC_OP_STD = 0x1f,
+    CC_OP_SPECIAL = 0x20,
+    CC_OP_JSR = 0x21,
+    CC_OP_INT = 0x28,
+    CC_OP_IAG = 0x29,
+    CC_OP_IAS = 0x2a,
+    CC_OP_RFI = 0x2b,
+    CC_OP_IAQ = 0x2c,
+    CC_OP_HWN = 0x30,
+    CC_OP_HWQ = 0x31,
+    CC_OP_HWI = 0x32,
+    CC_OP_COUNT = 0x40
+} cc_op;
+
+/* General purpose registers, in encoding order */
+typedef enum cc_reg {
+    CC_REG_A,
+    CC_REG_B,
+    CC_REG_C,
+    CC_REG_X,
+    CC_REG_Y,
+    CC_REG_Z,
+    CC_REG_I,
+    CC_REG_J,
+    CC_REG_COUNT
+} cc_reg;
+
+/* Operand ('a' and 'b' value) encodings */
+#define CC_VAL_REG 0x00 /* register */
+#define CC_VAL_IND 0x08 /* [register] */
+#define CC_VAL_OFF 0x10 /* [register + next word] */
+#define CC_VAL_PUSHPOP 0x18 /* PUSH (b) or POP (a) */
+#define CC_VAL_PEEK 0x19 /* [SP] */
+#define CC_VAL_PICK 0x1a /* [SP + next word] */
+#define CC_VAL_SP 0x1b
+#define CC_VAL_PC 0x1c
+#define CC_VAL_EX 0x1d
+#define CC_VAL_MEM 0x1e /* [next word] */
+#define CC_VAL_LIT 0x1f /* next word (literal) */
+#define CC_VAL_SHORT 0x20 /* literal -1..30, 'a' only */
+
+#define CC_DCPU_WORDS 0x10000 /* Size of the address space, in words */
+
+int cc_op_cycles(cc_op op);
+int cc_op_isif(cc_op op);
+char const * cc_op_name(cc_op op);
+char const * cc_reg_name(cc_reg reg);
+
+#endif
@@ -0,0 +1,845 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "emu.h"
+#include "prof.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Handlers are dispatched with computed gotos where the compiler supports
+ * them, and with a switch otherwise */
+#if defined(__GNUC__)
+#define CC_EMU_THREADED 1
+#pragma GCC diagnostic ignored "-Wpedantic"
+#else
+#define CC_EMU_THREADED 0
+#endif
+
+/* Opcodes with fast handlers.  There is one handler for each combination
+ * of a 'b' that is a register (R), a fixed address (M), a register plus an
+ * offset (O) or a stack slot (P), and an 'a' that is any of those or a
+ * literal (L). */
+#define CC_EMU_ARITH(X) \
+    X(SET) X(ADD) X(SUB) X(MUL) X(AND) X(BOR) X(XOR) X(SHR) X(ASR) X(SHL)
+#define CC_EMU_IFS(X) \
+    X(IFB) X(IFC) X(IFE) X(IFN) X(IFG) X(IFA) X(IFL) X(IFU)
+#define CC_EMU_FAST(X) CC_EMU_ARITH(X) CC_EMU_IFS(X)
+
+/* Number of 'a' kinds with fast handlers */
+#define CC_EMU_AKINDS 5
+
+#define CC_EMU_ENUM_B(op, b) CC_EMU_##op##_##b##R, CC_EMU_##op##_##b##L, \
+    CC_EMU_##op##_##b##M, CC_EMU_##op##_##b##O, CC_EMU_##op##_##b##P,
+#define CC_EMU_ENUM(op) CC_EMU_ENUM_B(op, R) CC_EMU_ENUM_B(op, M) \
+    CC_EMU_ENUM_B(op, O) CC_EMU_ENUM_B(op, P)
+
+enum {
+    CC_EMU_DECODE, /* Not decoded yet; must be zero */
+    CC_EMU_GENERIC,
+    CC_EMU_HALT, /* SUB PC, 1 */
+    CC_EMU_JUMP, /* SET PC, literal */
+    CC_EMU_CALL, /* JSR literal */
+    CC_EMU_RET, /* SET PC, POP */
+    CC_EMU_PUSHR, /* SET PUSH, register */
+    CC_EMU_PUSHL, /* SET PUSH, literal */
+    CC_EMU_POPR, /* SET register, POP */
+    CC_EMU_FAULT,
+    CC_EMU_FAST(CC_EMU_ENUM)
+    CC_EMU_HANDLERS
+};
+
+/* Index of each operand kind among the fast handlers, or -1 */
+static int const cc_emu_akind[] = { 0, 1, 2, 3, -1, 4, -1 };
+static int const cc_emu_bkind[] = { 0, -1, 1, 2, -1, 3, -1 };
+
+/* Allocates an emulator with no cache; one is allocated the first time it
+ * runs unless a shared one is attached */
+cc_emu * cc_emu_init() {
+    cc_emu * self = 0;
+    size_t size = (sizeof(cc_emu) + CC_EMU_ALIGN - 1) & ~(CC_EMU_ALIGN - 1);
+    if (posix_memalign((void **)&self, CC_EMU_ALIGN, size)) {
+        return 0;
+    }
+    memset(self, 0, size);
+    return self;
+}
+
+/* Loads an image at address 0.  Returns zero if it can't be read. */
+int cc_emu_load(cc_emu * self, char const * path) {
+    FILE * in = fopen(path, "rb");
+    int hi = 0;
+    int lo = 0;
+    int addr = 0;
+    if (!in) {
+        return 0;
+    }
+    while (addr < CC_DCPU_WORDS && EOF != (hi = fgetc(in))
+        && EOF != (lo = fgetc(in))) {
+        self->mem[addr++] = (unsigned short)(hi << 8 | lo);
+    }
+    fclose(in);
+    cc_emu_reset(self);
+    return 1;
+}
+
+/* Clears the registers and the instruction cache, keeping the memory */
+void cc_emu_reset(cc_emu * self) {
+    memset(self->regs, 0, sizeof(self->regs));
+    if (self->cache && self == self->cache->owner) {
+        cc_emucache_flush(self->cache);
+    }
+    self->cycles = 0;
+    self->steps = 0;
+    self->depth = 0;
+    self->halted = 0;
+    self->fault = 0;
+    self->queueing = 0;
+    self->queued = 0;
+}
+
+/* Makes the emulator use 'cache', flushing it if it held the instructions
+ * of another emulator, or if the emulator ran on another cache since.  The
+ * emulator may have overwritten its code there. */
+void cc_emu_attach(cc_emu * self, cc_emucache * cache) {
+    int moved = (self->cache != cache);
+    if (self->cache && moved && self->owns) {
+        cc_emucache_free(self->cache);
+        self->owns = 0;
+    }
+    if (cache->owner != self || moved) {
+        cc_emucache_flush(cache);
+        cache->owner = self;
+    }
+    self->cache = cache;
+}
+
+cc_emucache * cc_emucache_init() {
+    cc_emucache * self = calloc(1, sizeof(cc_emucache));
+    self->code = calloc(CC_DCPU_WORDS, sizeof(cc_emuinst));
+    self->cached = calloc(CC_DCPU_WORDS, 1);
+    self->decoded = calloc(CC_DCPU_WORDS, sizeof(unsigned short));
+    return self;
+}
+
+/* Drops every cached instruction */
+void cc_emucache_flush(cc_emucache * self) {
+    int i = 0;
+    int k = 0;
+    if (self->count >= CC_DCPU_WORDS) {
+        memset(self->code, 0, CC_DCPU_WORDS * sizeof(cc_emuinst));
+        memset(self->cached, 0, CC_DCPU_WORDS);
+    } else {
+        for (i = 0; i < self->count; ++i) {
+            cc_emuinst * inst = self->code + self->decoded[i];
+            for (k = 0; k < inst->len; ++k) {
+                self->cached[(self->decoded[i] + k) & 0xffff] = 0;
+            }
+            inst->handler = CC_EMU_DECODE;
+        }
+    }
+    self->count = 0;
+}
+
+void cc_emucache_free(cc_emucache * self) {
+    free(self->code);
+    free(self->cached);
+    free(self->decoded);
+    free(self);
+}
+
+/* Decodes an operand, reading its next word (if any) at '*pc' */
+static void cc_emu_operand(cc_emu * self, int value, int isa,
+    unsigned char * kind, unsigned char * reg, unsigned short * out,
+    unsigned * pc, int * words) {
+
+    unsigned short next = 0;
+    if ((value >= CC_VAL_OFF && value < CC_VAL_PUSHPOP)
+        || CC_VAL_PICK == value || CC_VAL_MEM == value
+        || CC_VAL_LIT == value) {
+        next = self->mem[*pc];
+        self->cache->cached[*pc] = 1;
+        *pc = (*pc + 1) & 0xffff;
+        (*words)++;
+    }
+    *reg = value & 7;
+    *out = 0;
+    if (value < CC_VAL_IND) {
+        *kind = CC_EMU_OPD_REG;
+        *out = value;
+    } else if (value < CC_VAL_PUSHPOP) {
+        *kind = CC_EMU_OPD_OFF;
+        *out = next;
+    } else if (CC_VAL_PUSHPOP == value) {
+        *kind = CC_EMU_OPD_PUSHPOP;
+    } else if (CC_VAL_PEEK == value || CC_VAL_PICK == value) {
+        *kind = CC_EMU_OPD_PICK;
+        *out = next;
+    } else if (CC_VAL_SP == value || CC_VAL_EX == value) {
+        *kind = CC_EMU_OPD_REG;
+        *out = CC_VAL_SP == value ? CC_EMU_SP : CC_EMU_EX;
+    } else if (CC_VAL_PC == value) {
+        *kind = CC_EMU_OPD_PC;
+    } else if (CC_VAL_MEM == value) {
+        *kind = CC_EMU_OPD_MEM;
+        *out = next;
+    } else if (CC_VAL_LIT == value) {
+        *kind = CC_EMU_OPD_LIT;
+        *out = next;
+    } else {
+        *kind = CC_EMU_OPD_LIT;
+        *out = (unsigned short)(value - CC_VAL_SHORT - 1);
+    }
+    (void)isa;
+}
+
+/* Returns the fast handler for the instruction, or the generic one */
+static int cc_emu_fast(cc_emuinst * inst) {
+    int a = cc_emu_akind[inst->ka];
+    int b = cc_emu_bkind[inst->kb];
+    int first = 0;
+    if (CC_OP_SET == inst->op && CC_EMU_OPD_PUSHPOP == inst->kb) {
+        if (CC_EMU_OPD_REG == inst->ka) {
+            return CC_EMU_PUSHR;
+        } else if (CC_EMU_OPD_LIT == inst->ka) {
+            return CC_EMU_PUSHL;
+        }
+    }
+    if (CC_OP_SET == inst->op && CC_EMU_OPD_PUSHPOP == inst->ka
+        && CC_EMU_OPD_REG == inst->kb) {
+        return CC_EMU_POPR;
+    }
+    if (a < 0 || b < 0
+        || (CC_EMU_OPD_REG == inst->kb && CC_EMU_SP == inst->vb)) {
+        /* The generic handler keeps track of the stack depth */
+        return CC_EMU_GENERIC;
+    }
+#define CC_EMU_CASE(op) case CC_OP_##op: first = CC_EMU_##op##_RR; break;
+    switch (inst->op) {
+    CC_EMU_FAST(CC_EMU_CASE)
+    default: return CC_EMU_GENERIC;
+    }
+#undef CC_EMU_CASE
+    return first + b * CC_EMU_AKINDS + a;
+}
+
+/* Decodes the instruction at 'pc' into the cache */
+static cc_emuinst * cc_emu_decode(cc_emu * self, unsigned pc) {
+    cc_emucache * cache = self->cache;
+    cc_emuinst * inst = cache->code + pc;
+    int word = self->mem[pc];
+    int op = word & 0x1f;
+    int b = (word >> 5) & 0x1f;
+    int words = 1;
+    unsigned next = (pc + 1) & 0xffff;
+
+    memset(inst, 0, sizeof(cc_emuinst));
+    cache->cached[pc] = 1;
+    if (cache->count < CC_DCPU_WORDS) {
+        cache->decoded[cache->count] = (unsigned short)pc;
+    }
+    cache->count++;
+    cc_emu_operand(self, word >> 10, 1, &inst->ka, &inst->ra, &inst->va,
+        &next, &words);
+    if (op) {
+        cc_emu_operand(self, b, 0, &inst->kb, &inst->rb, &inst->vb, &next,
+            &words);
+    } else {
+        op = CC_OP_SPECIAL + b;
+    }
+    inst->op = op;
+    inst->len = words;
+    inst->isif = cc_op_isif(op);
+    inst->cycles = cc_op_cycles(op) + words - 1;
+
+    if (!cc_op_name(op)) {
+        inst->handler = CC_EMU_FAULT;
+    } else if (CC_OP_JSR == op && CC_EMU_OPD_LIT == inst->ka) {
+        inst->handler = CC_EMU_CALL;
+    } else if (CC_EMU_OPD_PC != inst->kb) {
+        inst->handler = cc_emu_fast(inst);
+    } else if (CC_OP_SUB == op && CC_EMU_OPD_LIT == inst->ka
+        && 1 == inst->va && 1 == words) {
+        inst->handler = CC_EMU_HALT;
+    } else if (CC_OP_SET == op && CC_EMU_OPD_LIT == inst->ka) {
+        inst->handler = CC_EMU_JUMP;
+    } else if (CC_OP_SET == op && CC_EMU_OPD_PUSHPOP == inst->ka) {
+        inst->handler = CC_EMU_RET;
+    } else {
+        inst->handler = CC_EMU_GENERIC;
+    }
+    return inst;
+}
+
+/* Drops the cached instructions that may contain the word at 'addr' */
+static void cc_emu_invalidate(cc_emu * self, unsigned addr) {
+    int i = 0;
+    for (i = 0; i < 3; ++i) {
+        self->cache->code[(addr - i) & 0xffff].handler = CC_EMU_DECODE;
+    }
+    self->cache->cached[addr] = 0;
+}
+
+/* Skips the instructions after a failed IF at 'pc', and returns the
+ * address of the next one to run.  Each skipped instruction costs one
+ * cycle, and a skipped IF makes the next one be skipped too. */
+static unsigned cc_emu_skip(cc_emu * self, unsigned pc, unsigned long *
+    cycles) {
+
+    cc_emuinst * inst = self->cache->code + pc;
+    pc = (pc + inst->len) & 0xffff;
+    do {
+        inst = self->cache->code + pc;
+        if (CC_EMU_DECODE == inst->handler) {
+            cc_emu_decode(self, pc);
+        }
+        pc = (pc + inst->len) & 0xffff;
+        ++*cycles;
+    } while (inst->isif);
+    return pc;
+}
+
+/* Returns the location of an operand for the generic handler.  Literals
+ * are copied to 'lit', so that writing to them has no effect. */
+static unsigned short * cc_emu_locate(cc_emu * self, int kind, int reg,
+    unsigned short value, int isa, unsigned short * lit) {
+
+    unsigned short * r = self->regs;
+    switch (kind) {
+    case CC_EMU_OPD_REG: return r + value;
+    case CC_EMU_OPD_MEM: return self->mem + value;
+    case CC_EMU_OPD_OFF: return self->mem + ((r[reg] + value) & 0xffff);
+    case CC_EMU_OPD_PICK:
+        return self->mem + ((r[CC_EMU_SP] + value) & 0xffff);
+    case CC_EMU_OPD_PC: return r + CC_EMU_PC;
+    case CC_EMU_OPD_PUSHPOP:
+        if (isa) {
+            return self->mem + r[CC_EMU_SP]++;
+        }
+        return self->mem + --r[CC_EMU_SP];
+    default:
+        *lit = value;
+        return lit;
+    }
+}
+
+static void cc_emu_store(cc_emu * self, unsigned short * where,
+    unsigned long value) {
+
+    *where = (unsigned short)value;
+    if (where >= self->mem && where < self->mem + CC_DCPU_WORDS
+        && self->cache->cached[where - self->mem]) {
+        cc_emu_invalidate(self, where - self->mem);
+    }
+}
+
+static void cc_emu_push(cc_emu * self, unsigned value) {
+    cc_emu_store(self, self->mem + --self->regs[CC_EMU_SP], value);
+}
+
+static unsigned cc_emu_pop(cc_emu * self) {
+    return self->mem[self->regs[CC_EMU_SP]++];
+}
+
+/* Triggers an interrupt with message 'msg', or queues it if interrupts
+ * are being queued */
+static void cc_emu_interrupt(cc_emu * self, unsigned msg) {
+    unsigned short * r = self->regs;
+    if (!r[CC_EMU_IA]) {
+        return;
+    }
+    if (self->queueing) {
+        if (self->queued >= CC_EMU_QUEUE) {
+            self->halted = 1;
+            self->fault = 1;
+        } else {
+            self->queue[self->queued++] = msg;
+        }
+        return;
+    }
+    self->queueing = 1;
+    cc_emu_push(self, r[CC_EMU_PC]);
+    cc_emu_push(self, r[CC_REG_A]);
+    r[CC_EMU_PC] = r[CC_EMU_IA];
+    r[CC_REG_A] = msg;
+}
+
+static int cc_emu_test(int op, unsigned b, unsigned a) {
+    switch (op) {
+    case CC_OP_IFB: return 0 != (b & a);
+    case CC_OP_IFC: return 0 == (b & a);
+    case CC_OP_IFE: return b == a;
+    case CC_OP_IFN: return b != a;
+    case CC_OP_IFG: return b > a;
+    case CC_OP_IFA: return (short)b > (short)a;
+    case CC_OP_IFL: return b < a;
+    default: return (short)b < (short)a;
+    }
+}
+
+/* Executes any instruction.  The PC has already been advanced past it.
+ * Returns the cycles spent beyond the instruction's own. */
+static unsigned long cc_emu_generic(cc_emu * self, cc_emuinst * inst) {
+    unsigned short * r = self->regs;
+    unsigned short la = 0;
+    unsigned short lb = 0;
+    unsigned short * pa = cc_emu_locate(self, inst->ka, inst->ra, inst->va,
+        1, &la);
+    unsigned short * pb = 0;
+    unsigned long a = *pa;
+    unsigned long b = 0;
+    unsigned long t = 0;
+    unsigned long extra = 0;
+    long s = 0;
+
+    if (inst->op > CC_OP_SPECIAL) {
+        switch (inst->op) {
+        case CC_OP_JSR:
+            cc_emu_push(self, r[CC_EMU_PC]);
+            r[CC_EMU_PC] = (unsigned short)a;
+            break;
+        case CC_OP_INT: cc_emu_interrupt(self, a); break;
+        case CC_OP_IAG: cc_emu_store(self, pa, r[CC_EMU_IA]); break;
+        case CC_OP_IAS: r[CC_EMU_IA] = (unsigned short)a; break;
+        case CC_OP_RFI:
+            self->queueing = 0;
+            r[CC_REG_A] = cc_emu_pop(self);
+            r[CC_EMU_PC] = cc_emu_pop(self);
+            break;
+        case CC_OP_IAQ: self->queueing = 0 != a; break;
+        case CC_OP_HWN: cc_emu_store(self, pa, 0); break;
+        default: break; /* No hardware is attached */
+        }
+        if (!self->queueing && self->queued) {
+            unsigned msg = self->queue[0];
+            memmove(self->queue, self->queue + 1,
+                --self->queued * sizeof(unsigned short));
+            cc_emu_interrupt(self, msg);
+        }
+        return 0;
+    }
+
+    pb = cc_emu_locate(self, inst->kb, inst->rb, inst->vb, 0, &lb);
+    b = *pb;
+    if (inst->isif) {
+        if (!cc_emu_test(inst->op, b, a)) {
+            r[CC_EMU_PC] = cc_emu_skip(self,
+                (r[CC_EMU_PC] - inst->len) & 0xffff, &extra);
+        }
+        return extra;
+    }
+    switch (inst->op) {
+    case CC_OP_SET: t = a; break;
+    case CC_OP_ADD:
+        t = b + a;
+        r[CC_EMU_EX] = (unsigned short)(t >> 16);
+        break;
+    case CC_OP_SUB:
+        t = b - a;
+        r[CC_EMU_EX] = a > b ? 0xffff : 0;
+        break;
+    case CC_OP_MUL:
+        t = b * a;
+        r[CC_EMU_EX] = (unsigned short)(t >> 16);
+        break;
+    case CC_OP_MLI:
+        s = (long)(short)b * (short)a;
+        t = (unsigned long)s;
+        r[CC_EMU_EX] = (unsigned short)(t >> 16);
+        break;
+    case CC_OP_DIV:
+        t = a ? b / a : 0;
+        r[CC_EMU_EX] = (unsigned short)(a ? (b << 16) / a : 0);
+        break;
+    case CC_OP_DVI:
+        if ((short)a) {
+            s = (long)(short)b * 65536 / (short)a;
+            t = (unsigned long)((short)b / (short)a);
+            r[CC_EMU_EX] = (unsigned short)s;
+        } else {
+            t = 0;
+            r[CC_EMU_EX] = 0;
+        }
+        break;
+    case CC_OP_MOD: t = a ? b % a : 0; break;
+    case CC_OP_MDI:
+        t = (short)a ? (unsigned long)((short)b % (short)a) : 0;
+        break;
+    case CC_OP_AND: t = b & a; break;
+    case CC_OP_BOR: t = b | a; break;
+    case CC_OP_XOR: t = b ^ a; break;
+    case CC_OP_SHR:
+        t = a < 32 ? b >> a : 0;
+        r[CC_EMU_EX] = (unsigned short)(a < 32 ? (b << 16) >> a : 0);
+        break;
+    case CC_OP_ASR:
+        s = (long)(short)b * 65536;
+        s = a < 31 ? s >> a : (s < 0 ? -1 : 0);
+        t = (unsigned long)(s >> 16);
+        r[CC_EMU_EX] = (unsigned short)s;
+        break;
+    case CC_OP_SHL:
+        t = a < 32 ? b << a : 0;
+        r[CC_EMU_EX] = (unsigned short)(t >> 16);
+        break;
+    case CC_OP_ADX:
+        t = b + a + r[CC_EMU_EX];
+        r[CC_EMU_EX] = t > 0xffff;
+        break;
+    case CC_OP_SBX:
+        s = (long)b - (long)a + (long)r[CC_EMU_EX];
+        t = (unsigned long)s;
+        r[CC_EMU_EX] = s < 0 ? 0xffff : s > 0xffff;
+        break;
+    case CC_OP_STI:
+    case CC_OP_STD:
+        t = a;
+        r[CC_REG_I] += CC_OP_STI == inst->op ? 1 : -1;
+        r[CC_REG_J] += CC_OP_STI == inst->op ? 1 : -1;
+        break;
+    default:
+        break;
+    }
+    cc_emu_store(self, pb, t);
+    return extra;
+}
+
+/* Operations of the fast handlers on the location 'b' and the value 'a' */
+#define CC_EMU_OP_SET(b, a) b = a
+#define CC_EMU_OP_ADD(b, a) t = (unsigned long)b + a; \
+    r[CC_EMU_EX] = (unsigned short)(t >> 16); b = (unsigned short)t
+#define CC_EMU_OP_SUB(b, a) t = a; r[CC_EMU_EX] = t > b ? 0xffff : 0; \
+    b = (unsigned short)(b - t)
+#define CC_EMU_OP_MUL(b, a) t = (unsigned long)b * a; \
+    r[CC_EMU_EX] = (unsigned short)(t >> 16); b = (unsigned short)t
+#define CC_EMU_OP_AND(b, a) b &= a
+#define CC_EMU_OP_BOR(b, a) b |= a
+#define CC_EMU_OP_XOR(b, a) b ^= a
+#define CC_EMU_OP_SHR(b, a) t = a; \
+    r[CC_EMU_EX] = (unsigned short)(t < 32 ? ((unsigned long)b << 16) >> t \
+        : 0); \
+    b = (unsigned short)(t < 32 ? b >> t : 0)
+#define CC_EMU_OP_ASR(b, a) t = a; s = (long)(short)b * 65536; \
+    s = t < 31 ? s >> t : (s < 0 ? -1 : 0); \
+    r[CC_EMU_EX] = (unsigned short)s; b = (unsigned short)(s >> 16)
+#define CC_EMU_OP_SHL(b, a) t = a; \
+    t = t < 32 ? (unsigned long)b << t : 0; \
+    r[CC_EMU_EX] = (unsigned short)(t >> 16); b = (unsigned short)t
+#define CC_EMU_OP_IFB(b, a) test = 0 != (b & a)
+#define CC_EMU_OP_IFC(b, a) test = 0 == (b & a)
+#define CC_EMU_OP_IFE(b, a) test = b == a
+#define CC_EMU_OP_IFN(b, a) test = b != a
+#define CC_EMU_OP_IFG(b, a) test = b > a
+#define CC_EMU_OP_IFA(b, a) test = (short)b > (short)a
+#define CC_EMU_OP_IFL(b, a) test = b < a
+#define CC_EMU_OP_IFU(b, a) test = (short)b < (short)a
+
+/* Value of the 'a' operand of each kind */
+#define CC_EMU_A_R r[inst->va]
+#define CC_EMU_A_L inst->va
+#define CC_EMU_A_M mem[inst->va]
+#define CC_EMU_A_O mem[(r[inst->ra] + inst->va) & 0xffff]
+#define CC_EMU_A_P mem[(r[CC_EMU_SP] + inst->va) & 0xffff]
+
+/* Index of the 'b' operand of each kind in 'r' or 'mem', the location
+ * itself, and the check for a store into a cached instruction */
+#define CC_EMU_ADDR_R inst->vb
+#define CC_EMU_ADDR_M inst->vb
+#define CC_EMU_ADDR_O ((r[inst->rb] + inst->vb) & 0xffff)
+#define CC_EMU_ADDR_P ((r[CC_EMU_SP] + inst->vb) & 0xffff)
+#define CC_EMU_B_R r[addr]
+#define CC_EMU_B_M mem[addr]
+#define CC_EMU_B_O mem[addr]
+#define CC_EMU_B_P mem[addr]
+#define CC_EMU_STORE_R
+#define CC_EMU_STORE_M CC_EMU_STORE
+#define CC_EMU_STORE_O CC_EMU_STORE
+#define CC_EMU_STORE_P CC_EMU_STORE
+#define CC_EMU_STORE \
+    if (cached[addr]) { \
+        cc_emu_invalidate(self, addr); \
+    }
+
+/* Records the stack depth after SP has gone down */
+#define CC_EMU_DEEPEN \
+    if (((0x10000 - r[CC_EMU_SP]) & 0xffff) > depth) { \
+        depth = (0x10000 - r[CC_EMU_SP]) & 0xffff; \
+    }
+
+/* Each handler ends by starting the instruction at 'pc' */
+#if CC_EMU_THREADED
+#define CC_EMU_HANDLER(name) h_##name:
+#define CC_EMU_NEXT \
+    inst = code + pc; \
+    if (steps == limit) { \
+        goto done; \
+    } \
+    steps++; \
+    goto *handlers[inst->handler]
+#else
+#define CC_EMU_HANDLER(name) case CC_EMU_##name:
+#define CC_EMU_NEXT continue
+#endif
+
+#define CC_EMU_STEP \
+    cycles += inst->cycles; \
+    pc = (pc + inst->len) & 0xffff; \
+    CC_EMU_NEXT
+
+#define CC_EMU_ARITH_VARIANT(op, b, a) \
+    CC_EMU_HANDLER(op##_##b##a) { \
+        unsigned addr = CC_EMU_ADDR_##b; \
+        unsigned value = CC_EMU_A_##a; \
+        CC_EMU_OP_##op(CC_EMU_B_##b, value); \
+        CC_EMU_STORE_##b \
+    } \
+    CC_EMU_STEP;
+
+#define CC_EMU_IF_VARIANT(op, b, a) \
+    CC_EMU_HANDLER(op##_##b##a) { \
+        unsigned addr = CC_EMU_ADDR_##b; \
+        unsigned value = CC_EMU_A_##a; \
+        CC_EMU_OP_##op(CC_EMU_B_##b, value); \
+    } \
+    if (test) { \
+        CC_EMU_STEP; \
+    } \
+    cycles += inst->cycles; \
+    from = pc; \
+    extra = cycles; \
+    CC_EMU_SKIP \
+    if (prof) { \
+        prof->extra[from] += cycles - extra; \
+        CC_EMU_TRANSFER \
+    } \
+    CC_EMU_NEXT;
+
+/* Skips the instructions after a failed IF, like cc_emu_skip */
+#define CC_EMU_SKIP \
+    pc = (pc + inst->len) & 0xffff; \
+    do { \
+        inst = code + pc; \
+        if (CC_EMU_DECODE == inst->handler) { \
+            cc_emu_decode(self, pc); \
+        } \
+        pc = (pc + inst->len) & 0xffff; \
+        cycles++; \
+    } while (inst->isif);
+
+/* Tells the profiler that control went from 'from' to 'pc' */
+#define CC_EMU_TRANSFER \
+    prof->exits[from]++; \
+    prof->entries[pc]++; \
+    if (prof->owner[from] != prof->owner[pc]) { \
+        cc_prof_jump(prof, pc, cycles); \
+    }
+
+#define CC_EMU_VARIANTS(kind, op, b) kind(op, b, R) kind(op, b, L) \
+    kind(op, b, M) kind(op, b, O) kind(op, b, P)
+#define CC_EMU_BODIES(kind, op) CC_EMU_VARIANTS(kind, op, R) \
+    CC_EMU_VARIANTS(kind, op, M) CC_EMU_VARIANTS(kind, op, O) \
+    CC_EMU_VARIANTS(kind, op, P)
+#define CC_EMU_ARITH_BODY(op) CC_EMU_BODIES(CC_EMU_ARITH_VARIANT, op)
+#define CC_EMU_IF_BODY(op) CC_EMU_BODIES(CC_EMU_IF_VARIANT, op)
+
+#define CC_EMU_LABELS_B(op, b) &&h_##op##_##b##R, &&h_##op##_##b##L, \
+    &&h_##op##_##b##M, &&h_##op##_##b##O, &&h_##op##_##b##P,
+#define CC_EMU_LABELS(op) CC_EMU_LABELS_B(op, R) CC_EMU_LABELS_B(op, M) \
+    CC_EMU_LABELS_B(op, O) CC_EMU_LABELS_B(op, P)
+
+/* Runs until the processor halts or faults, or for at most 'limit'
+ * instructions.  Returns the number of instructions executed. */
+unsigned long cc_emu_run(cc_emu * self, unsigned long limit) {
+#if CC_EMU_THREADED
+    static void * const handlers[CC_EMU_HANDLERS] = {
+        &&h_DECODE, &&h_GENERIC, &&h_HALT, &&h_JUMP, &&h_CALL, &&h_RET,
+        &&h_PUSHR, &&h_PUSHL, &&h_POPR, &&h_FAULT,
+        CC_EMU_FAST(CC_EMU_LABELS)
+    };
+#endif
+    unsigned short * const mem = self->mem;
+    unsigned short * const r = self->regs;
+    cc_prof * const prof = self->prof;
+    unsigned char * cached = 0;
+    cc_emuinst * code = 0;
+    cc_emuinst * inst = 0;
+    unsigned long cycles = self->cycles;
+    unsigned long steps = 0;
+    unsigned long extra = 0;
+    unsigned depth = self->depth;
+    unsigned long t = 0;
+    long s = 0;
+    unsigned pc = r[CC_EMU_PC];
+    unsigned from = 0;
+    int test = 0;
+
+    if (self->halted) {
+        return 0;
+    }
+    if (!self->cache) {
+        cc_emu_attach(self, cc_emucache_init());
+        self->owns = 1;
+    } else if (self != self->cache->owner) {
+        cc_emu_attach(self, self->cache);
+    }
+    cached = self->cache->cached;
+    code = self->cache->code;
+    if (prof) {
+        cc_prof_start(prof, pc, cycles);
+    }
+#if CC_EMU_THREADED
+    CC_EMU_NEXT;
+#else
+    for (;;) {
+        inst = code + pc;
+        if (steps == limit) {
+            goto done;
+        }
+        steps++;
+        switch (inst->handler) {
+#endif
+
+    CC_EMU_HANDLER(DECODE)
+        cc_emu_decode(self, pc);
+        steps--;
+        CC_EMU_NEXT;
+    CC_EMU_HANDLER(GENERIC)
+        from = pc;
+        r[CC_EMU_PC] = (unsigned short)(pc + inst->len);
+        extra = cc_emu_generic(self, inst);
+        cycles += inst->cycles + extra;
+        pc = r[CC_EMU_PC];
+        CC_EMU_DEEPEN
+        if (prof && CC_OP_JSR == inst->op) {
+            prof->exits[from]++;
+            prof->entries[pc]++;
+            cc_prof_call(prof, pc, r[CC_EMU_SP], cycles);
+        } else if (prof && pc != ((from + inst->len) & 0xffff)) {
+            prof->extra[from] += extra;
+            CC_EMU_TRANSFER
+        }
+        if (self->halted) {
+            goto done;
+        }
+        CC_EMU_NEXT;
+    CC_EMU_HANDLER(HALT)
+        cycles += inst->cycles;
+        self->halted = 1;
+        if (prof) {
+            /* It ran, so it mustn't be discounted below like the
+             * instruction a run stops at */
+            prof->exits[pc]++;
+            prof->entries[pc]++;
+        }
+        goto done;
+    CC_EMU_HANDLER(JUMP)
+        from = pc;
+        cycles += inst->cycles;
+        pc = inst->va;
+        if (prof) {
+            CC_EMU_TRANSFER
+        }
+        CC_EMU_NEXT;
+    CC_EMU_HANDLER(CALL) {
+        unsigned addr = --r[CC_EMU_SP];
+        mem[addr] = (unsigned short)(pc + inst->len);
+        CC_EMU_STORE
+        CC_EMU_DEEPEN
+    }
+    from = pc;
+    cycles += inst->cycles;
+    pc = inst->va;
+    if (prof) {
+        prof->exits[from]++;
+        prof->entries[pc]++;
+        cc_prof_call(prof, pc, r[CC_EMU_SP], cycles);
+    }
+    CC_EMU_NEXT;
+    CC_EMU_HANDLER(RET)
+        from = pc;
+        cycles += inst->cycles;
+        pc = mem[r[CC_EMU_SP]++];
+        if (prof) {
+            prof->exits[from]++;
+            prof->entries[pc]++;
+            cc_prof_return(prof, pc, r[CC_EMU_SP], cycles);
+        }
+        CC_EMU_NEXT;
+    CC_EMU_HANDLER(PUSHR) {
+        unsigned addr = --r[CC_EMU_SP];
+        mem[addr] = r[inst->va];
+        CC_EMU_STORE
+        CC_EMU_DEEPEN
+    }
+    CC_EMU_STEP;
+    CC_EMU_HANDLER(PUSHL) {
+        unsigned addr = --r[CC_EMU_SP];
+        mem[addr] = inst->va;
+        CC_EMU_STORE
+        CC_EMU_DEEPEN
+    }
+    CC_EMU_STEP;
+    CC_EMU_HANDLER(POPR)
+        r[inst->vb] = mem[r[CC_EMU_SP]++];
+        CC_EMU_STEP;
+    CC_EMU_HANDLER(FAULT)
+        self->halted = 1;
+        self->fault = 1;
+        goto done;
+    CC_EMU_ARITH(CC_EMU_ARITH_BODY)
+    CC_EMU_IFS(CC_EMU_IF_BODY)
+
+#if !CC_EMU_THREADED
+        }
+    }
+#endif
+done:
+    if (prof) {
+        prof->entries[pc]--;
+        cc_prof_stop(prof, cycles);
+    }
+    r[CC_EMU_PC] = (unsigned short)pc;
+    self->cycles = cycles;
+    self->steps += steps;
+    self->depth = depth;
+    return steps;
+}
+
+/* Prints the registers and counters */
+void cc_emu_print(cc_emu * self, FILE * out) {
+    int reg = 0;
+    fprintf(out, "cycles %lu steps %lu%s\n", self->cycles, self->steps,
+        self->fault ? " fault" : "");
+    for (reg = CC_REG_A; reg < CC_REG_COUNT; ++reg) {
+        fprintf(out, "%s%s %u", reg ? " " : "", cc_reg_name(reg),
+            self->regs[reg]);
+    }
+    fprintf(out, "\nSP %u PC %u EX %u IA %u depth %u\n",
+        self->regs[CC_EMU_SP], self->regs[CC_EMU_PC], self->regs[CC_EMU_EX],
+        self->regs[CC_EMU_IA], self->depth);
+}
+
+void cc_emu_free(cc_emu * self) {
+    if (self->owns) {
+        cc_emucache_free(self->cache);
+    }
+    free(self);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_EMU_H
+#define CC_EMU_H
+
+#include "dcpu.h"
+#include <stdio.h>
+
+/* Indexes of the special registers in cc_emu.regs, after A to J */
+#define CC_EMU_SP 8
+#define CC_EMU_PC 9
+#define CC_EMU_EX 10
+#define CC_EMU_IA 11
+#define CC_EMU_REGS 12
+
+/* Longest interrupt queue before the processor catches fire */
+#define CC_EMU_QUEUE 256
+
+/* Predecoded instruction.  'handler' selects the code that executes it.
+ * Each operand is stored as a kind (one of the CC_EMU_OPD_* values), a
+ * register index and a value whose meaning depends on the kind. */
+typedef struct cc_emuinst {
+    unsigned short handler;
+    unsigned short va;
+    unsigned short vb;
+    unsigned char ka;
+    unsigned char kb;
+    unsigned char ra;
+    unsigned char rb;
+    unsigned char op; /* cc_op */
+    unsigned char len; /* Words */
+    unsigned char cycles; /* Not counting a failed IF */
+    unsigned char isif;
+    unsigned char pad[2]; /* Keeps the size a power of two */
+} cc_emuinst;
+
+/* Operand kinds.  For 'REG' the value is an index into cc_emu.regs (never
+ * the PC); for 'LIT' a literal; for 'MEM' an address; for 'IND' and 'OFF'
+ * an offset from the register; and for 'PICK' an offset from SP. */
+#define CC_EMU_OPD_REG 0
+#define CC_EMU_OPD_LIT 1
+#define CC_EMU_OPD_MEM 2
+#define CC_EMU_OPD_OFF 3
+#define CC_EMU_OPD_PUSHPOP 4
+#define CC_EMU_OPD_PICK 5
+#define CC_EMU_OPD_PC 6
+
+/* Cache of decoded instructions.  A cache serves one emulator at a time,
+ * and is flushed when another one is attached to it; only the entries
+ * decoded since the last flush are cleared. */
+typedef struct cc_emucache {
+    cc_emuinst * code; /* Cached instructions, by address */
+    unsigned char * cached; /* Words that are part of a cached instruction */
+    unsigned short * decoded; /* Addresses decoded since the last flush */
+    int count;
+    struct cc_emu * owner;
+} cc_emucache;
+
+/* Alignment of each emulator, so that emulators running on different
+ * threads never share a cache line */
+#define CC_EMU_ALIGN 64
+
+/* Emulated DCPU-16 with no attached hardware.  Instructions are decoded the
+ * first time they run into a cache indexed by address, and executed by
+ * threaded dispatch through the handler of each cached instruction.  A
+ * store to a word that is part of a cached instruction drops it from the
+ * cache, so self-modifying code behaves as on the real processor.
+ *
+ * The idiom SUB PC, 1 halts the emulator, like the startup code expects. */
+typedef struct cc_emu {
+    unsigned short regs[CC_EMU_REGS];
+    unsigned long cycles;
+    unsigned long steps; /* Instructions executed */
+    unsigned depth; /* Most words on the stack at once, with SP from 0 */
+    int halted;
+    int fault; /* Executed an invalid instruction */
+    int queueing; /* Interrupts are queued rather than triggered */
+    int queued;
+    cc_emucache * cache;
+    int owns; /* The cache was allocated for this emulator */
+    struct cc_prof * prof; /* Told about control transfers, if set */
+    unsigned short queue[CC_EMU_QUEUE];
+    unsigned short mem[CC_DCPU_WORDS];
+} cc_emu;
+
+cc_emu * cc_emu_init();
+int cc_emu_load(cc_emu * self, char const * path);
+void cc_emu_reset(cc_emu * self);
+void cc_emu_attach(cc_emu * self, cc_emucache * cache);
+unsigned long cc_emu_run(cc_emu * self, unsigned long steps);
+void cc_emu_print(cc_emu * self, FILE * out);
+void cc_emu_free(cc_emu * self);
+cc_emucache * cc_emucache_init();
+void cc_emucache_flush(cc_emucache * self);
+void cc_emucache_free(cc_emucache * self);
+
+#endif
@@ -22,6 +22,7 @@
 
 #include "env.h"
 #include "lexer.h"
+#include "report.h"
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -29,24 +30,100 @@
 
 int tabs = 0;
 
-/* Does a naive linear search through the list of identifiers to see if there's
- * already a matching one */
+static unsigned cc_env_hash(char const * str) {
+    unsigned hash = 2166136261u;
+    while (*str) {
+        hash = (hash ^ (unsigned char)*str++) * 16777619u;
+    }
+    return hash;
+}
+
+/* Returns the slot for 'str': the one that holds it, or the empty slot
+ * where it belongs */
+static cc_id ** cc_env_slot(cc_ids * self, char const * str) {
+    unsigned mask = self->capacity - 1;
+    unsigned i = cc_env_hash(str) & mask;
+    while (self->table[i] && strcmp(self->table[i]->str, str)) {
+        i = (i + 1) & mask;
+    }
+    return self->table + i;
+}
+
+/* Returns the identifier 'str', interning it if it hasn't been seen yet.
+ * The table doubles whenever it would become more than half full. */
 cc_id * cc_env_id(cc_env * self, char const * str) {
-    cc_id * id = 0;
-    for (id = self->ids; id; id = id->next) {
-        if (!strcmp(id->str, str)) {
-            return id;
+    cc_ids * ids = &self->ids;
+    cc_id ** slot = 0;
+    if (self->lock) {
+        pthread_mutex_lock(self->lock);
+    }
+    if (2 * (ids->count + 1) > ids->capacity) {
+        cc_id ** old = ids->table;
+        int capacity = ids->capacity;
+        int i = 0;
+        ids->capacity = capacity ? capacity * 2 : 1024;
+        ids->table = calloc(ids->capacity, sizeof(cc_id *));
+        for (i = 0; i < capacity; ++i) {
+            if (old[i]) {
+                *cc_env_slot(ids, old[i]->str) = old[i];
+            }
         }
-    } 
-    id = calloc(1, sizeof(cc_id));
-    id->str = strdup(str);  
-    return id;
+        free(old);
+    }
+    slot = cc_env_slot(ids, str);
+    if (self->report) {
+        self->report->lookups++;
+        self->report->hits += *slot ? 1 : 0;
+    }
+    if (!*slot) {
+        *slot = calloc(1, sizeof(cc_id));
+        (*slot)->str = strdup(str);
+        ids->count++;
+    }
+    if (self->lock) {
+        pthread_mutex_unlock(self->lock);
+    }
+    return *slot;
+}
+
+cc_var * cc_env_var(cc_env * self, cc_id * id) {
+    return cc_find_var(self->vars, id);
+}
+
+cc_func * cc_env_func(cc_env * self, cc_id * id) {
+    return cc_find_func(self->funcs, id);
+}
+
+/* Returns the struct named 'id', creating an undefined one if the name
+ * hasn't been seen yet */
+cc_struct * cc_env_struct(cc_env * self, cc_id * id) {
+    cc_struct * record = 0;
+    cc_struct ** tail = &self->structs;
+    for (record = self->structs; record; record = record->next) {
+        if (record->id == id) {
+            return record;
+        }
+        tail = &record->next;
+    }
+    record = cc_ast_alloc(sizeof(cc_struct));
+    record->node.type = CC_STRUCT;
+    record->id = id;
+    *tail = record;
+    return record;
 }
 
 void cc_env_print(cc_env * self) {
     cc_func * func = 0;
+    cc_struct * record = 0;
+    for (record = self->structs; record; record = record->next) {
+        if (record->defined) {
+            cc_struct_print(record);
+            printf("\n");
+        }
+    }
     for (func = self->funcs; func; func = func->next) {
         cc_func_print(func); 
+        printf("\n");
     }
     fflush(stdout);
 }
@@ -64,7 +141,12 @@ void cc_func_print(cc_func * self) {
             printf(", ");
         }
     }
-    cc_block_print(self->block);
+    if (self->block) {
+        printf(") ");
+        cc_block_print(self->block);
+    } else {
+        printf(");\n");
+    }
 }
 
 void cc_formal_print(cc_formal * formal) {
@@ -88,7 +170,7 @@ void cc_type_print(cc_type * self) {
         printf("[]");
     }
     else {
-        printf("%s", self->id->str);
+        printf(self->record ? "struct %s" : "%s", self->id->str);
     }
 }
 
@@ -97,7 +179,7 @@ void cc_block_print(cc_block * self) {
     cc_stmt * stmt = 0;
     int i = 0;
 
-    printf(") {\n");
+    printf("{\n");
     tabs++;
     for (var = self->vars; var; var = var->next) {
         cc_var_print(var);
@@ -110,7 +192,7 @@ void cc_block_print(cc_block * self) {
     for (i = 0; i < tabs; ++i) {
         printf("    ");
     }
-    printf("}\n\n");
+    printf("}\n");
 }
 
 void cc_var_print(cc_var * var) {
@@ -121,13 +203,22 @@ void cc_var_print(cc_var * var) {
     cc_type_print(var->type); 
     putc(' ', stdout);
     cc_id_print(var->id);
-    printf(" = ");
-    cc_expr_print(var->init); 
+    if (var->init) {
+        printf(" = ");
+        cc_expr_print(var->init); 
+    }
     printf(";\n");
 }
 
 void cc_stmt_print(cc_stmt * self) {
+    int i = 0;
     switch (self->node.type) {
+    case CC_BLOCK:
+        for (i = 0; i < tabs; ++i) {
+            printf("    ");
+        }
+        cc_block_print((cc_block *)self);
+        break;
     case CC_IF:
         cc_if_print((cc_if *)self);
         break;
@@ -150,6 +241,34 @@ void cc_stmt_print(cc_stmt * self) {
 }
 
 void cc_if_print(cc_if * self) {
+    int i = 0;
+    for (i = 0; i < tabs; ++i) {
+        printf("    ");
+    }
+    printf("if (");
+    cc_expr_print(self->guard);
+    printf(")");
+    cc_branch_print(self->yes);
+    if (self->no) {
+        for (i = 0; i < tabs; ++i) {
+            printf("    ");
+        }
+        printf("else");
+        cc_branch_print(self->no);
+    }
+}
+
+/* Prints the statement following an if or else keyword */
+void cc_branch_print(cc_stmt * self) {
+    if (CC_BLOCK == self->node.type) {
+        printf(" ");
+        cc_block_print((cc_block *)self);
+    } else {
+        printf("\n");
+        tabs++;
+        cc_stmt_print(self);
+        tabs--;
+    }
 }
 
 void cc_for_print(cc_loop * self) {
@@ -169,7 +288,7 @@ void cc_for_print(cc_loop * self) {
     if (self->update) {
         cc_expr_print(self->update);
     }
-    printf(")");
+    printf(") ");
     if (self->block) {
         cc_block_print(self->block);
     } else {
@@ -178,6 +297,14 @@ void cc_for_print(cc_loop * self) {
 }
 
 void cc_while_print(cc_loop * self) {
+    int i = 0;
+    for (i = 0; i < tabs; ++i) {
+        printf("    ");
+    }
+    printf("while (");
+    cc_expr_print(self->guard);
+    printf(") ");
+    cc_block_print(self->block);
 }
 
 void cc_simple_print(cc_simple * self) {
@@ -235,6 +362,22 @@ void cc_expr_print(cc_expr * self) {
 }
 
 void cc_member_print(cc_member * self) {
+    cc_expr_print(self->expr);
+    putc('.', stdout);
+    cc_id_print(self->id);
+}
+
+void cc_struct_print(cc_struct * self) {
+    cc_var * var = 0;
+    printf("struct ");
+    cc_id_print(self->id);
+    printf(" {\n");
+    tabs++;
+    for (var = self->vars; var; var = var->next) {
+        cc_var_print(var);
+    }
+    tabs--;
+    printf("};\n");
 }
 
 void cc_binary_print(cc_binary * self) {
@@ -24,6 +24,16 @@
 #define CC_ENV_H
 
 #include "ast.h"
+#include <pthread.h>
+
+/* Interned identifiers, in an open-addressed hash table kept at most half
+ * full.  The table outlives the units of a batch, so that names from every
+ * unit stay unique. */
+typedef struct cc_ids {
+    cc_id ** table;
+    int count;
+    int capacity;
+} cc_ids;
 
 /* The environment holds the global symbol table,
  * amongst other things.  Any shared whole-program
@@ -31,12 +41,17 @@
 typedef struct cc_env {
     cc_func * funcs;
     cc_var * vars; /* Global variables */
-    cc_id * ids; /* Identifiers */
+    cc_struct * structs;
+    cc_ids ids; /* Identifiers */
+    struct cc_pgo * pgo; /* Profile counters, if generated or used */
+    pthread_mutex_t * lock; /* Guards 'ids' while tasks run (see par.h) */
+    struct cc_report * report; /* Statistics, if reported (see report.h) */
 } cc_env;
 
 cc_id * cc_env_id(cc_env * self, char const * str);
 cc_var * cc_env_var(cc_env * self, cc_id * id);
 cc_func * cc_env_func(cc_env * self, cc_id * id);
+cc_struct * cc_env_struct(cc_env * self, cc_id * id);
 void cc_env_print(cc_env * self);
 void cc_func_print(cc_func * self);
 void cc_type_print(cc_type * self);
@@ -47,6 +62,7 @@ void cc_var_print(cc_var * self);
 void cc_expr_print(cc_expr * self);
 void cc_id_print(cc_id * self);
 void cc_member_print(cc_member * self);
+void cc_struct_print(cc_struct * self);
 void cc_binary_print(cc_binary * self);
 void cc_unary_print(cc_unary * self);
 void cc_call_print(cc_call * self);
@@ -54,6 +70,7 @@ void cc_ref_print(cc_ref * self);
 void cc_number_print(cc_number * self);
 void cc_string_print(cc_string * self);
 void cc_if_print(cc_if * self);
+void cc_branch_print(cc_stmt * self);
 void cc_for_print(cc_loop * self);
 void cc_while_print(cc_loop * self);
 void cc_simple_print(cc_simple * self);
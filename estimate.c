@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "estimate.h"
+#include "dcpu.h"
+#include <stdlib.h>
+#include <string.h>
+
+cc_estimate * cc_estimate_init(cc_gen * gen) {
+    cc_estimate * self = calloc(1, sizeof(cc_estimate));
+    self->gen = gen;
+    return self;
+}
+
+void cc_estimate_free(cc_estimate * self) {
+    free(self->blocks);
+    free(self->funcs);
+    free(self->lines);
+    free(self);
+}
+
+/* Returns non-zero if the instruction transfers control, ending its block */
+static int cc_estimate_ends(cc_inst * inst) {
+    return CC_INST_LABEL != inst->op && CC_OP_JSR != inst->op
+        && CC_VAL_PC == inst->b.mode;
+}
+
+static cc_estblock * cc_estimate_block(cc_estimate * self, cc_code * code,
+    int start) {
+
+    cc_estblock * block = 0;
+    if (self->nblocks >= self->capblocks) {
+        self->capblocks = self->capblocks ? self->capblocks * 2 : 64;
+        self->blocks = realloc(self->blocks,
+            self->capblocks * sizeof(cc_estblock));
+    }
+    block = self->blocks + self->nblocks++;
+    memset(block, 0, sizeof(cc_estblock));
+    block->code = code;
+    block->start = start;
+    block->end = start;
+    block->line = code->insts[start].line;
+    block->count = code->insts[start].weight;
+    return block;
+}
+
+/* Estimates the cycles of one function */
+static void cc_estimate_code(cc_estimate * self, cc_estfunc * func) {
+    cc_code * code = func->code;
+    cc_estblock * block = 0;
+    double weight = 0;
+    int skip = 0; /* The previous instruction is an IF */
+    int i = 0;
+
+    func->first = self->nblocks;
+    for (i = 0; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        cc_estline * line = 0;
+        double cycles = 0;
+        if (CC_INST_LABEL == inst->op) {
+            block = 0;
+            skip = 0;
+            continue;
+        }
+        if (!block) {
+            block = cc_estimate_block(self, code, i);
+            func->blocks++;
+        }
+        weight = skip ? weight / 2 : inst->weight;
+        skip = cc_op_isif(inst->op);
+        cycles = weight * (cc_inst_cycles(inst) + (skip ? 0.5 : 0));
+
+        block->end = i + 1;
+        block->words += cc_inst_words(inst);
+        block->cycles += cycles;
+        func->words += cc_inst_words(inst);
+        func->cycles += cycles;
+        if (inst->line > 0 && inst->line < self->nlines) {
+            line = self->lines + inst->line;
+            line->words += cc_inst_words(inst);
+            line->cycles += cycles;
+        }
+        if (cc_estimate_ends(inst)) {
+            block = 0;
+        }
+    }
+}
+
+/* Estimates every function of the program */
+void cc_estimate_env(cc_estimate * self) {
+    cc_code * code = 0;
+    int i = 0;
+
+    self->nlines = 1;
+    for (code = self->gen->codes; code; code = code->next) {
+        for (i = 0; i < code->count; ++i) {
+            if (code->insts[i].line >= self->nlines) {
+                self->nlines = code->insts[i].line + 1;
+            }
+        }
+        self->nfuncs++;
+    }
+    self->lines = calloc(self->nlines, sizeof(cc_estline));
+    self->funcs = calloc(self->nfuncs, sizeof(cc_estfunc));
+    for (code = self->gen->codes, i = 0; code; code = code->next, ++i) {
+        self->funcs[i].code = code;
+        cc_estimate_code(self, self->funcs + i);
+    }
+}
+
+/* Prints the source text with the words and estimated cycles of each line,
+ * followed by the blocks of each function */
+void cc_estimate_listing(cc_estimate * self, char const * file,
+    FILE * out) {
+
+    FILE * in = fopen(file, "r");
+    char text[256];
+    int number = 1;
+    int fresh = 1; /* At the start of a source line */
+    int i = 0;
+    int k = 0;
+
+    fprintf(out, "; Estimated cycles per call of each function\n");
+    fprintf(out, ";   cycles words | %s\n", file);
+    while (in && fgets(text, sizeof(text), in)) {
+        if (fresh && number < self->nlines && self->lines[number].words) {
+            cc_estline * line = self->lines + number;
+            fprintf(out, "%10.1f %5d | %s", line->cycles, line->words, text);
+        } else if (fresh) {
+            fprintf(out, "%16s | %s", "", text);
+        } else {
+            fputs(text, out);
+        }
+        fresh = !!strchr(text, '\n');
+        number += fresh;
+    }
+    if (!fresh) {
+        fputc('\n', out);
+    }
+    if (in) {
+        fclose(in);
+    }
+
+    fprintf(out, "\n; %-20s %6s %10s %6s\n", "function", "words", "cycles",
+        "blocks");
+    for (i = 0; i < self->nfuncs; ++i) {
+        cc_estfunc * func = self->funcs + i;
+        fprintf(out, "; %-20s %6d %10.1f %6d\n", func->code->id->str,
+            func->words, func->cycles, func->blocks);
+        for (k = func->first; k < func->first + func->blocks; ++k) {
+            cc_estblock * block = self->blocks + k;
+            fprintf(out, ";   line %-5d %4d words %10.1f runs %10.1f cycles\n",
+                block->line, block->words, block->count, block->cycles);
+        }
+    }
+}
+
+/* Prints a JSON string */
+static void cc_estimate_string(char const * str, FILE * out) {
+    fputc('"', out);
+    for (; *str; ++str) {
+        if ('"' == *str || '\\' == *str) {
+            fputc('\\', out);
+        }
+        if ((unsigned char)*str < ' ') {
+            fprintf(out, "\\u%04x", (unsigned char)*str);
+        } else {
+            fputc(*str, out);
+        }
+    }
+    fputc('"', out);
+}
+
+/* Prints the estimate as JSON: the functions with their blocks, and the
+ * source lines that produced code */
+void cc_estimate_json(cc_estimate * self, char const * file, FILE * out) {
+    int i = 0;
+    int k = 0;
+
+    fprintf(out, "{\n  \"file\": ");
+    cc_estimate_string(file, out);
+    fprintf(out, ",\n  \"functions\": [");
+    for (i = 0; i < self->nfuncs; ++i) {
+        cc_estfunc * func = self->funcs + i;
+        fprintf(out, "%s\n    {\"name\": ", i ? "," : "");
+        cc_estimate_string(func->code->id->str, out);
+        fprintf(out, ", \"words\": %d, \"cycles\": %.1f, \"blocks\": [",
+            func->words, func->cycles);
+        for (k = func->first; k < func->first + func->blocks; ++k) {
+            cc_estblock * block = self->blocks + k;
+            fprintf(out, "%s\n      {\"line\": %d, \"words\": %d, "
+                "\"count\": %.2f, \"cycles\": %.1f}",
+                k > func->first ? "," : "", block->line, block->words,
+                block->count, block->cycles);
+        }
+        fprintf(out, "%s]}", func->blocks ? "\n    " : "");
+    }
+    fprintf(out, "\n  ],\n  \"lines\": [");
+    for (i = 0, k = 0; i < self->nlines; ++i) {
+        if (self->lines[i].words) {
+            fprintf(out, "%s\n    {\"line\": %d, \"words\": %d, "
+                "\"cycles\": %.1f}", k++ ? "," : "", i,
+                self->lines[i].words, self->lines[i].cycles);
+        }
+    }
+    fprintf(out, "\n  ]\n}\n");
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_ESTIMATE_H
+#define CC_ESTIMATE_H
+
+#include "gen.h"
+#include <stdio.h>
+
+/* Static cycle estimate of the generated code.  Each instruction carries
+ * the number of times it is expected to run per call of its function, set
+ * by the code generator: loop bodies are multiplied by the trip count when
+ * it is constant and by CC_FRAME_LOOP otherwise, and each arm of an if
+ * statement runs half of the time.  On top of that, the instruction after
+ * an IF runs half as often as the IF, and the IF pays one extra cycle when
+ * it skips.
+ *
+ * The code of each function is split into basic blocks at labels and
+ * after jumps.  Cycles are summed per block, per function (excluding
+ * callees) and per source line. */
+
+/* Basic block: instructions 'start' up to 'end' of 'code' */
+typedef struct cc_estblock {
+    cc_code * code;
+    int start;
+    int end;
+    int line; /* Source line of the first instruction */
+    int words;
+    double count; /* Estimated executions per call of the function */
+    double cycles; /* Estimated cycles per call of the function */
+} cc_estblock;
+
+typedef struct cc_estfunc {
+    cc_code * code;
+    int first; /* Index of the first block */
+    int blocks;
+    int words;
+    double cycles; /* Estimated cycles per call */
+} cc_estfunc;
+
+typedef struct cc_estline {
+    int words;
+    double cycles;
+} cc_estline;
+
+typedef struct cc_estimate {
+    cc_gen * gen;
+    cc_estblock * blocks;
+    int nblocks;
+    int capblocks;
+    cc_estfunc * funcs;
+    int nfuncs;
+    cc_estline * lines; /* Indexed by source line */
+    int nlines;
+} cc_estimate;
+
+cc_estimate * cc_estimate_init(cc_gen * gen);
+void cc_estimate_free(cc_estimate * self);
+void cc_estimate_env(cc_estimate * self);
+void cc_estimate_listing(cc_estimate * self, char const * file, FILE * out);
+void cc_estimate_json(cc_estimate * self, char const * file, FILE * out);
+
+#endif
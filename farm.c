@@ -0,0 +1,201 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "farm.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/time.h>
+
+cc_farm * cc_farm_init(int threads) {
+    cc_farm * self = calloc(1, sizeof(cc_farm));
+    self->threads = threads > 0 ? threads : 1;
+    self->slice = CC_FARM_SLICE;
+    self->limit = (unsigned long)-1;
+    pthread_mutex_init(&self->lock, 0);
+    return self;
+}
+
+/* Allocates zeroed memory that fills whole cache lines of its own */
+static void * cc_farm_alloc(size_t size) {
+    void * self = 0;
+    size = (size + CC_EMU_ALIGN - 1) & ~(CC_EMU_ALIGN - 1);
+    if (posix_memalign(&self, CC_EMU_ALIGN, size)) {
+        return 0;
+    }
+    memset(self, 0, size);
+    return self;
+}
+
+void cc_farm_add(cc_farm * self, cc_emu * emu) {
+    if (self->count >= self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 16;
+        self->emus = realloc(self->emus, self->capacity * sizeof(cc_emu *));
+    }
+    self->emus[self->count++] = emu;
+}
+
+/* Queues are as large as the farm, so they never fill up */
+static void cc_farm_push(cc_farmqueue * queue, int item) {
+    pthread_mutex_lock(&queue->lock);
+    queue->items[(queue->head + queue->count++) % queue->capacity] = item;
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* Takes the instance at the head of the queue, or returns -1 */
+static int cc_farm_take(cc_farmqueue * queue) {
+    int item = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count) {
+        item = queue->items[queue->head];
+        queue->head = (queue->head + 1) % queue->capacity;
+        queue->count--;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+/* Takes the instance at the tail of the queue, or returns -1 */
+static int cc_farm_steal(cc_farmqueue * queue) {
+    int item = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->count) {
+        queue->count--;
+        item = queue->items[(queue->head + queue->count) % queue->capacity];
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return item;
+}
+
+static void * cc_farm_work(void * arg) {
+    cc_farmworker * worker = arg;
+    cc_farm * farm = worker->farm;
+    int remaining = 0;
+    int item = 0;
+    int k = 0;
+
+    for (;;) {
+        cc_emu * emu = 0;
+        unsigned long budget = 0;
+        item = cc_farm_take(farm->queues[worker->index]);
+        for (k = 1; item < 0 && k < farm->threads; ++k) {
+            item = cc_farm_steal(farm->queues[(worker->index + k)
+                % farm->threads]);
+            worker->steals += item >= 0;
+        }
+        if (item < 0) {
+            pthread_mutex_lock(&farm->lock);
+            remaining = farm->remaining;
+            pthread_mutex_unlock(&farm->lock);
+            if (!remaining) {
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+
+        emu = farm->emus[item];
+        cc_emu_attach(emu, worker->cache);
+        budget = farm->limit - emu->steps;
+        cc_emu_run(emu, budget < farm->slice ? budget : farm->slice);
+        worker->slices++;
+        if (emu->halted || emu->steps >= farm->limit) {
+            pthread_mutex_lock(&farm->lock);
+            farm->remaining--;
+            pthread_mutex_unlock(&farm->lock);
+        } else {
+            cc_farm_push(farm->queues[worker->index], item);
+        }
+    }
+    return 0;
+}
+
+/* Runs every instance until it halts or reaches the limit.  Instances are
+ * dealt to the workers in turn. */
+void cc_farm_run(cc_farm * self) {
+    struct timeval start;
+    struct timeval end;
+    int i = 0;
+
+    self->queues = calloc(self->threads, sizeof(cc_farmqueue *));
+    self->workers = calloc(self->threads, sizeof(cc_farmworker *));
+    for (i = 0; i < self->threads; ++i) {
+        cc_farmqueue * queue = cc_farm_alloc(sizeof(cc_farmqueue));
+        cc_farmworker * worker = cc_farm_alloc(sizeof(cc_farmworker));
+        pthread_mutex_init(&queue->lock, 0);
+        queue->capacity = self->count ? self->count : 1;
+        queue->items = cc_farm_alloc(queue->capacity * sizeof(int));
+        worker->farm = self;
+        worker->index = i;
+        worker->cache = cc_emucache_init();
+        self->queues[i] = queue;
+        self->workers[i] = worker;
+    }
+    for (i = 0; i < self->count; ++i) {
+        cc_farm_push(self->queues[i % self->threads], i);
+    }
+    self->remaining = self->count;
+
+    gettimeofday(&start, 0);
+    for (i = 0; i < self->threads; ++i) {
+        pthread_create(&self->workers[i]->thread, 0, cc_farm_work,
+            self->workers[i]);
+    }
+    for (i = 0; i < self->threads; ++i) {
+        pthread_join(self->workers[i]->thread, 0);
+    }
+    gettimeofday(&end, 0);
+    self->seconds = (end.tv_sec - start.tv_sec)
+        + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+/* Returns the instructions run by every instance */
+unsigned long cc_farm_steps(cc_farm * self) {
+    unsigned long steps = 0;
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        steps += self->emus[i]->steps;
+    }
+    return steps;
+}
+
+/* Frees the farm and its workers, but not the instances */
+void cc_farm_free(cc_farm * self) {
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        if (!self->emus[i]->owns) {
+            self->emus[i]->cache = 0;
+        }
+    }
+    for (i = 0; self->workers && i < self->threads; ++i) {
+        pthread_mutex_destroy(&self->queues[i]->lock);
+        free(self->queues[i]->items);
+        free(self->queues[i]);
+        cc_emucache_free(self->workers[i]->cache);
+        free(self->workers[i]);
+    }
+    pthread_mutex_destroy(&self->lock);
+    free(self->queues);
+    free(self->workers);
+    free(self->emus);
+    free(self);
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_FARM_H
+#define CC_FARM_H
+
+#include "emu.h"
+#include <pthread.h>
+
+/* Default time slice, in instructions */
+#define CC_FARM_SLICE 100000
+
+/* Run queue of one worker.  The owner takes instances from the head and
+ * puts them back at the tail, so its instances share the thread fairly;
+ * other workers steal from the tail.  Like the workers, each queue and its
+ * ring are aligned to whole cache lines (see CC_EMU_ALIGN), so that
+ * workers don't slow each other down by writing to lines they share. */
+typedef struct cc_farmqueue {
+    pthread_mutex_t lock;
+    int * items; /* Indexes of instances, in a ring */
+    int head;
+    int count;
+    int capacity;
+} cc_farmqueue;
+
+struct cc_farm;
+
+typedef struct cc_farmworker {
+    struct cc_farm * farm;
+    int index;
+    pthread_t thread;
+    cc_emucache * cache; /* Shared by the instances the worker runs */
+    unsigned long slices;
+    unsigned long steals;
+} cc_farmworker;
+
+/* Runs many independent emulators on a pool of threads.  Each instance
+ * runs for at most 'slice' instructions at a time, then goes back to the
+ * queue of the worker that ran it.  A worker whose queue is empty steals
+ * from the others. */
+typedef struct cc_farm {
+    cc_emu ** emus;
+    int count;
+    int capacity;
+    int threads;
+    unsigned long slice;
+    unsigned long limit; /* Most instructions run by one instance */
+    cc_farmqueue ** queues;
+    cc_farmworker ** workers;
+    pthread_mutex_t lock;
+    int remaining; /* Instances that haven't stopped */
+    double seconds; /* Wall clock time of the last run */
+} cc_farm;
+
+cc_farm * cc_farm_init(int threads);
+void cc_farm_add(cc_farm * self, cc_emu * emu);
+void cc_farm_run(cc_farm * self);
+unsigned long cc_farm_steps(cc_farm * self);
+void cc_farm_free(cc_farm * self);
+
+#endif
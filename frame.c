@@ -0,0 +1,1177 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "frame.h"
+#include "lexer.h"
+#include "mem.h"
+#include "pool.h"
+#include "check.h"
+#include "pgo.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void cc_frame_weigh_stmt(cc_gen * self, cc_stmt * stmt, long weight);
+static void cc_frame_weigh_expr(cc_gen * self, cc_expr * expr, long weight);
+
+/* Returns the register operand for argument register 'i' */
+static cc_operand cc_frame_arg(int i) {
+    return cc_opd_reg(CC_REG_A + i);
+}
+
+/* Returns the operand for a slot at 'offset' from the frame base, which is
+ * where J points if the function has a frame pointer.  Otherwise, the slot is
+ * addressed relative to SP, and the offset is fixed up by cc_frame_leave once
+ * the frame size and the saved registers are known. */
+static cc_operand cc_frame_at(cc_gen * self, int offset) {
+    cc_operand opd;
+    if (self->fp) {
+        return cc_opd_off(CC_REG_J, offset);
+    }
+    opd = cc_opd_pick(1);
+    opd.value = offset + self->depth;
+    opd.frame = offset < 0 ? CC_OPD_LOCAL : CC_OPD_FORMAL;
+    return opd;
+}
+
+/* Returns the operand that holds a local or formal */
+cc_operand cc_frame_home(cc_gen * self, cc_local * local) {
+    if (local->reg >= 0) {
+        return cc_opd_reg(local->reg);
+    }
+    return cc_frame_at(self, local->offset);
+}
+
+/* Returns the operand for stack argument 'n' of the function.  Without a
+ * frame pointer, the saved J isn't there, so the arguments start one word
+ * closer to the frame base. */
+static cc_operand cc_frame_stack(cc_gen * self, int n) {
+    return cc_frame_at(self, (self->fp ? 2 : 1) + n);
+}
+
+/* Returns non-zero if 'opd' reads a stack argument of the function */
+static int cc_frame_incoming(cc_gen * self, cc_operand * opd) {
+    if (self->fp) {
+        return CC_VAL_OFF == opd->mode && CC_REG_J == opd->reg
+            && opd->value >= 2;
+    }
+    return CC_OPD_FORMAL == opd->frame;
+}
+
+/* Returns non-zero if 'opd' reads a temporary register */
+int cc_frame_temp(cc_gen * self, cc_operand * opd) {
+    if (CC_VAL_REG != opd->mode && CC_VAL_IND != opd->mode
+        && CC_VAL_OFF != opd->mode) {
+        return 0;
+    }
+    return !(self->fp && CC_REG_J == opd->reg)
+        && !(self->vars & (1 << opd->reg));
+}
+
+/* Returns the registers available for temporaries and variables */
+int cc_frame_regs(cc_gen * self) {
+    return self->fp ? CC_GEN_REGS : CC_GEN_REGS | (1 << CC_REG_J);
+}
+
+/* Reserves a frame slot of 'size' words and returns its offset */
+static int cc_frame_slot(cc_gen * self, int size) {
+    self->frame += size;
+    if (self->frame > self->frame_size) {
+        self->frame_size = self->frame;
+    }
+    return -self->frame;
+}
+
+/* Updates the static stack depth for an instruction about to be emitted.
+ * The depth is the number of words pushed since the frame was set up, and
+ * SP-relative operands include it.  'a' is evaluated before 'b', so a slot
+ * written with a value popped off the stack is one word closer. */
+void cc_frame_track(cc_gen * self, int op, cc_operand * b, cc_operand * a) {
+    if (CC_VAL_PUSHPOP == a->mode && b->frame && op < CC_OP_SPECIAL) {
+        b->value--;
+    }
+    if (CC_VAL_PUSHPOP == b->mode && op < CC_OP_SPECIAL) {
+        self->depth++;
+    }
+    if (CC_VAL_PUSHPOP == a->mode && CC_VAL_PC != b->mode) {
+        self->depth--;
+    }
+    if (CC_VAL_SP == b->mode && CC_VAL_LIT == a->mode && !a->sym) {
+        if (CC_OP_ADD == op) {
+            self->depth -= a->value;
+        } else if (CC_OP_SUB == op) {
+            self->depth += a->value;
+        }
+    }
+}
+
+/* Returns non-zero if the function needs J as a frame pointer.  That is
+ * the case without optimization, so that frames can be walked in a
+ * debugger, and whenever the stack depth isn't known statically, which no
+ * construct of the language currently causes. */
+static int cc_frame_pointer(cc_gen * self, cc_func * func) {
+    return self->level < 1;
+}
+
+/* Generates the prologue and binds the formals.  Formals passed in registers
+ * are moved to their homes right away, since A, B and C are needed for
+ * temporaries.  The registers the function saves aren't known until the body
+ * has been generated, so the prologue records where to push them. */
+void cc_frame_enter(cc_gen * self, cc_func * func) {
+    cc_formal * formal = 0;
+    cc_operand j = cc_opd_reg(CC_REG_J);
+    cc_operand sp = cc_opd_special(CC_VAL_SP);
+    int count = 0;
+    int i = 0;
+
+    self->nteardowns = 0;
+    self->depth = 0;
+    self->fp = cc_frame_pointer(self, func);
+    self->addressed = cc_frame_addressed(self, (cc_stmt *)func->block);
+    cc_frame_regvars(self, func);
+
+    if (self->fp) {
+        cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PUSHPOP), j);
+        cc_gen_emit(self, CC_OP_SET, j, sp);
+    }
+    self->save = self->code->count;
+    self->reserve = self->code->count;
+    cc_gen_emit(self, CC_OP_SUB, sp, cc_opd_lit(0));
+    if (self->fp) {
+        self->save = self->code->count;
+    }
+
+    for (formal = func->formals; formal; formal = formal->next) {
+        count++;
+    }
+    free(self->formals);
+    self->formals = calloc(count + 1, sizeof(cc_local *));
+    self->nformals = count;
+    for (i = 0, formal = func->formals; formal; formal = formal->next, ++i) {
+        cc_local * local = calloc(1, sizeof(cc_local));
+        local->id = formal->id;
+        local->type = formal->type;
+        local->reg = cc_frame_regvar(self, formal);
+        if (i < CC_FRAME_ARGS) {
+            cc_operand arg = cc_frame_arg(i);
+            if (local->reg < 0) {
+                local->offset = cc_frame_slot(self,
+                    cc_type_size(formal->type));
+            }
+            if (local->reg != arg.reg) {
+                cc_gen_emit(self, CC_OP_SET, cc_frame_home(self, local), arg);
+            }
+        } else {
+            cc_operand slot = cc_frame_stack(self, i - CC_FRAME_ARGS);
+            local->offset = (self->fp ? 2 : 1) + i - CC_FRAME_ARGS;
+            if (local->reg >= 0) {
+                cc_gen_emit(self, CC_OP_SET, cc_opd_reg(local->reg), slot);
+            }
+        }
+        local->next = self->locals;
+        self->locals = local;
+        self->formals[i] = local;
+    }
+    self->body = cc_code_label(self->code);
+    cc_code_place(self->code, self->body);
+}
+
+/* Inserts instructions that pop the saved registers at 'index' */
+static void cc_frame_restore(cc_gen * self, int index) {
+    cc_inst * inst = 0;
+    int reg = 0;
+    for (reg = CC_REG_J; reg >= CC_REG_A; --reg) {
+        if (self->saved & (1 << reg)) {
+            inst = cc_code_insert(self->code, index++, CC_OP_SET,
+                cc_opd_reg(reg), cc_opd_special(CC_VAL_PUSHPOP));
+            if (index > 1) {
+                /* Charged like the teardown or label before it */
+                inst->line = inst[-1].line;
+                inst->weight = inst[-1].weight;
+            }
+        }
+    }
+}
+
+/* Adds the frame size, and the size of the saved registers for stack
+ * arguments, to an SP-relative operand */
+static void cc_frame_fixup(cc_gen * self, cc_operand * opd, int saved) {
+    if (!opd->frame) {
+        return;
+    }
+    opd->value += self->frame_size;
+    if (CC_OPD_FORMAL == opd->frame) {
+        opd->value += saved;
+    }
+    if (CC_VAL_PICK == opd->mode && !opd->value) {
+        opd->mode = CC_VAL_PEEK;
+    }
+    opd->frame = 0;
+}
+
+/* Generates the epilogue, then fills in the parts of the prologue and of
+ * each tail call that depend on the frame size and on the callee-saved
+ * registers the function writes.  Tail calls are patched from the last one
+ * back, so that the recorded indexes stay valid. */
+void cc_frame_leave(cc_gen * self) {
+    cc_operand j = cc_opd_reg(CC_REG_J);
+    cc_operand sp = cc_opd_special(CC_VAL_SP);
+    cc_operand pop = cc_opd_special(CC_VAL_PUSHPOP);
+    int callee = CC_FRAME_CALLEE & ~(self->fp ? (1 << CC_REG_J) : 0);
+    int saved = 0;
+    int reg = 0;
+    int i = 0;
+    int k = 0;
+
+    self->saved = 0;
+    for (i = 0; i < self->code->count; ++i) {
+        cc_inst * inst = &self->code->insts[i];
+        if (CC_OP_STI == inst->op || CC_OP_STD == inst->op) {
+            self->saved |= (1 << CC_REG_I) | (1 << CC_REG_J);
+        }
+        if (CC_INST_LABEL != inst->op && CC_VAL_REG == inst->b.mode
+            && (inst->op < CC_OP_IFB || inst->op > CC_OP_IFU)) {
+            self->saved |= (1 << inst->b.reg);
+        }
+    }
+    self->saved &= callee;
+    for (reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        saved += !!(self->saved & (1 << reg));
+    }
+    for (i = 0; i < self->code->count; ++i) {
+        cc_inst * inst = &self->code->insts[i];
+        int offset = CC_VAL_LIT == inst->a.mode && inst->a.frame;
+        cc_frame_fixup(self, &inst->a, saved);
+        cc_frame_fixup(self, &inst->b, saved);
+        if (offset && CC_OP_ADD == inst->op && !inst->a.value) {
+            /* &local at the top of the stack */
+            for (k = 0; k < self->nteardowns; ++k) {
+                self->teardowns[k] -= (self->teardowns[k] > i);
+            }
+            cc_code_remove(self->code, i--);
+        }
+    }
+
+    /* The prologue and epilogue are charged to the function's own line */
+    self->code->line = self->func->node.line;
+    cc_code_place(self->code, self->exit);
+    if (self->fp) {
+        cc_frame_restore(self, self->code->count);
+        if (self->frame_size) {
+            cc_gen_emit(self, CC_OP_SET, sp, j);
+        }
+        cc_gen_emit(self, CC_OP_SET, j, pop);
+    } else {
+        if (self->frame_size) {
+            cc_gen_emit(self, CC_OP_ADD, sp, cc_opd_lit(self->frame_size));
+        }
+        cc_frame_restore(self, self->code->count);
+    }
+    cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PC), pop);
+
+    for (i = self->nteardowns - 1; i >= 0; --i) {
+        int index = self->teardowns[i];
+        if (!self->frame_size) {
+            cc_code_remove(self->code, index);
+        } else if (!self->fp) {
+            self->code->insts[index++].a = cc_opd_lit(self->frame_size);
+        }
+        cc_frame_restore(self, index);
+    }
+    if (self->frame_size) {
+        self->code->insts[self->reserve].a = cc_opd_lit(self->frame_size);
+    } else {
+        cc_code_remove(self->code, self->reserve);
+        if (self->save > self->reserve) {
+            self->save--;
+        }
+    }
+    for (i = 0, reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        if (self->saved & (1 << reg)) {
+            cc_code_insert(self->code, self->save + i++, CC_OP_SET,
+                cc_opd_special(CC_VAL_PUSHPOP), cc_opd_reg(reg));
+        }
+    }
+}
+
+/* Emits the part of a tail call that pops our frame, leaving the return
+ * address on top of the stack.  The saved registers are restored here once
+ * they are known. */
+void cc_frame_teardown(cc_gen * self) {
+    cc_operand j = cc_opd_reg(CC_REG_J);
+    cc_operand sp = cc_opd_special(CC_VAL_SP);
+    if (self->nteardowns >= self->capteardowns) {
+        self->capteardowns = self->capteardowns ? self->capteardowns * 2 : 8;
+        self->teardowns = realloc(self->teardowns,
+            self->capteardowns * sizeof(int));
+    }
+    self->teardowns[self->nteardowns++] = self->code->count;
+    if (self->fp) {
+        cc_gen_emit(self, CC_OP_SET, sp, j);
+        cc_gen_emit(self, CC_OP_SET, j, cc_opd_special(CC_VAL_PUSHPOP));
+    } else {
+        cc_code_emit(self->code, CC_OP_ADD, sp, cc_opd_lit(0));
+    }
+}
+
+/* Returns the innermost candidate in scope named 'id', or 0 */
+static cc_regvar * cc_frame_candidate(cc_gen * self, cc_id * id) {
+    int i = 0;
+    for (i = self->nregvars - 1; i >= 0; --i) {
+        if (self->regvars[i].live && self->regvars[i].id == id) {
+            return &self->regvars[i];
+        }
+    }
+    return 0;
+}
+
+/* Adds a variable or formal to the candidates for a register */
+static void cc_frame_declare(cc_gen * self, void * decl, cc_id * id,
+    cc_type * type) {
+    cc_regvar * regvar = 0;
+    if (self->nregvars >= self->capregvars) {
+        self->capregvars = self->capregvars ? self->capregvars * 2 : 16;
+        self->regvars = realloc(self->regvars,
+            self->capregvars * sizeof(cc_regvar));
+    }
+    regvar = &self->regvars[self->nregvars++];
+    memset(regvar, 0, sizeof(*regvar));
+    regvar->decl = decl;
+    regvar->id = id;
+    regvar->live = 1;
+    regvar->reg = -1;
+    regvar->addressed = (1 != cc_type_size(type));
+}
+
+/* Returns the number of registers needed to evaluate both operands of
+ * 'binary' and combine them */
+static int cc_frame_operands(cc_gen * self, cc_binary * binary) {
+    int left = cc_frame_need(self, binary->left);
+    int right = cc_frame_need(self, binary->right) + 1;
+    if (cc_type_islong(binary->left->type)
+        || cc_type_islong(binary->right->type)) {
+        /* A word per register, and a spare for the cross products */
+        left = left > 2 ? left : 2;
+        right += 1 + ('*' == binary->op);
+    } else if (',' == binary->op
+        || ('=' == binary->op && CC_REF == binary->left->node.type)) {
+        right--;
+    } else if (left < 1) {
+        left = 1;
+    }
+    return left > right ? left : right;
+}
+
+/* Returns the number of registers needed to test 'expr' with a chain of IF
+ * instructions or a branch, which don't need a register for the result */
+static int cc_frame_cond(cc_gen * self, cc_expr * expr) {
+    cc_binary * binary = (cc_binary *)expr;
+    int left = 0;
+    int right = 0;
+    if (!expr) {
+        return 0;
+    }
+    if (CC_UNARY == expr->node.type && '!' == ((cc_unary *)expr)->op) {
+        return cc_frame_cond(self, ((cc_unary *)expr)->expr);
+    }
+    if (CC_BINARY != expr->node.type || !cc_check_iscompare(binary->op)) {
+        return cc_frame_need(self, expr);
+    }
+    if (CC_TOK_AND == binary->op || CC_TOK_OR == binary->op) {
+        left = cc_frame_cond(self, binary->left);
+        right = cc_frame_cond(self, binary->right);
+        return left > right ? left : right;
+    }
+    return cc_frame_operands(self, binary);
+}
+
+/* Returns the number of registers needed to evaluate 'expr', assuming that
+ * variables are used in place and that calls save live temporaries.  The
+ * value of a condition takes a register of its own, which cc_gen_bool
+ * holds while the condition is tested. */
+int cc_frame_need(cc_gen * self, cc_expr * expr) {
+    cc_expr * arg = 0;
+    int need = 0;
+    int i = 0;
+    if (!expr) {
+        return 0;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        need = cc_frame_need(self, ((cc_member *)expr)->expr);
+        return need > 1 ? need : 1;
+    case CC_UNARY:
+        if ('!' == ((cc_unary *)expr)->op) {
+            return cc_frame_cond(self, expr) + 1;
+        }
+        need = cc_frame_need(self, ((cc_unary *)expr)->expr);
+        if (cc_type_islong(expr->type)) {
+            return need > 2 ? need : 2;
+        }
+        return need > 1 ? need : 1;
+    case CC_BINARY:
+        if (cc_check_iscompare(((cc_binary *)expr)->op)) {
+            return cc_frame_cond(self, expr) + 1;
+        }
+        return cc_frame_operands(self, (cc_binary *)expr);
+    case CC_CALL: {
+        int held = 0;
+        need = 1;
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next, ++i) {
+            int value = cc_frame_need(self, arg);
+            if (i < CC_FRAME_ARGS) {
+                held += value > 0;
+                value += held;
+            }
+            if (value > need) {
+                need = value;
+            }
+        }
+        if (cc_mem_builtin(self, (cc_call *)expr)) {
+            need += 2; /* I and J */
+        } else if (cc_pool_builtin(self, (cc_call *)expr)) {
+            need++;
+        }
+        return need;
+    }
+    default:
+        return 0;
+    }
+}
+
+/* Records the registers needed by a top-level expression */
+static void cc_frame_needs(cc_gen * self, cc_expr * expr) {
+    int need = cc_frame_need(self, expr);
+    if (need > self->need) {
+        self->need = need;
+    }
+}
+
+/* Returns the number of registers free for temporaries */
+int cc_frame_free(cc_gen * self) {
+    int avail = cc_frame_regs(self) & ~self->vars & ~self->used;
+    int count = 0;
+    int reg = 0;
+    for (reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        count += !!(avail & (1 << reg));
+    }
+    return count;
+}
+
+/* Reserves a frame slot of 'size' words for spilled temporaries, and
+ * returns the operand for its first word.  The slot lasts until the end of
+ * the enclosing block. */
+cc_operand cc_frame_scratch(cc_gen * self, int size) {
+    return cc_frame_at(self, cc_frame_slot(self, size));
+}
+
+/* Returns 'value', or a new frame slot that it has been stored in if
+ * evaluating 'next' while 'value' is held would take more registers than
+ * are free. */
+cc_operand cc_frame_spill(cc_gen * self, cc_operand value, cc_expr * next) {
+    cc_operand slot;
+    if (!cc_frame_temp(self, &value)
+        || cc_frame_need(self, next) <= cc_frame_free(self)) {
+        return value;
+    }
+    slot = cc_frame_scratch(self, 1);
+    cc_gen_emit(self, CC_OP_SET, slot, value);
+    cc_gen_release(self, value);
+    return slot;
+}
+
+/* Returns the operand that receives the truth value of 'expr': a register,
+ * or a new frame slot if testing the condition takes every free one */
+cc_operand cc_frame_result(cc_gen * self, cc_expr * expr) {
+    if (cc_frame_cond(self, expr) < cc_frame_free(self)) {
+        return cc_opd_reg(cc_gen_alloc(self));
+    }
+    return cc_frame_scratch(self, 1);
+}
+
+/* Records the registers needed by the guard of an if statement or loop */
+static void cc_frame_guard(cc_gen * self, cc_expr * expr) {
+    int need = cc_frame_cond(self, expr);
+    if (need > self->need) {
+        self->need = need;
+    }
+}
+
+/* Counts the uses in a call.  A call in tail position doesn't count as a
+ * call by itself, since its arguments are read before any register is
+ * clobbered and nothing is read after it returns. */
+static void cc_frame_weigh_call(cc_gen * self, cc_call * call, long weight) {
+    cc_expr * arg = 0;
+    if (CC_REF == call->expr->node.type
+        && ((cc_ref *)call->expr)->id == self->func->id) {
+        self->recursive = 1;
+    }
+    cc_frame_weigh_expr(self, call->expr, weight);
+    for (arg = call->args; arg; arg = arg->next) {
+        cc_frame_weigh_expr(self, arg, weight);
+    }
+}
+
+static void cc_frame_weigh_expr(cc_gen * self, cc_expr * expr, long weight) {
+    cc_regvar * regvar = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_frame_weigh_expr(self, ((cc_member *)expr)->expr, weight);
+        break;
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        if (('/' == binary->op || '%' == binary->op)
+            && cc_type_islong(expr->type)) {
+            self->calls = 1; /* long$div */
+        }
+        cc_frame_weigh_expr(self, binary->left, weight);
+        cc_frame_weigh_expr(self, binary->right, weight);
+        break;
+    }
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        cc_expr * root = cc_expr_root(unary->expr);
+        if ('&' == unary->op && CC_REF == root->node.type) {
+            regvar = cc_frame_candidate(self, ((cc_ref *)root)->id);
+            if (regvar) {
+                regvar->addressed = 1;
+            }
+        }
+        cc_frame_weigh_expr(self, unary->expr, weight);
+        break;
+    }
+    case CC_CALL:
+        if (!cc_gen_builtin(self, (cc_call *)expr)) {
+            self->calls = 1;
+        }
+        cc_frame_weigh_call(self, (cc_call *)expr, weight);
+        break;
+    case CC_REF:
+        regvar = cc_frame_candidate(self, ((cc_ref *)expr)->id);
+        if (regvar) {
+            regvar->weight += weight;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_frame_weigh_block(cc_gen * self, cc_block * block,
+    long weight) {
+    int first = self->nregvars;
+    cc_var * var = 0;
+    for (var = block->vars; var; var = var->next) {
+        cc_frame_declare(self, var, var->id, var->type);
+        cc_frame_weigh_expr(self, var->init, weight);
+        cc_frame_needs(self, var->init);
+    }
+    cc_frame_weigh_stmt(self, block->stmts, weight);
+    while (first < self->nregvars) {
+        self->regvars[first++].live = 0;
+    }
+}
+
+static void cc_frame_weigh_stmt(cc_gen * self, cc_stmt * stmt, long weight) {
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK:
+            cc_frame_weigh_block(self, (cc_block *)stmt, weight);
+            break;
+        case CC_IF: {
+            cc_if * stmt_if = (cc_if *)stmt;
+            double ratio = cc_pgo_ratio(self->env->pgo, stmt_if->site);
+            long yes = ratio >= 0 ? (long)(weight * ratio + 0.5) : weight;
+            long no = ratio >= 0 ? (long)(weight * (1 - ratio) + 0.5) : weight;
+            cc_frame_weigh_expr(self, stmt_if->guard, weight);
+            cc_frame_guard(self, stmt_if->guard);
+            cc_frame_weigh_stmt(self, stmt_if->yes, yes);
+            cc_frame_weigh_stmt(self, stmt_if->no, no);
+            break;
+        }
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            double ratio = cc_pgo_ratio(self->env->pgo, loop->site);
+            long max = CC_FRAME_LOOP * CC_FRAME_LOOP * CC_FRAME_LOOP
+                * self->unit;
+            double inner = weight * (ratio >= 0 ? ratio : CC_FRAME_LOOP);
+            if (inner > max) {
+                inner = max;
+            }
+            cc_frame_weigh_expr(self, loop->init, weight);
+            cc_frame_weigh_expr(self, loop->guard, (long)(inner + 0.5));
+            cc_frame_weigh_expr(self, loop->update, (long)(inner + 0.5));
+            cc_frame_needs(self, loop->init);
+            cc_frame_guard(self, loop->guard);
+            cc_frame_needs(self, loop->update);
+            if (loop->block) {
+                cc_frame_weigh_block(self, loop->block, (long)(inner + 0.5));
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            cc_frame_weigh_expr(self, ((cc_simple *)stmt)->expr, weight);
+            cc_frame_needs(self, ((cc_simple *)stmt)->expr);
+            break;
+        case CC_RETURN: {
+            cc_expr * expr = ((cc_return *)stmt)->expr;
+            cc_frame_needs(self, expr);
+            if (expr && CC_CALL == expr->node.type) {
+                cc_frame_weigh_call(self, (cc_call *)expr, weight);
+            } else {
+                cc_frame_weigh_expr(self, expr, weight);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+}
+
+/* Returns the number of registers left for temporaries if 'reg' is also
+ * used for a variable */
+static int cc_frame_spare(cc_gen * self, int reg) {
+    int avail = cc_frame_regs(self) & ~self->vars & ~(1 << reg);
+    int count = 0;
+    for (reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        count += !!(avail & (1 << reg));
+    }
+    return count;
+}
+
+/* Chooses the variables kept in X, Y, Z and J for the whole function.  Each use
+ * is weighted by the depth of the loops around it, and the heaviest
+ * variables whose address is never taken win.  A recursive function is
+ * weighted as if its body were a loop, since recursive calls in tail
+ * position become jumps.  Variables with a single use stay in memory, since
+ * the register would have to be saved and restored, which costs more than
+ * the use.  A function that makes no calls, except in tail position, keeps
+ * its register arguments where they arrive instead.  Enough registers are
+ * left for the most complex expression, plus 'slack' more if the estimate
+ * turned out to be short (see cc_gen_func).
+ *
+ * With a profile, uses are weighted by how often they actually ran per
+ * call instead, in units of CC_FRAME_UNIT so that arms that run a fraction
+ * of the time can be told apart. */
+void cc_frame_regvars(cc_gen * self, cc_func * func) {
+    cc_pgofunc * profile = cc_pgo_func(self->env->pgo, func);
+    cc_formal * formal = 0;
+    int formals = 0;
+    int reg = 0;
+    int i = 0;
+
+    self->nregvars = 0;
+    self->vars = 0;
+    self->recursive = 0;
+    self->calls = 0;
+    self->need = 0;
+    if (self->level < 1) {
+        return;
+    }
+    self->unit = 1;
+    if (profile && cc_pgo_count(self->env->pgo, profile->first) >= 0) {
+        self->unit = CC_FRAME_UNIT;
+    }
+    for (formal = func->formals; formal; formal = formal->next) {
+        cc_frame_declare(self, formal, formal->id, formal->type);
+        formals++;
+    }
+    cc_frame_weigh_block(self, func->block, self->unit);
+    if (self->recursive) {
+        for (i = 0; i < self->nregvars; ++i) {
+            self->regvars[i].weight *= CC_FRAME_LOOP;
+        }
+    }
+    for (i = 0; !self->calls && i < formals && i < CC_FRAME_ARGS; ++i) {
+        cc_regvar * regvar = &self->regvars[i];
+        if (!regvar->addressed && regvar->weight > 0
+            && cc_frame_spare(self, CC_REG_A + i) > self->need + self->slack) {
+            regvar->reg = CC_REG_A + i;
+            self->vars |= (1 << regvar->reg);
+        }
+    }
+
+    for (reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        cc_regvar * best = 0;
+        if (!(CC_FRAME_VARS & cc_frame_regs(self) & (1 << reg))) {
+            continue;
+        }
+        for (i = 0; i < self->nregvars; ++i) {
+            cc_regvar * regvar = &self->regvars[i];
+            if (regvar->reg < 0 && !regvar->addressed
+                && regvar->weight >= CC_FRAME_WEIGHT * self->unit
+                && (!best || regvar->weight > best->weight)) {
+                best = regvar;
+            }
+        }
+        if (!best || cc_frame_spare(self, reg) <= self->need + self->slack) {
+            break;
+        }
+        best->reg = reg;
+        self->vars |= (1 << reg);
+    }
+}
+
+/* Returns the register assigned to a variable or formal, or -1 */
+int cc_frame_regvar(cc_gen * self, void * decl) {
+    int i = 0;
+    for (i = 0; i < self->nregvars; ++i) {
+        if (self->regvars[i].decl == decl) {
+            return self->regvars[i].reg;
+        }
+    }
+    return -1;
+}
+
+/* Moves 'values' into A, B and C as if all at once.  A register that must
+ * be read after it has been overwritten is copied to EX first; with three
+ * destinations there can be at most one such cycle. */
+void cc_frame_move(cc_gen * self, cc_operand * values, int count) {
+    cc_operand ex = cc_opd_special(CC_VAL_EX);
+    int pending[CC_FRAME_ARGS];
+    int left = 0;
+    int i = 0;
+    int k = 0;
+
+    for (i = 0; i < count; ++i) {
+        cc_operand dest = cc_frame_arg(i);
+        pending[i] = !cc_operand_equal(&values[i], &dest);
+        left += pending[i];
+    }
+    while (left) {
+        int progress = 0;
+        for (i = 0; i < count; ++i) {
+            cc_operand dest = cc_frame_arg(i);
+            int blocked = 0;
+            if (!pending[i]) {
+                continue;
+            }
+            for (k = 0; k < count; ++k) {
+                if (k != i && pending[k]
+                    && cc_operand_equal(&values[k], &dest)) {
+                    blocked = 1;
+                }
+            }
+            if (!blocked) {
+                cc_gen_emit(self, CC_OP_SET, dest, values[i]);
+                pending[i] = 0;
+                left--;
+                progress = 1;
+            }
+        }
+        if (!progress) {
+            for (i = 0; !pending[i]; ++i) {
+            }
+            cc_gen_emit(self, CC_OP_SET, ex, cc_frame_arg(i));
+            for (k = 0; k < count; ++k) {
+                cc_operand dest = cc_frame_arg(i);
+                if (pending[k] && cc_operand_equal(&values[k], &dest)) {
+                    values[k] = ex;
+                }
+            }
+        }
+    }
+}
+
+/* Returns non-zero if 'expr' names a function, so that a call to it can be
+ * made directly, with the arguments in registers */
+int cc_frame_direct(cc_gen * self, cc_expr * expr) {
+    cc_id * id = 0;
+    if (CC_REF != expr->node.type) {
+        return 0;
+    }
+    id = ((cc_ref *)expr)->id;
+    return !cc_gen_local(self, id) && !cc_env_var(self->env, id);
+}
+
+/* Generates a call.  Live temporaries in A, B and C are saved around the
+ * call; the callee preserves the other registers.  Calls through a pointer
+ * pass every argument on the stack, to the callee's stack adapter. */
+cc_operand cc_frame_call(cc_gen * self, cc_call * call) {
+    cc_operand push = cc_opd_special(CC_VAL_PUSHPOP);
+    cc_operand a = cc_opd_reg(CC_REG_A);
+    cc_operand values[CC_FRAME_ARGS];
+    cc_operand result;
+    cc_expr ** args = 0;
+    cc_expr * arg = 0;
+    int used = self->used;
+    int live = used & CC_FRAME_CALLER;
+    int direct = cc_frame_direct(self, call->expr);
+    int first = direct ? CC_FRAME_ARGS : 0;
+    int stack = 0;
+    int count = 0;
+    int i = 0;
+
+    for (i = CC_REG_A; i <= CC_REG_I; ++i) {
+        if (live & (1 << i)) {
+            cc_gen_emit(self, CC_OP_SET, push, cc_opd_reg(i));
+        }
+    }
+    self->used = used & ~CC_FRAME_CALLER;
+
+    for (arg = call->args; arg; arg = arg->next) {
+        count++;
+    }
+    args = calloc(count + 1, sizeof(cc_expr *));
+    for (i = 0, arg = call->args; arg; arg = arg->next) {
+        args[i++] = arg;
+    }
+    for (i = count - 1; i >= first; --i) {
+        cc_operand value = cc_gen_expr(self, args[i]);
+        cc_gen_emit(self, CC_OP_SET, push, value);
+        cc_gen_release(self, value);
+        stack++;
+    }
+
+    if (direct) {
+        int n = count < CC_FRAME_ARGS ? count : CC_FRAME_ARGS;
+        for (i = 0; i < n; ++i) {
+            values[i] = cc_gen_expr(self, args[i]);
+            if (CC_VAL_REG != values[i].mode
+                && cc_frame_temp(self, &values[i])) {
+                values[i] = cc_gen_load(self, values[i]);
+            }
+        }
+        cc_frame_move(self, values, n);
+        for (i = 0; i < n; ++i) {
+            cc_gen_release(self, values[i]);
+        }
+        cc_gen_emit(self, CC_OP_JSR, cc_opd_lit(0),
+            cc_opd_sym(((cc_ref *)call->expr)->id));
+    } else {
+        cc_operand target = cc_gen_expr(self, call->expr);
+        cc_gen_emit(self, CC_OP_JSR, cc_opd_lit(0), target);
+        cc_gen_release(self, target);
+    }
+    free(args);
+    if (stack) {
+        cc_gen_emit(self, CC_OP_ADD, cc_opd_special(CC_VAL_SP),
+            cc_opd_lit(stack));
+    }
+
+    self->used = used;
+    result = cc_opd_reg(cc_gen_alloc(self));
+    if (!cc_operand_equal(&result, &a)) {
+        cc_gen_emit(self, CC_OP_SET, result, a);
+    }
+    for (i = CC_REG_I; i >= CC_REG_A; --i) {
+        if (live & (1 << i)) {
+            cc_gen_emit(self, CC_OP_SET, cc_opd_reg(i), push);
+        }
+    }
+    return result;
+}
+
+/* Returns non-zero if the argument 'arg' of a tail call can be stored in
+ * place, without holding it in a register until every argument has been
+ * computed.  A recursive call overwrites the formals, so only constants
+ * qualify; a call to another function overwrites only the stack
+ * arguments. */
+static int cc_frame_inplace(cc_gen * self, cc_expr * arg, int recurse) {
+    cc_local * local = 0;
+    int value = 0;
+    if (cc_expr_const(arg, &value)) {
+        return 1;
+    }
+    if (recurse || CC_REF != arg->node.type) {
+        return 0;
+    }
+    local = cc_gen_local(self, ((cc_ref *)arg)->id);
+    return !local || local->reg >= 0 || local->offset < 0;
+}
+
+/* Returns the number of registers needed to compute the arguments of a
+ * tail call, holding the ones that can't be stored in place */
+static int cc_frame_tail_need(cc_gen * self, cc_call * call, int recurse) {
+    cc_expr * arg = 0;
+    int held = 0;
+    int need = 0;
+    for (arg = call->args; arg; arg = arg->next) {
+        int value = held + cc_frame_need(self, arg);
+        if (value > need) {
+            need = value;
+        }
+        if (!cc_frame_inplace(self, arg, recurse)) {
+            held++;
+        }
+    }
+    return need > held ? need : held;
+}
+
+/* Generates a call in tail position as a jump, so that the callee returns
+ * directly to our caller.  A call to the function itself stores the
+ * arguments in the formals' homes and jumps back to the top of the body.
+ * A call to another function moves the register arguments into A, B and C
+ * and stores the stack arguments over our own, which is only possible if it
+ * takes no more stack arguments than we do; the caller pops the words it
+ * pushed.  Every argument is computed before any is stored, since they may
+ * read the formals that are overwritten.  Returns 0 if the call must be
+ * generated normally, which is also the case if the function takes the
+ * address of a local, since the local's storage is reused. */
+int cc_frame_tail(cc_gen * self, cc_call * call) {
+    cc_operand values[CC_FRAME_TAIL_ARGS];
+    cc_expr * arg = 0;
+    cc_id * id = 0;
+    int recurse = 0;
+    int count = 0;
+    int spare = 0;
+    int reg = 0;
+    int i = 0;
+
+    if (self->level < 1 || self->addressed
+        || !cc_frame_direct(self, call->expr) || cc_gen_builtin(self, call)) {
+        return 0;
+    }
+    for (arg = call->args; arg; arg = arg->next) {
+        count++;
+    }
+    for (reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        if ((cc_frame_regs(self) & ~self->vars & ~self->used) & (1 << reg)) {
+            spare++;
+        }
+    }
+    id = ((cc_ref *)call->expr)->id;
+    recurse = (id == self->func->id);
+    if (count > CC_FRAME_TAIL_ARGS
+        || cc_frame_tail_need(self, call, recurse) > spare) {
+        return 0;
+    }
+    if (recurse ? count != self->nformals
+        : count > CC_FRAME_ARGS && count > self->nformals) {
+        return 0;
+    }
+
+    for (i = 0, arg = call->args; arg; arg = arg->next, ++i) {
+        cc_operand home = recurse ? cc_frame_home(self, self->formals[i])
+            : cc_frame_stack(self, i - CC_FRAME_ARGS);
+        values[i] = cc_gen_expr(self, arg);
+        if (cc_operand_equal(&values[i], &home)
+            && (recurse || i >= CC_FRAME_ARGS)) {
+            continue; /* Passed through unchanged */
+        }
+        if (recurse) {
+            if (CC_VAL_LIT != values[i].mode
+                && !(CC_VAL_REG == values[i].mode
+                && cc_frame_temp(self, &values[i]))) {
+                values[i] = cc_gen_load(self, values[i]);
+            }
+        } else if ((CC_VAL_REG != values[i].mode
+            && cc_frame_temp(self, &values[i]))
+            || cc_frame_incoming(self, &values[i])) {
+            values[i] = cc_gen_load(self, values[i]);
+        }
+    }
+
+    if (recurse) {
+        for (i = 0; i < count; ++i) {
+            cc_operand home = cc_frame_home(self, self->formals[i]);
+            if (!cc_operand_equal(&values[i], &home)) {
+                cc_gen_emit(self, CC_OP_SET, home, values[i]);
+                cc_gen_release(self, values[i]);
+            }
+        }
+        cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+            cc_opd_label(self->body));
+    } else {
+        int n = count < CC_FRAME_ARGS ? count : CC_FRAME_ARGS;
+        for (i = CC_FRAME_ARGS; i < count; ++i) {
+            cc_operand slot = cc_frame_stack(self, i - CC_FRAME_ARGS);
+            if (!cc_operand_equal(&values[i], &slot)) {
+                cc_gen_emit(self, CC_OP_SET, slot, values[i]);
+                cc_gen_release(self, values[i]);
+            }
+        }
+        cc_frame_move(self, values, n);
+        for (i = 0; i < n; ++i) {
+            cc_gen_release(self, values[i]);
+        }
+        cc_frame_teardown(self);
+        cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+            cc_opd_sym(id));
+    }
+    self->tails++;
+    return 1;
+}
+
+/* Returns non-zero if 'expr' takes the address of a local variable */
+static int cc_frame_addressed_expr(cc_gen * self, cc_expr * expr) {
+    cc_expr * arg = 0;
+    if (!expr) {
+        return 0;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        return cc_frame_addressed_expr(self, ((cc_member *)expr)->expr);
+    case CC_BINARY:
+        return cc_frame_addressed_expr(self, ((cc_binary *)expr)->left)
+            || cc_frame_addressed_expr(self, ((cc_binary *)expr)->right);
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        cc_expr * root = cc_expr_root(unary->expr);
+        if ('&' == unary->op && CC_REF == root->node.type
+            && !cc_env_var(self->env, ((cc_ref *)root)->id)) {
+            return 1;
+        }
+        return cc_frame_addressed_expr(self, unary->expr);
+    }
+    case CC_CALL:
+        if (cc_frame_addressed_expr(self, ((cc_call *)expr)->expr)) {
+            return 1;
+        }
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            if (cc_frame_addressed_expr(self, arg)) {
+                return 1;
+            }
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* Returns non-zero if a list of statements takes the address of a local */
+int cc_frame_addressed(cc_gen * self, cc_stmt * stmt) {
+    cc_var * var = 0;
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK:
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                if (cc_frame_addressed_expr(self, var->init)) {
+                    return 1;
+                }
+            }
+            if (cc_frame_addressed(self, ((cc_block *)stmt)->stmts)) {
+                return 1;
+            }
+            break;
+        case CC_IF:
+            if (cc_frame_addressed_expr(self, ((cc_if *)stmt)->guard)
+                || cc_frame_addressed(self, ((cc_if *)stmt)->yes)
+                || cc_frame_addressed(self, ((cc_if *)stmt)->no)) {
+                return 1;
+            }
+            break;
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            if (cc_frame_addressed_expr(self, loop->init)
+                || cc_frame_addressed_expr(self, loop->guard)
+                || cc_frame_addressed_expr(self, loop->update)
+                || (loop->block && cc_frame_addressed(self,
+                    (cc_stmt *)loop->block))) {
+                return 1;
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            if (cc_frame_addressed_expr(self, ((cc_simple *)stmt)->expr)) {
+                return 1;
+            }
+            break;
+        case CC_RETURN:
+            if (cc_frame_addressed_expr(self, ((cc_return *)stmt)->expr)) {
+                return 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Returns the stack adapter for function 'id', which is what the function's
+ * address refers to.  Calls through a pointer push every argument, and the
+ * adapter moves the first ones into registers before entering the function.
+ * Adapters are generated after all the functions. */
+cc_id * cc_frame_adapter(cc_gen * self, cc_id * id) {
+    char * name = malloc(strlen(id->str) + 8);
+    cc_id * adapter = 0;
+    int i = 0;
+
+    sprintf(name, "%s$stack", id->str);
+    adapter = cc_env_id(self->env, name);
+    free(name);
+    for (i = 0; i < self->nadapters; ++i) {
+        if (self->adapters[i] == id) {
+            return adapter;
+        }
+    }
+    if (self->nadapters >= self->capadapters) {
+        self->capadapters = self->capadapters ? self->capadapters * 2 : 8;
+        self->adapters = realloc(self->adapters,
+            self->capadapters * sizeof(cc_id *));
+    }
+    self->adapters[self->nadapters++] = id;
+    return adapter;
+}
+
+/* Generates the stack adapters.  If all the arguments fit in registers, the
+ * adapter loads them and jumps to the function, which returns directly to
+ * the caller.  Otherwise, the stack arguments are pushed again below the
+ * return address, and the adapter calls the function. */
+void cc_frame_adapters(cc_gen * self) {
+    cc_operand push = cc_opd_special(CC_VAL_PUSHPOP);
+    int i = 0;
+    int k = 0;
+
+    for (i = 0; i < self->nadapters; ++i) {
+        cc_id * id = self->adapters[i];
+        cc_func * func = cc_env_func(self->env, id);
+        cc_formal * formal = 0;
+        char * name = malloc(strlen(id->str) + 8);
+        int count = 0;
+        int stack = 0;
+
+        sprintf(name, "%s$stack", id->str);
+        self->code = cc_code_init(cc_env_id(self->env, name));
+        free(name);
+        for (formal = func ? func->formals : 0; formal; formal = formal->next) {
+            count++;
+        }
+        stack = count > CC_FRAME_ARGS ? count - CC_FRAME_ARGS : 0;
+        for (k = 0; k < stack; ++k) {
+            cc_gen_emit(self, CC_OP_SET, push, cc_opd_pick(count));
+        }
+        for (k = 0; k < count && k < CC_FRAME_ARGS; ++k) {
+            cc_gen_emit(self, CC_OP_SET, cc_frame_arg(k),
+                cc_opd_pick(1 + k + stack));
+        }
+        if (stack) {
+            cc_gen_emit(self, CC_OP_JSR, cc_opd_lit(0), cc_opd_sym(id));
+            cc_gen_emit(self, CC_OP_ADD, cc_opd_special(CC_VAL_SP),
+                cc_opd_lit(stack));
+            cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PC), push);
+        } else {
+            cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+                cc_opd_sym(id));
+        }
+        *self->tail = self->code;
+        self->tail = &self->code->next;
+        self->code = 0;
+    }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_FRAME_H
+#define CC_FRAME_H
+
+#include "gen.h"
+
+/* Calling convention.  The first CC_FRAME_ARGS arguments are passed in A, B
+ * and C, and the rest are pushed right to left and popped by the caller.
+ * The result is returned in A.  A, B, C and EX may be clobbered by a call;
+ * X, Y, Z, I and J are preserved, and a function saves only the ones it
+ * writes.  Calls through a function pointer push every argument instead, and
+ * taking the address of a function yields an adapter that moves the
+ * arguments into registers.
+ *
+ * Frame layout, with J as the frame pointer (at -O0):
+ *
+ *   [J+2+n]  stack argument n (argument CC_FRAME_ARGS+n)
+ *   [J+1]    return address
+ *   [J]      caller's J
+ *   [J-1-n]  local n, including register arguments kept in memory
+ *   below    saved registers
+ *
+ * Otherwise J is an ordinary callee-saved register, and the frame is
+ * addressed relative to SP with PICK.  The stack depth is tracked
+ * statically, so each slot's distance from SP is known at every
+ * instruction:
+ *
+ *   PICK d+f+s+1+n  stack argument n
+ *   PICK d+f+s      return address
+ *   PICK d+f        saved registers (s words)
+ *   PICK d+f-1-n    local n (f words in all)
+ *   PICK 0          top of the stack, d words pushed since the prologue
+ */
+#define CC_FRAME_ARGS 3
+
+/* Registers a call may clobber: A, B and C */
+#define CC_FRAME_CALLER 0x07
+
+/* Registers a function must preserve: X, Y, Z, I and J */
+#define CC_FRAME_CALLEE 0xf8
+
+/* Registers that may hold variables: X, Y, Z, and J if it isn't the frame
+ * pointer */
+#define CC_FRAME_VARS 0xb8
+
+/* Fewest weighted uses for a variable to be kept in a register */
+#define CC_FRAME_WEIGHT 2
+
+/* Weight of a use inside a loop, relative to a use outside of it */
+#define CC_FRAME_LOOP 8
+
+/* Weight of a use that runs once per call, when weights come from a
+ * profile */
+#define CC_FRAME_UNIT 16
+
+/* Tail calls with more arguments than this are generated as normal calls */
+#define CC_FRAME_TAIL_ARGS 8
+
+void cc_frame_enter(cc_gen * self, cc_func * func);
+void cc_frame_leave(cc_gen * self);
+void cc_frame_regvars(cc_gen * self, cc_func * func);
+int cc_frame_regvar(cc_gen * self, void * decl);
+cc_operand cc_frame_home(cc_gen * self, cc_local * local);
+int cc_frame_regs(cc_gen * self);
+void cc_frame_track(cc_gen * self, int op, cc_operand * b, cc_operand * a);
+int cc_frame_temp(cc_gen * self, cc_operand * opd);
+int cc_frame_need(cc_gen * self, cc_expr * expr);
+int cc_frame_free(cc_gen * self);
+cc_operand cc_frame_scratch(cc_gen * self, int size);
+cc_operand cc_frame_spill(cc_gen * self, cc_operand value, cc_expr * next);
+cc_operand cc_frame_result(cc_gen * self, cc_expr * expr);
+cc_operand cc_frame_call(cc_gen * self, cc_call * call);
+int cc_frame_tail(cc_gen * self, cc_call * call);
+void cc_frame_move(cc_gen * self, cc_operand * values, int count);
+void cc_frame_teardown(cc_gen * self);
+int cc_frame_direct(cc_gen * self, cc_expr * expr);
+int cc_frame_addressed(cc_gen * self, cc_stmt * stmt);
+cc_id * cc_frame_adapter(cc_gen * self, cc_id * id);
+void cc_frame_adapters(cc_gen * self);
+
+#endif
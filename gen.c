@@ -0,0 +1,1327 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "gen.h"
+#include "check.h"
+#include "arith.h"
+#include "burs.h"
+#include "lexer.h"
+#include "long.h"
+#include "loop.h"
+#include "frame.h"
+#include "mem.h"
+#include "pool.h"
+#include "size.h"
+#include "peep.h"
+#include "par.h"
+#include "pgo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Creates a new code generator for the program in 'env' */
+cc_gen * cc_gen_init(cc_env * env) {
+    cc_gen * self = calloc(1, sizeof(cc_gen));
+    self->env = env;
+    self->tail = &self->codes;
+    self->pool = cc_pool_init(env);
+    self->data_tail = &self->data;
+    self->zeros_tail = &self->zeros;
+    return self;
+}
+
+static void cc_global_free(cc_global * self) {
+    while (self) {
+        cc_global * next = self->next;
+        free(self);
+        self = next;
+    }
+}
+
+void cc_gen_free(cc_gen * self) {
+    cc_code_free(self->codes);
+    cc_code_free(self->plain);
+    cc_pool_free(self->pool);
+    cc_global_free(self->data);
+    cc_global_free(self->zeros);
+    free(self->teardowns);
+    free(self->formals);
+    free(self->regvars);
+    free(self->adapters);
+    free(self->colds);
+    free(self);
+}
+
+/* Generates code for the whole program.  The startup code comes first, so
+ * that it runs from address 0; functions follow in source order, then the
+ * data.  With more than one thread, the functions are generated in
+ * parallel (see par.h). */
+void cc_gen_env(cc_gen * self) {
+    cc_func * func = 0;
+    cc_func ** funcs = 0;
+    int count = 0;
+    int i = 0;
+
+    if (self->pool->packed) {
+        cc_pool_check(self);
+    }
+    cc_gen_data(self);
+    cc_gen_start(self);
+    for (func = self->env->funcs; func; func = func->next) {
+        count += 0 != func->block;
+    }
+    /* The list is newest first */
+    funcs = calloc(count + 1, sizeof(cc_func *));
+    i = count;
+    for (func = self->env->funcs; func; func = func->next) {
+        if (func->block) {
+            funcs[--i] = func;
+        }
+    }
+    if (self->threads > 1 && count > 1) {
+        cc_par_funcs(self, funcs, count);
+    } else {
+        for (i = 0; i < count; ++i) {
+            cc_gen_func(self, funcs[i]);
+        }
+    }
+    free(funcs);
+    cc_frame_adapters(self);
+    cc_long_helpers(self);
+    if (self->peephole) {
+        cc_peep_env(self);
+    }
+    if (self->size) {
+        cc_size_env(self);
+    }
+    cc_pool_layout(self->pool);
+    if (self->verbose) {
+        fprintf(stderr, "gen: %d tail calls\n", self->tails);
+        fprintf(stderr, "gen: %d block operations inline\n", self->blocks);
+        if (self->burs) {
+            fprintf(stderr, "gen: %d memory operands tiled\n", self->tiled);
+        }
+        if (self->env->pgo && !self->env->pgo->generate) {
+            fprintf(stderr, "gen: %d if statements laid out by the profile\n",
+                self->inverted);
+        }
+        fprintf(stderr, "gen: %d strings in %d words, %d words saved\n",
+            self->pool->count, self->pool->words, self->pool->saved);
+    }
+}
+
+/* Evaluates the initializers of the globals.  Globals that start out as
+ * zero are gathered into the BSS region, so that they take no space in the
+ * image. */
+void cc_gen_data(cc_gen * self) {
+    cc_var * var = 0;
+    for (var = self->env->vars; var; var = var->next) {
+        cc_global * global = calloc(1, sizeof(cc_global));
+        global->var = var;
+        global->size = cc_type_size(var->type);
+        global->value = cc_opd_lit(0);
+        if (cc_type_islong(var->type)) {
+            long value = 0;
+            cc_pair pair;
+            if (var->init && !cc_long_const(var->init, &value)) {
+                cc_gen_err(self, var->node.line, "Initializer is not constant");
+            }
+            pair = cc_long_lit(value);
+            global->value = pair.lo;
+            global->high = pair.hi.value;
+        } else if (var->init
+            && !cc_gen_const(self, var->init, &global->value)) {
+            cc_gen_err(self, var->node.line, "Initializer is not constant");
+        }
+        if (global->value.value || global->value.sym || global->high) {
+            *self->data_tail = global;
+            self->data_tail = &global->next;
+        } else {
+            *self->zeros_tail = global;
+            self->zeros_tail = &global->next;
+            self->bss += global->size;
+        }
+    }
+    if (self->env->pgo && self->env->pgo->generate) {
+        /* Two words per profile counter */
+        cc_pgo * pgo = self->env->pgo;
+        cc_global * global = calloc(1, sizeof(cc_global));
+        global->var = cc_var_init(0, 0, pgo->id);
+        global->size = 2 * pgo->counters;
+        global->value = cc_opd_lit(0);
+        *self->zeros_tail = global;
+        self->zeros_tail = &global->next;
+        self->bss += global->size;
+    }
+}
+
+/* Evaluates a constant initializer: a constant expression, or an address
+ * plus or minus one.  A long constant is converted to its low word.
+ * Returns 0 if the value isn't known until run time. */
+int cc_gen_const(cc_gen * self, cc_expr * expr, cc_operand * value) {
+    long big = 0;
+    int k = 0;
+    if (cc_expr_const(expr, &k)) {
+        *value = cc_opd_lit(k);
+        return 1;
+    }
+    if (cc_type_islong(expr->type) && cc_long_const(expr, &big)) {
+        *value = cc_opd_lit(cc_word((int)(big & 0xffff)));
+        return 1;
+    }
+    switch (expr->node.type) {
+    case CC_STRING:
+        *value = cc_gen_string(self, (cc_string *)expr);
+        return 1;
+    case CC_REF: {
+        cc_id * id = ((cc_ref *)expr)->id;
+        if (!cc_env_var(self->env, id) && cc_env_func(self->env, id)) {
+            *value = cc_opd_sym(cc_frame_adapter(self, id));
+            return 1;
+        }
+        return 0;
+    }
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        if ('&' == unary->op && CC_REF == unary->expr->node.type
+            && cc_env_var(self->env, ((cc_ref *)unary->expr)->id)) {
+            *value = cc_opd_sym(((cc_ref *)unary->expr)->id);
+            return 1;
+        }
+        return 0;
+    }
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        if (('+' != binary->op && '-' != binary->op)
+            || !cc_type_isptr(binary->left->type)
+            || !cc_expr_const(binary->right, &k)
+            || !cc_gen_const(self, binary->left, value)) {
+            return 0;
+        }
+        k *= cc_type_size(binary->left->type->nested);
+        value->value += ('+' == binary->op) ? k : -k;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+/* Emits the startup code: clear the BSS region, call main, then halt by
+ * jumping to the same instruction forever.  An object only has startup
+ * code if it defines main; its BSS sections are gathered by the linker
+ * between $bss and $end, so the size isn't known until then. */
+void cc_gen_start(cc_gen * self) {
+    cc_func * main = cc_env_func(self->env, cc_env_id(self->env, "main"));
+    cc_code * code = 0;
+    if (self->object && !(main && main->block)) {
+        return;
+    }
+    code = cc_code_init(cc_env_id(self->env, "$start"));
+    if (self->object) {
+        int loop = cc_code_label(code);
+        int test = cc_code_label(code);
+        cc_code_emit(code, CC_OP_SET, cc_opd_reg(CC_REG_I),
+            cc_opd_sym(cc_env_id(self->env, "$bss")));
+        cc_code_emit(code, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+            cc_opd_label(test));
+        cc_code_place(code, loop);
+        cc_code_emit(code, CC_OP_STI, cc_opd_ind(CC_REG_I), cc_opd_lit(0));
+        cc_code_place(code, test);
+        cc_code_emit(code, CC_OP_IFN, cc_opd_reg(CC_REG_I),
+            cc_opd_sym(cc_env_id(self->env, "$end")));
+        cc_code_emit(code, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+            cc_opd_label(loop));
+    } else if (self->bss) {
+        self->code = code;
+        cc_mem_fill(self, cc_opd_sym(cc_env_id(self->env, "$bss")),
+            cc_opd_lit(0), self->bss);
+        self->code = 0;
+    }
+    cc_code_emit(code, CC_OP_JSR, cc_opd_lit(0),
+        cc_opd_sym(cc_env_id(self->env, "main")));
+    cc_code_emit(code, CC_OP_SUB, cc_opd_special(CC_VAL_PC), cc_opd_lit(1));
+    *self->tail = code;
+    self->tail = &code->next;
+}
+
+/* Moves the cold code recorded in 'colds' after the rest of the body, in
+ * front of the epilogue, so that the hot path runs straight through.  The
+ * body is made to jump to the epilogue instead of falling into it. */
+static void cc_gen_outline(cc_gen * self) {
+    cc_code * code = self->code;
+    cc_inst * last = code->count ? code->insts + code->count - 1 : 0;
+    cc_inst * moved = 0;
+    int i = 0;
+    int k = 0;
+
+    if (!self->ncolds) {
+        return;
+    }
+    if (!last || CC_OP_SET != last->op || CC_VAL_PC != last->b.mode
+        || (code->count > 1 && cc_op_isif(last[-1].op))) {
+        code->line = self->func->node.line;
+        cc_gen_emit(self, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+            cc_opd_label(self->exit));
+    }
+    for (i = self->ncolds - 2; i >= 0; i -= 2) {
+        int start = self->colds[i];
+        int end = self->colds[i + 1];
+        int size = end - start;
+        moved = malloc(size * sizeof(cc_inst));
+        memcpy(moved, code->insts + start, size * sizeof(cc_inst));
+        memmove(code->insts + start, code->insts + end,
+            (code->count - end) * sizeof(cc_inst));
+        memcpy(code->insts + code->count - size, moved,
+            size * sizeof(cc_inst));
+        free(moved);
+        for (k = 0; k < self->nteardowns; ++k) {
+            int * at = self->teardowns + k;
+            if (*at >= start && *at < end) {
+                *at += code->count - end;
+            } else if (*at >= end) {
+                *at -= size;
+            }
+        }
+    }
+    self->ncolds = 0;
+}
+
+/* Leaves the scopes entered since the innermost local was 'locals' */
+static void cc_gen_pop(cc_gen * self, cc_local * locals) {
+    while (self->locals != locals) {
+        cc_local * next = self->locals->next;
+        free(self->locals);
+        self->locals = next;
+    }
+}
+
+/* Generates a function.  The prologue and epilogue depend on the frame
+ * size and on the registers the body writes, so they are completed after
+ * the body has been generated.  If an expression runs out of registers
+ * because variables hold too many, the function is generated again with
+ * fewer register variables, until none are left. */
+void cc_gen_func(cc_gen * self, cc_func * func) {
+    int tails = self->tails;
+    int blocks = self->blocks;
+    int inverted = self->inverted;
+    int tiled = self->tiled;
+    int ldiv = self->ldiv;
+
+    self->slack = 0;
+    for (;;) {
+        self->func = func;
+        self->code = cc_code_init(func->id);
+        self->code->line = func->node.line;
+        self->locals = 0;
+        self->frame = 0;
+        self->frame_size = 0;
+        self->used = 0;
+        self->starved = 0;
+        self->exit = cc_code_label(self->code);
+
+        cc_frame_enter(self, func);
+        if (self->env->pgo && self->env->pgo->generate) {
+            cc_gen_count(self, cc_pgo_func(self->env->pgo, func)->first, 1);
+        }
+        cc_gen_block(self, func->block);
+        cc_gen_outline(self);
+        cc_frame_leave(self);
+        cc_gen_pop(self, 0);
+        if (!self->starved) {
+            break;
+        }
+        self->slack++;
+        self->ncolds = 0;
+        cc_code_free(self->code);
+        self->tails = tails;
+        self->blocks = blocks;
+        self->inverted = inverted;
+        self->tiled = tiled;
+        self->ldiv = ldiv;
+    }
+
+    *self->tail = self->code;
+    self->tail = &self->code->next;
+    self->code = 0;
+    self->func = 0;
+}
+
+/* Generates a block.  Each variable not kept in a register gets the next
+ * free slot below the frame pointer; slots are reused by sibling blocks. */
+void cc_gen_block(cc_gen * self, cc_block * block) {
+    cc_local * locals = self->locals;
+    int frame = self->frame;
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+
+    for (var = block->vars; var; var = var->next) {
+        cc_local * local = calloc(1, sizeof(cc_local));
+        local->id = var->id;
+        local->type = var->type;
+        local->reg = cc_frame_regvar(self, var);
+        if (local->reg < 0) {
+            self->frame += cc_type_size(var->type);
+            if (self->frame > self->frame_size) {
+                self->frame_size = self->frame;
+            }
+            local->offset = -self->frame;
+        }
+        local->next = self->locals;
+        self->locals = local;
+        if (var->init && cc_type_islong(var->type)) {
+            self->code->line = var->node.line;
+            cc_long_store(self, cc_frame_home(self, local), var->init);
+        } else if (var->init) {
+            cc_operand value;
+            self->code->line = var->node.line;
+            value = cc_gen_expr(self, var->init);
+            cc_gen_emit(self, CC_OP_SET, cc_frame_home(self, local), value);
+            cc_gen_release(self, value);
+        }
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_gen_stmt(self, stmt);
+    }
+    cc_gen_pop(self, locals);
+    self->frame = frame;
+}
+
+void cc_gen_stmt(cc_gen * self, cc_stmt * stmt) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    self->code->line = stmt->node.line;
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_gen_block(self, (cc_block *)stmt);
+        break;
+    case CC_IF:
+        cc_gen_if(self, (cc_if *)stmt);
+        break;
+    case CC_FOR:
+    case CC_WHILE: {
+        /* The guard is tested at the bottom of the loop, so that each
+         * iteration takes a single conditional branch.  The jump to the
+         * first test is omitted only if the trip count, simulated with the
+         * comparison's signedness, shows the loop runs at least once.
+         * The body, update and test are weighted by the trip count, or by
+         * CC_FRAME_LOOP if it isn't constant. */
+        cc_loop * loop = (cc_loop *)stmt;
+        int top = cc_code_label(self->code);
+        int test = cc_code_label(self->code);
+        int value = 0;
+        int trips = cc_loop_trips(loop, CC_DCPU_WORDS);
+        double weight = self->code->weight;
+        double ratio = cc_pgo_ratio(self->env->pgo, loop->site);
+        if (self->env->pgo && self->env->pgo->generate) {
+            cc_gen_count(self, loop->site, 1);
+        }
+        if (loop->init) {
+            cc_gen_void(self, loop->init);
+        }
+        if (loop->guard && !(cc_expr_const(loop->guard, &value) && value)
+            && trips <= 0) {
+            cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(test));
+        }
+        if (trips < 0 && ratio >= 0) {
+            self->code->weight = weight * ratio;
+        } else {
+            self->code->weight = weight * (trips >= 0 ? trips : CC_FRAME_LOOP);
+        }
+        cc_code_place(self->code, top);
+        if (self->env->pgo && self->env->pgo->generate) {
+            cc_gen_count(self, loop->site + 1, loop->unroll ? loop->unroll : 1);
+        }
+        if (loop->block) {
+            cc_gen_block(self, loop->block);
+        }
+        self->code->line = stmt->node.line;
+        if (loop->update) {
+            cc_gen_void(self, loop->update);
+        }
+        cc_code_place(self->code, test);
+        if (loop->guard) {
+            cc_gen_branch(self, loop->guard, 1, top);
+        } else {
+            cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(top));
+        }
+        self->code->weight = weight;
+        break;
+    }
+    case CC_SIMPLE:
+        cc_gen_void(self, ((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN: {
+        cc_return * ret = (cc_return *)stmt;
+        if (ret->expr && CC_CALL == ret->expr->node.type
+            && cc_frame_tail(self, (cc_call *)ret->expr)) {
+            break;
+        }
+        if (ret->expr) {
+            cc_operand value = cc_gen_expr(self, ret->expr);
+            cc_operand a = cc_opd_reg(CC_REG_A);
+            if (!cc_operand_equal(&value, &a)) {
+                cc_gen_emit(self, CC_OP_SET, a, value);
+            }
+            cc_gen_release(self, value);
+        }
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(self->exit));
+        break;
+    }
+    default:
+        cc_gen_err(self, stmt->node.line, "Invalid statement");
+        break;
+    }
+}
+
+/* Generates an if statement.  Without a profile, each arm is assumed to
+ * run half of the time, and the 'yes' arm comes first.  The arm that comes
+ * first is reached by skipping the jump after the IF chain, and must jump
+ * over the other arm when it is done, so with a profile the arm that runs
+ * more often comes second.  An arm without an 'else' that rarely runs is
+ * moved after the body of the function, so that the common case skips a
+ * jump instead of taking one. */
+void cc_gen_if(cc_gen * self, cc_if * stmt) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    int count = self->env->pgo && self->env->pgo->generate;
+    cc_stmt * first = stmt->yes;
+    cc_stmt * second = stmt->no;
+    int sense = 0;
+    int no = cc_code_label(self->code);
+    int done = no;
+    double weight = self->code->weight;
+    double ratio = cc_pgo_ratio(self->env->pgo, stmt->site);
+    double share = ratio >= 0 ? ratio : 0.5;
+
+    if (count) {
+        cc_gen_count(self, stmt->site, 1);
+    }
+    if (ratio >= 0 && self->level >= 1 && !self->size && !self->cold
+        && stmt->yes && !stmt->no && ratio < CC_GEN_COLD) {
+        int cold = cc_code_label(self->code);
+        cc_gen_branch(self, stmt->guard, 1, cold);
+        if (self->ncolds + 2 > self->capcolds) {
+            self->capcolds = self->capcolds ? self->capcolds * 2 : 16;
+            self->colds = realloc(self->colds, self->capcolds * sizeof(int));
+        }
+        self->colds[self->ncolds++] = self->code->count;
+        self->cold = 1;
+        self->code->weight = weight * share;
+        cc_code_place(self->code, cold);
+        cc_gen_stmt(self, stmt->yes);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(done));
+        self->cold = 0;
+        self->colds[self->ncolds++] = self->code->count;
+        self->code->weight = weight;
+        cc_code_place(self->code, done);
+        self->inverted++;
+        return;
+    }
+    if (ratio > 0.5 && stmt->no) {
+        first = stmt->no;
+        second = stmt->yes;
+        sense = 1;
+        share = 1 - ratio;
+        self->inverted++;
+    }
+    cc_gen_branch(self, stmt->guard, sense, no);
+    self->code->weight = weight * share;
+    if (count && first == stmt->yes) {
+        cc_gen_count(self, stmt->site + 1, 1);
+    }
+    if (first) {
+        cc_gen_stmt(self, first);
+    }
+    if (second) {
+        done = cc_code_label(self->code);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(done));
+        cc_code_place(self->code, no);
+        self->code->weight = weight * (1 - share);
+        if (count && second == stmt->yes) {
+            cc_gen_count(self, stmt->site + 1, 1);
+        }
+        cc_gen_stmt(self, second);
+    }
+    self->code->weight = weight;
+    cc_code_place(self->code, done);
+}
+
+/* Emits code that adds 'amount' to a 32-bit profile counter */
+void cc_gen_count(cc_gen * self, int counter, int amount) {
+    cc_id * id = self->env->pgo->id;
+    cc_gen_emit(self, CC_OP_ADD, cc_opd_mem(id, 2 * counter),
+        cc_opd_lit(amount));
+    cc_gen_emit(self, CC_OP_ADX, cc_opd_mem(id, 2 * counter + 1),
+        cc_opd_lit(0));
+}
+
+/* Generates a branch to 'label' that is taken if the truth value of 'expr'
+ * is 'sense'.  Conditions are lowered directly to IF* instructions, so no
+ * boolean value is computed unless the condition can't be expressed as a
+ * chain of tests. */
+void cc_gen_branch(cc_gen * self, cc_expr * expr, int sense, int label) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    int value = 0;
+    int op = 0;
+    if (cc_expr_const(expr, &value)) {
+        if (!value == !sense) {
+            cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+        }
+        return;
+    }
+    if (cc_gen_chain(self, expr, sense, 1, 0)) {
+        cc_gen_chain(self, expr, sense, 1, 1);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+        return;
+    }
+    if (CC_UNARY == expr->node.type && '!' == ((cc_unary *)expr)->op) {
+        cc_gen_branch(self, ((cc_unary *)expr)->expr, !sense, label);
+        return;
+    }
+    if (CC_BINARY == expr->node.type) {
+        op = ((cc_binary *)expr)->op;
+    }
+    if ((CC_TOK_AND == op && !sense) || (CC_TOK_OR == op && sense)) {
+        /* Either operand decides the branch */
+        cc_gen_branch(self, ((cc_binary *)expr)->left, sense, label);
+        cc_gen_branch(self, ((cc_binary *)expr)->right, sense, label);
+    } else if (CC_TOK_AND == op || CC_TOK_OR == op) {
+        /* Both operands are needed to take the branch */
+        int skip = cc_code_label(self->code);
+        cc_gen_branch(self, ((cc_binary *)expr)->left, !sense, skip);
+        cc_gen_branch(self, ((cc_binary *)expr)->right, sense, label);
+        cc_code_place(self->code, skip);
+    } else if (cc_long_cond(expr)) {
+        cc_long_branch(self, expr, sense, label);
+    } else {
+        /* Test the opposite condition, and skip over the jump if it passes.
+         * This handles '<=' and '>=' of two variables, which have no single
+         * IF instruction. */
+        int skip = cc_code_label(self->code);
+        cc_gen_chain(self, expr, !sense, 1, 1);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(skip));
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+        cc_code_place(self->code, skip);
+    }
+}
+
+/* Emits a chain of IF instructions that all pass if the truth value of 'expr'
+ * is 'sense'.  A failed IF skips the rest of the chain along with the
+ * instruction after it, so a chain tests the conjunction of its links.  Only
+ * the operands of the first link may need code to compute them, since that
+ * code would otherwise run in the middle of the chain.  If 'emit' is 0, the
+ * chain is only checked, and the return value says if it can be emitted. */
+int cc_gen_chain(cc_gen * self, cc_expr * expr, int sense, int first,
+    int emit) {
+
+    cc_binary * binary = (cc_binary *)expr;
+    cc_expr * left = 0;
+    cc_expr * right = 0;
+    cc_operand l;
+    cc_operand r;
+    int adjust = 0;
+    int op = 0;
+
+    if (CC_UNARY == expr->node.type && '!' == ((cc_unary *)expr)->op) {
+        return cc_gen_chain(self, ((cc_unary *)expr)->expr, !sense, first,
+            emit);
+    }
+    if (CC_BINARY == expr->node.type) {
+        op = binary->op;
+    }
+    if ((CC_TOK_AND == op && sense) || (CC_TOK_OR == op && !sense)) {
+        if (!emit) {
+            return cc_gen_chain(self, binary->left, sense, first, 0)
+                && cc_gen_chain(self, binary->right, sense, 0, 0);
+        }
+        cc_gen_chain(self, binary->left, sense, first, 1);
+        cc_gen_chain(self, binary->right, sense, 0, 1);
+        return 1;
+    } else if (CC_TOK_AND == op || CC_TOK_OR == op) {
+        return 0;
+    }
+    if (cc_long_cond(expr)) {
+        return cc_long_chain(self, expr, sense, first, emit);
+    }
+
+    if (cc_check_iscompare(op)) {
+        op = cc_gen_test(binary, sense, &left, &right, &adjust);
+        if (!op) {
+            return 0;
+        }
+    } else if ('&' == op) {
+        /* IFB passes if any bit is set in both operands */
+        op = sense ? CC_OP_IFB : CC_OP_IFC;
+        left = binary->left;
+        right = binary->right;
+    } else {
+        op = sense ? CC_OP_IFN : CC_OP_IFE;
+        left = expr;
+        right = 0;
+    }
+    if (!first && (!cc_gen_isleaf(self, left)
+        || (right && !cc_gen_isleaf(self, right)))) {
+        return 0;
+    }
+    if (!emit) {
+        return 1;
+    }
+    l = cc_gen_expr(self, left);
+    if (right) {
+        l = cc_frame_spill(self, l, right);
+    }
+    r = right ? cc_gen_expr(self, right) : cc_opd_lit(0);
+    r.value = cc_word(r.value + adjust);
+    cc_gen_emit(self, op, l, r);
+    cc_gen_release(self, l);
+    cc_gen_release(self, r);
+    return 1;
+}
+
+/* Returns the IF instruction that passes if the truth value of the
+ * comparison 'expr' is 'sense', or 0 if there isn't one.  A constant operand
+ * is moved to the right, where it may fit in a short literal.  '<=' and
+ * '>=' against a constant become strict comparisons against the constant
+ * plus or minus 'adjust'. */
+int cc_gen_test(cc_binary * expr, int sense, cc_expr ** left,
+    cc_expr ** right, int * adjust) {
+
+    int sign = !cc_type_isunsigned(expr->left->type)
+        && !cc_type_isunsigned(expr->right->type);
+    int op = expr->op;
+    int value = 0;
+    int max = sign ? 0x7fff : 0xffff;
+    int min = sign ? -0x8000 : 0;
+
+    *left = expr->left;
+    *right = expr->right;
+    *adjust = 0;
+    if (cc_expr_const(*left, &value) && !cc_expr_const(*right, &value)) {
+        *left = expr->right;
+        *right = expr->left;
+        switch (op) {
+        case '<': op = '>'; break;
+        case '>': op = '<'; break;
+        case CC_TOK_LE: op = CC_TOK_GE; break;
+        case CC_TOK_GE: op = CC_TOK_LE; break;
+        default: break;
+        }
+    }
+    if (!sense) {
+        switch (op) {
+        case '<': op = CC_TOK_GE; break;
+        case '>': op = CC_TOK_LE; break;
+        case CC_TOK_LE: op = '>'; break;
+        case CC_TOK_GE: op = '<'; break;
+        case CC_TOK_EQ: op = CC_TOK_NE; break;
+        case CC_TOK_NE: op = CC_TOK_EQ; break;
+        default: break;
+        }
+    }
+    if (CC_TOK_LE == op || CC_TOK_GE == op) {
+        if (!cc_expr_const(*right, &value)) {
+            return 0;
+        }
+        if (!sign) {
+            value &= 0xffff;
+        }
+        if (CC_TOK_LE == op && value != max) {
+            op = '<';
+            *adjust = 1;
+        } else if (CC_TOK_GE == op && value != min) {
+            op = '>';
+            *adjust = -1;
+        } else {
+            return 0;
+        }
+    }
+    switch (op) {
+    case '<': return sign ? CC_OP_IFU : CC_OP_IFL;
+    case '>': return sign ? CC_OP_IFA : CC_OP_IFG;
+    case CC_TOK_EQ: return CC_OP_IFE;
+    case CC_TOK_NE: return CC_OP_IFN;
+    default: return 0;
+    }
+}
+
+/* Returns 1 if 'expr' can be used as an operand without emitting any code */
+int cc_gen_isleaf(cc_gen * self, cc_expr * expr) {
+    int value = 0;
+    return cc_expr_const(expr, &value) || CC_REF == expr->node.type;
+}
+
+/* Computes the truth value of a condition as 0 or 1.  The value is set
+ * before a chain of tests, and the chain skips over the instruction that
+ * changes it. */
+cc_operand cc_gen_bool(cc_gen * self, cc_expr * expr) {
+    cc_operand t = cc_frame_result(self, expr);
+    if (cc_gen_chain(self, expr, 1, 1, 0)) {
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_lit(0));
+        cc_gen_chain(self, expr, 1, 1, 1);
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_lit(1));
+    } else if (cc_gen_chain(self, expr, 0, 1, 0)) {
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_lit(1));
+        cc_gen_chain(self, expr, 0, 1, 1);
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_lit(0));
+    } else {
+        int done = cc_code_label(self->code);
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_lit(0));
+        cc_gen_branch(self, expr, 0, done);
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_lit(1));
+        cc_code_place(self->code, done);
+    }
+    return t;
+}
+
+/* Generates an expression whose value isn't used */
+void cc_gen_void(cc_gen * self, cc_expr * expr) {
+    if (CC_BINARY == expr->node.type && ',' == ((cc_binary *)expr)->op) {
+        cc_gen_void(self, ((cc_binary *)expr)->left);
+        cc_gen_void(self, ((cc_binary *)expr)->right);
+    } else {
+        cc_gen_release(self, cc_gen_expr(self, expr));
+    }
+}
+
+/* Generates an expression, and returns the operand that holds its value.
+ * The operand may be a register, a literal, or a memory reference; any
+ * temporary register it uses must be released by the caller. */
+cc_operand cc_gen_expr(cc_gen * self, cc_expr * expr) {
+    int value = 0;
+    if (cc_expr_const(expr, &value)) {
+        return cc_opd_lit(value);
+    } else if (cc_type_islong(expr->type)) {
+        return cc_long_low(self, cc_long_expr(self, expr));
+    }
+    switch (expr->node.type) {
+    case CC_BINARY:
+        return cc_gen_binary(self, (cc_binary *)expr);
+    case CC_UNARY:
+        return cc_gen_unary(self, (cc_unary *)expr);
+    case CC_CALL:
+        return cc_gen_call(self, (cc_call *)expr);
+    case CC_REF:
+        return cc_gen_ref(self, (cc_ref *)expr);
+    case CC_STRING:
+        return cc_gen_string(self, (cc_string *)expr);
+    case CC_MEMBER:
+        return cc_gen_lvalue(self, expr);
+    default:
+        cc_gen_err(self, expr->node.line, "Not implemented");
+        return cc_opd_lit(0);
+    }
+}
+
+cc_operand cc_gen_binary(cc_gen * self, cc_binary * expr) {
+    switch (expr->op) {
+    case '=':
+        return cc_gen_assign(self, expr);
+    case ',':
+        cc_gen_void(self, expr->left);
+        return cc_gen_expr(self, expr->right);
+    case CC_TOK_AND:
+    case CC_TOK_OR:
+    case '<':
+    case '>':
+    case CC_TOK_LE:
+    case CC_TOK_GE:
+    case CC_TOK_EQ:
+    case CC_TOK_NE:
+        return cc_gen_bool(self, (cc_expr *)expr);
+    default:
+        return cc_gen_arith(self, expr);
+    }
+}
+
+/* Generates an arithmetic operator.  The left operand is loaded into a
+ * register, which also receives the result, unless it has to be spilled
+ * while the right operand is computed (see cc_frame_spill).  Multiplies, divides and modulos
+ * by a constant are lowered through the cycle cost table in arith.c. */
+cc_operand cc_gen_arith(cc_gen * self, cc_binary * expr) {
+    cc_expr * left = expr->left;
+    cc_expr * right = expr->right;
+    int sign = !cc_type_isunsigned(expr->node.type);
+    int value = 0;
+    int op = 0;
+    cc_operand l;
+    cc_operand r;
+
+    switch (expr->op) {
+    case '+': op = CC_OP_ADD; break;
+    case '-': op = CC_OP_SUB; break;
+    case '*': op = CC_OP_MUL; break;
+    case '/': op = sign ? CC_OP_DVI : CC_OP_DIV; break;
+    case '%': op = sign ? CC_OP_MDI : CC_OP_MOD; break;
+    case '&': op = CC_OP_AND; break;
+    case '|': op = CC_OP_BOR; break;
+    case '^': op = CC_OP_XOR; break;
+    case CC_TOK_LSHIFT: op = CC_OP_SHL; break;
+    case CC_TOK_RSHIFT: op = sign ? CC_OP_ASR : CC_OP_SHR; break;
+    default:
+        cc_gen_err(self, expr->node.node.line, "Invalid operator");
+        return cc_opd_lit(0);
+    }
+
+    /* Put constants on the right of commutative operators */
+    if ((CC_OP_ADD == op || CC_OP_MUL == op || CC_OP_AND == op
+        || CC_OP_BOR == op || CC_OP_XOR == op) && cc_expr_const(left, &value)
+        && !cc_type_isptr(right->type)) {
+        cc_expr * temp = left;
+        left = right;
+        right = temp;
+    }
+
+    l = cc_gen_load(self, cc_gen_expr(self, left));
+    if (cc_type_isptr(right->type) && !cc_type_isptr(left->type)) {
+        int size = cc_type_size(right->type->nested);
+        if (size > 1) {
+            cc_gen_emit(self, CC_OP_MUL, l, cc_opd_lit(size));
+        }
+    }
+    if ((CC_OP_MUL == op || CC_OP_DIV == op || CC_OP_DVI == op
+        || CC_OP_MOD == op || CC_OP_MDI == op)
+        && cc_expr_const(right, &value)) {
+        int scratch = cc_gen_scratch(self);
+        cc_seq seq;
+        int i = 0;
+        if (CC_OP_MUL == op) {
+            cc_arith_mul(&seq, l.reg, value, scratch);
+        } else if (CC_OP_DIV == op || CC_OP_DVI == op) {
+            cc_arith_div(&seq, l.reg, value, sign, scratch);
+        } else {
+            cc_arith_mod(&seq, l.reg, value, sign, scratch);
+        }
+        if (self->size && cc_seq_words(&seq) > 1 + (value < -1 || value > 30)) {
+            /* The instruction itself is smaller */
+            seq.count = 1;
+            seq.insts[0].op = op;
+            seq.insts[0].b = l;
+            seq.insts[0].a = cc_opd_lit(value);
+        }
+        for (i = 0; i < seq.count; ++i) {
+            cc_gen_emit(self, seq.insts[i].op, seq.insts[i].b, seq.insts[i].a);
+        }
+        if (scratch >= 0) {
+            cc_gen_release(self, cc_opd_reg(scratch));
+        }
+        return l;
+    }
+
+    l = cc_frame_spill(self, l, right);
+    r = cc_gen_expr(self, right);
+    if (cc_type_isptr(left->type) && !cc_type_isptr(right->type)) {
+        int size = cc_type_size(left->type->nested);
+        if (size > 1) {
+            r = cc_gen_load(self, r);
+            cc_gen_emit(self, CC_OP_MUL, r, cc_opd_lit(size));
+        }
+    }
+    cc_gen_emit(self, op, l, r);
+    cc_gen_release(self, r);
+    if (CC_OP_SUB == op && cc_type_isptr(left->type)
+        && cc_type_isptr(right->type)) {
+        int size = cc_type_size(left->type->nested);
+        if (size > 1) {
+            cc_gen_emit(self, CC_OP_DIV, l, cc_opd_lit(size));
+        }
+    }
+    return l;
+}
+
+/* Generates an assignment.  The value of the assignment is the value that
+ * was stored; values wider than a word are copied as a block. */
+cc_operand cc_gen_assign(cc_gen * self, cc_binary * expr) {
+    cc_operand lvalue;
+    cc_operand value;
+    int size = cc_type_size(expr->left->type);
+    int op = 0;
+    if (size > 1) {
+        return cc_mem_copy(self, expr->left, expr->right, size);
+    }
+    lvalue = cc_gen_lvalue(self, expr->left);
+    op = cc_gen_rmw(self, expr);
+    if (op) {
+        /* x = x op y:  operate on the variable in place */
+        value = cc_gen_expr(self, ((cc_binary *)expr->right)->right);
+        cc_gen_emit(self, op, lvalue, value);
+        cc_gen_release(self, value);
+        return lvalue;
+    }
+    value = cc_gen_expr(self, expr->right);
+    cc_gen_emit(self, CC_OP_SET, lvalue, value);
+    cc_gen_release(self, lvalue);
+    return value;
+}
+
+/* Returns the opcode for an assignment of the form 'x = x op y' that can be
+ * done with a single read-modify-write instruction, or 0 */
+int cc_gen_rmw(cc_gen * self, cc_binary * expr) {
+    cc_binary * right = (cc_binary *)expr->right;
+    int sign = !cc_type_isunsigned(expr->left->type);
+    int value = 0;
+    if (CC_BINARY != right->node.node.type
+        || !cc_expr_equal(expr->left, right->left)
+        || cc_type_isptr(expr->left->type)) {
+        return 0;
+    }
+    switch (right->op) {
+    case '+': return CC_OP_ADD;
+    case '-': return CC_OP_SUB;
+    case '&': return CC_OP_AND;
+    case '|': return CC_OP_BOR;
+    case '^': return CC_OP_XOR;
+    case CC_TOK_LSHIFT: return CC_OP_SHL;
+    case CC_TOK_RSHIFT: return sign ? CC_OP_ASR : CC_OP_SHR;
+    default: break;
+    }
+    if (cc_expr_const(right->right, &value)) {
+        return 0; /* Lowered by cc_gen_arith */
+    }
+    switch (right->op) {
+    case '*': return CC_OP_MUL;
+    case '/': return sign ? CC_OP_DVI : CC_OP_DIV;
+    case '%': return sign ? CC_OP_MDI : CC_OP_MOD;
+    default: return 0;
+    }
+}
+
+cc_operand cc_gen_unary(cc_gen * self, cc_unary * expr) {
+    cc_operand value;
+    switch (expr->op) {
+    case '*':
+        if (CC_UNARY == expr->expr->node.type
+            && '&' == ((cc_unary *)expr->expr)->op) {
+            return cc_gen_lvalue(self, ((cc_unary *)expr->expr)->expr);
+        } else if (self->burs
+            && cc_burs_lvalue(self, (cc_expr *)expr, &value)) {
+            return value;
+        }
+        value = cc_gen_expr(self, expr->expr);
+        if (CC_VAL_LIT == value.mode) {
+            value.mode = CC_VAL_MEM;
+            return value;
+        } else if (CC_VAL_REG == value.mode) {
+            return cc_opd_ind(value.reg);
+        }
+        value = cc_gen_load(self, value);
+        return cc_opd_ind(value.reg);
+    case '&':
+        return cc_gen_addr(self, expr->expr);
+    case '-':
+        value = cc_gen_load(self, cc_gen_expr(self, expr->expr));
+        cc_gen_emit(self, CC_OP_MLI, value, cc_opd_lit(-1));
+        return value;
+    case '~':
+        value = cc_gen_load(self, cc_gen_expr(self, expr->expr));
+        cc_gen_emit(self, CC_OP_XOR, value, cc_opd_lit(-1));
+        return value;
+    case '!':
+        return cc_gen_bool(self, (cc_expr *)expr);
+    default:
+        cc_gen_err(self, expr->node.node.line, "Invalid operator");
+        return cc_opd_lit(0);
+    }
+}
+
+/* Returns the address of an lvalue, as a literal or in a register */
+cc_operand cc_gen_addr(cc_gen * self, cc_expr * expr) {
+    cc_operand value = cc_gen_lvalue(self, expr);
+    cc_operand t;
+    if (CC_VAL_MEM == value.mode) {
+        value.mode = CC_VAL_LIT;
+        return value;
+    } else if (CC_VAL_IND == value.mode) {
+        return cc_opd_reg(value.reg);
+    }
+    if (CC_VAL_PICK == value.mode || CC_VAL_PEEK == value.mode) {
+        /* SP-relative local; the offset may be fixed up later */
+        cc_operand offset = value;
+        t = cc_opd_reg(cc_gen_alloc(self));
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_special(CC_VAL_SP));
+        offset.mode = CC_VAL_LIT;
+        cc_gen_emit(self, CC_OP_ADD, t, offset);
+        return t;
+    }
+    t = cc_opd_reg(value.reg);
+    if ((self->fp && CC_REG_J == value.reg)
+        || (self->vars & (1 << value.reg))) {
+        t = cc_opd_reg(cc_gen_alloc(self));
+        cc_gen_emit(self, CC_OP_SET, t, cc_opd_reg(value.reg));
+    }
+    if (value.sym) {
+        value.mode = CC_VAL_LIT;
+        value.reg = 0;
+        cc_gen_emit(self, CC_OP_ADD, t, value);
+    } else if (value.value < 0) {
+        cc_gen_emit(self, CC_OP_SUB, t, cc_opd_lit(-value.value));
+    } else if (value.value > 0) {
+        cc_gen_emit(self, CC_OP_ADD, t, cc_opd_lit(value.value));
+    }
+    return t;
+}
+
+/* Generates a call, following the convention in frame.h.  Calls to
+ * builtins are expanded inline. */
+cc_operand cc_gen_call(cc_gen * self, cc_call * expr) {
+    if (cc_mem_builtin(self, expr)) {
+        return cc_mem_call(self, expr);
+    } else if (cc_pool_builtin(self, expr)) {
+        return cc_pool_call(self, expr);
+    }
+    return cc_frame_call(self, expr);
+}
+
+/* Returns non-zero if 'call' is a direct call to 'name' with 'args'
+ * arguments, and 'name' is declared without a body.  Such calls may be
+ * builtins; a program can still define a function of the same name. */
+int cc_gen_calls(cc_gen * self, cc_call * call, char const * name,
+    int args) {
+    cc_func * func = 0;
+    cc_expr * arg = 0;
+    cc_id * id = 0;
+    if (!cc_frame_direct(self, call->expr)) {
+        return 0;
+    }
+    id = ((cc_ref *)call->expr)->id;
+    func = cc_env_func(self->env, id);
+    if (!func || func->block || strcmp(id->str, name)) {
+        return 0;
+    }
+    for (arg = call->args; arg; arg = arg->next) {
+        args--;
+    }
+    return !args;
+}
+
+/* Returns non-zero if 'call' is expanded inline rather than called */
+int cc_gen_builtin(cc_gen * self, cc_call * call) {
+    return cc_mem_builtin(self, call) || cc_pool_builtin(self, call);
+}
+
+/* Returns the operand for a variable reference.  Function names evaluate to
+ * the address of the function's stack adapter. */
+cc_operand cc_gen_ref(cc_gen * self, cc_ref * expr) {
+    if (cc_gen_local(self, expr->id) || cc_env_var(self->env, expr->id)) {
+        return cc_gen_lvalue(self, (cc_expr *)expr);
+    }
+    return cc_opd_sym(cc_frame_adapter(self, expr->id));
+}
+
+/* Returns the address of a string literal in the pool */
+cc_operand cc_gen_string(cc_gen * self, cc_string * expr) {
+    return cc_pool_add(self->pool, expr->value);
+}
+
+/* Returns a memory operand for an lvalue expression */
+cc_operand cc_gen_lvalue(cc_gen * self, cc_expr * expr) {
+    if (CC_REF == expr->node.type) {
+        cc_id * id = ((cc_ref *)expr)->id;
+        cc_local * local = cc_gen_local(self, id);
+        if (local) {
+            return cc_frame_home(self, local);
+        } else if (cc_env_var(self->env, id)) {
+            return cc_opd_mem(id, 0);
+        }
+    } else if (CC_UNARY == expr->node.type && '*' == ((cc_unary *)expr)->op) {
+        return cc_gen_unary(self, (cc_unary *)expr);
+    } else if (CC_MEMBER == expr->node.type) {
+        cc_operand value;
+        if (self->burs && cc_burs_lvalue(self, expr, &value)) {
+            return value;
+        }
+        return cc_gen_member(self, (cc_member *)expr);
+    }
+    cc_gen_err(self, expr->node.line, "Invalid lvalue");
+    return cc_opd_lit(0);
+}
+
+/* Returns a memory operand for a field.  The field's offset is added to the
+ * operand for the struct, so a chain of fields folds into one offset, and
+ * a field reached through a pointer is a single [reg+offset] operand. */
+cc_operand cc_gen_member(cc_gen * self, cc_member * expr) {
+    cc_operand value = cc_gen_lvalue(self, expr->expr);
+    cc_var * field = cc_type_field(expr->expr->type, expr->id);
+    int offset = field ? field->offset : 0;
+    switch (value.mode) {
+    case CC_VAL_IND:
+    case CC_VAL_OFF:
+        if (value.sym) {
+            value.value += offset;
+            return value;
+        }
+        return cc_opd_off(value.reg, value.value + offset);
+    case CC_VAL_PICK:
+    case CC_VAL_MEM:
+        value.value += offset;
+        return value;
+    default:
+        /* A struct of one word may be kept in a register */
+        return value;
+    }
+}
+
+/* Loads 'opd' into a register.  If 'opd' already owns a register, then that
+ * register is reused.  Registers holding variables are never owned. */
+cc_operand cc_gen_load(cc_gen * self, cc_operand opd) {
+    cc_operand reg;
+    int owned = !(self->fp && CC_REG_J == opd.reg)
+        && !(self->vars & (1 << opd.reg));
+    if (CC_VAL_REG == opd.mode && owned) {
+        return opd;
+    }
+    if ((CC_VAL_IND == opd.mode || CC_VAL_OFF == opd.mode) && owned) {
+        reg = cc_opd_reg(opd.reg);
+    } else {
+        reg = cc_opd_reg(cc_gen_alloc(self));
+    }
+    cc_gen_emit(self, CC_OP_SET, reg, opd);
+    return reg;
+}
+
+cc_local * cc_gen_local(cc_gen * self, cc_id * id) {
+    cc_local * local = 0;
+    for (local = self->locals; local; local = local->next) {
+        if (local->id == id) {
+            return local;
+        }
+    }
+    return 0;
+}
+
+cc_inst * cc_gen_emit(cc_gen * self, int op, cc_operand b, cc_operand a) {
+    cc_frame_track(self, op, &b, &a);
+    return cc_code_emit(self->code, op, b, a);
+}
+
+/* Allocates a register for a temporary.  If none is free while variables
+ * hold registers, the function is retried (see cc_gen_func). */
+int cc_gen_alloc(cc_gen * self) {
+    int reg = cc_gen_scratch(self);
+    if (reg < 0 && self->vars) {
+        self->starved = 1;
+        return CC_REG_A;
+    }
+    if (reg < 0) {
+        cc_gen_err(self, self->code->line, "Expression too complex");
+        return CC_REG_A;
+    }
+    return reg;
+}
+
+/* Allocates a register if one is free, or returns -1 */
+int cc_gen_scratch(cc_gen * self) {
+    int avail = cc_frame_regs(self) & ~self->vars & ~self->used;
+    int reg = 0;
+    for (reg = CC_REG_A; reg <= CC_REG_J; ++reg) {
+        if (avail & (1 << reg)) {
+            self->used |= (1 << reg);
+            return reg;
+        }
+    }
+    return -1;
+}
+
+/* Frees the register owned by 'opd', if any */
+void cc_gen_release(cc_gen * self, cc_operand opd) {
+    if ((CC_VAL_REG == opd.mode || CC_VAL_IND == opd.mode
+        || CC_VAL_OFF == opd.mode) && !(self->fp && CC_REG_J == opd.reg)
+        && !(self->vars & (1 << opd.reg))) {
+        self->used &= ~(1 << opd.reg);
+    }
+}
+
+/* Prints the generated code and data as assembly text.  The BSS region is
+ * printed as zeros, since the text has no way to reserve words. */
+void cc_gen_print(cc_gen * self, FILE * out) {
+    cc_code * code = 0;
+    cc_global * global = 0;
+    int i = 0;
+    for (code = self->codes; code; code = code->next) {
+        cc_code_print(code, out);
+    }
+    cc_pool_print(self->pool, out);
+    for (global = self->data; global; global = global->next) {
+        cc_operand * value = &global->value;
+        fprintf(out, ":%s\n    DAT ", global->var->id->str);
+        if (value->sym) {
+            fprintf(out, value->value ? "%s%+d" : "%s", value->sym->str,
+                value->value);
+        } else {
+            fprintf(out, "%d", value->value & 0xffff);
+        }
+        for (i = 1; i < global->size; ++i) {
+            fprintf(out, ", %d", 1 == i ? global->high & 0xffff : 0);
+        }
+        fprintf(out, "\n");
+    }
+    if (self->zeros && !self->object) {
+        fprintf(out, ":$bss\n");
+    }
+    for (global = self->zeros; global; global = global->next) {
+        fprintf(out, ":%s\n    DAT 0", global->var->id->str);
+        for (i = 1; i < global->size; ++i) {
+            fprintf(out, ", 0");
+        }
+        fprintf(out, "\n");
+    }
+}
+
+/* Assembles the generated code and data into 'out', which is left
+ * unlinked */
+void cc_gen_assemble(cc_gen * self, cc_asm * out) {
+    cc_id * start = cc_env_id(self->env, "$start");
+    cc_code * code = 0;
+    cc_global * global = 0;
+    int i = 0;
+    for (code = self->codes; code; code = code->next) {
+        cc_asm_code(out, code);
+        if (code->id == start) {
+            cc_asm_entry(out);
+        }
+    }
+    cc_pool_assemble(self->pool, out);
+    for (global = self->data; global; global = global->next) {
+        cc_asm_section(out, CC_OBJ_DATA);
+        cc_asm_define(out, global->var->id, out->count);
+        if (global->value.sym) {
+            cc_asm_ref(out, global->value.sym, global->value.value);
+        } else {
+            cc_asm_word(out, global->value.value);
+        }
+        for (i = 1; i < global->size; ++i) {
+            cc_asm_word(out, 1 == i ? global->high : 0);
+        }
+    }
+    if (self->zeros && !self->object) {
+        cc_asm_bss(out, cc_env_id(self->env, "$bss"), 0);
+    }
+    for (global = self->zeros; global; global = global->next) {
+        cc_asm_bss(out, global->var->id, global->size);
+        if (!global->var->init) {
+            cc_asm_common(out);
+        }
+    }
+}
+
+void cc_gen_err(cc_gen * self, int line, char const * msg) {
+    fprintf(stderr, "%d: %s\n", line, msg);
+    self->errors++;
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_GEN_H
+#define CC_GEN_H
+
+#include "env.h"
+#include "ast.h"
+#include "code.h"
+#include "asm.h"
+#include <stdio.h>
+
+/* Registers available for temporaries, plus J if it isn't the frame
+ * pointer */
+#define CC_GEN_REGS 0x7f
+
+/* Fraction of the runs of an if statement below which its only arm is
+ * moved out of line, when there is a profile */
+#define CC_GEN_COLD 0.2
+
+/* Local variable or formal parameter.  It lives in register 'reg', or if
+ * 'reg' is -1, at 'offset' from the frame pointer.  Formals passed on the
+ * stack are at positive offsets, everything else at negative ones. */
+typedef struct cc_local {
+    cc_id * id;
+    cc_type * type;
+    int offset;
+    int reg;
+    struct cc_local * next;
+} cc_local;
+
+/* Candidate for a register variable: a cc_var or cc_formal, and the number
+ * of times it is used, weighted by loop depth */
+typedef struct cc_regvar {
+    void * decl;
+    cc_id * id;
+    long weight;
+    int addressed;
+    int live; /* In scope while the uses are being counted */
+    int reg;
+} cc_regvar;
+
+/* Global variable, laid out in the data segment if it has a non-zero
+ * initializer and in the BSS region otherwise.  'value' is the initial
+ * value of the first word, as a literal that may include the address of a
+ * symbol; 'high' is the second word of a long, and the rest are zero. */
+typedef struct cc_global {
+    cc_var * var;
+    cc_operand value;
+    int high;
+    int size;
+    struct cc_global * next;
+} cc_global;
+
+/* Code generator.  Walks the checked AST and emits DCPU-16 instructions into
+ * one code buffer per function.  The calling convention and frame layout are
+ * described in frame.h. */
+typedef struct cc_gen {
+    cc_env * env;
+    cc_code * codes; /* Generated code, in layout order */
+    cc_code ** tail;
+    cc_code * code; /* Code for the function being generated */
+    cc_func * func;
+    cc_local * locals; /* Innermost scope first */
+    struct cc_pool * pool; /* String literals */
+    cc_global * data; /* Initialized globals, in source order */
+    cc_global ** data_tail;
+    cc_global * zeros; /* Zero-initialized globals, in source order */
+    cc_global ** zeros_tail;
+    int bss; /* Words of zero-initialized globals */
+    int frame; /* Words of locals in scope */
+    int frame_size; /* Words of locals needed by the function */
+    int used; /* Bit mask of registers holding temporaries */
+    int fp; /* J is the frame pointer */
+    int depth; /* Words pushed since the prologue */
+    int vars; /* Bit mask of registers holding variables */
+    int saved; /* Bit mask of callee-saved registers the function writes */
+    int reserve; /* Index of the instruction that reserves the frame */
+    int save; /* Index where the saved registers are pushed */
+    int * teardowns; /* Indexes of the tail calls that pop the frame */
+    int nteardowns;
+    int capteardowns;
+    cc_local ** formals; /* Formals of the function, in order */
+    int nformals;
+    cc_regvar * regvars;
+    int recursive; /* The function calls itself */
+    int calls; /* The function calls other functions */
+    int need; /* Registers needed by the most complex expression */
+    int slack; /* Registers kept from variables after running short */
+    int starved; /* A temporary found no free register */
+    int nregvars;
+    int capregvars;
+    long unit; /* Weight of a use that runs once per call */
+    cc_id ** adapters; /* Functions whose address is taken */
+    int nadapters;
+    int capadapters;
+    int exit; /* Label of the function epilogue */
+    int body; /* Label after the function prologue */
+    int addressed; /* The function takes the address of a local */
+    int level; /* Optimization level (-O) */
+    int verbose;
+    int object; /* Generate a relocatable object (-c) */
+    int size; /* Prefer fewer words to fewer cycles (-Os) */
+    int burs; /* Select memory operands by tiling (see burs.h) */
+    int peephole; /* Run the peephole pass (see peep.h) */
+    int check; /* Keep the code from before the peephole pass */
+    int threads; /* Threads that generate functions (see par.h) */
+    cc_code * plain; /* Code from before the peephole pass, if kept */
+    int * colds; /* Instruction ranges moved after the body, in pairs */
+    int ncolds;
+    int capcolds;
+    int cold; /* Generating code that is moved after the body */
+    int tails; /* Number of calls generated as jumps */
+    int blocks; /* Number of block operations expanded inline */
+    int inverted; /* Number of if statements laid out by the profile */
+    int tiled; /* Number of memory operands selected by tiling */
+    int ldiv; /* A long division calls long$div (see long.h) */
+    int errors;
+} cc_gen;
+
+cc_gen * cc_gen_init(cc_env * env);
+void cc_gen_free(cc_gen * self);
+void cc_gen_env(cc_gen * self);
+void cc_gen_data(cc_gen * self);
+int cc_gen_const(cc_gen * self, cc_expr * expr, cc_operand * value);
+void cc_gen_start(cc_gen * self);
+void cc_gen_func(cc_gen * self, cc_func * func);
+void cc_gen_block(cc_gen * self, cc_block * block);
+void cc_gen_stmt(cc_gen * self, cc_stmt * stmt);
+void cc_gen_if(cc_gen * self, cc_if * stmt);
+void cc_gen_count(cc_gen * self, int counter, int amount);
+void cc_gen_branch(cc_gen * self, cc_expr * expr, int sense, int label);
+int cc_gen_chain(cc_gen * self, cc_expr * expr, int sense, int first,
+    int emit);
+int cc_gen_test(cc_binary * expr, int sense, cc_expr ** left,
+    cc_expr ** right, int * adjust);
+int cc_gen_isleaf(cc_gen * self, cc_expr * expr);
+cc_operand cc_gen_bool(cc_gen * self, cc_expr * expr);
+void cc_gen_void(cc_gen * self, cc_expr * expr);
+cc_operand cc_gen_expr(cc_gen * self, cc_expr * expr);
+cc_operand cc_gen_binary(cc_gen * self, cc_binary * expr);
+cc_operand cc_gen_arith(cc_gen * self, cc_binary * expr);
+cc_operand cc_gen_assign(cc_gen * self, cc_binary * expr);
+int cc_gen_rmw(cc_gen * self, cc_binary * expr);
+cc_operand cc_gen_unary(cc_gen * self, cc_unary * expr);
+cc_operand cc_gen_call(cc_gen * self, cc_call * expr);
+int cc_gen_calls(cc_gen * self, cc_call * call, char const * name, int args);
+int cc_gen_builtin(cc_gen * self, cc_call * call);
+cc_operand cc_gen_ref(cc_gen * self, cc_ref * expr);
+cc_operand cc_gen_string(cc_gen * self, cc_string * expr);
+cc_operand cc_gen_lvalue(cc_gen * self, cc_expr * expr);
+cc_operand cc_gen_addr(cc_gen * self, cc_expr * expr);
+cc_operand cc_gen_member(cc_gen * self, cc_member * expr);
+cc_operand cc_gen_load(cc_gen * self, cc_operand opd);
+cc_local * cc_gen_local(cc_gen * self, cc_id * id);
+cc_inst * cc_gen_emit(cc_gen * self, int op, cc_operand b, cc_operand a);
+int cc_gen_alloc(cc_gen * self);
+int cc_gen_scratch(cc_gen * self);
+void cc_gen_release(cc_gen * self, cc_operand opd);
+void cc_gen_print(cc_gen * self, FILE * out);
+void cc_gen_assemble(cc_gen * self, cc_asm * out);
+void cc_gen_err(cc_gen * self, int line, char const * msg);
+
+#endif
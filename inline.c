@@ -0,0 +1,1062 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "inline.h"
+#include "check.h"
+#include "lexer.h"
+#include "pgo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Words saved at each call site by removing the JSR and the argument pop */
+#define CC_INLINE_CALL 3
+
+/* Deepest loop nesting that still raises the size limit */
+#define CC_INLINE_DEPTH 3
+
+/* With a profile, runs per call of the caller below which a call isn't
+ * worth any growth, and the runs that count as one level of loop nesting */
+#define CC_INLINE_COLD 0.125
+#define CC_INLINE_TRIPS 8
+
+/* Inlines small functions into their callers.  Runs before the loop passes,
+ * so that inlined code is optimized along with the loop that holds it. */
+void cc_inline_env(cc_opt * opt) {
+    cc_inline * self = calloc(1, sizeof(cc_inline));
+    int i = 0;
+    self->opt = opt;
+    cc_inline_graph(self);
+    self->mark++;
+    for (i = 0; i < self->count; ++i) {
+        cc_inline_visit(self, self->nodes + i);
+    }
+    opt->func = 0;
+    for (i = 0; i < self->count; ++i) {
+        free(self->nodes[i].callees);
+    }
+    free(self->nodes);
+    free(self);
+}
+
+/* Returns the call graph node for the function that 'call' targets, or 0 if
+ * the target isn't a direct reference to a function.  The caller's locals
+ * must be in 'opt->locals', since a local may shadow a function name. */
+static cc_cgnode * cc_inline_callee(cc_inline * self, cc_call * call) {
+    cc_id * id = 0;
+    if (CC_REF != call->expr->node.type) {
+        return 0;
+    }
+    id = ((cc_ref *)call->expr)->id;
+    if (cc_idset_has(&self->opt->locals, id)
+        || cc_env_var(self->opt->env, id)) {
+        return 0;
+    }
+    return cc_inline_node(self, id);
+}
+
+static void cc_inline_graph_block(cc_inline * self, cc_cgnode * node,
+    cc_block * block);
+
+/* Adds call graph edges for the calls in 'expr' */
+static void cc_inline_graph_expr(cc_inline * self, cc_cgnode * node,
+    cc_expr * expr) {
+
+    cc_cgnode * callee = 0;
+    cc_expr * arg = 0;
+    int i = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_inline_graph_expr(self, node, ((cc_member *)expr)->expr);
+        break;
+    case CC_BINARY:
+        cc_inline_graph_expr(self, node, ((cc_binary *)expr)->left);
+        cc_inline_graph_expr(self, node, ((cc_binary *)expr)->right);
+        break;
+    case CC_UNARY:
+        cc_inline_graph_expr(self, node, ((cc_unary *)expr)->expr);
+        break;
+    case CC_CALL:
+        cc_inline_graph_expr(self, node, ((cc_call *)expr)->expr);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            cc_inline_graph_expr(self, node, arg);
+        }
+        if (!(callee = cc_inline_callee(self, (cc_call *)expr))) {
+            break;
+        }
+        callee->sites++;
+        for (i = 0; i < node->count; ++i) {
+            if (node->callees[i] == callee) {
+                return;
+            }
+        }
+        if (node->count >= node->capacity) {
+            node->capacity = node->capacity ? node->capacity * 2 : 4;
+            node->callees = realloc(node->callees,
+                node->capacity * sizeof(cc_cgnode *));
+        }
+        node->callees[node->count++] = callee;
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_inline_graph_stmt(cc_inline * self, cc_cgnode * node,
+    cc_stmt * stmt) {
+
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK:
+            cc_inline_graph_block(self, node, (cc_block *)stmt);
+            break;
+        case CC_IF:
+            cc_inline_graph_expr(self, node, ((cc_if *)stmt)->guard);
+            cc_inline_graph_stmt(self, node, ((cc_if *)stmt)->yes);
+            cc_inline_graph_stmt(self, node, ((cc_if *)stmt)->no);
+            break;
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            cc_inline_graph_expr(self, node, loop->init);
+            cc_inline_graph_expr(self, node, loop->guard);
+            cc_inline_graph_expr(self, node, loop->update);
+            if (loop->block) {
+                cc_inline_graph_block(self, node, loop->block);
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            cc_inline_graph_expr(self, node, ((cc_simple *)stmt)->expr);
+            break;
+        case CC_RETURN:
+            cc_inline_graph_expr(self, node, ((cc_return *)stmt)->expr);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static void cc_inline_graph_block(cc_inline * self, cc_cgnode * node,
+    cc_block * block) {
+
+    cc_var * var = 0;
+    for (var = block->vars; var; var = var->next) {
+        cc_inline_graph_expr(self, node, var->init);
+    }
+    cc_inline_graph_stmt(self, node, block->stmts);
+}
+
+/* Builds the call graph, and marks the functions that are part of a cycle.
+ * Recursive functions are never inlined, since that would not terminate. */
+void cc_inline_graph(cc_inline * self) {
+    cc_func * func = 0;
+    int i = 0;
+    for (func = self->opt->env->funcs; func; func = func->next) {
+        self->count++;
+    }
+    self->nodes = calloc(self->count + 1, sizeof(cc_cgnode));
+    for (func = self->opt->env->funcs; func; func = func->next) {
+        self->nodes[i++].func = func;
+    }
+    for (i = 0; i < self->count; ++i) {
+        cc_cgnode * node = self->nodes + i;
+        if (node->func->block) {
+            cc_opt_scan(self->opt, node->func);
+            cc_inline_graph_block(self, node, node->func->block);
+        }
+        node->form = cc_inline_form(node->func);
+    }
+    for (i = 0; i < self->count; ++i) {
+        cc_cgnode * node = self->nodes + i;
+        int j = 0;
+        self->mark++;
+        for (j = 0; j < node->count; ++j) {
+            if (cc_inline_reaches(self, node->callees[j], node)) {
+                node->recursive = 1;
+                break;
+            }
+        }
+    }
+}
+
+/* Returns the node for the function named 'id', preferring the definition
+ * over any forward declarations. */
+cc_cgnode * cc_inline_node(cc_inline * self, cc_id * id) {
+    cc_cgnode * found = 0;
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        if (self->nodes[i].func->id == id) {
+            found = self->nodes + i;
+            if (found->func->block) {
+                return found;
+            }
+        }
+    }
+    return found;
+}
+
+/* Returns non-zero if 'to' can be reached from 'from'.  Nodes visited during
+ * the walk are marked with 'self->mark'. */
+int cc_inline_reaches(cc_inline * self, cc_cgnode * from, cc_cgnode * to) {
+    int i = 0;
+    if (from == to) {
+        return 1;
+    }
+    if (from->mark == self->mark) {
+        return 0;
+    }
+    from->mark = self->mark;
+    for (i = 0; i < from->count; ++i) {
+        if (cc_inline_reaches(self, from->callees[i], to)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Visits the callees of 'node' before 'node' itself */
+void cc_inline_visit(cc_inline * self, cc_cgnode * node) {
+    int i = 0;
+    if (node->mark == self->mark) {
+        return;
+    }
+    node->mark = self->mark;
+    for (i = 0; i < node->count; ++i) {
+        cc_inline_visit(self, node->callees[i]);
+    }
+    cc_inline_func(self, node);
+}
+
+/* Inlines calls in the body of 'node'.  The function's inline form is
+ * recomputed afterwards, since its body may have changed. */
+void cc_inline_func(cc_inline * self, cc_cgnode * node) {
+    cc_pgofunc * profile = cc_pgo_func(self->opt->env->pgo, node->func);
+    double calls = -1;
+    if (!node->func->block) {
+        return;
+    }
+    if (profile) {
+        calls = cc_pgo_count(self->opt->env->pgo, profile->first);
+    }
+    cc_opt_scan(self->opt, node->func);
+    self->caller = node->func;
+    self->depth = 0;
+    self->runs = calls < 0 ? -1 : calls > 0 ? 1 : 0;
+    cc_inline_stmts(self, &node->func->block->stmts);
+    self->caller = 0;
+    node->form = cc_inline_form(node->func);
+}
+
+/* Inlines calls in the list of statements starting at '*link' */
+void cc_inline_stmts(cc_inline * self, cc_stmt ** link) {
+    while (*link) {
+        cc_stmt * stmt = *link;
+        self->link = link;
+        switch (stmt->node.type) {
+        case CC_BLOCK: {
+            cc_var * var = 0;
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                cc_inline_expr(self, &var->init, 0);
+            }
+            cc_inline_stmts(self, &((cc_block *)stmt)->stmts);
+            break;
+        }
+        case CC_IF: {
+            cc_if * stmt_if = (cc_if *)stmt;
+            double runs = self->runs;
+            double ratio = cc_pgo_ratio(self->opt->env->pgo, stmt_if->site);
+            cc_inline_expr(self, &stmt_if->guard, 1);
+            if (runs >= 0 && ratio >= 0) {
+                self->runs = runs * ratio;
+            }
+            cc_inline_branch(self, &stmt_if->yes);
+            if (runs >= 0 && ratio >= 0) {
+                self->runs = runs * (1 - ratio);
+            }
+            cc_inline_branch(self, &stmt_if->no);
+            self->runs = runs;
+            break;
+        }
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            double runs = self->runs;
+            double ratio = cc_pgo_ratio(self->opt->env->pgo, loop->site);
+            cc_inline_expr(self, &loop->init, 1);
+            self->depth++;
+            if (runs >= 0 && ratio >= 0) {
+                self->runs = runs * ratio;
+            }
+            cc_inline_expr(self, &loop->guard, 0);
+            cc_inline_expr(self, &loop->update, 0);
+            if (loop->block) {
+                cc_inline_stmts(self, &loop->block->stmts);
+            }
+            self->runs = runs;
+            self->depth--;
+            break;
+        }
+        case CC_SIMPLE: {
+            cc_simple * simple = (cc_simple *)stmt;
+            cc_inline_expr(self, &simple->expr,
+                CC_CALL == simple->expr->node.type ? 2 : 1);
+            break;
+        }
+        case CC_RETURN:
+            cc_inline_expr(self, &((cc_return *)stmt)->expr, 1);
+            break;
+        default:
+            break;
+        }
+        link = &stmt->next;
+    }
+}
+
+/* Inlines calls in the statement after an if or else.  The statement is
+ * wrapped in a block, so that inlined code can be inserted in front of it. */
+void cc_inline_branch(cc_inline * self, cc_stmt ** link) {
+    if (*link && CC_BLOCK != (*link)->node.type) {
+        cc_block * block = cc_block_init((*link)->node.line);
+        block->stmts = *link;
+        *link = (cc_stmt *)block;
+    }
+    cc_inline_stmts(self, link);
+}
+
+/* Inlines calls in the expression at '*slot'.  Calls are handled after
+ * their arguments.  A block-form callee can only be inlined if 'hoist' is
+ * set, meaning the call may be moved in front of the statement that holds
+ * it; that isn't the case for code that runs conditionally or repeatedly.
+ * 'hoist' is 2 if the value of the expression isn't used. */
+void cc_inline_expr(cc_inline * self, cc_expr ** slot, int hoist) {
+    cc_expr * expr = *slot;
+    cc_cgnode * node = 0;
+    cc_expr * value = 0;
+    cc_expr ** arg = 0;
+    int form = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_inline_expr(self, &((cc_member *)expr)->expr, !!hoist);
+        return;
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        int op = binary->op;
+        cc_inline_expr(self, &binary->left, !!hoist);
+        cc_inline_expr(self, &binary->right, (CC_TOK_AND == op
+            || CC_TOK_OR == op || ',' == op) ? 0 : !!hoist);
+        return;
+    }
+    case CC_UNARY:
+        cc_inline_expr(self, &((cc_unary *)expr)->expr, !!hoist);
+        return;
+    case CC_CALL:
+        break;
+    default:
+        return;
+    }
+
+    cc_inline_expr(self, &((cc_call *)expr)->expr, !!hoist);
+    for (arg = &((cc_call *)expr)->args; *arg; arg = &(*arg)->next) {
+        cc_inline_expr(self, arg, !!hoist);
+    }
+    node = cc_inline_callee(self, (cc_call *)expr);
+    if (!node || node->recursive || !node->form
+        || !cc_inline_arity(node->func, (cc_call *)expr)) {
+        return;
+    }
+    form = node->form;
+    if (CC_INLINE_BLOCK == form && !hoist) {
+        return;
+    }
+    if (cc_inline_captures(self, node->func)
+        || !cc_inline_profitable(self, node, form)) {
+        return;
+    }
+    if (CC_INLINE_EXPR == form) {
+        value = cc_inline_subst(self, node->func, (cc_call *)expr);
+    } else {
+        value = cc_inline_block(self, node->func, (cc_call *)expr,
+            2 != hoist);
+    }
+    if (!value) {
+        value = (cc_expr *)cc_number_init(expr->node.line, 0);
+        value->type = expr->type;
+    }
+    value->next = expr->next;
+    *slot = value;
+    self->opt->inlined++;
+}
+
+static void cc_inline_names_expr(cc_expr * expr, cc_idset * refs) {
+    cc_expr * arg = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_inline_names_expr(((cc_member *)expr)->expr, refs);
+        break;
+    case CC_BINARY:
+        cc_inline_names_expr(((cc_binary *)expr)->left, refs);
+        cc_inline_names_expr(((cc_binary *)expr)->right, refs);
+        break;
+    case CC_UNARY:
+        cc_inline_names_expr(((cc_unary *)expr)->expr, refs);
+        break;
+    case CC_CALL:
+        cc_inline_names_expr(((cc_call *)expr)->expr, refs);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            cc_inline_names_expr(arg, refs);
+        }
+        break;
+    case CC_REF:
+        if (!cc_idset_has(refs, ((cc_ref *)expr)->id)) {
+            cc_idset_add(refs, ((cc_ref *)expr)->id);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Collects the names referenced in a list of statements into 'refs', and
+ * the variables declared into 'vars'.  Returns the number of variables that
+ * were declared more than once. */
+static int cc_inline_names_stmt(cc_stmt * stmt, cc_idset * refs,
+    cc_idset * vars) {
+
+    int dups = 0;
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK: {
+            cc_var * var = 0;
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                dups += cc_idset_has(vars, var->id);
+                cc_idset_add(vars, var->id);
+                cc_inline_names_expr(var->init, refs);
+            }
+            dups += cc_inline_names_stmt(((cc_block *)stmt)->stmts, refs,
+                vars);
+            break;
+        }
+        case CC_IF:
+            cc_inline_names_expr(((cc_if *)stmt)->guard, refs);
+            dups += cc_inline_names_stmt(((cc_if *)stmt)->yes, refs, vars);
+            dups += cc_inline_names_stmt(((cc_if *)stmt)->no, refs, vars);
+            break;
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            cc_inline_names_expr(loop->init, refs);
+            cc_inline_names_expr(loop->guard, refs);
+            cc_inline_names_expr(loop->update, refs);
+            if (loop->block) {
+                dups += cc_inline_names_stmt((cc_stmt *)loop->block, refs,
+                    vars);
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            cc_inline_names_expr(((cc_simple *)stmt)->expr, refs);
+            break;
+        case CC_RETURN:
+            cc_inline_names_expr(((cc_return *)stmt)->expr, refs);
+            break;
+        default:
+            break;
+        }
+    }
+    return dups;
+}
+
+/* Returns the number of return statements in a list of statements */
+static int cc_inline_returns(cc_stmt * stmt) {
+    int count = 0;
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK:
+            count += cc_inline_returns(((cc_block *)stmt)->stmts);
+            break;
+        case CC_IF:
+            count += cc_inline_returns(((cc_if *)stmt)->yes);
+            count += cc_inline_returns(((cc_if *)stmt)->no);
+            break;
+        case CC_FOR:
+        case CC_WHILE:
+            if (((cc_loop *)stmt)->block) {
+                count += cc_inline_returns(((cc_loop *)stmt)->block->stmts);
+            }
+            break;
+        case CC_RETURN:
+            count++;
+            break;
+        default:
+            break;
+        }
+    }
+    return count;
+}
+
+static void cc_inline_rename_expr(cc_expr * expr, cc_idset * from,
+    cc_idset * to) {
+
+    cc_expr * arg = 0;
+    int i = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_inline_rename_expr(((cc_member *)expr)->expr, from, to);
+        break;
+    case CC_BINARY:
+        cc_inline_rename_expr(((cc_binary *)expr)->left, from, to);
+        cc_inline_rename_expr(((cc_binary *)expr)->right, from, to);
+        break;
+    case CC_UNARY:
+        cc_inline_rename_expr(((cc_unary *)expr)->expr, from, to);
+        break;
+    case CC_CALL:
+        cc_inline_rename_expr(((cc_call *)expr)->expr, from, to);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            cc_inline_rename_expr(arg, from, to);
+        }
+        break;
+    case CC_REF:
+        for (i = 0; i < from->count; ++i) {
+            if (from->ids[i] == ((cc_ref *)expr)->id) {
+                ((cc_ref *)expr)->id = to->ids[i];
+                break;
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Replaces references to the names in 'from' with the matching names in
+ * 'to', in a list of statements */
+static void cc_inline_rename_stmt(cc_stmt * stmt, cc_idset * from,
+    cc_idset * to) {
+
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK: {
+            cc_var * var = 0;
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                cc_inline_rename_expr(var->init, from, to);
+            }
+            cc_inline_rename_stmt(((cc_block *)stmt)->stmts, from, to);
+            break;
+        }
+        case CC_IF:
+            cc_inline_rename_expr(((cc_if *)stmt)->guard, from, to);
+            cc_inline_rename_stmt(((cc_if *)stmt)->yes, from, to);
+            cc_inline_rename_stmt(((cc_if *)stmt)->no, from, to);
+            break;
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            cc_inline_rename_expr(loop->init, from, to);
+            cc_inline_rename_expr(loop->guard, from, to);
+            cc_inline_rename_expr(loop->update, from, to);
+            if (loop->block) {
+                cc_inline_rename_stmt((cc_stmt *)loop->block, from, to);
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            cc_inline_rename_expr(((cc_simple *)stmt)->expr, from, to);
+            break;
+        case CC_RETURN:
+            cc_inline_rename_expr(((cc_return *)stmt)->expr, from, to);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Returns non-zero if 'expr' assigns 'id' or takes its address */
+static int cc_inline_writes(cc_expr * expr, cc_id * id) {
+    cc_expr * arg = 0;
+    if (!expr) {
+        return 0;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        return cc_inline_writes(((cc_member *)expr)->expr, id);
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        if ('=' == binary->op && CC_REF == binary->left->node.type
+            && id == ((cc_ref *)binary->left)->id) {
+            return 1;
+        }
+        return cc_inline_writes(binary->left, id)
+            || cc_inline_writes(binary->right, id);
+    }
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        if ('&' == unary->op && CC_REF == unary->expr->node.type
+            && id == ((cc_ref *)unary->expr)->id) {
+            return 1;
+        }
+        return cc_inline_writes(unary->expr, id);
+    }
+    case CC_CALL:
+        if (cc_inline_writes(((cc_call *)expr)->expr, id)) {
+            return 1;
+        }
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            if (cc_inline_writes(arg, id)) {
+                return 1;
+            }
+        }
+        return 0;
+    default:
+        return 0;
+    }
+}
+
+/* Replaces each reference to 'id' in the expression at '*slot' with a copy
+ * of 'value' */
+static void cc_inline_replace(cc_expr ** slot, cc_id * id, cc_expr * value) {
+    cc_expr * expr = *slot;
+    cc_expr ** arg = 0;
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_inline_replace(&((cc_member *)expr)->expr, id, value);
+        break;
+    case CC_BINARY:
+        cc_inline_replace(&((cc_binary *)expr)->left, id, value);
+        cc_inline_replace(&((cc_binary *)expr)->right, id, value);
+        break;
+    case CC_UNARY:
+        cc_inline_replace(&((cc_unary *)expr)->expr, id, value);
+        break;
+    case CC_CALL:
+        cc_inline_replace(&((cc_call *)expr)->expr, id, value);
+        for (arg = &((cc_call *)expr)->args; *arg; arg = &(*arg)->next) {
+            cc_inline_replace(arg, id, value);
+        }
+        break;
+    case CC_REF:
+        if (id == ((cc_ref *)expr)->id) {
+            cc_expr * copy = cc_expr_copy(value);
+            copy->next = expr->next;
+            *slot = copy;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* Returns non-zero if a list of statements assigns 'id' or takes its
+ * address */
+static int cc_inline_writes_stmt(cc_stmt * stmt, cc_id * id) {
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK: {
+            cc_var * var = 0;
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                if (cc_inline_writes(var->init, id)) {
+                    return 1;
+                }
+            }
+            if (cc_inline_writes_stmt(((cc_block *)stmt)->stmts, id)) {
+                return 1;
+            }
+            break;
+        }
+        case CC_IF:
+            if (cc_inline_writes(((cc_if *)stmt)->guard, id)
+                || cc_inline_writes_stmt(((cc_if *)stmt)->yes, id)
+                || cc_inline_writes_stmt(((cc_if *)stmt)->no, id)) {
+                return 1;
+            }
+            break;
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            if (cc_inline_writes(loop->init, id)
+                || cc_inline_writes(loop->guard, id)
+                || cc_inline_writes(loop->update, id)
+                || (loop->block && cc_inline_writes_stmt(
+                    (cc_stmt *)loop->block, id))) {
+                return 1;
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            if (cc_inline_writes(((cc_simple *)stmt)->expr, id)) {
+                return 1;
+            }
+            break;
+        case CC_RETURN:
+            if (cc_inline_writes(((cc_return *)stmt)->expr, id)) {
+                return 1;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return 0;
+}
+
+/* Replaces each reference to 'id' in a list of statements with a copy of
+ * 'value' */
+static void cc_inline_replace_stmt(cc_stmt * stmt, cc_id * id,
+    cc_expr * value) {
+
+    for (; stmt; stmt = stmt->next) {
+        switch (stmt->node.type) {
+        case CC_BLOCK: {
+            cc_var * var = 0;
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                cc_inline_replace(&var->init, id, value);
+            }
+            cc_inline_replace_stmt(((cc_block *)stmt)->stmts, id, value);
+            break;
+        }
+        case CC_IF:
+            cc_inline_replace(&((cc_if *)stmt)->guard, id, value);
+            cc_inline_replace_stmt(((cc_if *)stmt)->yes, id, value);
+            cc_inline_replace_stmt(((cc_if *)stmt)->no, id, value);
+            break;
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            cc_inline_replace(&loop->init, id, value);
+            cc_inline_replace(&loop->guard, id, value);
+            cc_inline_replace(&loop->update, id, value);
+            if (loop->block) {
+                cc_inline_replace_stmt((cc_stmt *)loop->block, id, value);
+            }
+            break;
+        }
+        case CC_SIMPLE:
+            cc_inline_replace(&((cc_simple *)stmt)->expr, id, value);
+            break;
+        case CC_RETURN:
+            cc_inline_replace(&((cc_return *)stmt)->expr, id, value);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Returns non-zero if 'arg' can be substituted for 'formal', which the
+ * callee never writes.  That is the case for constants, for the address of
+ * a variable, and for locals of the caller that the callee can't reach
+ * through a pointer, if they have the formal's type; otherwise the
+ * argument must be converted by assigning it to a temporary.  The name
+ * mustn't be one of the callee's 'names', which are replaced or renamed
+ * after the substitution. */
+static int cc_inline_direct(cc_inline * self, cc_formal * formal,
+    cc_expr * arg, cc_idset * names) {
+    int value = 0;
+    if (!cc_type_equal(arg->type, formal->type)) {
+        return 0;
+    }
+    if (cc_expr_const(arg, &value)) {
+        return 1;
+    }
+    if (CC_UNARY == arg->node.type && '&' == ((cc_unary *)arg)->op
+        && CC_REF == ((cc_unary *)arg)->expr->node.type) {
+        return !cc_idset_has(names, ((cc_ref *)((cc_unary *)arg)->expr)->id);
+    }
+    return CC_REF == arg->node.type
+        && cc_idset_has(&self->opt->locals, ((cc_ref *)arg)->id)
+        && !cc_idset_has(&self->opt->addressed, ((cc_ref *)arg)->id)
+        && !cc_idset_has(names, ((cc_ref *)arg)->id);
+}
+
+/* Collects the names of the formals and variables of 'func' */
+static void cc_inline_declared(cc_func * func, cc_idset * names) {
+    cc_idset refs = { 0, 0, 0 };
+    cc_formal * formal = 0;
+    for (formal = func->formals; formal; formal = formal->next) {
+        cc_idset_add(names, formal->id);
+    }
+    cc_inline_names_stmt((cc_stmt *)func->block, &refs, names);
+    free(refs.ids);
+}
+
+/* Returns the form in which calls to 'func' can be inlined.  Variable names
+ * must be unique within the function, since the inlined copy renames them
+ * without regard to scope. */
+int cc_inline_form(cc_func * func) {
+    cc_idset refs = { 0, 0, 0 };
+    cc_idset vars = { 0, 0, 0 };
+    cc_formal * formal = 0;
+    cc_stmt * stmt = 0;
+    cc_stmt * last = 0;
+    int dups = 0;
+    int returns = 0;
+    int form = CC_INLINE_NONE;
+
+    if (!func->block) {
+        return CC_INLINE_NONE;
+    }
+    for (formal = func->formals; formal; formal = formal->next) {
+        dups += cc_idset_has(&vars, formal->id);
+        cc_idset_add(&vars, formal->id);
+    }
+    dups += cc_inline_names_stmt((cc_stmt *)func->block, &refs, &vars);
+    returns = cc_inline_returns(func->block->stmts);
+    for (stmt = func->block->stmts; stmt; stmt = stmt->next) {
+        last = stmt;
+    }
+    if (dups) {
+        form = CC_INLINE_NONE;
+    } else if (!func->block->vars && last && last == func->block->stmts
+        && CC_RETURN == last->node.type && ((cc_return *)last)->expr) {
+        form = CC_INLINE_EXPR;
+    } else if (!returns || (1 == returns && CC_RETURN == last->node.type)) {
+        form = CC_INLINE_BLOCK;
+    }
+    free(refs.ids);
+    free(vars.ids);
+    return form;
+}
+
+/* Returns non-zero if 'call' passes one argument per formal of 'func' */
+int cc_inline_arity(cc_func * func, cc_call * call) {
+    cc_formal * formal = func->formals;
+    cc_expr * arg = call->args;
+    while (formal && arg) {
+        formal = formal->next;
+        arg = arg->next;
+    }
+    return !formal && !arg;
+}
+
+/* Returns non-zero if a name that 'func' uses from the global scope is
+ * shadowed by a local of the caller */
+int cc_inline_captures(cc_inline * self, cc_func * func) {
+    cc_idset refs = { 0, 0, 0 };
+    cc_idset vars = { 0, 0, 0 };
+    cc_formal * formal = 0;
+    int captures = 0;
+    int i = 0;
+    for (formal = func->formals; formal; formal = formal->next) {
+        cc_idset_add(&vars, formal->id);
+    }
+    cc_inline_names_stmt((cc_stmt *)func->block, &refs, &vars);
+    for (i = 0; i < refs.count; ++i) {
+        if (!cc_idset_has(&vars, refs.ids[i])
+            && cc_idset_has(&self->opt->locals, refs.ids[i])) {
+            captures = 1;
+        }
+    }
+    free(refs.ids);
+    free(vars.ids);
+    return captures;
+}
+
+/* Decides whether to inline a call to 'node' at the current call site.  A
+ * call that doesn't grow the program is always inlined.  Otherwise, the
+ * callee must fit in a size limit that grows with the loop depth of the
+ * call site, since a call in a loop runs more often, and the growth is
+ * taken from the optimizer's code-size budget.  A function called from one
+ * place may use the whole budget.  With a profile, a call that ran often
+ * is treated as nested deeper than its loops, and a call that rarely ran
+ * isn't worth any growth. */
+int cc_inline_profitable(cc_inline * self, cc_cgnode * node, int form) {
+    cc_opt * opt = self->opt;
+    cc_cost cost = { 0, 0 };
+    int depth = self->depth < CC_INLINE_DEPTH ? self->depth : CC_INLINE_DEPTH;
+    int hot = 0;
+    int growth = 0;
+    int limit = 0;
+    double runs = self->runs;
+
+    for (; runs >= CC_INLINE_TRIPS && hot < CC_INLINE_DEPTH;
+        runs /= CC_INLINE_TRIPS) {
+        hot++;
+    }
+    depth = hot > depth ? hot : depth;
+    limit = opt->inline_size * (1 + depth);
+
+    cc_opt_block_cost(node->func->block, &cost);
+    growth = cost.words - CC_INLINE_CALL;
+    if (CC_INLINE_EXPR == form) {
+        growth -= 2; /* No jump to the epilogue */
+    }
+    if (growth <= 0) {
+        return 1;
+    }
+    if (self->runs >= 0 && self->runs < CC_INLINE_COLD) {
+        return 0;
+    }
+    if (1 == node->sites) {
+        limit = opt->budget;
+    }
+    if (growth > limit || growth > opt->budget) {
+        return 0;
+    }
+    opt->budget -= growth;
+    return 1;
+}
+
+/* Returns an expression that computes 'call' by substituting the arguments
+ * into the callee's return expression.  Arguments that are constants or
+ * unaliased locals of the caller are substituted directly; the rest are
+ * evaluated in order into temporaries first. */
+cc_expr * cc_inline_subst(cc_inline * self, cc_func * callee, cc_call * call) {
+    cc_expr * body = cc_expr_copy(((cc_return *)callee->block->stmts)->expr);
+    cc_expr * assigns[16];
+    cc_idset names = { 0, 0, 0 };
+    cc_formal * formal = 0;
+    cc_expr * arg = call->args;
+    cc_expr * next = 0;
+    int line = call->node.node.line;
+    int count = 0;
+
+    cc_inline_declared(callee, &names);
+    for (formal = callee->formals; formal; formal = formal->next, arg = next) {
+        next = arg->next;
+        arg->next = 0;
+        if (!cc_inline_writes(body, formal->id)
+            && cc_inline_direct(self, formal, arg, &names)) {
+            cc_inline_replace(&body, formal->id, arg);
+        } else if (count < sizeof(assigns)/sizeof(assigns[0])) {
+            cc_var * temp = cc_opt_temp(self->opt, line, formal->type);
+            cc_ref * ref = cc_ref_init(line, temp->id);
+            ref->node.type = temp->type;
+            cc_inline_replace(&body, formal->id, (cc_expr *)ref);
+            ref = cc_ref_init(line, temp->id);
+            ref->node.type = temp->type;
+            assigns[count++] = (cc_expr *)cc_binary_init(line, '=',
+                (cc_expr *)ref, arg);
+        } else {
+            free(names.ids);
+            return 0;
+        }
+    }
+    free(names.ids);
+    while (count-- > 0) {
+        cc_binary * comma = cc_binary_init(line, ',', assigns[count], body);
+        comma->node.type = body->type;
+        body = (cc_expr *)comma;
+    }
+    return body;
+}
+
+/* Inserts a copy of the callee's body in front of the statement that holds
+ * 'call', and returns an expression for the result, or 0 if the result isn't
+ * 'used'.  The formals become variables of the copied block, initialized
+ * with the arguments, unless an argument can be substituted directly.  All
+ * of the callee's variables are renamed, so that they can't capture names
+ * used in the arguments. */
+cc_expr * cc_inline_block(cc_inline * self, cc_func * callee, cc_call * call,
+    int used) {
+
+    cc_block * block = cc_block_copy(callee->block);
+    cc_idset from = { 0, 0, 0 };
+    cc_idset to = { 0, 0, 0 };
+    cc_idset names = { 0, 0, 0 };
+    cc_formal * formal = 0;
+    cc_expr * arg = call->args;
+    cc_expr * next = 0;
+    cc_var * formals = 0;
+    cc_var ** tail = &formals;
+    cc_var * var = 0;
+    cc_stmt ** last = 0;
+    cc_expr * result = 0;
+    int line = call->node.node.line;
+    char buf[16];
+
+    cc_inline_declared(callee, &names);
+    for (formal = callee->formals; formal; formal = formal->next, arg = next) {
+        next = arg->next;
+        arg->next = 0;
+        if (!cc_inline_writes_stmt((cc_stmt *)block, formal->id)
+            && cc_inline_direct(self, formal, arg, &names)) {
+            cc_inline_replace_stmt((cc_stmt *)block, formal->id, arg);
+            continue;
+        }
+        sprintf(buf, "$t%d", self->opt->temps++);
+        *tail = cc_var_init(line, formal->type, cc_env_id(self->opt->env, buf));
+        (*tail)->init = arg;
+        cc_idset_add(&from, formal->id);
+        cc_idset_add(&to, (*tail)->id);
+        cc_idset_add(&self->opt->locals, (*tail)->id);
+        tail = &(*tail)->next;
+    }
+    for (var = block->vars; var; var = var->next) {
+        sprintf(buf, "$t%d", self->opt->temps++);
+        cc_idset_add(&from, var->id);
+        var->id = cc_env_id(self->opt->env, buf);
+        cc_idset_add(&to, var->id);
+        cc_idset_add(&self->opt->locals, var->id);
+    }
+    /* The arguments are evaluated before the callee's own variables */
+    *tail = block->vars;
+    block->vars = formals;
+    for (var = *tail; var; var = var->next) {
+        cc_inline_rename_expr(var->init, &from, &to);
+    }
+    cc_inline_rename_stmt(block->stmts, &from, &to);
+
+    for (last = &block->stmts; *last && (*last)->next; last = &(*last)->next) {
+    }
+    if (*last && CC_RETURN == (*last)->node.type) {
+        cc_return * ret = (cc_return *)*last;
+        *last = 0;
+        if (ret->expr && used) {
+            cc_var * temp = cc_opt_temp(self->opt, line, callee->type);
+            cc_ref * ref = cc_ref_init(line, temp->id);
+            ref->node.type = temp->type;
+            *last = (cc_stmt *)cc_simple_init(line, (cc_expr *)cc_binary_init(
+                line, '=', (cc_expr *)ref, ret->expr));
+            ref = cc_ref_init(line, temp->id);
+            ref->node.type = temp->type;
+            result = (cc_expr *)ref;
+        } else if (ret->expr) {
+            *last = (cc_stmt *)cc_simple_init(line, ret->expr);
+        }
+    }
+    block->node.node.line = line;
+    block->node.next = *self->link;
+    *self->link = (cc_stmt *)block;
+    self->link = &block->node.next;
+    free(from.ids);
+    free(to.ids);
+    free(names.ids);
+    return result;
+}
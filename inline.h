@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_INLINE_H
+#define CC_INLINE_H
+
+#include "opt.h"
+
+/* How a function body can be substituted for a call */
+#define CC_INLINE_NONE 0
+#define CC_INLINE_EXPR 1 /* Body is 'return expr;': inlined in place */
+#define CC_INLINE_BLOCK 2 /* Body ends in its only return: inlined as a block
+                           * before the statement holding the call */
+
+/* Call graph node.  Edges come from calls whose target is a direct
+ * reference to a function. */
+typedef struct cc_cgnode {
+    cc_func * func;
+    struct cc_cgnode ** callees;
+    int count;
+    int capacity;
+    int sites; /* Number of calls to the function in the program */
+    int recursive; /* The function is part of a cycle in the call graph */
+    int mark; /* Used by graph walks */
+    int form; /* CC_INLINE_* */
+} cc_cgnode;
+
+/* Inliner state.  Functions are visited bottom-up in the call graph, so a
+ * callee has already had its own calls inlined when it is considered. */
+typedef struct cc_inline {
+    cc_opt * opt;
+    cc_cgnode * nodes;
+    int count;
+    int mark;
+    cc_func * caller;
+    cc_stmt ** link; /* Inlined blocks are inserted here */
+    int depth; /* Loop nesting depth of the call site */
+    double runs; /* Runs of the call site per call of 'caller' according
+                  * to the profile, or -1 */
+} cc_inline;
+
+void cc_inline_env(cc_opt * opt);
+void cc_inline_graph(cc_inline * self);
+cc_cgnode * cc_inline_node(cc_inline * self, cc_id * id);
+int cc_inline_reaches(cc_inline * self, cc_cgnode * from, cc_cgnode * to);
+void cc_inline_visit(cc_inline * self, cc_cgnode * node);
+void cc_inline_func(cc_inline * self, cc_cgnode * node);
+void cc_inline_stmts(cc_inline * self, cc_stmt ** link);
+void cc_inline_branch(cc_inline * self, cc_stmt ** link);
+void cc_inline_expr(cc_inline * self, cc_expr ** slot, int hoist);
+int cc_inline_form(cc_func * func);
+int cc_inline_arity(cc_func * func, cc_call * call);
+int cc_inline_captures(cc_inline * self, cc_func * func);
+int cc_inline_profitable(cc_inline * self, cc_cgnode * node, int form);
+cc_expr * cc_inline_subst(cc_inline * self, cc_func * callee, cc_call * call);
+cc_expr * cc_inline_block(cc_inline * self, cc_func * callee, cc_call * call,
+    int used);
+
+#endif
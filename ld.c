@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "ld.h"
+#include "dcpu.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CC_LD_SECTION(obj, i, field) \
+    CC_OBJ_WORD((obj)->sections, (i) * CC_OBJ_SECTION + (field))
+#define CC_LD_SYMBOL(obj, i, field) \
+    CC_OBJ_WORD((obj)->symbols, (i) * CC_OBJ_SYMBOL + (field))
+#define CC_LD_RELOC(obj, i, field) \
+    CC_OBJ_WORD((obj)->relocs, (i) * CC_OBJ_RELOC + (field))
+
+cc_ld * cc_ld_init() {
+    cc_ld * self = calloc(1, sizeof(cc_ld));
+    self->capacity = 1024;
+    self->table = calloc(self->capacity, sizeof(cc_ldsym));
+    self->entry = -1;
+    return self;
+}
+
+static unsigned cc_ld_hash(char const * name) {
+    unsigned hash = 2166136261u;
+    while (*name) {
+        hash = (hash ^ (unsigned char)*name++) * 16777619u;
+    }
+    return hash;
+}
+
+/* Returns the slot for 'name': the one that holds it, or the empty slot
+ * where it belongs */
+static cc_ldsym * cc_ld_slot(cc_ld * self, char const * name) {
+    unsigned mask = self->capacity - 1;
+    unsigned i = cc_ld_hash(name) & mask;
+    while (self->table[i].name && strcmp(self->table[i].name, name)) {
+        i = (i + 1) & mask;
+    }
+    return self->table + i;
+}
+
+cc_ldsym * cc_ld_find(cc_ld * self, char const * name) {
+    cc_ldsym * sym = cc_ld_slot(self, name);
+    return sym->name ? sym : 0;
+}
+
+/* Returns the size of section 'section' of object 'obj' */
+static int cc_ld_size(cc_ld * self, int obj, int section) {
+    return CC_LD_SECTION(self->objs[obj], section, 1);
+}
+
+/* Adds a global symbol, keeping the table at most half full.  Of two
+ * definitions of a name, a tentative one gives way to the other, or to the
+ * larger if both are tentative; the losing section is stripped. */
+static void cc_ld_define(cc_ld * self, char const * name, int obj,
+    int section, int value, int common) {
+
+    cc_ldsym * sym = 0;
+    if (2 * (self->count + 1) > self->capacity) {
+        cc_ldsym * old = self->table;
+        int capacity = self->capacity;
+        int i = 0;
+        self->capacity *= 2;
+        self->table = calloc(self->capacity, sizeof(cc_ldsym));
+        for (i = 0; i < capacity; ++i) {
+            if (old[i].name) {
+                *cc_ld_slot(self, old[i].name) = old[i];
+            }
+        }
+        free(old);
+    }
+    sym = cc_ld_slot(self, name);
+    if (sym->name && (common || sym->common)) {
+        if (common && (!sym->common || cc_ld_size(self, sym->obj,
+            sym->section) >= cc_ld_size(self, obj, section))) {
+            self->addrs[obj][section] = -1;
+            return;
+        }
+        self->addrs[sym->obj][sym->section] = -1;
+        sym->obj = obj;
+        sym->section = section;
+        sym->value = value;
+        sym->common = common;
+        return;
+    }
+    if (sym->name) {
+        fprintf(stderr, "Duplicate symbol '%s' in %s and %s\n", name,
+            sym->obj < 0 ? "the linker" : self->objs[sym->obj]->path,
+            obj < 0 ? "the linker" : self->objs[obj]->path);
+        self->errors++;
+        return;
+    }
+    sym->name = name;
+    sym->obj = obj;
+    sym->section = section;
+    sym->value = value;
+    sym->common = common;
+    self->count++;
+}
+
+/* Maps the object at 'path', and enters its global symbols */
+void cc_ld_add(cc_ld * self, char const * path) {
+    cc_obj * obj = cc_obj_open(path);
+    int index = self->nobjs;
+    int i = 0;
+    if (!obj) {
+        self->errors++;
+        return;
+    }
+    if (self->nobjs >= self->capobjs) {
+        self->capobjs = self->capobjs ? self->capobjs * 2 : 64;
+        self->objs = realloc(self->objs, self->capobjs * sizeof(cc_obj *));
+        self->addrs = realloc(self->addrs, self->capobjs * sizeof(int *));
+    }
+    self->objs[self->nobjs++] = obj;
+    self->addrs[index] = calloc(obj->nsections + 1, sizeof(int));
+    self->sections += obj->nsections;
+
+    for (i = 0; i < obj->nsections; ++i) {
+        if (CC_LD_SECTION(obj, i, 0) & CC_OBJ_ENTRY) {
+            if (self->entry >= 0) {
+                fprintf(stderr, "Startup code in both %s and %s\n",
+                    self->objs[self->entry]->path, path);
+                self->errors++;
+            }
+            self->entry = index;
+            self->entry_section = i;
+        }
+    }
+    for (i = 0; i < obj->nsymbols; ++i) {
+        int section = CC_LD_SYMBOL(obj, i, 1);
+        if (CC_OBJ_UNDEF != section
+            && (CC_LD_SYMBOL(obj, i, 3) & CC_OBJ_GLOBAL)) {
+            cc_ld_define(self, obj->names + CC_LD_SYMBOL(obj, i, 0), index,
+                section, CC_LD_SYMBOL(obj, i, 2),
+                !!(CC_LD_SECTION(obj, section, 0) & CC_OBJ_COMMON));
+        }
+    }
+}
+
+/* Finds the definition of symbol 'i' of object 'obj': the object's own, if
+ * it has one that isn't tentative, or else the global one.  Returns 0 if
+ * there is none. */
+static int cc_ld_resolve(cc_ld * self, int obj, int i, cc_ldsym * out) {
+    cc_obj * o = self->objs[obj];
+    int section = CC_LD_SYMBOL(o, i, 1);
+    cc_ldsym * sym = 0;
+    if (CC_OBJ_UNDEF != section && (!(CC_LD_SECTION(o, section, 0)
+        & CC_OBJ_COMMON) || !(CC_LD_SYMBOL(o, i, 3) & CC_OBJ_GLOBAL))) {
+        out->obj = obj;
+        out->section = section;
+        out->value = CC_LD_SYMBOL(o, i, 2);
+        return 1;
+    }
+    sym = cc_ld_find(self, o->names + CC_LD_SYMBOL(o, i, 0));
+    if (!sym) {
+        return 0;
+    }
+    *out = *sym;
+    return 1;
+}
+
+/* Keeps only the sections reachable from the startup code through
+ * relocations, by marking them from a worklist */
+void cc_ld_mark(cc_ld * self) {
+    int * work = calloc(2 * self->sections + 2, sizeof(int));
+    int count = 0;
+    int i = 0;
+    int k = 0;
+
+    for (i = 0; i < self->nobjs; ++i) {
+        for (k = 0; k < self->objs[i]->nsections; ++k) {
+            self->addrs[i][k] = -1;
+        }
+    }
+    if (self->entry >= 0) {
+        self->addrs[self->entry][self->entry_section] = 0;
+        work[count++] = self->entry;
+        work[count++] = self->entry_section;
+    }
+    while (count > 0) {
+        int section = work[--count];
+        int obj = work[--count];
+        cc_obj * o = self->objs[obj];
+        int first = CC_LD_SECTION(o, section, 3);
+        int end = first + CC_LD_SECTION(o, section, 4);
+        for (k = first; k < end; ++k) {
+            cc_ldsym target;
+            if (cc_ld_resolve(self, obj, CC_LD_RELOC(o, k, 1), &target)
+                && target.obj >= 0
+                && self->addrs[target.obj][target.section] < 0) {
+                self->addrs[target.obj][target.section] = 0;
+                work[count++] = target.obj;
+                work[count++] = target.section;
+            }
+        }
+    }
+    free(work);
+}
+
+/* Assigns addresses to the sections of kind 'kind', in input order */
+static void cc_ld_place(cc_ld * self, int kind) {
+    int i = 0;
+    int k = 0;
+    for (i = 0; i < self->nobjs; ++i) {
+        cc_obj * obj = self->objs[i];
+        for (k = 0; k < obj->nsections; ++k) {
+            int flags = CC_LD_SECTION(obj, k, 0);
+            if ((flags & CC_OBJ_KIND) != kind || (flags & CC_OBJ_ENTRY)
+                || self->addrs[i][k] < 0) {
+                continue;
+            }
+            if (CC_OBJ_BSS == kind) {
+                self->addrs[i][k] = self->image + self->bss;
+                self->bss += CC_LD_SECTION(obj, k, 1);
+            } else {
+                self->addrs[i][k] = self->image;
+                self->image += CC_LD_SECTION(obj, k, 1);
+            }
+            self->kept++;
+        }
+    }
+}
+
+/* Lays out the kept sections, with the startup code at address 0, and
+ * defines $bss and $end around the BSS region */
+void cc_ld_layout(cc_ld * self) {
+    if (self->entry < 0) {
+        fprintf(stderr, "No startup code (main is not defined)\n");
+        self->errors++;
+        return;
+    }
+    self->addrs[self->entry][self->entry_section] = 0;
+    self->image = CC_LD_SECTION(self->objs[self->entry], self->entry_section,
+        1);
+    self->kept++;
+    cc_ld_place(self, CC_OBJ_CODE);
+    cc_ld_place(self, CC_OBJ_DATA);
+    cc_ld_place(self, CC_OBJ_BSS);
+    if (self->image + self->bss > CC_DCPU_WORDS) {
+        fprintf(stderr, "Program is larger than 64K words\n");
+        self->errors++;
+    }
+    cc_ld_define(self, "$bss", -1, 0, self->image, 0);
+    cc_ld_define(self, "$end", -1, 0, self->image + self->bss, 0);
+}
+
+/* Copies every kept section into the image and applies its relocations.
+ * Each object's symbols are resolved once, before its sections. */
+void cc_ld_relocate(cc_ld * self) {
+    int i = 0;
+    int k = 0;
+    int r = 0;
+    self->words = calloc(self->image + 1, sizeof(unsigned short));
+    for (i = 0; i < self->nobjs; ++i) {
+        cc_obj * obj = self->objs[i];
+        int * addrs = self->addrs[i];
+        int * syms = malloc((obj->nsymbols + 1) * sizeof(int));
+        for (k = 0; k < obj->nsymbols; ++k) {
+            cc_ldsym sym;
+            if (!cc_ld_resolve(self, i, k, &sym)) {
+                syms[k] = -1;
+            } else if (sym.obj < 0) {
+                syms[k] = sym.value;
+            } else {
+                syms[k] = self->addrs[sym.obj][sym.section] + sym.value;
+            }
+        }
+        for (k = 0; k < obj->nsections; ++k) {
+            int kind = CC_LD_SECTION(obj, k, 0) & CC_OBJ_KIND;
+            int size = CC_LD_SECTION(obj, k, 1);
+            int payload = CC_LD_SECTION(obj, k, 2);
+            int first = CC_LD_SECTION(obj, k, 3);
+            int end = first + CC_LD_SECTION(obj, k, 4);
+            unsigned short * words = self->words + addrs[k];
+            if (addrs[k] < 0 || CC_OBJ_BSS == kind) {
+                continue;
+            }
+            for (r = 0; r < size; ++r) {
+                words[r] = CC_OBJ_WORD(obj->payload, payload + r);
+            }
+            for (r = first; r < end; ++r) {
+                int sym = CC_LD_RELOC(obj, r, 1);
+                if (syms[sym] < 0) {
+                    fprintf(stderr, "%s: Undefined symbol '%s'\n", obj->path,
+                        obj->names + CC_LD_SYMBOL(obj, sym, 0));
+                    self->errors++;
+                    syms[sym] = 0;
+                }
+                words[CC_LD_RELOC(obj, r, 0)]
+                    = (syms[sym] + CC_LD_RELOC(obj, r, 2)) & 0xffff;
+            }
+        }
+        free(syms);
+    }
+}
+
+/* Writes the image as big-endian 16-bit words */
+void cc_ld_write(cc_ld * self, FILE * out) {
+    int i = 0;
+    for (i = 0; i < self->image; ++i) {
+        fputc(self->words[i] >> 8, out);
+        fputc(self->words[i] & 0xff, out);
+    }
+}
+
+void cc_ld_free(cc_ld * self) {
+    int i = 0;
+    for (i = 0; i < self->nobjs; ++i) {
+        cc_obj_close(self->objs[i]);
+        free(self->addrs[i]);
+    }
+    free(self->objs);
+    free(self->addrs);
+    free(self->table);
+    free(self->words);
+    free(self);
+}
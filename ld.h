@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_LD_H
+#define CC_LD_H
+
+#include "obj.h"
+#include <stdio.h>
+
+/* Global symbol.  'obj' is -1 for the symbols the linker defines itself,
+ * whose 'value' is an absolute address.  'common' is set while the only
+ * definitions seen are tentative (see obj.h). */
+typedef struct cc_ldsym {
+    char const * name;
+    int obj;
+    int section;
+    int value;
+    int common;
+} cc_ldsym;
+
+/* Linker.  Objects are mapped and read in place; the global symbols go in
+ * an open-addressed hash table keyed by name.  With 'gc' set, only the
+ * sections reachable from the startup code are kept.  Sections are placed
+ * code first, then data, then BSS past the end of the image, and each one
+ * is copied and relocated in a single pass. */
+typedef struct cc_ld {
+    cc_obj ** objs;
+    int nobjs;
+    int capobjs;
+    cc_ldsym * table;
+    int count;
+    int capacity; /* Always a power of two */
+    int ** addrs; /* Address of each section, or -1 if it is stripped */
+    int entry; /* Object holding the startup code */
+    int entry_section;
+    unsigned short * words;
+    int image; /* Words in the image */
+    int bss; /* Words reserved past the image */
+    int kept;
+    int sections;
+    int gc;
+    int errors;
+} cc_ld;
+
+cc_ld * cc_ld_init();
+void cc_ld_add(cc_ld * self, char const * path);
+cc_ldsym * cc_ld_find(cc_ld * self, char const * name);
+void cc_ld_mark(cc_ld * self);
+void cc_ld_layout(cc_ld * self);
+void cc_ld_relocate(cc_ld * self);
+void cc_ld_write(cc_ld * self, FILE * out);
+void cc_ld_free(cc_ld * self);
+
+#endif
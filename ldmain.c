@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "ld.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+void usage() {
+    printf("Usage: dcpu16ld [-v] [--gc-sections] [-o out] file...\n");
+}
+
+int main(int argc, char ** argv) {
+    cc_ld * ld = cc_ld_init();
+    char const * out = "a.out";
+    clock_t start = clock();
+    int verbose = 0;
+    int files = 0;
+    int i = 0;
+    FILE * fd = 0;
+
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = 1;
+        } else if (!strcmp(argv[i], "--gc-sections")) {
+            ld->gc = 1;
+        } else if (!strcmp(argv[i], "-o") && i + 1 < argc) {
+            out = argv[++i];
+        } else {
+            cc_ld_add(ld, argv[i]);
+            files++;
+        }
+    }
+    if (!files) {
+        usage();
+        return 1;
+    }
+    if (ld->errors) {
+        return 1;
+    }
+    if (ld->gc) {
+        cc_ld_mark(ld);
+    }
+    cc_ld_layout(ld);
+    if (ld->errors) {
+        return 1;
+    }
+    cc_ld_relocate(ld);
+    if (ld->errors) {
+        return 1;
+    }
+    /* '-o -' writes the image to stdout */
+    fd = strcmp(out, "-") ? fopen(out, "wb") : stdout;
+    if (!fd) {
+        fprintf(stderr, "Could not open %s\n", out);
+        return 1;
+    }
+    cc_ld_write(ld, fd);
+    if (stdout == fd) {
+        fflush(fd);
+    } else {
+        fclose(fd);
+    }
+    if (verbose) {
+        fprintf(stderr, "ld: %d objects, %d of %d sections kept\n",
+            ld->nobjs, ld->kept, ld->sections);
+        fprintf(stderr, "ld: %d words, %d words of BSS, %d symbols\n",
+            ld->image, ld->bss, ld->count);
+        fprintf(stderr, "ld: %.1f ms\n",
+            1000.0 * (clock() - start) / CLOCKS_PER_SEC);
+    }
+    cc_ld_free(ld);
+    return 0;
+}
@@ -21,25 +21,56 @@
  */  
 
 #include "lexer.h"
+#include "report.h"
 #include <stdio.h>
 #include <ctype.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 
+static void cc_lexer_scan(cc_lexer * self);
+
 /* Creates a new lexer that will read from 'file'.  'env' contains the C
  * lexical environment (unused for now) */
 cc_lexer * cc_lexer_init(cc_env * env, char const * file) {
     cc_lexer * self = calloc(1, sizeof(cc_lexer));
     self->in = fopen(file, "r");
-    self->ch = fgetc(self->in);
+    self->line = 1;
     self->env = env;
+    self->report = env ? env->report : 0;
+    if (!self->in) {
+        fprintf(stderr, "Could not open %s\n", file);
+        self->errors++;
+    }
+    cc_lexer_getc(self);
     return self; 
 }
 
-/* Parses the next token and stores it in self->token.  Current handles only
- * decimal digits, strings, keywords, identifiers, and C-style comments. */
+/* Frees the lexer, closing the file if it wasn't read to the end */
+void cc_lexer_free(cc_lexer * self) {
+    if (self->in) {
+        fclose(self->in);
+    }
+    free(self);
+}
+
+/* Parses the next token and stores it in self->token, timing it if there is
+ * a report */
 void cc_lexer_next(cc_lexer * self) {
+    double start = 0;
+    if (!self->report) {
+        cc_lexer_scan(self);
+        return;
+    }
+    start = cc_report_now();
+    cc_lexer_scan(self);
+    self->report->lex += cc_report_now() - start;
+    self->report->tokens++;
+}
+
+/* Parses the next token.  Current handles only decimal digits, strings,
+ * keywords, identifiers, and C-style comments. */
+static void cc_lexer_scan(cc_lexer * self) {
     int c;
 restart:
     c = self->ch;
@@ -93,12 +124,47 @@ restart:
         if ('=' == self->ch) {
             cc_lexer_getc(self);
             self->token = CC_TOK_EQ;
-        } else if ('!' == self->ch) {
+        } else {
+            self->token = c;
+        }
+    } else if ('!' == c) {
+        cc_lexer_getc(self);
+        if ('=' == self->ch) {
             cc_lexer_getc(self);
             self->token = CC_TOK_NE;
         } else {
             self->token = c;
         }
+    } else if ('<' == c) {
+        cc_lexer_getc(self);
+        if ('=' == self->ch) {
+            cc_lexer_getc(self);
+            self->token = CC_TOK_LE;
+        } else if ('<' == self->ch) {
+            cc_lexer_getc(self);
+            self->token = CC_TOK_LSHIFT;
+        } else {
+            self->token = c;
+        }
+    } else if ('>' == c) {
+        cc_lexer_getc(self);
+        if ('=' == self->ch) {
+            cc_lexer_getc(self);
+            self->token = CC_TOK_GE;
+        } else if ('>' == self->ch) {
+            cc_lexer_getc(self);
+            self->token = CC_TOK_RSHIFT;
+        } else {
+            self->token = c;
+        }
+    } else if ('-' == c) {
+        cc_lexer_getc(self);
+        if ('>' == self->ch) {
+            cc_lexer_getc(self);
+            self->token = CC_TOK_ARROW;
+        } else {
+            self->token = c;
+        }
     } else {
         self->token = c;
         self->value[0] = c;
@@ -112,6 +178,9 @@ restart:
 void cc_lexer_comment(cc_lexer * self) {
     int c = self->ch;
     while (EOF != self->ch) {
+        if ('\n' == c) {
+            self->line++;
+        }
         cc_lexer_getc(self);
         if ('*' == c && '/' == self->ch) {
             cc_lexer_getc(self);
@@ -124,7 +193,8 @@ void cc_lexer_comment(cc_lexer * self) {
 /* Reads a sequence of digits into an integer literal.  This function will give
  * up if the literal is greater than the size of the literal buffer.  This
  * function expects the next character in the input stream to be a digit.
- * Doesn't handle suffixes (e.g., 32L) */
+ * An 'l' or 'L' suffix is kept as 'L' at the end of the value, to mark a long
+ * literal; no other suffixes are handled. */
 void cc_lexer_number(cc_lexer * self) {
     int i = 0;
     while(isdigit(self->ch)) {
@@ -135,6 +205,11 @@ void cc_lexer_number(cc_lexer * self) {
         self->value[i++] = self->ch;
         cc_lexer_getc(self);
     }
+    if (('l' == self->ch || 'L' == self->ch) && !cc_lexer_checkval(self, i)) {
+        /* The suffix makes the literal a long */
+        self->value[i++] = 'L';
+        cc_lexer_getc(self);
+    }
     self->value[i++] = '\0';
     self->token = CC_TOK_NUMBER;
 }
@@ -183,6 +258,8 @@ void cc_lexer_id(cc_lexer * self) {
 
     if (!strcmp("if", self->value)) {
         self->token = CC_TOK_IF; 
+    } else if (!strcmp("else", self->value)) {
+        self->token = CC_TOK_ELSE;
     } else if (!strcmp("while", self->value)) {
         self->token = CC_TOK_WHILE;
     } else if (!strcmp("return", self->value)) {
@@ -197,6 +274,10 @@ void cc_lexer_id(cc_lexer * self) {
         self->token = CC_TOK_CHAR;
     } else if (!strcmp("struct", self->value)) {
         self->token = CC_TOK_STRUCT;
+    } else if (!strcmp("unsigned", self->value)) {
+        self->token = CC_TOK_UNSIGNED;
+    } else if (!strcmp("long", self->value)) {
+        self->token = CC_TOK_LONG;
     } else {
         self->token = CC_TOK_ID;
     }
@@ -214,7 +295,12 @@ int cc_lexer_checkval(cc_lexer * self, int i) {
     }
 }
 
-/* Gets the next character and stores it in self->ch */
+/* Reads the next character, closing the file at the end so that a batch of
+ * units doesn't hold every file open */
 void cc_lexer_getc(cc_lexer * self) {
-    self->ch = fgetc(self->in);
+    self->ch = self->in ? fgetc(self->in) : EOF;
+    if (EOF == self->ch && self->in) {
+        fclose(self->in);
+        self->in = 0;
+    }
 }
@@ -38,6 +38,8 @@ typedef enum cc_token {
     CC_TOK_INT,
     CC_TOK_CHAR,
     CC_TOK_STRUCT, 
+    CC_TOK_UNSIGNED,
+    CC_TOK_LONG,
     CC_TOK_STRING,
     CC_TOK_NUMBER,
     CC_TOK_ID,
@@ -61,9 +63,11 @@ typedef struct cc_lexer {
     int line;
     int ch;
     FILE * in;
+    struct cc_report * report; /* Counts tokens, if set (see report.h) */
 } cc_lexer;
 
 cc_lexer * cc_lexer_init(cc_env * env, char const * file);
+void cc_lexer_free(cc_lexer * self);
 void cc_lexer_next(cc_lexer * self);
 void cc_lexer_comment(cc_lexer * self);
 void cc_lexer_number(cc_lexer * self);
@@ -0,0 +1,801 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "long.h"
+#include "check.h"
+#include "frame.h"
+#include "lexer.h"
+#include <stdlib.h>
+
+/* Returns 'value' wrapped to 32 bits, as a signed number */
+static long cc_long_wrap(unsigned long value) {
+    value &= 0xffffffffUL;
+    if (value & 0x80000000UL) {
+        return -(long)(0xffffffffUL - value) - 1;
+    }
+    return (long)value;
+}
+
+/* Evaluates 'expr' at compile time as a long, like cc_expr_const does for
+ * ints.  An int operand is extended with its sign, or with zeros if it is
+ * unsigned; a literal keeps its value, so 40000 is 40000 as a long. */
+int cc_long_const(cc_expr * expr, long * value) {
+    unsigned long left = 0;
+    unsigned long right = 0;
+    long l = 0;
+    long r = 0;
+    int k = 0;
+
+    if (!expr) {
+        return 0;
+    }
+    if (CC_NUMBER == expr->node.type) {
+        *value = cc_long_wrap(strtoul(((cc_number *)expr)->value, 0, 10));
+        return 1;
+    } else if (!cc_type_islong(expr->type)) {
+        if (!cc_expr_const(expr, &k)) {
+            return 0;
+        }
+        *value = cc_type_isunsigned(expr->type) ? (k & 0xffff) : k;
+        return 1;
+    }
+    if (CC_UNARY == expr->node.type) {
+        cc_unary * unary = (cc_unary *)expr;
+        if (!cc_long_const(unary->expr, &l)) {
+            return 0;
+        }
+        left = l;
+        switch (unary->op) {
+        case '-': *value = cc_long_wrap(-left); return 1;
+        case '~': *value = cc_long_wrap(~left); return 1;
+        default: return 0;
+        }
+    } else if (CC_BINARY == expr->node.type) {
+        cc_binary * binary = (cc_binary *)expr;
+        if (!cc_long_const(binary->left, &l)
+            || !cc_long_const(binary->right, &r)) {
+            return 0;
+        }
+        left = l;
+        right = r;
+        switch (binary->op) {
+        case '+': *value = cc_long_wrap(left + right); return 1;
+        case '-': *value = cc_long_wrap(left - right); return 1;
+        case '*': *value = cc_long_wrap(left * right); return 1;
+        case '/':
+            *value = !r ? 0 : -1 == r ? cc_long_wrap(-left) : l / r;
+            return 1;
+        case '%': *value = !r || -1 == r ? 0 : l % r; return 1;
+        case '&': *value = cc_long_wrap(left & right); return 1;
+        case '|': *value = cc_long_wrap(left | right); return 1;
+        case '^': *value = cc_long_wrap(left ^ right); return 1;
+        case CC_TOK_LSHIFT:
+            *value = cc_long_wrap(left << (right & 31));
+            return 1;
+        case CC_TOK_RSHIFT:
+            *value = l < 0 ? ~(~l >> (right & 31)) : l >> (right & 31);
+            return 1;
+        default: return 0;
+        }
+    }
+    return 0;
+}
+
+/* Returns the words of the constant 'value' as literals */
+cc_pair cc_long_lit(long value) {
+    unsigned long word = value;
+    cc_pair pair;
+    pair.lo = cc_opd_lit(cc_word((int)(word & 0xffff)));
+    pair.hi = cc_opd_lit(cc_word((int)((word >> 16) & 0xffff)));
+    return pair;
+}
+
+/* Returns non-zero if 'opd' is the literal 'value' */
+static int cc_long_is(cc_operand * opd, int value) {
+    return CC_VAL_LIT == opd->mode && !opd->sym && !opd->label
+        && cc_word(opd->value) == cc_word(value);
+}
+
+/* Returns the long in memory at 'opd', which holds its low word */
+static cc_pair cc_long_memory(cc_operand opd) {
+    cc_pair pair;
+    pair.lo = opd;
+    pair.hi = opd;
+    switch (opd.mode) {
+    case CC_VAL_IND:
+        pair.hi.mode = CC_VAL_OFF;
+        pair.hi.value = 1;
+        break;
+    case CC_VAL_OFF:
+        if (!++pair.hi.value && !pair.hi.sym) {
+            pair.hi.mode = CC_VAL_IND;
+        }
+        break;
+    default:
+        /* PICK and MEM */
+        pair.hi.value++;
+        break;
+    }
+    return pair;
+}
+
+/* Returns non-zero if both words are addressed through one register */
+static int cc_long_shared(cc_pair * pair) {
+    return (CC_VAL_IND == pair->lo.mode || CC_VAL_OFF == pair->lo.mode)
+        && (CC_VAL_IND == pair->hi.mode || CC_VAL_OFF == pair->hi.mode)
+        && pair->lo.reg == pair->hi.reg;
+}
+
+/* Loads both words of 'pair' into registers it owns.  If both words are
+ * read through the same register, the high word is read first, since the
+ * low word may reuse the register. */
+static cc_pair cc_long_load(cc_gen * self, cc_pair pair) {
+    if (cc_long_shared(&pair)) {
+        cc_operand hi = cc_opd_reg(cc_gen_alloc(self));
+        cc_gen_emit(self, CC_OP_SET, hi, pair.hi);
+        pair.hi = hi;
+    } else {
+        pair.hi = cc_gen_load(self, pair.hi);
+    }
+    pair.lo = cc_gen_load(self, pair.lo);
+    return pair;
+}
+
+void cc_long_release(cc_gen * self, cc_pair pair) {
+    cc_gen_release(self, pair.lo);
+    cc_gen_release(self, pair.hi);
+}
+
+/* Releases the high word of 'pair', and returns the low one */
+cc_operand cc_long_low(cc_gen * self, cc_pair pair) {
+    if (!cc_long_shared(&pair)) {
+        cc_gen_release(self, pair.hi);
+    }
+    return pair.lo;
+}
+
+/* Returns the number of registers needed to compute 'expr' as a long.  A
+ * signed int needs one more for the sign. */
+static int cc_long_need(cc_gen * self, cc_expr * expr) {
+    int need = cc_frame_need(self, expr);
+    long value = 0;
+    if (cc_type_islong(expr->type) || cc_type_isunsigned(expr->type)
+        || cc_long_const(expr, &value)) {
+        return need;
+    }
+    return (need > 1 ? need : 1) + 1;
+}
+
+/* Returns 'pair', or a new frame slot that it has been stored in if 'need'
+ * registers are needed while 'pair' is held, and fewer are free (see
+ * cc_frame_spill) */
+static cc_pair cc_long_spill(cc_gen * self, cc_pair pair, int need) {
+    cc_pair slot;
+    if ((!cc_frame_temp(self, &pair.lo) && !cc_frame_temp(self, &pair.hi))
+        || need <= cc_frame_free(self)) {
+        return pair;
+    }
+    slot = cc_long_memory(cc_frame_scratch(self, 2));
+    cc_gen_emit(self, CC_OP_SET, slot.lo, pair.lo);
+    cc_gen_emit(self, CC_OP_SET, slot.hi, pair.hi);
+    cc_long_release(self, pair);
+    return slot;
+}
+
+/* Extends the int 'expr' to a long */
+static cc_pair cc_long_extend(cc_gen * self, cc_expr * expr) {
+    cc_pair pair;
+    pair.lo = cc_gen_expr(self, expr);
+    if (cc_type_isunsigned(expr->type)) {
+        pair.hi = cc_opd_lit(0);
+        return pair;
+    }
+    pair.hi = cc_opd_reg(cc_gen_alloc(self));
+    cc_gen_emit(self, CC_OP_SET, pair.hi, pair.lo);
+    cc_gen_emit(self, CC_OP_ASR, pair.hi, cc_opd_lit(15));
+    return pair;
+}
+
+/* dst = dst op src, for the operators that work a word at a time or carry
+ * through EX */
+static void cc_long_op(cc_gen * self, int op, cc_pair dst, cc_pair src) {
+    switch (op) {
+    case '+':
+    case '-':
+        if (cc_long_is(&src.lo, 0)) {
+            /* No carry out of the low word */
+            if (!cc_long_is(&src.hi, 0)) {
+                cc_gen_emit(self, '+' == op ? CC_OP_ADD : CC_OP_SUB, dst.hi,
+                    src.hi);
+            }
+            return;
+        }
+        cc_gen_emit(self, '+' == op ? CC_OP_ADD : CC_OP_SUB, dst.lo, src.lo);
+        cc_gen_emit(self, '+' == op ? CC_OP_ADX : CC_OP_SBX, dst.hi, src.hi);
+        return;
+    case '&':
+        if (!cc_long_is(&src.lo, -1)) {
+            cc_gen_emit(self, CC_OP_AND, dst.lo, src.lo);
+        }
+        if (!cc_long_is(&src.hi, -1)) {
+            cc_gen_emit(self, CC_OP_AND, dst.hi, src.hi);
+        }
+        return;
+    case '|':
+        if (!cc_long_is(&src.lo, 0)) {
+            cc_gen_emit(self, CC_OP_BOR, dst.lo, src.lo);
+        }
+        if (!cc_long_is(&src.hi, 0)) {
+            cc_gen_emit(self, CC_OP_BOR, dst.hi, src.hi);
+        }
+        return;
+    case '^':
+        if (!cc_long_is(&src.lo, 0)) {
+            cc_gen_emit(self, CC_OP_XOR, dst.lo, src.lo);
+        }
+        if (!cc_long_is(&src.hi, 0)) {
+            cc_gen_emit(self, CC_OP_XOR, dst.hi, src.hi);
+        }
+        return;
+    default:
+        cc_gen_err(self, self->code->line, "Invalid operator");
+        return;
+    }
+}
+
+/* l = l * r, keeping the low 32 bits, which are the same for signed and
+ * unsigned operands.  The high word is the sum of the cross products and
+ * the high half of the product of the low words, which MUL leaves in EX. */
+static void cc_long_mul(cc_gen * self, cc_pair l, cc_pair r) {
+    if (!cc_long_is(&r.hi, 0)) {
+        cc_operand t = cc_opd_reg(cc_gen_alloc(self));
+        cc_gen_emit(self, CC_OP_SET, t, l.lo);
+        cc_gen_emit(self, CC_OP_MUL, t, r.hi);
+        cc_gen_emit(self, CC_OP_MUL, l.hi, r.lo);
+        cc_gen_emit(self, CC_OP_ADD, l.hi, t);
+        cc_gen_release(self, t);
+    } else {
+        cc_gen_emit(self, CC_OP_MUL, l.hi, r.lo);
+    }
+    cc_gen_emit(self, CC_OP_MUL, l.lo, r.lo);
+    cc_gen_emit(self, CC_OP_ADD, l.hi, cc_opd_special(CC_VAL_EX));
+}
+
+/* Shifts 'l' by 'count' bits, which is less than 16.  The bits that cross
+ * from one word to the other are left in EX by the second shift. */
+static void cc_long_small(cc_gen * self, cc_pair l, int op,
+    cc_operand count) {
+
+    cc_operand ex = cc_opd_special(CC_VAL_EX);
+    if (CC_OP_SHL == op) {
+        cc_gen_emit(self, CC_OP_SHL, l.hi, count);
+        cc_gen_emit(self, CC_OP_SHL, l.lo, count);
+        cc_gen_emit(self, CC_OP_BOR, l.hi, ex);
+    } else {
+        cc_gen_emit(self, CC_OP_SHR, l.lo, count);
+        cc_gen_emit(self, op, l.hi, count);
+        cc_gen_emit(self, CC_OP_BOR, l.lo, ex);
+    }
+}
+
+/* Shifts 'l' by 16 plus 'count' bits: one word moves to the other, and the
+ * vacated word is filled with zeros or the sign */
+static void cc_long_big(cc_gen * self, cc_pair l, int op, cc_operand count) {
+    if (CC_OP_SHL == op) {
+        cc_gen_emit(self, CC_OP_SET, l.hi, l.lo);
+        if (!cc_long_is(&count, 0)) {
+            cc_gen_emit(self, CC_OP_SHL, l.hi, count);
+        }
+        cc_gen_emit(self, CC_OP_SET, l.lo, cc_opd_lit(0));
+    } else {
+        cc_gen_emit(self, CC_OP_SET, l.lo, l.hi);
+        if (!cc_long_is(&count, 0)) {
+            cc_gen_emit(self, op, l.lo, count);
+        }
+        if (CC_OP_ASR == op) {
+            cc_gen_emit(self, CC_OP_ASR, l.hi, cc_opd_lit(15));
+        } else {
+            cc_gen_emit(self, CC_OP_SET, l.hi, cc_opd_lit(0));
+        }
+    }
+}
+
+/* Generates a shift.  A count that isn't constant picks between the two
+ * cases at run time. */
+static cc_pair cc_long_shift(cc_gen * self, cc_binary * expr) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    int op = CC_TOK_LSHIFT == expr->op ? CC_OP_SHL : CC_OP_ASR;
+    cc_pair l = cc_long_load(self, cc_long_expr(self, expr->left));
+    long value = 0;
+    if (cc_long_const(expr->right, &value)) {
+        value &= 31;
+        if (value >= 16) {
+            cc_long_big(self, l, op, cc_opd_lit(value - 16));
+        } else if (value) {
+            cc_long_small(self, l, op, cc_opd_lit(value));
+        }
+    } else {
+        cc_operand n;
+        int small = cc_code_label(self->code);
+        int done = cc_code_label(self->code);
+        int need = cc_frame_need(self, expr->right);
+        l = cc_long_spill(self, l, need > 1 ? need : 1);
+        n = cc_gen_load(self, cc_gen_expr(self, expr->right));
+        cc_gen_emit(self, CC_OP_IFL, n, cc_opd_lit(16));
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(small));
+        cc_gen_emit(self, CC_OP_SUB, n, cc_opd_lit(16));
+        cc_long_big(self, l, op, n);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(done));
+        cc_code_place(self->code, small);
+        cc_long_small(self, l, op, n);
+        cc_code_place(self->code, done);
+        cc_gen_release(self, n);
+    }
+    return l;
+}
+
+/* Generates a division or remainder with a call to long$div.  Live
+ * temporaries in A, B and C are saved around the call, as for any call. */
+static cc_pair cc_long_divide(cc_gen * self, cc_binary * expr) {
+    cc_operand push = cc_opd_special(CC_VAL_PUSHPOP);
+    cc_operand values[2];
+    cc_pair pair;
+    int ab = (1 << CC_REG_A) | (1 << CC_REG_B);
+    int used = self->used;
+    int live = used & CC_FRAME_CALLER;
+    int reg = 0;
+
+    for (reg = CC_REG_A; reg <= CC_REG_C; ++reg) {
+        if (live & (1 << reg)) {
+            cc_gen_emit(self, CC_OP_SET, push, cc_opd_reg(reg));
+        }
+    }
+    self->used = used & ~CC_FRAME_CALLER;
+
+    pair = cc_long_expr(self, expr->right);
+    cc_gen_emit(self, CC_OP_SET, push, pair.hi);
+    if (CC_VAL_PICK == pair.lo.mode) {
+        pair.lo.value++; /* One word further from SP */
+    }
+    cc_gen_emit(self, CC_OP_SET, push, pair.lo);
+    cc_long_release(self, pair);
+
+    pair = cc_long_expr(self, expr->left);
+    if (CC_VAL_IND == pair.lo.mode || CC_VAL_OFF == pair.lo.mode
+        || CC_VAL_IND == pair.hi.mode || CC_VAL_OFF == pair.hi.mode) {
+        pair = cc_long_load(self, pair);
+    }
+    values[0] = pair.lo;
+    values[1] = pair.hi;
+    cc_frame_move(self, values, 2);
+    cc_long_release(self, pair);
+    cc_gen_emit(self, CC_OP_JSR, cc_opd_lit(0),
+        cc_opd_sym(cc_env_id(self->env, "long$div")));
+    self->ldiv = 1;
+
+    self->used = used;
+    if ('%' == expr->op) {
+        pair.lo = cc_opd_reg(cc_gen_alloc(self));
+        cc_gen_emit(self, CC_OP_SET, pair.lo, push);
+        pair.hi = cc_opd_reg(cc_gen_alloc(self));
+        cc_gen_emit(self, CC_OP_SET, pair.hi, push);
+    } else {
+        cc_gen_emit(self, CC_OP_ADD, cc_opd_special(CC_VAL_SP), cc_opd_lit(2));
+        self->used |= ab;
+        pair.lo = cc_opd_reg(CC_REG_A);
+        pair.hi = cc_opd_reg(CC_REG_B);
+        if (used & (1 << CC_REG_A)) {
+            pair.lo = cc_opd_reg(cc_gen_alloc(self));
+            cc_gen_emit(self, CC_OP_SET, pair.lo, cc_opd_reg(CC_REG_A));
+        }
+        if (used & (1 << CC_REG_B)) {
+            pair.hi = cc_opd_reg(cc_gen_alloc(self));
+            cc_gen_emit(self, CC_OP_SET, pair.hi, cc_opd_reg(CC_REG_B));
+        }
+        self->used = (self->used & ~ab) | (used & ab) | (1 << pair.lo.reg)
+            | (1 << pair.hi.reg);
+    }
+    for (reg = CC_REG_C; reg >= CC_REG_A; --reg) {
+        if (live & (1 << reg)) {
+            cc_gen_emit(self, CC_OP_SET, cc_opd_reg(reg), push);
+        }
+    }
+    return pair;
+}
+
+/* Generates an assignment.  x = x op y is done in place if op works a word
+ * at a time or carries through EX. */
+static cc_pair cc_long_assign(cc_gen * self, cc_binary * expr) {
+    cc_binary * rhs = (cc_binary *)expr->right;
+    cc_pair dst = cc_long_memory(cc_gen_lvalue(self, expr->left));
+    cc_pair value;
+    if (CC_BINARY == rhs->node.node.type
+        && cc_expr_equal(expr->left, rhs->left)
+        && ('+' == rhs->op || '-' == rhs->op || '&' == rhs->op
+            || '|' == rhs->op || '^' == rhs->op)) {
+        value = cc_long_expr(self, rhs->right);
+        cc_long_op(self, rhs->op, dst, value);
+        cc_long_release(self, value);
+        return dst;
+    }
+    value = cc_long_expr(self, expr->right);
+    cc_gen_emit(self, CC_OP_SET, dst.lo, value.lo);
+    cc_gen_emit(self, CC_OP_SET, dst.hi, value.hi);
+    cc_long_release(self, dst);
+    return value;
+}
+
+/* Returns k if 'value' is 2^k for 0 < k < 32, or -1 */
+static int cc_long_log2(long value) {
+    int k = 1;
+    for (k = 1; k < 32; ++k) {
+        if ((unsigned long)value == 1UL << k) {
+            return k;
+        }
+    }
+    return -1;
+}
+
+/* Generates an operator that works a word at a time, carries through EX,
+ * or multiplies.  A multiply by a power of two is a shift. */
+static cc_pair cc_long_arith(cc_gen * self, cc_binary * expr) {
+    cc_expr * left = expr->left;
+    cc_expr * right = expr->right;
+    long value = 0;
+    int k = 0;
+    cc_pair l;
+    cc_pair r;
+
+    /* Put constants on the right of commutative operators */
+    if (('+' == expr->op || '*' == expr->op || '&' == expr->op
+        || '|' == expr->op || '^' == expr->op)
+        && cc_long_const(left, &value)) {
+        left = expr->right;
+        right = expr->left;
+    }
+    l = cc_long_load(self, cc_long_expr(self, left));
+    if ('*' == expr->op && cc_long_const(right, &value)
+        && (k = cc_long_log2(value)) >= 0) {
+        if (k >= 16) {
+            cc_long_big(self, l, CC_OP_SHL, cc_opd_lit(k - 16));
+        } else {
+            cc_long_small(self, l, CC_OP_SHL, cc_opd_lit(k));
+        }
+        return l;
+    }
+    l = cc_long_spill(self, l,
+        cc_long_need(self, right) + ('*' == expr->op));
+    r = cc_long_expr(self, right);
+    if ('*' == expr->op) {
+        cc_long_mul(self, l, r);
+    } else {
+        cc_long_op(self, expr->op, l, r);
+    }
+    cc_long_release(self, r);
+    return l;
+}
+
+static cc_pair cc_long_unary(cc_gen * self, cc_unary * expr) {
+    cc_pair pair;
+    if ('*' == expr->op) {
+        return cc_long_memory(cc_gen_unary(self, expr));
+    }
+    pair = cc_long_load(self, cc_long_expr(self, expr->expr));
+    cc_gen_emit(self, CC_OP_XOR, pair.lo, cc_opd_lit(-1));
+    cc_gen_emit(self, CC_OP_XOR, pair.hi, cc_opd_lit(-1));
+    if ('-' == expr->op) {
+        cc_gen_emit(self, CC_OP_ADD, pair.lo, cc_opd_lit(1));
+        cc_gen_emit(self, CC_OP_ADX, pair.hi, cc_opd_lit(0));
+    }
+    return pair;
+}
+
+/* Generates 'expr' as a long, and returns the operands that hold its words.
+ * Any temporary register they use must be released by the caller. */
+cc_pair cc_long_expr(cc_gen * self, cc_expr * expr) {
+    cc_binary * binary = (cc_binary *)expr;
+    long value = 0;
+    if (cc_long_const(expr, &value)) {
+        return cc_long_lit(value);
+    } else if (!cc_type_islong(expr->type)) {
+        return cc_long_extend(self, expr);
+    }
+    switch (expr->node.type) {
+    case CC_REF:
+    case CC_MEMBER:
+        return cc_long_memory(cc_gen_lvalue(self, expr));
+    case CC_UNARY:
+        return cc_long_unary(self, (cc_unary *)expr);
+    case CC_BINARY:
+        switch (binary->op) {
+        case '=':
+            return cc_long_assign(self, binary);
+        case ',':
+            cc_gen_void(self, binary->left);
+            return cc_long_expr(self, binary->right);
+        case '/':
+        case '%':
+            return cc_long_divide(self, binary);
+        case CC_TOK_LSHIFT:
+        case CC_TOK_RSHIFT:
+            return cc_long_shift(self, binary);
+        default:
+            return cc_long_arith(self, binary);
+        }
+    case CC_CALL:
+        cc_gen_err(self, expr->node.line, "Results must be one word wide");
+        return cc_long_lit(0);
+    default:
+        cc_gen_err(self, expr->node.line, "Not implemented");
+        return cc_long_lit(0);
+    }
+}
+
+/* Stores the long value of 'expr' at 'dst', which holds the low word */
+void cc_long_store(cc_gen * self, cc_operand dst, cc_expr * expr) {
+    cc_pair home = cc_long_memory(dst);
+    cc_pair value = cc_long_expr(self, expr);
+    cc_gen_emit(self, CC_OP_SET, home.lo, value.lo);
+    cc_gen_emit(self, CC_OP_SET, home.hi, value.hi);
+    cc_long_release(self, value);
+}
+
+/* Returns non-zero if 'expr' is a condition on a long: a comparison with a
+ * long operand, or the truth value of a long */
+int cc_long_cond(cc_expr * expr) {
+    cc_binary * binary = (cc_binary *)expr;
+    if (CC_BINARY == expr->node.type && cc_check_iscompare(binary->op)
+        && CC_TOK_AND != binary->op && CC_TOK_OR != binary->op) {
+        return cc_type_islong(binary->left->type)
+            || cc_type_islong(binary->right->type);
+    }
+    return cc_type_islong(expr->type);
+}
+
+/* Reduces the long condition 'expr' to a test of 'left' against 'right':
+ * CC_TOK_EQ, CC_TOK_NE or '<'.  '>' swaps the operands, and '<=' and '>='
+ * flip 'sense' as well.  The truth value of a long is a test against zero,
+ * with 'right' null. */
+static int cc_long_test(cc_expr * expr, int * sense, cc_expr ** left,
+    cc_expr ** right) {
+
+    cc_binary * binary = (cc_binary *)expr;
+    cc_expr * temp = 0;
+    long value = 0;
+    if (CC_BINARY != expr->node.type || !cc_check_iscompare(binary->op)) {
+        *left = expr;
+        *right = 0;
+        return CC_TOK_NE;
+    }
+    *left = binary->left;
+    *right = binary->right;
+    switch (binary->op) {
+    case CC_TOK_EQ:
+    case CC_TOK_NE:
+        if (cc_long_const(*left, &value) && !cc_long_const(*right, &value)) {
+            break;
+        }
+        return binary->op;
+    case '<':
+        return '<';
+    case CC_TOK_GE:
+        *sense = !*sense;
+        return '<';
+    case CC_TOK_LE:
+        *sense = !*sense;
+        break;
+    default:
+        break;
+    }
+    temp = *left;
+    *left = *right;
+    *right = temp;
+    return CC_TOK_LE == binary->op || '>' == binary->op ? '<' : binary->op;
+}
+
+/* Returns non-zero if 'expr' is a long operand that needs no code */
+static int cc_long_leaf(cc_expr * expr) {
+    long value = 0;
+    return cc_long_const(expr, &value)
+        || (CC_REF == expr->node.type && cc_type_islong(expr->type));
+}
+
+/* Emits the links of an IF chain for a long condition, as cc_gen_chain
+ * does.  Only equality is a conjunction of tests on the two words, so the
+ * other conditions return 0. */
+int cc_long_chain(cc_gen * self, cc_expr * expr, int sense, int first,
+    int emit) {
+
+    cc_expr * left = 0;
+    cc_expr * right = 0;
+    int op = cc_long_test(expr, &sense, &left, &right);
+    cc_pair l;
+    cc_pair r;
+    if ((CC_TOK_EQ == op) != sense || '<' == op) {
+        return 0;
+    }
+    if (!first && (!cc_long_leaf(left) || (right && !cc_long_leaf(right)))) {
+        return 0;
+    }
+    if (!emit) {
+        return 1;
+    }
+    l = cc_long_expr(self, left);
+    if (right) {
+        l = cc_long_spill(self, l, cc_long_need(self, right));
+    }
+    r = right ? cc_long_expr(self, right) : cc_long_lit(0);
+    cc_gen_emit(self, CC_OP_IFE, l.lo, r.lo);
+    cc_gen_emit(self, CC_OP_IFE, l.hi, r.hi);
+    cc_long_release(self, l);
+    cc_long_release(self, r);
+    return 1;
+}
+
+/* Generates a branch to 'label' that is taken if the truth value of the
+ * long condition 'expr' is 'sense'.  For '<', the high words decide as
+ * signed numbers unless they are equal, and then the low words decide as
+ * unsigned numbers. */
+void cc_long_branch(cc_gen * self, cc_expr * expr, int sense, int label) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    cc_expr * left = 0;
+    cc_expr * right = 0;
+    int op = cc_long_test(expr, &sense, &left, &right);
+    int skip = cc_code_label(self->code);
+    int yes = sense ? label : skip;
+    int no = sense ? skip : label;
+    cc_pair l = cc_long_expr(self, left);
+    cc_pair r;
+
+    if (right) {
+        l = cc_long_spill(self, l, cc_long_need(self, right));
+    }
+    r = right ? cc_long_expr(self, right) : cc_long_lit(0);
+    if ('<' == op) {
+        cc_gen_emit(self, CC_OP_IFU, l.hi, r.hi);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(yes));
+        cc_gen_emit(self, CC_OP_IFN, l.hi, r.hi);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(no));
+        cc_gen_emit(self, CC_OP_IFL, l.lo, r.lo);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(yes));
+        if (!sense) {
+            cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+        }
+    } else if ((CC_TOK_NE == op) == sense) {
+        /* Either word decides */
+        cc_gen_emit(self, CC_OP_IFN, l.lo, r.lo);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+        cc_gen_emit(self, CC_OP_IFN, l.hi, r.hi);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+    } else {
+        cc_gen_emit(self, CC_OP_IFE, l.lo, r.lo);
+        cc_gen_emit(self, CC_OP_IFE, l.hi, r.hi);
+        cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(label));
+    }
+    cc_long_release(self, l);
+    cc_long_release(self, r);
+    cc_code_place(self->code, skip);
+}
+
+/* Emits long$div, if a division needs it.  The divisor and remainder are
+ * made positive, the unsigned quotient and remainder are found by shifting
+ * the dividend into the remainder a bit at a time, and the signs are put
+ * back: the quotient is negative if the operands' signs differ, and the
+ * remainder has the sign of the dividend.  ADD and ADX shift all four
+ * words left at once, with the bit shifted out of the remainder in EX. */
+void cc_long_helpers(cc_gen * self) {
+    cc_operand a = cc_opd_reg(CC_REG_A);
+    cc_operand b = cc_opd_reg(CC_REG_B);
+    cc_operand c = cc_opd_reg(CC_REG_C);
+    cc_operand x = cc_opd_reg(CC_REG_X);
+    cc_operand y = cc_opd_reg(CC_REG_Y);
+    cc_operand z = cc_opd_reg(CC_REG_Z);
+    cc_operand i = cc_opd_reg(CC_REG_I);
+    cc_operand ex = cc_opd_special(CC_VAL_EX);
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    cc_operand push = cc_opd_special(CC_VAL_PUSHPOP);
+    cc_operand zero = cc_opd_lit(0);
+    int loop = 0;
+    int sub = 0;
+    int next = 0;
+
+    if (!self->ldiv) {
+        return;
+    }
+    self->code = cc_code_init(cc_env_id(self->env, "long$div"));
+    loop = cc_code_label(self->code);
+    sub = cc_code_label(self->code);
+    next = cc_code_label(self->code);
+
+    /* The divisor is at PICK 5 and PICK 6 once X, Y, Z and I are saved */
+    cc_gen_emit(self, CC_OP_SET, push, x);
+    cc_gen_emit(self, CC_OP_SET, push, y);
+    cc_gen_emit(self, CC_OP_SET, push, z);
+    cc_gen_emit(self, CC_OP_SET, push, i);
+    cc_gen_emit(self, CC_OP_SET, z, cc_opd_pick(5));
+    cc_gen_emit(self, CC_OP_SET, i, cc_opd_pick(6));
+    cc_gen_emit(self, CC_OP_SET, x, b);
+    cc_gen_emit(self, CC_OP_ASR, x, cc_opd_lit(15));
+    cc_gen_emit(self, CC_OP_SET, y, i);
+    cc_gen_emit(self, CC_OP_ASR, y, cc_opd_lit(15));
+    /* (v ^ s) - s is |v| for the sign s, which is 0 or -1 */
+    cc_gen_emit(self, CC_OP_XOR, a, x);
+    cc_gen_emit(self, CC_OP_XOR, b, x);
+    cc_gen_emit(self, CC_OP_SUB, a, x);
+    cc_gen_emit(self, CC_OP_SBX, b, x);
+    cc_gen_emit(self, CC_OP_XOR, z, y);
+    cc_gen_emit(self, CC_OP_XOR, i, y);
+    cc_gen_emit(self, CC_OP_SUB, z, y);
+    cc_gen_emit(self, CC_OP_SBX, i, y);
+    cc_gen_emit(self, CC_OP_XOR, y, x);
+    cc_gen_emit(self, CC_OP_SET, push, y);
+    cc_gen_emit(self, CC_OP_SET, push, x);
+
+    /* A:B is shifted into the remainder X:Y, and the quotient into A:B */
+    cc_gen_emit(self, CC_OP_SET, x, zero);
+    cc_gen_emit(self, CC_OP_SET, y, zero);
+    cc_gen_emit(self, CC_OP_SET, c, cc_opd_lit(32));
+    cc_code_place(self->code, loop);
+    cc_gen_emit(self, CC_OP_ADD, a, a);
+    cc_gen_emit(self, CC_OP_ADX, b, b);
+    cc_gen_emit(self, CC_OP_ADX, x, x);
+    cc_gen_emit(self, CC_OP_ADX, y, y);
+    cc_gen_emit(self, CC_OP_IFN, ex, zero);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(sub));
+    cc_gen_emit(self, CC_OP_IFG, y, i);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(sub));
+    cc_gen_emit(self, CC_OP_IFN, y, i);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(next));
+    cc_gen_emit(self, CC_OP_IFL, x, z);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(next));
+    cc_code_place(self->code, sub);
+    cc_gen_emit(self, CC_OP_SUB, x, z);
+    cc_gen_emit(self, CC_OP_SBX, y, i);
+    cc_gen_emit(self, CC_OP_BOR, a, cc_opd_lit(1));
+    cc_code_place(self->code, next);
+    cc_gen_emit(self, CC_OP_SUB, c, cc_opd_lit(1));
+    cc_gen_emit(self, CC_OP_IFN, c, zero);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(loop));
+
+    /* Sign the remainder and store it over the divisor, then the quotient */
+    cc_gen_emit(self, CC_OP_SET, c, push);
+    cc_gen_emit(self, CC_OP_XOR, x, c);
+    cc_gen_emit(self, CC_OP_XOR, y, c);
+    cc_gen_emit(self, CC_OP_SUB, x, c);
+    cc_gen_emit(self, CC_OP_SBX, y, c);
+    cc_gen_emit(self, CC_OP_SET, cc_opd_pick(6), x);
+    cc_gen_emit(self, CC_OP_SET, cc_opd_pick(7), y);
+    cc_gen_emit(self, CC_OP_SET, c, push);
+    cc_gen_emit(self, CC_OP_XOR, a, c);
+    cc_gen_emit(self, CC_OP_XOR, b, c);
+    cc_gen_emit(self, CC_OP_SUB, a, c);
+    cc_gen_emit(self, CC_OP_SBX, b, c);
+    cc_gen_emit(self, CC_OP_SET, i, push);
+    cc_gen_emit(self, CC_OP_SET, z, push);
+    cc_gen_emit(self, CC_OP_SET, y, push);
+    cc_gen_emit(self, CC_OP_SET, x, push);
+    cc_gen_emit(self, CC_OP_SET, pc, push);
+    *self->tail = self->code;
+    self->tail = &self->code->next;
+    self->code = 0;
+}
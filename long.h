@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_LONG_H
+#define CC_LONG_H
+
+#include "gen.h"
+
+/* 32-bit longs.  A long is two words, low word first, and its arithmetic
+ * is expanded inline: ADD/ADX and SUB/SBX carry the low word into the high
+ * one through EX, a multiply takes the high half of the low product from
+ * EX after MUL, shifts move the bits that cross the word boundary through
+ * EX, and comparisons are chains of tests on the high word, then the low
+ * one.  Only division calls a helper, long$div, which is generated once
+ * per program if it is needed:
+ *
+ *   in   A:B the dividend, and two words pushed by the caller, high word
+ *        first, holding the divisor
+ *   out  A:B the quotient, and the pushed words hold the remainder, which
+ *        the caller pops
+ *
+ * The helper preserves every register except A, B, C and EX.  An operand
+ * held while the other one is computed is stored in a frame slot if the
+ * registers would run out.  A long that is used as an int is truncated to
+ * its low word, which is what cc_gen_expr returns for it. */
+
+/* Operands for the low and high words of a long value.  Each is an
+ * operand as cc_gen_expr returns it: a register, a literal, or memory. */
+typedef struct cc_pair {
+    cc_operand lo;
+    cc_operand hi;
+} cc_pair;
+
+int cc_long_const(cc_expr * expr, long * value);
+cc_pair cc_long_lit(long value);
+cc_pair cc_long_expr(cc_gen * self, cc_expr * expr);
+cc_operand cc_long_low(cc_gen * self, cc_pair pair);
+void cc_long_store(cc_gen * self, cc_operand dst, cc_expr * expr);
+void cc_long_release(cc_gen * self, cc_pair pair);
+int cc_long_cond(cc_expr * expr);
+int cc_long_chain(cc_gen * self, cc_expr * expr, int sense, int first,
+    int emit);
+void cc_long_branch(cc_gen * self, cc_expr * expr, int sense, int label);
+void cc_long_helpers(cc_gen * self);
+
+#endif
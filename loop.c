@@ -0,0 +1,808 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "loop.h"
+#include "lexer.h"
+#include "check.h"
+#include "dcpu.h"
+#include "pgo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Induction variable expressions being replaced by running sums.  'temps[i]'
+ * holds the value of 'exprs[i]', which is 'base + id * factors[i]' for some
+ * loop-invariant base. */
+typedef struct cc_reduction {
+    cc_id * id;
+    cc_type * type; /* Type of the induction variable */
+    cc_loopinfo * info; /* Facts for the whole loop */
+    cc_expr * exprs[8];
+    int factors[8];
+    cc_var * temps[8];
+    int count;
+} cc_reduction;
+
+static void cc_loop_scan_block(cc_loopinfo * info, cc_block * block);
+
+/* Records the names assigned by 'expr', and whether it calls functions or
+ * stores through pointers. */
+static void cc_loop_scan_expr(cc_loopinfo * info, cc_expr * expr) {
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_loop_scan_expr(info, ((cc_member *)expr)->expr);
+        break;
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        if ('=' == binary->op && CC_REF == binary->left->node.type) {
+            cc_idset_add(&info->killed, ((cc_ref *)binary->left)->id);
+        } else if ('=' == binary->op) {
+            info->stores = 1;
+        }
+        cc_loop_scan_expr(info, binary->left);
+        cc_loop_scan_expr(info, binary->right);
+        break;
+    }
+    case CC_UNARY:
+        cc_loop_scan_expr(info, ((cc_unary *)expr)->expr);
+        break;
+    case CC_CALL: {
+        cc_expr * arg = 0;
+        info->calls = 1;
+        cc_loop_scan_expr(info, ((cc_call *)expr)->expr);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            cc_loop_scan_expr(info, arg);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void cc_loop_scan_stmt(cc_loopinfo * info, cc_stmt * stmt) {
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_loop_scan_block(info, (cc_block *)stmt);
+        break;
+    case CC_IF:
+        cc_loop_scan_expr(info, ((cc_if *)stmt)->guard);
+        cc_loop_scan_stmt(info, ((cc_if *)stmt)->yes);
+        cc_loop_scan_stmt(info, ((cc_if *)stmt)->no);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_loop_scan_expr(info, ((cc_loop *)stmt)->init);
+        cc_loop_scan_expr(info, ((cc_loop *)stmt)->guard);
+        cc_loop_scan_expr(info, ((cc_loop *)stmt)->update);
+        if (((cc_loop *)stmt)->block) {
+            cc_loop_scan_block(info, ((cc_loop *)stmt)->block);
+        }
+        break;
+    case CC_SIMPLE:
+        cc_loop_scan_expr(info, ((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN:
+        cc_loop_scan_expr(info, ((cc_return *)stmt)->expr);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Variables declared inside the loop get a new value on every iteration, so
+ * they are never invariant. */
+static void cc_loop_scan_block(cc_loopinfo * info, cc_block * block) {
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    for (var = block->vars; var; var = var->next) {
+        cc_idset_add(&info->killed, var->id);
+        cc_loop_scan_expr(info, var->init);
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_loop_scan_stmt(info, stmt);
+    }
+}
+
+/* Returns non-zero if 'expr' computes the same value on every iteration of
+ * the loop described by 'info'.  Locals are invariant unless they're assigned
+ * in the loop or have their address taken; globals and memory are invariant
+ * only if the loop has no calls and no stores through pointers. */
+static int cc_loop_invariant(cc_opt * opt, cc_loopinfo * info, cc_expr * expr) {
+    switch (expr->node.type) {
+    case CC_NUMBER:
+    case CC_STRING:
+        return 1;
+    case CC_REF: {
+        cc_id * id = ((cc_ref *)expr)->id;
+        if (cc_idset_has(&info->killed, id)) {
+            return 0;
+        } else if (cc_idset_has(&opt->locals, id)) {
+            return !cc_idset_has(&opt->addressed, id);
+        } else if (cc_find_func(opt->env->funcs, id)) {
+            return 1;
+        } else {
+            return !info->calls && !info->stores;
+        }
+    }
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        if ('&' == unary->op) {
+            return CC_REF == unary->expr->node.type;
+        } else if ('*' == unary->op && (info->calls || info->stores)) {
+            return 0;
+        }
+        return cc_loop_invariant(opt, info, unary->expr);
+    }
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        if ('=' == binary->op || ',' == binary->op) {
+            return 0;
+        }
+        return cc_loop_invariant(opt, info, binary->left)
+            && cc_loop_invariant(opt, info, binary->right);
+    }
+    default:
+        return 0;
+    }
+}
+
+/* Moves the invariant expression in '*slot' into a temporary that is
+ * assigned before the loop, and replaces it with a reference to the
+ * temporary.  Identical expressions share one temporary. */
+static void cc_loop_move(cc_opt * opt, cc_loopinfo * info, cc_expr ** slot) {
+    cc_expr * expr = *slot;
+    cc_expr * next = expr->next;
+    int line = expr->node.line;
+    cc_var * temp = 0;
+    cc_ref * ref = 0;
+    int i = 0;
+
+    for (i = 0; i < info->count; ++i) {
+        if (cc_expr_equal(info->hoisted[i], expr)) {
+            temp = info->temps[i];
+            break;
+        }
+    }
+    if (!temp) {
+        cc_ref * lhs = 0;
+        cc_simple * stmt = 0;
+        if (info->count >= sizeof(info->hoisted)/sizeof(info->hoisted[0])) {
+            return;
+        }
+        temp = cc_opt_temp(opt, line, expr->type);
+        lhs = cc_ref_init(line, temp->id);
+        lhs->node.type = temp->type;
+        expr->next = 0;
+        stmt = cc_simple_init(line,
+            (cc_expr *)cc_binary_init(line, '=', (cc_expr *)lhs, expr));
+        stmt->node.next = *info->link;
+        *info->link = (cc_stmt *)stmt;
+        info->link = &stmt->node.next;
+        info->hoisted[info->count] = expr;
+        info->temps[info->count] = temp;
+        info->count++;
+        opt->hoisted++;
+    }
+    ref = cc_ref_init(line, temp->id);
+    ref->node.type = temp->type;
+    ref->node.next = next;
+    *slot = (cc_expr *)ref;
+}
+
+/* Folds constant subexpressions of '*slot' and hoists the largest invariant
+ * subexpressions out of the loop.  Leaves and lvalues are left in place. */
+static void cc_loop_hoist_expr(cc_opt * opt, cc_loopinfo * info,
+    cc_expr ** slot) {
+
+    cc_expr * expr = *slot;
+    int value = 0;
+    if (!expr) {
+        return;
+    }
+    if (CC_BINARY == expr->node.type || CC_UNARY == expr->node.type) {
+        if (cc_expr_const(expr, &value)) {
+            cc_number * number = cc_number_init(expr->node.line, value);
+            number->node.type = expr->type;
+            number->node.next = expr->next;
+            *slot = (cc_expr *)number;
+            return;
+        }
+        if (expr->type && cc_loop_invariant(opt, info, expr)
+            && !(CC_UNARY == expr->node.type
+                && '&' == ((cc_unary *)expr)->op)) {
+            cc_loop_move(opt, info, slot);
+            return;
+        }
+    }
+
+    switch (expr->node.type) {
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)expr;
+        if ('=' != binary->op) {
+            cc_loop_hoist_expr(opt, info, &binary->left);
+        } else if (CC_UNARY == binary->left->node.type) {
+            cc_loop_hoist_expr(opt, info, &((cc_unary *)binary->left)->expr);
+        }
+        cc_loop_hoist_expr(opt, info, &binary->right);
+        break;
+    }
+    case CC_UNARY:
+        if ('&' != ((cc_unary *)expr)->op) {
+            cc_loop_hoist_expr(opt, info, &((cc_unary *)expr)->expr);
+        }
+        break;
+    case CC_CALL: {
+        cc_expr ** arg = &((cc_call *)expr)->args;
+        for (; *arg; arg = &(*arg)->next) {
+            cc_loop_hoist_expr(opt, info, arg);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void cc_loop_hoist_block(cc_opt * opt, cc_loopinfo * info,
+    cc_block * block);
+
+static void cc_loop_hoist_stmt(cc_opt * opt, cc_loopinfo * info,
+    cc_stmt * stmt) {
+
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_loop_hoist_block(opt, info, (cc_block *)stmt);
+        break;
+    case CC_IF:
+        cc_loop_hoist_expr(opt, info, &((cc_if *)stmt)->guard);
+        cc_loop_hoist_stmt(opt, info, ((cc_if *)stmt)->yes);
+        cc_loop_hoist_stmt(opt, info, ((cc_if *)stmt)->no);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_loop_hoist_expr(opt, info, &((cc_loop *)stmt)->init);
+        cc_loop_hoist_expr(opt, info, &((cc_loop *)stmt)->guard);
+        cc_loop_hoist_expr(opt, info, &((cc_loop *)stmt)->update);
+        if (((cc_loop *)stmt)->block) {
+            cc_loop_hoist_block(opt, info, ((cc_loop *)stmt)->block);
+        }
+        break;
+    case CC_SIMPLE:
+        cc_loop_hoist_expr(opt, info, &((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN:
+        cc_loop_hoist_expr(opt, info, &((cc_return *)stmt)->expr);
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_loop_hoist_block(cc_opt * opt, cc_loopinfo * info,
+    cc_block * block) {
+
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    for (var = block->vars; var; var = var->next) {
+        cc_loop_hoist_expr(opt, info, &var->init);
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_loop_hoist_stmt(opt, info, stmt);
+    }
+}
+
+/* Optimizes the loop at '*link'.  Small loops with a constant trip count are
+ * fully unrolled.  Otherwise, invariant code is hoisted, induction variable
+ * multiplies are strength-reduced, and loops with a larger constant trip
+ * count are partially unrolled.  Returns the link holding the loop (or the
+ * code that replaced it) after any code inserted before it. */
+cc_stmt ** cc_loop_opt(cc_opt * opt, cc_stmt ** link) {
+    int trips = 0;
+    link = cc_loop_hoist(opt, link);
+    trips = cc_loop_trips((cc_loop *)*link, CC_DCPU_WORDS);
+    if (trips >= 0 && trips <= opt->unroll_max
+        && cc_loop_unroll(opt, link, trips)) {
+        return link;
+    }
+    link = cc_loop_reduce(opt, link);
+    if (trips > opt->unroll_max) {
+        cc_loop_unroll(opt, link, trips);
+    }
+    return link;
+}
+
+/* Hoists loop-invariant expressions out of the loop at '*link' */
+cc_stmt ** cc_loop_hoist(cc_opt * opt, cc_stmt ** link) {
+    cc_loop * loop = (cc_loop *)*link;
+    cc_loopinfo info;
+    memset(&info, 0, sizeof(info));
+
+    cc_loop_scan_stmt(&info, (cc_stmt *)loop);
+    info.link = link;
+    cc_loop_hoist_expr(opt, &info, &loop->guard);
+    cc_loop_hoist_expr(opt, &info, &loop->update);
+    if (loop->block) {
+        cc_loop_hoist_block(opt, &info, loop->block);
+    }
+    free(info.killed.ids);
+    return info.link;
+}
+
+/* If 'expr' is 'i * k' or 'k * i' for the induction variable i and a
+ * constant k, stores k and returns non-zero. */
+static int cc_loop_scaled(cc_reduction * red, cc_expr * expr, int * factor) {
+    cc_binary * binary = (cc_binary *)expr;
+    if (CC_REF == expr->node.type && red->id == ((cc_ref *)expr)->id) {
+        red->type = expr->type;
+        *factor = 1;
+        return 1;
+    }
+    if (CC_BINARY != expr->node.type || '*' != binary->op) {
+        return 0;
+    }
+    if (CC_REF == binary->left->node.type
+        && red->id == ((cc_ref *)binary->left)->id) {
+        red->type = binary->left->type;
+        return cc_expr_const(binary->right, factor);
+    }
+    if (CC_REF == binary->right->node.type
+        && red->id == ((cc_ref *)binary->right)->id) {
+        red->type = binary->right->type;
+        return cc_expr_const(binary->left, factor);
+    }
+    return 0;
+}
+
+/* Returns non-zero if 'expr' is a linear function of the induction variable
+ * worth keeping in a running sum: either 'i * k', or 'x + i * k' (and 'x + i')
+ * for a loop-invariant x, as in array indexing.  The sum is bumped with one
+ * read-modify-write ADD per iteration, so reading it must save more than
+ * that costs. */
+static int cc_loop_linear(cc_opt * opt, cc_reduction * red, cc_expr * expr,
+    int * factor) {
+
+    cc_binary * binary = (cc_binary *)expr;
+    cc_cost cost = { 0, 0 };
+    if (!expr->type || CC_BINARY != expr->node.type) {
+        return 0;
+    }
+    if ('*' == binary->op) {
+        if (!cc_loop_scaled(red, expr, factor)) {
+            return 0;
+        }
+    } else if ('+' == binary->op) {
+        if (cc_loop_scaled(red, binary->right, factor)) {
+            if (!cc_loop_invariant(opt, red->info, binary->left)) {
+                return 0;
+            }
+        } else if (cc_loop_scaled(red, binary->left, factor)) {
+            if (!cc_loop_invariant(opt, red->info, binary->right)) {
+                return 0;
+            }
+        } else {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+    cc_opt_expr_cost(expr, &cost);
+    return cost.cycles - 2 > cc_op_cycles(CC_OP_ADD) + 1;
+}
+
+/* Replaces linear functions of the induction variable in '*slot' with
+ * temporaries that track their value. */
+static void cc_loop_reduce_expr(cc_opt * opt, cc_reduction * red,
+    cc_expr ** slot) {
+
+    cc_expr * expr = *slot;
+    int factor = 0;
+    if (!expr) {
+        return;
+    }
+    if (cc_loop_linear(opt, red, expr, &factor)) {
+        cc_var * temp = 0;
+        cc_ref * ref = 0;
+        int i = 0;
+        for (i = 0; i < red->count; ++i) {
+            if (cc_expr_equal(red->exprs[i], expr)) {
+                temp = red->temps[i];
+            }
+        }
+        if (!temp && red->count < sizeof(red->temps)/sizeof(cc_var *)) {
+            temp = cc_opt_temp(opt, expr->node.line, expr->type);
+            red->exprs[red->count] = expr;
+            red->factors[red->count] = factor;
+            red->temps[red->count] = temp;
+            red->count++;
+        }
+        if (temp) {
+            ref = cc_ref_init(expr->node.line, temp->id);
+            ref->node.type = temp->type;
+            ref->node.next = expr->next;
+            expr->next = 0;
+            *slot = (cc_expr *)ref;
+            return;
+        }
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_loop_reduce_expr(opt, red, &((cc_member *)expr)->expr);
+        break;
+    case CC_BINARY:
+        if ('=' != ((cc_binary *)expr)->op
+            || CC_REF != ((cc_binary *)expr)->left->node.type) {
+            cc_loop_reduce_expr(opt, red, &((cc_binary *)expr)->left);
+        }
+        cc_loop_reduce_expr(opt, red, &((cc_binary *)expr)->right);
+        break;
+    case CC_UNARY:
+        if ('&' != ((cc_unary *)expr)->op) {
+            cc_loop_reduce_expr(opt, red, &((cc_unary *)expr)->expr);
+        }
+        break;
+    case CC_CALL: {
+        cc_expr ** arg = &((cc_call *)expr)->args;
+        for (; *arg; arg = &(*arg)->next) {
+            cc_loop_reduce_expr(opt, red, arg);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void cc_loop_reduce_stmt(cc_opt * opt, cc_reduction * red,
+    cc_stmt * stmt) {
+
+    cc_var * var = 0;
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+            cc_loop_reduce_expr(opt, red, &var->init);
+        }
+        for (stmt = ((cc_block *)stmt)->stmts; stmt; stmt = stmt->next) {
+            cc_loop_reduce_stmt(opt, red, stmt);
+        }
+        break;
+    case CC_IF:
+        cc_loop_reduce_expr(opt, red, &((cc_if *)stmt)->guard);
+        cc_loop_reduce_stmt(opt, red, ((cc_if *)stmt)->yes);
+        cc_loop_reduce_stmt(opt, red, ((cc_if *)stmt)->no);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_loop_reduce_expr(opt, red, &((cc_loop *)stmt)->init);
+        cc_loop_reduce_expr(opt, red, &((cc_loop *)stmt)->guard);
+        cc_loop_reduce_expr(opt, red, &((cc_loop *)stmt)->update);
+        cc_loop_reduce_stmt(opt, red, (cc_stmt *)((cc_loop *)stmt)->block);
+        break;
+    case CC_SIMPLE:
+        cc_loop_reduce_expr(opt, red, &((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN:
+        cc_loop_reduce_expr(opt, red, &((cc_return *)stmt)->expr);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Inserts 'stmt' before the statement at '*link', returning the link that
+ * now holds the original statement. */
+static cc_stmt ** cc_loop_insert(cc_stmt ** link, cc_stmt * stmt) {
+    stmt->next = *link;
+    *link = stmt;
+    return &stmt->next;
+}
+
+/* Strength-reduces linear functions of the loop's induction variable.  Each
+ * one becomes a temporary that is computed after the loop's init expression
+ * and bumped by the scaled step in the loop update, which turns 'a + i * 4'
+ * indexing into a pointer increment. */
+cc_stmt ** cc_loop_reduce(cc_opt * opt, cc_stmt ** link) {
+    cc_loop * loop = (cc_loop *)*link;
+    cc_loopinfo body;
+    cc_loopinfo info;
+    cc_reduction red;
+    int step = 0;
+    int line = loop->node.node.line;
+    int i = 0;
+
+    memset(&red, 0, sizeof(red));
+    if (opt->level < 1 || !cc_loop_induction(loop, &red.id, &step)) {
+        return link;
+    }
+    if (!cc_idset_has(&opt->locals, red.id)
+        || cc_idset_has(&opt->addressed, red.id)) {
+        return link;
+    }
+    memset(&body, 0, sizeof(body));
+    cc_loop_scan_expr(&body, loop->guard);
+    if (loop->block) {
+        cc_loop_scan_block(&body, loop->block);
+    }
+    if (cc_idset_has(&body.killed, red.id)) {
+        free(body.killed.ids);
+        return link;
+    }
+    free(body.killed.ids);
+
+    memset(&info, 0, sizeof(info));
+    cc_loop_scan_stmt(&info, (cc_stmt *)loop);
+    red.info = &info;
+    cc_loop_reduce_expr(opt, &red, &loop->guard);
+    cc_loop_reduce_stmt(opt, &red, (cc_stmt *)loop->block);
+    free(info.killed.ids);
+
+    for (i = 0; i < red.count; ++i) {
+        cc_var * temp = red.temps[i];
+        cc_ref * lhs = cc_ref_init(line, temp->id);
+        cc_ref * var = cc_ref_init(line, temp->id);
+        cc_number * inc = cc_number_init(line, cc_word(step * red.factors[i]));
+        cc_binary * init = 0;
+        cc_binary * sum = 0;
+
+        lhs->node.type = temp->type;
+        init = cc_binary_init(line, '=', (cc_expr *)lhs, red.exprs[i]);
+        if (loop->init) {
+            init = cc_binary_init(line, ',', loop->init, (cc_expr *)init);
+            loop->init = (cc_expr *)init;
+        } else {
+            link = cc_loop_insert(link, (cc_stmt *)cc_simple_init(line,
+                (cc_expr *)init));
+        }
+
+        lhs = cc_ref_init(line, temp->id);
+        lhs->node.type = var->node.type = temp->type;
+        inc->node.type = red.type;
+        sum = cc_binary_init(line, '+', (cc_expr *)var, (cc_expr *)inc);
+        sum = cc_binary_init(line, '=', (cc_expr *)lhs, (cc_expr *)sum);
+        loop->update = (cc_expr *)cc_binary_init(line, ',', loop->update,
+            (cc_expr *)sum);
+        opt->reduced++;
+    }
+    return link;
+}
+
+/* Unrolls the loop at '*link', which runs 'trips' times.  Loops that fit in
+ * the unroll limits are replaced entirely by copies of their body; larger
+ * loops have their body replicated by a factor that divides the trip count,
+ * so no remainder loop is needed.  All growth is charged to the optimizer's
+ * code size budget.  Returns non-zero if the loop was unrolled. */
+int cc_loop_unroll(cc_opt * opt, cc_stmt ** link, int trips) {
+    cc_loop * loop = (cc_loop *)*link;
+    cc_loopinfo info;
+    cc_cost body = { 0, 0 };
+    cc_block * block = 0;
+    cc_stmt ** slink = 0;
+    cc_id * id = 0;
+    int step = 0;
+    int factor = 0;
+    int line = loop->node.node.line;
+    int i = 0;
+
+    if (opt->level < 2 || CC_FOR != loop->node.node.type) {
+        return 0;
+    }
+    if (!cc_loop_induction(loop, &id, &step)) {
+        return 0;
+    }
+    memset(&info, 0, sizeof(info));
+    cc_loop_scan_expr(&info, loop->guard);
+    if (loop->block) {
+        cc_loop_scan_block(&info, loop->block);
+    }
+    if (cc_idset_has(&info.killed, id)) {
+        free(info.killed.ids);
+        return 0;
+    }
+    free(info.killed.ids);
+
+    if (loop->block) {
+        cc_opt_block_cost(loop->block, &body);
+    }
+    cc_opt_expr_cost(loop->update, &body);
+    block = cc_block_init(line);
+    slink = &block->stmts;
+
+    if (trips <= opt->unroll_max) {
+        if (trips * body.words > opt->unroll_size) {
+            return 0;
+        }
+        if (loop->site && opt->env->pgo && opt->env->pgo->generate) {
+            return 0; /* The copies wouldn't count the loop's runs */
+        }
+        if ((trips - 1) * body.words > opt->budget) {
+            return 0;
+        }
+        opt->budget -= (trips > 0) ? (trips - 1) * body.words : 0;
+        if (loop->init) {
+            *slink = (cc_stmt *)cc_simple_init(line, loop->init);
+            slink = &(*slink)->next;
+        }
+        for (i = 0; i < trips; ++i) {
+            if (loop->block) {
+                *slink = (cc_stmt *)cc_block_copy(loop->block);
+                slink = &(*slink)->next;
+            }
+            *slink = (cc_stmt *)cc_simple_init(line,
+                cc_expr_copy(loop->update));
+            slink = &(*slink)->next;
+        }
+        block->node.next = loop->node.next;
+        *link = (cc_stmt *)block;
+        opt->unrolled++;
+        return 1;
+    }
+
+    for (factor = opt->unroll_max; factor >= 2; --factor) {
+        if (!(trips % factor) && factor * body.words <= opt->unroll_size) {
+            break;
+        }
+    }
+    if (factor < 2 || (factor - 1) * body.words > opt->budget) {
+        return 0;
+    }
+    opt->budget -= (factor - 1) * body.words;
+    for (i = 0; i < factor; ++i) {
+        if (i > 0) {
+            *slink = (cc_stmt *)cc_simple_init(line,
+                cc_expr_copy(loop->update));
+            slink = &(*slink)->next;
+        }
+        if (loop->block) {
+            *slink = (cc_stmt *)cc_block_copy(loop->block);
+            slink = &(*slink)->next;
+        }
+    }
+    loop->block = block;
+    loop->unroll = factor;
+    opt->unrolled++;
+    return 1;
+}
+
+/* Returns the number of times the loop body runs, or -1 if the trip count
+ * isn't a compile-time constant no larger than 'max'.  The loop must have the
+ * form 'for (i = c0; i op c1; i = i + step)', with 'i' an int or unsigned,
+ * and the comparison is simulated with the signedness the code generator
+ * gives it.  The caller is responsible for checking that the body doesn't
+ * assign 'i'. */
+int cc_loop_trips(cc_loop * self, int max) {
+    cc_binary * init = (cc_binary *)self->init;
+    cc_binary * guard = (cc_binary *)self->guard;
+    cc_id * id = 0;
+    int step = 0;
+    int value = 0;
+    int limit = 0;
+    int trips = 0;
+    int sign = 0;
+
+    if (!cc_loop_induction(self, &id, &step)) {
+        return -1;
+    }
+    while (init && CC_BINARY == init->node.node.type && ',' == init->op) {
+        init = (cc_binary *)init->left;
+    }
+    if (!init || CC_BINARY != init->node.node.type || '=' != init->op
+        || CC_REF != init->left->node.type || id != ((cc_ref *)init->left)->id
+        || !cc_expr_const(init->right, &value)) {
+        return -1;
+    }
+    if (!guard || CC_BINARY != guard->node.node.type
+        || CC_REF != guard->left->node.type
+        || id != ((cc_ref *)guard->left)->id
+        || !cc_expr_const(guard->right, &limit)) {
+        return -1;
+    }
+    switch (guard->op) {
+    case '<': case '>': case CC_TOK_LE: case CC_TOK_GE: case CC_TOK_NE:
+        break;
+    default:
+        return -1;
+    }
+    if (!guard->left->type || !guard->right->type
+        || cc_type_isptr(guard->left->type) || cc_type_islong(guard->left->type)
+        || cc_type_islong(guard->right->type)) {
+        return -1;
+    }
+    sign = !cc_type_isunsigned(guard->left->type)
+        && !cc_type_isunsigned(guard->right->type);
+    value = sign ? cc_word(value) : value & 0xffff;
+    limit = sign ? cc_word(limit) : limit & 0xffff;
+    while (1) {
+        int test = 0;
+        switch (guard->op) {
+        case '<': test = value < limit; break;
+        case '>': test = value > limit; break;
+        case CC_TOK_LE: test = value <= limit; break;
+        case CC_TOK_GE: test = value >= limit; break;
+        default: test = value != limit; break;
+        }
+        if (!test) {
+            return trips;
+        }
+        if (++trips > max) {
+            return -1;
+        }
+        value = sign ? cc_word(value + step) : (value + step) & 0xffff;
+    }
+}
+
+/* Matches an update expression of the form 'i = i + c', 'i = c + i' or
+ * 'i = i - c', possibly followed by the updates of reduced temporaries.  On success, stores the induction variable and the constant
+ * step, and returns non-zero. */
+int cc_loop_induction(cc_loop * self, cc_id ** id, int * step) {
+    cc_binary * update = (cc_binary *)self->update;
+    cc_binary * sum = 0;
+    cc_ref * var = 0;
+    int value = 0;
+
+    while (update && CC_BINARY == update->node.node.type
+        && ',' == update->op) {
+        update = (cc_binary *)update->left; /* Added by strength reduction */
+    }
+    if (!update || CC_BINARY != update->node.node.type || '=' != update->op
+        || CC_REF != update->left->node.type
+        || cc_type_islong(update->left->type)) {
+        return 0;
+    }
+    var = (cc_ref *)update->left;
+    sum = (cc_binary *)update->right;
+    if (!sum || CC_BINARY != sum->node.node.type) {
+        return 0;
+    }
+    if ('+' == sum->op) {
+        if (CC_REF == sum->left->node.type
+            && var->id == ((cc_ref *)sum->left)->id
+            && cc_expr_const(sum->right, &value)) {
+            *step = value;
+        } else if (CC_REF == sum->right->node.type
+            && var->id == ((cc_ref *)sum->right)->id
+            && cc_expr_const(sum->left, &value)) {
+            *step = value;
+        } else {
+            return 0;
+        }
+    } else if ('-' == sum->op && CC_REF == sum->left->node.type
+        && var->id == ((cc_ref *)sum->left)->id
+        && cc_expr_const(sum->right, &value)) {
+        *step = cc_word(-value);
+    } else {
+        return 0;
+    }
+    *id = var->id;
+    return 0 != *step;
+}
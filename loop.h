@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_LOOP_H
+#define CC_LOOP_H
+
+#include "opt.h"
+
+/* Loop facts gathered before transforming a loop.  'killed' holds the names
+ * that may change while the loop runs. */
+typedef struct cc_loopinfo {
+    cc_idset killed;
+    int calls; /* The loop contains a call */
+    int stores; /* The loop stores through a pointer */
+    cc_stmt ** link; /* Hoisted code is inserted here, before the loop */
+    cc_expr * hoisted[16]; /* Invariant expressions already hoisted */
+    cc_var * temps[16]; /* Temporaries holding 'hoisted' */
+    int count;
+} cc_loopinfo;
+
+cc_stmt ** cc_loop_opt(cc_opt * opt, cc_stmt ** link);
+cc_stmt ** cc_loop_hoist(cc_opt * opt, cc_stmt ** link);
+cc_stmt ** cc_loop_reduce(cc_opt * opt, cc_stmt ** link);
+int cc_loop_unroll(cc_opt * opt, cc_stmt ** link, int trips);
+int cc_loop_trips(cc_loop * self, int max);
+int cc_loop_induction(cc_loop * self, cc_id ** id, int * step);
+
+#endif
@@ -22,28 +22,436 @@
 
 #include "lexer.h"
 #include "parser.h"
+#include "check.h"
+#include "opt.h"
+#include "gen.h"
+#include "pool.h"
+#include "asm.h"
+#include "estimate.h"
+#include "pgo.h"
+#include "report.h"
+#include "peep.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 void usage() {
-    printf("Usage: dcpu16cc [file]\n");
+    printf("Usage: dcpu16cc [-O<level>] [-Os] [-v] [-p] [-S] [-c] "
+        "[-g] [-fpack-strings] [-fexport=name] [-fcycles[=json]] "
+        "[-fprofile-generate] [-fprofile-use=file] [-fno-peephole] "
+        "[-fpeephole-check] [-fselect=burs|simple] "
+        "[-ftime-report[=json]] [-fmem-report[=json]] [-j threads] "
+        "[-o out] file... [@file]\n");
 }
 
-int main(int argc, char ** argv) {
-    if (argc < 2) {
-        usage();
-    } else {
-/*
-        cc_lexer * lex = cc_lexer_init(0, argv[1]);
-        while (lex->token != CC_TOK_EOF) {
-            cc_lexer_next(lex);
-            printf("%s\n", lex->value);
-        }
-*/
-        cc_env * env = calloc(1, sizeof(cc_env));
-        cc_parser * parser = cc_parser_init(env, argv[1]);
+/* Options shared by every input file */
+typedef struct ccopts {
+    int level;
+    int verbose;
+    int ast;
+    int packed;
+    int object;
+    int size;
+    int cycles; /* 1 for a listing, 2 for JSON */
+    int lines;
+    int generate; /* -fprofile-generate */
+    char const * profile; /* -fprofile-use */
+    int peephole;
+    int verify; /* -fpeephole-check */
+    int burs; /* -fselect= */
+    int threads; /* -j, or one per processor if 0 */
+    char const ** exports;
+    int nexports;
+} ccopts;
+
+/* Arguments, with response files expanded */
+typedef struct ccargs {
+    char ** args;
+    int count;
+    int capacity;
+} ccargs;
+
+static void arg(ccargs * self, char * arg) {
+    if (self->count >= self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 16;
+        self->args = realloc(self->args, self->capacity * sizeof(char *));
+    }
+    self->args[self->count++] = arg;
+}
+
+/* Appends the arguments in the response file 'name', which are separated
+ * by white space.  Returns 0 if the file can't be read. */
+static int response(ccargs * self, char const * name) {
+    FILE * in = fopen(name, "r");
+    char * text = 0;
+    char * word = 0;
+    long length = 0;
+    if (!in) {
+        return 0;
+    }
+    fseek(in, 0, SEEK_END);
+    length = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    text = calloc(length + 1, 1);
+    length = (long)fread(text, 1, length, in);
+    fclose(in);
+    text[length] = '\0';
+    for (word = strtok(text, " \t\r\n"); word; word = strtok(0, " \t\r\n")) {
+        arg(self, word);
+    }
+    return 1;
+}
+
+/* State of one unit.  All of it but the identifier table is freed once the
+ * unit is emitted, so that a batch doesn't hold every unit in memory. */
+typedef struct ccunit {
+    cc_env * env;
+    cc_parser * parser;
+    cc_check * check;
+    cc_opt * opt;
+    cc_gen * gen;
+    cc_asm * as;
+    char * name; /* Object named after the source file, with -c */
+} ccunit;
+
+static void unit_free(ccunit * self) {
+    if (self->parser) {
+        cc_parser_free(self->parser);
+    }
+    if (self->check) {
+        cc_check_free(self->check);
+    }
+    if (self->opt) {
+        cc_opt_free(self->opt);
+    }
+    if (self->gen) {
+        cc_gen_free(self->gen);
+    }
+    if (self->as) {
+        cc_asm_free(self->as);
+    }
+    if (self->env->pgo) {
+        cc_pgo_free(self->env->pgo);
+    }
+    cc_ast_free();
+    free(self->name);
+    free(self->env);
+}
+
+/* Begins timing 'phase' of the unit in 'env', if there is a report */
+static void phase(cc_env * env, int phase) {
+    if (env->report) {
+        cc_report_phase(env->report, phase);
+    }
+}
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+/* Compiles 'file' in the fresh environment of 'unit' into 'out', or to
+ * stdout if 'out' is 0.  Returns non-zero on error. */
+static int compile(ccopts * opts, ccunit * unit, char const * file,
+    char const * out) {
+
+    cc_env * env = unit->env;
+    cc_parser * parser = 0;
+    cc_check * check = 0;
+    cc_opt * opt = 0;
+    int i = 0;
+
+    phase(env, CC_PHASE_PARSE);
+    parser = unit->parser = cc_parser_init(env, file);
+    check = unit->check = cc_check_init(env);
+    opt = unit->opt = cc_opt_init(env, opts->level);
+    while (CC_TOK_EOF != parser->lexer->token) {
         cc_parser_global(parser);
+    }
+    if (env->report) {
+        env->report->lines += parser->lexer->line;
+        cc_report_nodes(env->report, env, 0);
+    }
+    if (parser->errors || parser->lexer->errors) {
+        return 1;
+    }
+    phase(env, CC_PHASE_CHECK);
+    cc_check_env(check);
+    if (check->errors) {
+        return 1;
+    }
+    phase(env, CC_PHASE_OPT);
+    if (opts->generate || opts->profile) {
+        env->pgo = cc_pgo_init(env);
+        env->pgo->generate = opts->generate;
+    }
+    if (opts->profile && !cc_pgo_load(env->pgo, opts->profile)) {
+        fprintf(stderr, "Could not read profile %s\n", opts->profile);
+        return 1;
+    }
+    if (opts->profile && opts->verbose) {
+        fprintf(stderr, "pgo: %d functions profiled, %d stale\n",
+            env->pgo->matched, env->pgo->stale);
+    }
+    opt->verbose = opts->verbose;
+    opt->object = opts->object;
+    for (i = 0; i < opts->nexports; ++i) {
+        cc_idset_add(&opt->roots, cc_env_id(env, opts->exports[i]));
+    }
+    cc_opt_env(opt);
+    if (env->report) {
+        cc_report_nodes(env->report, env, 1);
+    }
+    if (opts->ast) {
+        phase(env, CC_PHASE_EMIT);
         cc_env_print(env);
+    } else {
+        cc_gen * gen = 0;
+        phase(env, CC_PHASE_GEN);
+        gen = unit->gen = cc_gen_init(env);
+        gen->level = opts->level;
+        gen->verbose = opts->verbose;
+        gen->pool->packed = opts->packed;
+        gen->object = opts->object;
+        gen->size = opts->size;
+        gen->burs = opts->burs && opts->level >= 1;
+        gen->peephole = opts->peephole && opts->level >= 1;
+        gen->check = opts->verify && !opts->object;
+        gen->threads = opts->threads > 0 ? opts->threads
+            : (int)sysconf(_SC_NPROCESSORS_ONLN);
+        cc_gen_env(gen);
+        if (gen->errors) {
+            return 1;
+        }
+        phase(env, CC_PHASE_EMIT);
+        if (opts->cycles) {
+            /* The estimate replaces the assembly on stdout */
+            cc_estimate * estimate = cc_estimate_init(gen);
+            cc_estimate_env(estimate);
+            if (1 == opts->cycles) {
+                cc_estimate_listing(estimate, file, stdout);
+            } else {
+                cc_estimate_json(estimate, file, stdout);
+            }
+            cc_estimate_free(estimate);
+        }
+        if (opts->object && !out) {
+            /* Name the object after the source file */
+            char * name = malloc(strlen(file) + 3);
+            char * dot = 0;
+            strcpy(name, file);
+            dot = strrchr(name, '.');
+            strcpy(dot && !strchr(dot, '/') ? dot : name + strlen(name),
+                ".o");
+            out = unit->name = name;
+        }
+        if (out) {
+            cc_asm * as = unit->as = cc_asm_init(env);
+            FILE * fd = 0;
+            cc_gen_assemble(gen, as);
+            if (!opts->object) {
+                cc_asm_link(as);
+            }
+            if (as->errors) {
+                return 1;
+            }
+            /* '-o -' writes the image or object to stdout */
+            fd = strcmp(out, "-") ? fopen(out, "wb") : stdout;
+            if (!fd) {
+                fprintf(stderr, "Could not open %s\n", out);
+                return 1;
+            }
+            if (opts->object) {
+                cc_asm_object(as, fd);
+            } else {
+                cc_asm_write(as, fd);
+            }
+            if (stdout == fd) {
+                fflush(fd);
+            } else {
+                fclose(fd);
+            }
+            if (as->errors) {
+                return 1;
+            }
+            if ((opts->generate || opts->lines) && !strcmp(out, "-")) {
+                fprintf(stderr, "warning: -fprofile-generate and -g need a "
+                    "named output file\n");
+            } else if (opts->generate && opts->object) {
+                fprintf(stderr, "warning: -fprofile-generate needs a "
+                    "linked image\n");
+            } else if (opts->generate) {
+                /* The counter map goes next to the image */
+                char * name = malloc(strlen(out) + 9);
+                sprintf(name, "%s.profmap", out);
+                fd = fopen(name, "w");
+                if (!fd) {
+                    fprintf(stderr, "Could not open %s\n", name);
+                    free(name);
+                    return 1;
+                }
+                cc_pgo_map(env->pgo, as, fd);
+                fclose(fd);
+                free(name);
+            }
+            if (opts->lines && opts->object) {
+                fprintf(stderr, "warning: -g needs a linked image\n");
+            } else if (opts->lines && strcmp(out, "-")) {
+                /* The line table goes next to the image */
+                char * name = malloc(strlen(out) + 7);
+                sprintf(name, "%s.lines", out);
+                fd = fopen(name, "w");
+                if (!fd) {
+                    fprintf(stderr, "Could not open %s\n", name);
+                    free(name);
+                    return 1;
+                }
+                cc_asm_lines(as, fd, file);
+                fclose(fd);
+                free(name);
+            }
+        } else if (!opts->cycles) {
+            cc_gen_print(gen, stdout);
+        }
+        if (opts->verify && opts->object) {
+            fprintf(stderr, "warning: -fpeephole-check needs a linked "
+                "image\n");
+        } else if (opts->verify && !cc_peep_check(gen)) {
+            return 1;
+        }
     }
     return 0;
 }
+
+/* Compiles each input file in turn, in one process.  With several inputs,
+ * each object is named after its source with -c, and assembly goes to
+ * stdout otherwise.  A file that fails doesn't stop the others. */
+int main(int argc, char ** argv) {
+    ccopts opts;
+    ccargs args;
+    char const ** files = 0;
+    int nfiles = 0;
+    char const * out = 0;
+    cc_ids ids;
+    cc_report * report = 0; /* -ftime-report and -fmem-report */
+    double start = 0;
+    double total = 0;
+    int failed = 0;
+    int i = 0;
+
+    memset(&opts, 0, sizeof(opts));
+    memset(&ids, 0, sizeof(ids));
+    memset(&args, 0, sizeof(args));
+    opts.peephole = 1;
+    opts.burs = 1;
+    opts.threads = 1;
+    for (i = 1; i < argc; ++i) {
+        if ('@' == argv[i][0] && !response(&args, argv[i] + 1)) {
+            fprintf(stderr, "Could not read %s\n", argv[i] + 1);
+            return 1;
+        } else if ('@' != argv[i][0]) {
+            arg(&args, argv[i]);
+        }
+    }
+    opts.exports = calloc(args.count + 1, sizeof(char const *));
+    files = calloc(args.count + 1, sizeof(char const *));
+
+    for (i = 0; i < args.count; ++i) {
+        char const * a = args.args[i];
+        if (!strcmp(a, "-Os")) {
+            opts.level = 1;
+            opts.size = 1;
+        } else if (!strncmp(a, "-O", 2)) {
+            opts.level = a[2] ? atoi(a + 2) : 1;
+        } else if (!strcmp(a, "-v")) {
+            opts.verbose = 1;
+        } else if (!strcmp(a, "-p")) {
+            opts.ast = 1;
+        } else if (!strcmp(a, "-fpack-strings")) {
+            opts.packed = 1;
+        } else if (!strncmp(a, "-fexport=", 9)) {
+            opts.exports[opts.nexports++] = a + 9;
+        } else if (!strcmp(a, "-fcycles")) {
+            opts.cycles = 1;
+        } else if (!strcmp(a, "-fcycles=json")) {
+            opts.cycles = 2;
+        } else if (!strcmp(a, "-fprofile-generate")) {
+            opts.generate = 1;
+        } else if (!strncmp(a, "-fprofile-use=", 14)) {
+            opts.profile = a + 14;
+        } else if (!strcmp(a, "-fno-peephole")) {
+            opts.peephole = 0;
+        } else if (!strcmp(a, "-fpeephole-check")) {
+            opts.verify = 1;
+        } else if (!strcmp(a, "-fselect=burs")) {
+            opts.burs = 1;
+        } else if (!strcmp(a, "-fselect=simple")) {
+            opts.burs = 0;
+        } else if (!strcmp(a, "-ftime-report")
+            || !strcmp(a, "-ftime-report=json")) {
+            report = report ? report : cc_report_init();
+            report->time = 1;
+            report->json |= !strcmp(a + 13, "=json");
+        } else if (!strcmp(a, "-fmem-report")
+            || !strcmp(a, "-fmem-report=json")) {
+            report = report ? report : cc_report_init();
+            report->mem = 1;
+            report->json |= !strcmp(a + 12, "=json");
+        } else if (!strcmp(a, "-j") && i + 1 < args.count) {
+            opts.threads = atoi(args.args[++i]);
+        } else if (!strcmp(a, "-g")) {
+            opts.lines = 1;
+        } else if (!strcmp(a, "-S")) {
+            out = 0;
+            opts.object = 0;
+        } else if (!strcmp(a, "-c")) {
+            opts.object = 1;
+        } else if (!strcmp(a, "-o") && i + 1 < args.count) {
+            out = args.args[++i];
+        } else {
+            files[nfiles++] = a;
+        }
+    }
+
+    if (!nfiles || (opts.generate && opts.profile)) {
+        usage();
+        return 0;
+    } else if (nfiles > 1 && out) {
+        fprintf(stderr, "-o needs a single input file\n");
+        return 1;
+    }
+    for (i = 0; i < nfiles; ++i) {
+        /* Only the identifier table outlives a unit */
+        ccunit unit;
+        memset(&unit, 0, sizeof(unit));
+        unit.env = calloc(1, sizeof(cc_env));
+        unit.env->ids = ids;
+        unit.env->report = report;
+        start = now();
+        if (compile(&opts, &unit, files[i], out)) {
+            failed++;
+        }
+        ids = unit.env->ids;
+        if (report) {
+            cc_report_phase(report, -1);
+            report->units++;
+        }
+        unit_free(&unit);
+        total += now() - start;
+        if (opts.verbose) {
+            fprintf(stderr, "batch: %s %.1f ms\n", files[i],
+                (now() - start) * 1e3);
+        }
+    }
+    if (opts.verbose && nfiles > 1) {
+        fprintf(stderr, "batch: %d files, %d failed, %.1f ms\n", nfiles,
+            failed, total * 1e3);
+    }
+    if (report) {
+        cc_report_print(report, stderr);
+    }
+    return failed ? 1 : 0;
+}
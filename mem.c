@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "mem.h"
+#include "frame.h"
+#include "opt.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Registers stepped by STI */
+#define CC_MEM_REGS ((1 << CC_REG_I) | (1 << CC_REG_J))
+
+/* Returns non-zero if 'call' is a call to memcpy or memset that is expanded
+ * inline */
+int cc_mem_builtin(cc_gen * self, cc_call * call) {
+    return cc_gen_calls(self, call, "memcpy", 3)
+        || cc_gen_calls(self, call, "memset", 3);
+}
+
+/* Keeps I and J from being allocated to temporaries.  Returns the bits
+ * that were free, and sets 'mem->live' to the ones that hold values. */
+static int cc_mem_reserve(cc_gen * self, cc_mem * mem) {
+    int avail = CC_MEM_REGS & ~self->used;
+    mem->live = (~avail | self->vars) & CC_MEM_REGS;
+    if (self->fp) {
+        mem->live |= (1 << CC_REG_J);
+    }
+    self->used |= CC_MEM_REGS;
+    return avail;
+}
+
+/* Moves 'value' to a register other than I and J unless it is a literal, so
+ * that it survives the pushes and the changes to I and J that follow */
+static cc_operand cc_mem_place(cc_gen * self, cc_operand value) {
+    if (CC_VAL_LIT == value.mode || (CC_VAL_REG == value.mode
+        && !(CC_MEM_REGS & (1 << value.reg)))) {
+        return value;
+    }
+    return cc_gen_load(self, value);
+}
+
+/* Returns non-zero if 'value' is a register the block operation may
+ * overwrite */
+static int cc_mem_owned(cc_gen * self, cc_operand * value) {
+    return CC_VAL_REG == value->mode && !(self->vars & (1 << value->reg));
+}
+
+/* Returns the word 'k' words past address 'addr' */
+static cc_operand cc_mem_at(cc_operand addr, int k) {
+    if (CC_VAL_REG == addr.mode) {
+        return cc_opd_off(addr.reg, k);
+    }
+    addr.mode = CC_VAL_MEM;
+    addr.value += k;
+    return addr;
+}
+
+/* Emits an instruction, or if 'cost' is non-null, adds the cost of running
+ * it 'times' times */
+static void cc_mem_emit(cc_gen * self, cc_cost * cost, long times, int op,
+    cc_operand b, cc_operand a) {
+    cc_inst inst;
+    if (!cost) {
+        cc_gen_emit(self, op, b, a);
+        return;
+    }
+    memset(&inst, 0, sizeof(inst));
+    inst.op = op;
+    inst.b = b;
+    inst.a = a;
+    cost->words += cc_inst_words(&inst);
+    cost->cycles += times * cc_inst_cycles(&inst);
+}
+
+/* Saves I and J if they hold values, then points J at the destination and I
+ * at the source.  A fill that loops counts the words in I instead. */
+static void cc_mem_enter(cc_gen * self, cc_mem * mem, int loop,
+    cc_cost * cost) {
+    cc_operand push = cc_opd_special(CC_VAL_PUSHPOP);
+    cc_operand i = cc_opd_reg(CC_REG_I);
+    int reg = 0;
+    for (reg = CC_REG_I; reg <= CC_REG_J; ++reg) {
+        if (mem->live & (1 << reg)) {
+            cc_mem_emit(self, cost, 1, CC_OP_SET, push, cc_opd_reg(reg));
+        }
+    }
+    if (mem->copy) {
+        cc_mem_emit(self, cost, 1, CC_OP_SET, i, mem->src);
+    } else if (loop) {
+        cc_mem_emit(self, cost, 1, CC_OP_SET, i, cc_opd_lit(0));
+    }
+    cc_mem_emit(self, cost, 1, CC_OP_SET, cc_opd_reg(CC_REG_J), mem->dst);
+}
+
+/* Restores I and J */
+static void cc_mem_leave(cc_gen * self, cc_mem * mem, cc_cost * cost) {
+    cc_operand pop = cc_opd_special(CC_VAL_PUSHPOP);
+    int reg = 0;
+    for (reg = CC_REG_J; reg >= CC_REG_I; --reg) {
+        if (mem->live & (1 << reg)) {
+            cc_mem_emit(self, cost, 1, CC_OP_SET, cc_opd_reg(reg), pop);
+        }
+    }
+}
+
+/* Returns the value of I once a loop is done: the end of the source for a
+ * copy, or the number of words for a fill */
+static cc_operand cc_mem_end(cc_gen * self, cc_mem * mem, cc_cost * cost) {
+    cc_operand end = mem->src;
+    if (!mem->copy) {
+        return cc_opd_lit(mem->words);
+    } else if (CC_VAL_LIT == end.mode) {
+        end.value += mem->words;
+        return end;
+    } else if (!cc_mem_owned(self, &end)) {
+        if (!cost) {
+            end = cc_opd_reg(cc_gen_alloc(self));
+        }
+        cc_mem_emit(self, cost, 1, CC_OP_SET, end, mem->src);
+    }
+    cc_mem_emit(self, cost, 1, CC_OP_ADD, end, cc_opd_lit(mem->words));
+    return end;
+}
+
+/* Generates a block operation of constant size, or if 'cost' is non-null,
+ * adds up its cost instead.  With 'factor' 0, each word is stored by an
+ * indexed SET, which needs neither I nor J; with 'factor' 1, by its own
+ * STI.  Larger factors loop over runs of that many STIs, after doing the
+ * remainder. */
+static void cc_mem_fixed(cc_gen * self, cc_mem * mem, int factor,
+    cc_cost * cost) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    cc_operand j = cc_opd_ind(CC_REG_J);
+    cc_operand value = mem->copy ? cc_opd_ind(CC_REG_I) : mem->src;
+    cc_operand end;
+    int trips = factor > 1 ? mem->words / factor : 1;
+    int rest = factor > 1 ? mem->words % factor : mem->words;
+    int top = 0;
+    int k = 0;
+
+    if (!factor) {
+        for (k = 0; k < mem->words; ++k) {
+            cc_mem_emit(self, cost, 1, CC_OP_SET, cc_mem_at(mem->dst, k),
+                mem->copy ? cc_mem_at(mem->src, k) : mem->src);
+        }
+        return;
+    }
+    cc_mem_enter(self, mem, factor > 1, cost);
+    for (k = 0; k < rest; ++k) {
+        cc_mem_emit(self, cost, 1, CC_OP_STI, j, value);
+    }
+    if (factor > 1) {
+        end = cc_mem_end(self, mem, cost);
+        top = cost ? 1 : cc_code_label(self->code);
+        if (!cost) {
+            cc_code_place(self->code, top);
+        }
+        for (k = 0; k < factor; ++k) {
+            cc_mem_emit(self, cost, trips, CC_OP_STI, j, value);
+        }
+        cc_mem_emit(self, cost, trips, CC_OP_IFN, cc_opd_reg(CC_REG_I), end);
+        cc_mem_emit(self, cost, trips - 1, CC_OP_SET, pc, cc_opd_label(top));
+        if (cost) {
+            cost->cycles++; /* The last test fails */
+        } else if (!cc_operand_equal(&end, &mem->src)) {
+            cc_gen_release(self, end);
+        }
+    }
+    cc_mem_leave(self, mem, cost);
+}
+
+/* Generates a block operation whose size is only known at run time, as a
+ * loop of single STIs.  A copy turns the count into the end of the source,
+ * so 'mem->count' must be an owned register. */
+static void cc_mem_loop(cc_gen * self, cc_mem * mem) {
+    cc_operand pc = cc_opd_special(CC_VAL_PC);
+    cc_operand i = cc_opd_reg(CC_REG_I);
+    int top = cc_code_label(self->code);
+    int done = cc_code_label(self->code);
+    cc_mem_enter(self, mem, 1, 0);
+    if (mem->copy) {
+        cc_gen_emit(self, CC_OP_ADD, mem->count, i);
+    }
+    cc_gen_emit(self, CC_OP_IFE, i, mem->count);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(done));
+    cc_code_place(self->code, top);
+    cc_gen_emit(self, CC_OP_STI, cc_opd_ind(CC_REG_J),
+        mem->copy ? cc_opd_ind(CC_REG_I) : mem->src);
+    cc_gen_emit(self, CC_OP_IFN, i, mem->count);
+    cc_gen_emit(self, CC_OP_SET, pc, cc_opd_label(top));
+    cc_code_place(self->code, done);
+    cc_mem_leave(self, mem, 0);
+}
+
+/* Returns non-zero if 'cost' is better than 'best': no larger than
+ * CC_MEM_WORDS words if possible, then the fewest cycles, then the fewest
+ * words.  With 'size' set, the fewest words come first. */
+static int cc_mem_better(cc_cost * cost, cc_cost * best, int size) {
+    int big = cost->words > CC_MEM_WORDS;
+    if (size && cost->words != best->words) {
+        return cost->words < best->words;
+    } else if (big != (best->words > CC_MEM_WORDS)) {
+        return !big;
+    } else if (big || cost->cycles == best->cycles) {
+        return cost->words < best->words;
+    }
+    return cost->cycles < best->cycles;
+}
+
+/* Generates a block operation.  A constant size is done in whichever form
+ * the cycle model prefers. */
+static void cc_mem_expand(cc_gen * self, cc_mem * mem) {
+    static int const factors[] = { 0, 1, 2, 4, 8 };
+    cc_cost best;
+    cc_cost cost;
+    int choice = -1;
+    int i = 0;
+
+    self->blocks++;
+    if (CC_VAL_LIT != mem->count.mode || mem->count.sym
+        || mem->count.label) {
+        cc_mem_loop(self, mem);
+        return;
+    }
+    mem->words = mem->count.value;
+    if (mem->words <= 0) {
+        return;
+    }
+    for (i = 0; i < (int)(sizeof(factors) / sizeof(factors[0])); ++i) {
+        if (factors[i] > 1 && mem->words / factors[i] < 2) {
+            continue;
+        }
+        memset(&cost, 0, sizeof(cost));
+        cc_mem_fixed(self, mem, factors[i], &cost);
+        if (choice < 0 || cc_mem_better(&cost, &best, self->size)) {
+            best = cost;
+            choice = factors[i];
+        }
+    }
+    cc_mem_fixed(self, mem, choice, 0);
+}
+
+/* Generates an inline call to memcpy or memset, which returns the
+ * destination */
+cc_operand cc_mem_call(cc_gen * self, cc_call * call) {
+    cc_expr * arg = call->args;
+    cc_mem mem;
+    int avail = 0;
+    memset(&mem, 0, sizeof(mem));
+    avail = cc_mem_reserve(self, &mem);
+    mem.copy = !strcmp(((cc_ref *)call->expr)->id->str, "memcpy");
+    mem.dst = cc_mem_place(self, cc_gen_expr(self, arg));
+    mem.src = cc_mem_place(self, cc_gen_expr(self, arg->next));
+    mem.count = cc_mem_place(self, cc_gen_expr(self, arg->next->next));
+    if (mem.copy && CC_VAL_LIT != mem.count.mode
+        && !cc_mem_owned(self, &mem.count)) {
+        mem.count = cc_gen_load(self, mem.count);
+    }
+    cc_mem_expand(self, &mem);
+    cc_gen_release(self, mem.src);
+    cc_gen_release(self, mem.count);
+    self->used &= ~avail;
+    return mem.dst;
+}
+
+/* Generates an assignment of a value 'words' words wide.  Returns the
+ * address of the destination. */
+cc_operand cc_mem_copy(cc_gen * self, cc_expr * dst, cc_expr * src,
+    int words) {
+    cc_mem mem;
+    int avail = 0;
+    memset(&mem, 0, sizeof(mem));
+    avail = cc_mem_reserve(self, &mem);
+    mem.copy = 1;
+    mem.dst = cc_mem_place(self, cc_gen_addr(self, dst));
+    mem.src = cc_mem_place(self, cc_gen_addr(self, src));
+    mem.count = cc_opd_lit(words);
+    cc_mem_expand(self, &mem);
+    cc_gen_release(self, mem.src);
+    self->used &= ~avail;
+    return mem.dst;
+}
+
+/* Generates a fill of 'words' words at 'dst' with 'value' */
+void cc_mem_fill(cc_gen * self, cc_operand dst, cc_operand value,
+    int words) {
+    cc_mem mem;
+    int avail = 0;
+    memset(&mem, 0, sizeof(mem));
+    avail = cc_mem_reserve(self, &mem);
+    mem.dst = cc_mem_place(self, dst);
+    mem.src = cc_mem_place(self, value);
+    mem.count = cc_opd_lit(words);
+    cc_mem_expand(self, &mem);
+    cc_gen_release(self, mem.src);
+    self->used &= ~avail;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_MEM_H
+#define CC_MEM_H
+
+#include "gen.h"
+
+/* Block operations: calls to memcpy and memset, and assignments of values
+ * wider than a word.  They are expanded inline with STI, which stores a word
+ * and steps both I and J in a single instruction. */
+
+/* Largest expansion of a block operation of constant size, in words */
+#define CC_MEM_WORDS 16
+
+/* Block copy (or fill, if 'copy' is zero) being generated.  The addresses
+ * and value are literals or registers other than I and J. */
+typedef struct cc_mem {
+    cc_operand dst;
+    cc_operand src; /* Source address, or the value stored by memset */
+    cc_operand count; /* Number of words, if not constant */
+    int words; /* Number of words, if 'count' is a literal */
+    int copy;
+    int live; /* Bit mask of I and J, if they hold values */
+} cc_mem;
+
+int cc_mem_builtin(cc_gen * self, cc_call * call);
+cc_operand cc_mem_call(cc_gen * self, cc_call * call);
+cc_operand cc_mem_copy(cc_gen * self, cc_expr * dst, cc_expr * src,
+    int words);
+void cc_mem_fill(cc_gen * self, cc_operand dst, cc_operand value,
+    int words);
+
+#endif
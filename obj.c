@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "obj.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static int cc_obj_check(cc_obj * self);
+
+/* Maps the object at 'path' into memory and checks that its tables fit in
+ * the file.  Returns 0 and prints a message on failure. */
+cc_obj * cc_obj_open(char const * path) {
+    cc_obj * self = 0;
+    struct stat st;
+    void * base = 0;
+    long words = 0;
+    long need = 0;
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "Could not open %s\n", path);
+        return 0;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size < 2 * CC_OBJ_HEADER) {
+        fprintf(stderr, "%s: Not an object file\n", path);
+        close(fd);
+        return 0;
+    }
+    base = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (MAP_FAILED == base) {
+        fprintf(stderr, "Could not map %s\n", path);
+        return 0;
+    }
+
+    self = calloc(1, sizeof(cc_obj));
+    self->path = path;
+    self->base = base;
+    self->length = st.st_size;
+    if (CC_OBJ_MAGIC != CC_OBJ_WORD(self->base, 0)
+        || CC_OBJ_VERSION != CC_OBJ_WORD(self->base, 1)) {
+        fprintf(stderr, "%s: Not an object file\n", path);
+        cc_obj_close(self);
+        return 0;
+    }
+    self->nsections = CC_OBJ_WORD(self->base, 2);
+    self->nsymbols = CC_OBJ_WORD(self->base, 3);
+    self->nrelocs = CC_OBJ_WORD(self->base, 4);
+    self->npayload = CC_OBJ_WORD(self->base, 5);
+    self->nnames = CC_OBJ_WORD(self->base, 6);
+
+    words = CC_OBJ_HEADER;
+    self->sections = self->base + 2 * words;
+    words += (long)self->nsections * CC_OBJ_SECTION;
+    self->symbols = self->base + 2 * words;
+    words += (long)self->nsymbols * CC_OBJ_SYMBOL;
+    self->relocs = self->base + 2 * words;
+    words += (long)self->nrelocs * CC_OBJ_RELOC;
+    self->payload = self->base + 2 * words;
+    words += self->npayload;
+    self->names = (char const *)self->base + 2 * words;
+    need = 2 * words + self->nnames;
+    if (need > self->length || (self->nnames && self->names[self->nnames - 1])) {
+        fprintf(stderr, "%s: Truncated object file\n", path);
+        cc_obj_close(self);
+        return 0;
+    }
+    if (!cc_obj_check(self)) {
+        fprintf(stderr, "%s: Corrupt object file\n", path);
+        cc_obj_close(self);
+        return 0;
+    }
+    return self;
+}
+
+/* Checks that every index and offset in the tables is in range, so that
+ * the linker doesn't have to */
+static int cc_obj_check(cc_obj * self) {
+    int i = 0;
+    int k = 0;
+    for (i = 0; i < self->nsections; ++i) {
+        unsigned char const * section = self->sections + 2 * i * CC_OBJ_SECTION;
+        int kind = CC_OBJ_WORD(section, 0) & CC_OBJ_KIND;
+        int size = CC_OBJ_WORD(section, 1);
+        int first = CC_OBJ_WORD(section, 3);
+        int count = CC_OBJ_WORD(section, 4);
+        if (kind > CC_OBJ_BSS || first + count > self->nrelocs
+            || (CC_OBJ_BSS != kind
+                && CC_OBJ_WORD(section, 2) + size > self->npayload)
+            || (CC_OBJ_BSS == kind && count)) {
+            return 0;
+        }
+        for (k = first; k < first + count; ++k) {
+            if (CC_OBJ_WORD(self->relocs, k * CC_OBJ_RELOC) >= size
+                || CC_OBJ_WORD(self->relocs, k * CC_OBJ_RELOC + 1)
+                    >= self->nsymbols) {
+                return 0;
+            }
+        }
+    }
+    for (i = 0; i < self->nsymbols; ++i) {
+        int section = CC_OBJ_WORD(self->symbols, i * CC_OBJ_SYMBOL + 1);
+        if (CC_OBJ_WORD(self->symbols, i * CC_OBJ_SYMBOL) >= self->nnames
+            || (CC_OBJ_UNDEF != section && section >= self->nsections)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void cc_obj_close(cc_obj * self) {
+    munmap((void *)self->base, self->length);
+    free(self);
+}
+
+/* Returns non-zero if a symbol named 'name' is visible to other objects */
+int cc_obj_global(char const * name) {
+    return !strchr(name, '$');
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_OBJ_H
+#define CC_OBJ_H
+
+/* Relocatable object format.  An object is a sequence of big-endian 16-bit
+ * words, like an image, so that the linker can read it in place:
+ *
+ *   header    CC_OBJ_HEADER words: magic, version, then the number of
+ *             sections, symbols, relocations, payload words and name bytes
+ *   sections  CC_OBJ_SECTION words each: kind and flags, size in words,
+ *             payload offset, first relocation, number of relocations
+ *   symbols   CC_OBJ_SYMBOL words each: name offset, section (or
+ *             CC_OBJ_UNDEF), offset in the section, flags
+ *   relocs    CC_OBJ_RELOC words each: offset in the section, symbol,
+ *             addend; grouped by section
+ *   payload   the words of the code and data sections; BSS sections have
+ *             none
+ *   names     NUL-terminated symbol names, padded to a whole word
+ *
+ * Each relocation adds the address of its symbol plus the addend to the
+ * word it refers to.  Every function, global and literal pool gets a
+ * section of its own, so that the linker can drop the ones nothing
+ * refers to.  Symbols whose names contain '$' are generated by the
+ * compiler and are local to their object.  A global without an
+ * initializer gets a CC_OBJ_COMMON section: the objects may all define it,
+ * and the linker keeps one of them, or the initialized definition if there
+ * is one. */
+
+#define CC_OBJ_MAGIC 0x4443 /* "DC" */
+#define CC_OBJ_VERSION 1
+#define CC_OBJ_UNDEF 0xffff
+
+#define CC_OBJ_HEADER 7
+#define CC_OBJ_SECTION 5
+#define CC_OBJ_SYMBOL 4
+#define CC_OBJ_RELOC 3
+
+/* Section kinds, in the order the linker places them */
+#define CC_OBJ_CODE 0
+#define CC_OBJ_DATA 1
+#define CC_OBJ_BSS 2
+#define CC_OBJ_KIND 0x3
+
+/* Section flags */
+#define CC_OBJ_ENTRY 0x100 /* Startup code, placed at address 0 */
+#define CC_OBJ_COMMON 0x200 /* Tentative definition, as of 'int x;' */
+
+/* Symbol flags */
+#define CC_OBJ_GLOBAL 0x1
+
+/* Reads word 'i' of the object mapped at 'p' */
+#define CC_OBJ_WORD(p, i) \
+    ((unsigned short)(((p)[2 * (i)] << 8) | (p)[2 * (i) + 1]))
+
+/* Object mapped into memory.  The table pointers point into the mapping. */
+typedef struct cc_obj {
+    char const * path;
+    unsigned char const * base;
+    long length;
+    int nsections;
+    int nsymbols;
+    int nrelocs;
+    int npayload;
+    int nnames;
+    unsigned char const * sections;
+    unsigned char const * symbols;
+    unsigned char const * relocs;
+    unsigned char const * payload;
+    char const * names;
+} cc_obj;
+
+cc_obj * cc_obj_open(char const * path);
+void cc_obj_close(cc_obj * self);
+int cc_obj_global(char const * name);
+
+#endif
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "opt.h"
+#include "loop.h"
+#include "inline.h"
+#include "dce.h"
+#include "pgo.h"
+#include "lexer.h"
+#include "dcpu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Trip count assumed for loops whose trip count isn't known */
+#define CC_OPT_TRIPS 8
+
+/* Creates a new optimizer for the program in 'env'.  'level' selects the
+ * passes: 1 enables loop-invariant code motion, strength reduction and
+ * dead function elimination, and 2 also enables unrolling and inlining. */
+cc_opt * cc_opt_init(cc_env * env, int level) {
+    cc_opt * self = calloc(1, sizeof(cc_opt));
+    self->env = env;
+    self->level = level;
+    self->budget = CC_DCPU_WORDS / 16;
+    self->unroll_max = 8;
+    self->unroll_size = 128;
+    self->inline_size = 16;
+    return self;
+}
+
+void cc_opt_free(cc_opt * self) {
+    free(self->locals.ids);
+    free(self->addressed.ids);
+    free(self->roots.ids);
+    free(self);
+}
+
+/* Optimizes every function in the program */
+void cc_opt_env(cc_opt * self) {
+    cc_func * func = 0;
+    if (self->level <= 0) {
+        return;
+    }
+    if (self->level >= 2 && !(self->env->pgo && self->env->pgo->generate)) {
+        /* An inlined body wouldn't count the calls to its function */
+        cc_inline_env(self);
+    }
+    for (func = self->env->funcs; func; func = func->next) {
+        cc_opt_func(self, func);
+    }
+    cc_dce_env(self);
+    if (self->verbose) {
+        fprintf(stderr, "opt: %d inlined, %d hoisted, %d reduced, "
+            "%d unrolled\n", self->inlined, self->hoisted, self->reduced,
+            self->unrolled);
+    }
+}
+
+/* Collects the locals of a function, and the locals that have their address
+ * taken, into the optimizer's sets. */
+static void cc_opt_scan_expr(cc_opt * self, cc_expr * expr) {
+    if (!expr) {
+        return;
+    }
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        cc_opt_scan_expr(self, ((cc_member *)expr)->expr);
+        break;
+    case CC_BINARY:
+        cc_opt_scan_expr(self, ((cc_binary *)expr)->left);
+        cc_opt_scan_expr(self, ((cc_binary *)expr)->right);
+        break;
+    case CC_UNARY: {
+        cc_unary * unary = (cc_unary *)expr;
+        cc_expr * root = cc_expr_root(unary->expr);
+        if ('&' == unary->op && CC_REF == root->node.type) {
+            cc_idset_add(&self->addressed, ((cc_ref *)root)->id);
+        }
+        cc_opt_scan_expr(self, unary->expr);
+        break;
+    }
+    case CC_CALL: {
+        cc_expr * arg = 0;
+        cc_opt_scan_expr(self, ((cc_call *)expr)->expr);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            cc_opt_scan_expr(self, arg);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void cc_opt_scan_block(cc_opt * self, cc_block * block);
+
+static void cc_opt_scan_stmt(cc_opt * self, cc_stmt * stmt) {
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_opt_scan_block(self, (cc_block *)stmt);
+        break;
+    case CC_IF:
+        cc_opt_scan_expr(self, ((cc_if *)stmt)->guard);
+        cc_opt_scan_stmt(self, ((cc_if *)stmt)->yes);
+        cc_opt_scan_stmt(self, ((cc_if *)stmt)->no);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_opt_scan_expr(self, ((cc_loop *)stmt)->init);
+        cc_opt_scan_expr(self, ((cc_loop *)stmt)->guard);
+        cc_opt_scan_expr(self, ((cc_loop *)stmt)->update);
+        if (((cc_loop *)stmt)->block) {
+            cc_opt_scan_block(self, ((cc_loop *)stmt)->block);
+        }
+        break;
+    case CC_SIMPLE:
+        cc_opt_scan_expr(self, ((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN:
+        cc_opt_scan_expr(self, ((cc_return *)stmt)->expr);
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_opt_scan_block(cc_opt * self, cc_block * block) {
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    for (var = block->vars; var; var = var->next) {
+        cc_idset_add(&self->locals, var->id);
+        cc_opt_scan_expr(self, var->init);
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_opt_scan_stmt(self, stmt);
+    }
+}
+
+/* Makes 'func' the function being optimized, and collects its locals */
+void cc_opt_scan(cc_opt * self, cc_func * func) {
+    cc_formal * formal = 0;
+    self->func = func;
+    self->locals.count = 0;
+    self->addressed.count = 0;
+    for (formal = func->formals; formal; formal = formal->next) {
+        cc_idset_add(&self->locals, formal->id);
+    }
+    cc_opt_scan_block(self, func->block);
+}
+
+/* Optimizes a single function.  With -v, prints the estimated cost of the
+ * function before and after optimization. */
+void cc_opt_func(cc_opt * self, cc_func * func) {
+    cc_cost before = { 0, 0 };
+    cc_cost after = { 0, 0 };
+    if (!func->block) {
+        return;
+    }
+    cc_opt_scan(self, func);
+
+    cc_opt_block_cost(func->block, &before);
+    cc_opt_block(self, func->block);
+    cc_opt_block_cost(func->block, &after);
+    if (self->verbose) {
+        fprintf(stderr, "opt: %s: ~%ld -> ~%ld cycles, ~%d -> ~%d words\n",
+            func->id->str, before.cycles, after.cycles, before.words,
+            after.words);
+    }
+    self->func = 0;
+}
+
+void cc_opt_block(cc_opt * self, cc_block * block) {
+    cc_opt_stmts(self, &block->stmts);
+}
+
+/* Optimizes an arm of an if statement.  An arm that isn't a block is first
+ * made into one, since statements hoisted out of a loop are linked in
+ * before it, and the arm must remain a single statement. */
+static void cc_opt_arm(cc_opt * self, cc_stmt ** arm) {
+    cc_block * block = 0;
+    if (!*arm) {
+        return;
+    }
+    if (CC_BLOCK != (*arm)->node.type) {
+        block = cc_block_init((*arm)->node.line);
+        block->stmts = *arm;
+        *arm = &block->node;
+    }
+    cc_opt_block(self, (cc_block *)*arm);
+}
+
+/* Optimizes the list of statements starting at '*link'.  Loops are
+ * optimized innermost first, so that code hoisted out of an inner loop can be
+ * considered again for the enclosing loop. */
+void cc_opt_stmts(cc_opt * self, cc_stmt ** link) {
+    while (*link) {
+        cc_stmt * stmt = *link;
+        switch (stmt->node.type) {
+        case CC_BLOCK:
+            cc_opt_block(self, (cc_block *)stmt);
+            break;
+        case CC_IF:
+            cc_opt_arm(self, &((cc_if *)stmt)->yes);
+            cc_opt_arm(self, &((cc_if *)stmt)->no);
+            break;
+        case CC_FOR:
+        case CC_WHILE:
+            if (((cc_loop *)stmt)->block) {
+                cc_opt_block(self, ((cc_loop *)stmt)->block);
+            }
+            link = cc_loop_opt(self, link);
+            break;
+        default:
+            break;
+        }
+        link = &(*link)->next;
+    }
+}
+
+/* Creates a new compiler temporary in the outermost block of the current
+ * function.  Temporaries are named with a '$', so they can't collide with
+ * identifiers from the source. */
+cc_var * cc_opt_temp(cc_opt * self, int line, cc_type * type) {
+    char buf[16];
+    cc_var * var = 0;
+    sprintf(buf, "$t%d", self->temps++);
+    var = cc_var_init(line, type, cc_env_id(self->env, buf));
+    var->next = self->func->block->vars;
+    self->func->block->vars = var;
+    cc_idset_add(&self->locals, var->id);
+    return var;
+}
+
+/* Returns the opcode used to implement the binary operator 'op' */
+static cc_op cc_opt_op(int op) {
+    switch (op) {
+    case '+': return CC_OP_ADD;
+    case '-': return CC_OP_SUB;
+    case '*': return CC_OP_MUL;
+    case '/': return CC_OP_DVI;
+    case '%': return CC_OP_MDI;
+    case '&': return CC_OP_AND;
+    case '|': return CC_OP_BOR;
+    case '^': return CC_OP_XOR;
+    case CC_TOK_LSHIFT: return CC_OP_SHL;
+    case CC_TOK_RSHIFT: return CC_OP_ASR;
+    default: return CC_OP_SET;
+    }
+}
+
+/* Estimates the words and cycles needed to evaluate 'self' into a register,
+ * using the DCPU-16 cycle table.  Locals are assumed to live in the frame, so
+ * each access costs an extra word.  These are rough numbers, used only to
+ * weigh code growth against speed. */
+void cc_opt_expr_cost(cc_expr * self, cc_cost * cost) {
+    int value = 0;
+    if (!self) {
+        return;
+    }
+    switch (self->node.type) {
+    case CC_MEMBER:
+        cc_opt_expr_cost(((cc_member *)self)->expr, cost);
+        cost->words += 2;
+        cost->cycles += 2;
+        break;
+    case CC_BINARY: {
+        cc_binary * binary = (cc_binary *)self;
+        cc_binary * rhs = (cc_binary *)binary->right;
+        if ('=' == binary->op && CC_REF == binary->left->node.type
+            && CC_BINARY == rhs->node.node.type
+            && cc_expr_equal(binary->left, rhs->left)
+            && CC_OP_SET != cc_opt_op(rhs->op)) {
+            /* x = x op y is one read-modify-write instruction */
+            if (!cc_expr_const(rhs->right, &value)) {
+                cc_opt_expr_cost(rhs->right, cost);
+            } else if (value < -1 || value > 30) {
+                cost->words += 1;
+                cost->cycles += 1;
+            }
+            cost->words += 2;
+            cost->cycles += cc_op_cycles(cc_opt_op(rhs->op)) + 1;
+            break;
+        }
+        if ('=' != binary->op || CC_REF != binary->left->node.type) {
+            cc_opt_expr_cost(binary->left, cost);
+        }
+        cc_opt_expr_cost(binary->right, cost);
+        switch (binary->op) {
+        case '=':
+        case CC_TOK_AND:
+        case CC_TOK_OR:
+            cost->words += 2;
+            cost->cycles += 3;
+            break;
+        case ',':
+            break;
+        case '<':
+        case '>':
+        case CC_TOK_EQ:
+        case CC_TOK_NE:
+        case CC_TOK_LE:
+        case CC_TOK_GE:
+            /* SET r, 0; IFx; SET r, 1 */
+            cost->words += 3;
+            cost->cycles += 4;
+            break;
+        default:
+            cost->words += 1;
+            cost->cycles += cc_op_cycles(cc_opt_op(binary->op));
+            break;
+        }
+        break;
+    }
+    case CC_UNARY:
+        cc_opt_expr_cost(((cc_unary *)self)->expr, cost);
+        cost->words += ('*' == ((cc_unary *)self)->op) ? 1 : 2;
+        cost->cycles += ('*' == ((cc_unary *)self)->op) ? 1 : 2;
+        break;
+    case CC_CALL: {
+        cc_expr * arg = 0;
+        for (arg = ((cc_call *)self)->args; arg; arg = arg->next) {
+            cc_opt_expr_cost(arg, cost);
+            cost->words += 1;
+            cost->cycles += 1;
+        }
+        /* JSR with a next-word target, then popping the arguments */
+        cost->words += 3;
+        cost->cycles += cc_op_cycles(CC_OP_JSR) + 1 + cc_op_cycles(CC_OP_ADD);
+        break;
+    }
+    case CC_REF:
+        cost->words += 2;
+        cost->cycles += 2;
+        break;
+    case CC_NUMBER:
+        cc_expr_const(self, &value);
+        cost->words += (value >= -1 && value <= 30) ? 1 : 2;
+        cost->cycles += (value >= -1 && value <= 30) ? 1 : 2;
+        break;
+    case CC_STRING:
+        cost->words += 2;
+        cost->cycles += 2;
+        break;
+    default:
+        break;
+    }
+}
+
+void cc_opt_stmt_cost(cc_stmt * self, cc_cost * cost) {
+    if (!self) {
+        return;
+    }
+    switch (self->node.type) {
+    case CC_BLOCK:
+        cc_opt_block_cost((cc_block *)self, cost);
+        break;
+    case CC_IF: {
+        cc_if * stmt = (cc_if *)self;
+        cc_cost yes = { 0, 0 };
+        cc_cost no = { 0, 0 };
+        cc_opt_expr_cost(stmt->guard, cost);
+        cc_opt_stmt_cost(stmt->yes, &yes);
+        cc_opt_stmt_cost(stmt->no, &no);
+        cost->words += yes.words + no.words + 3;
+        cost->cycles += (yes.cycles + no.cycles) / 2 + 4;
+        break;
+    }
+    case CC_FOR:
+    case CC_WHILE: {
+        cc_loop * loop = (cc_loop *)self;
+        cc_cost body = { 0, 0 };
+        int trips = cc_loop_trips(loop, CC_DCPU_WORDS);
+        cc_opt_expr_cost(loop->init, cost);
+        cc_opt_expr_cost(loop->guard, &body);
+        cc_opt_expr_cost(loop->update, &body);
+        if (loop->block) {
+            cc_opt_block_cost(loop->block, &body);
+        }
+        /* Branch on the guard, and jump back to the top */
+        body.words += 4;
+        body.cycles += 5;
+        cost->words += body.words;
+        if (trips < 0) {
+            trips = CC_OPT_TRIPS;
+        } else if (loop->unroll) {
+            trips /= loop->unroll;
+        }
+        cost->cycles += body.cycles * trips;
+        break;
+    }
+    case CC_SIMPLE:
+        cc_opt_expr_cost(((cc_simple *)self)->expr, cost);
+        break;
+    case CC_RETURN:
+        cc_opt_expr_cost(((cc_return *)self)->expr, cost);
+        cost->words += 2;
+        cost->cycles += 2;
+        break;
+    default:
+        break;
+    }
+}
+
+void cc_opt_block_cost(cc_block * self, cc_cost * cost) {
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    for (var = self->vars; var; var = var->next) {
+        if (var->init) {
+            cc_opt_expr_cost(var->init, cost);
+            cost->words += 2;
+            cost->cycles += 2;
+        }
+    }
+    for (stmt = self->stmts; stmt; stmt = stmt->next) {
+        cc_opt_stmt_cost(stmt, cost);
+    }
+}
+
+void cc_idset_add(cc_idset * self, cc_id * id) {
+    if (cc_idset_has(self, id)) {
+        return;
+    }
+    if (self->count >= self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 16;
+        self->ids = realloc(self->ids, self->capacity * sizeof(cc_id *));
+    }
+    self->ids[self->count++] = id;
+}
+
+int cc_idset_has(cc_idset * self, cc_id * id) {
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        if (self->ids[i] == id) {
+            return 1;
+        }
+    }
+    return 0;
+}
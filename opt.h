@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_OPT_H
+#define CC_OPT_H
+
+#include "env.h"
+#include "ast.h"
+
+/* Estimated cost of a piece of code, in words and cycles */
+typedef struct cc_cost {
+    int words;
+    long cycles;
+} cc_cost;
+
+/* Small set of identifiers, used by the analyses */
+typedef struct cc_idset {
+    cc_id ** ids;
+    int count;
+    int capacity;
+} cc_idset;
+
+/* Optimizer state shared by the AST-level passes.  'budget' is the number of
+ * words the program is still allowed to grow by; transformations that trade
+ * code size for speed (unrolling, inlining) draw from it, since the whole
+ * image must fit in the 64K-word address space. */
+typedef struct cc_opt {
+    cc_env * env;
+    cc_func * func; /* Function being optimized */
+    cc_idset locals; /* Locals and formals of 'func' */
+    cc_idset addressed; /* Locals of 'func' whose address is taken */
+    int level; /* Optimization level (-O) */
+    int budget; 
+    int unroll_max; /* Largest unroll factor */
+    int unroll_size; /* Largest unrolled loop body, in words */
+    int inline_size; /* Largest inlined growth outside of loops, in words */
+    int verbose;
+    int object; /* Compiling an object, which other objects may call into */
+    cc_idset roots; /* Functions and globals kept even if unused (-fexport) */
+    int temps; /* Used to name compiler temporaries */
+    int hoisted;
+    int reduced;
+    int unrolled;
+    int inlined;
+} cc_opt;
+
+cc_opt * cc_opt_init(cc_env * env, int level);
+void cc_opt_free(cc_opt * self);
+void cc_opt_env(cc_opt * self);
+void cc_opt_func(cc_opt * self, cc_func * func);
+void cc_opt_scan(cc_opt * self, cc_func * func);
+void cc_opt_block(cc_opt * self, cc_block * block);
+void cc_opt_stmts(cc_opt * self, cc_stmt ** link);
+cc_var * cc_opt_temp(cc_opt * self, int line, cc_type * type);
+void cc_opt_expr_cost(cc_expr * self, cc_cost * cost);
+void cc_opt_stmt_cost(cc_stmt * self, cc_cost * cost);
+void cc_opt_block_cost(cc_block * self, cc_cost * cost);
+void cc_idset_add(cc_idset * self, cc_id * id);
+int cc_idset_has(cc_idset * self, cc_id * id);
+
+#endif
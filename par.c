@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "par.h"
+#include "frame.h"
+#include "pool.h"
+#include <stdlib.h>
+
+/* Returns a generator for one function, with the options of 'gen' */
+static cc_gen * cc_par_fork(cc_gen * gen) {
+    cc_gen * task = cc_gen_init(gen->env);
+    task->pool->packed = gen->pool->packed;
+    task->level = gen->level;
+    task->object = gen->object;
+    task->size = gen->size;
+    task->burs = gen->burs;
+    task->peephole = gen->peephole;
+    return task;
+}
+
+static void * cc_par_work(void * arg) {
+    cc_par * par = arg;
+    int i = 0;
+    for (;;) {
+        pthread_mutex_lock(&par->lock);
+        i = par->next++;
+        pthread_mutex_unlock(&par->lock);
+        if (i >= par->count) {
+            break;
+        }
+        cc_gen_func(par->tasks[i], par->funcs[i]);
+    }
+    return 0;
+}
+
+/* Renames the strings of 'pool' in 'code' to 'ids' */
+static void cc_par_rename(cc_code * code, cc_pool * pool, cc_id ** ids) {
+    cc_operand * opds[2];
+    int i = 0;
+    int k = 0;
+    int n = 0;
+    for (i = 0; i < code->count; ++i) {
+        opds[0] = &code->insts[i].b;
+        opds[1] = &code->insts[i].a;
+        for (k = 0; k < 2; ++k) {
+            for (n = 0; opds[k]->sym && n < pool->count; ++n) {
+                if (opds[k]->sym == pool->literals[n]->id) {
+                    opds[k]->sym = ids[n];
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/* Moves the results of 'task' into 'gen' */
+static void cc_par_join(cc_gen * gen, cc_gen * task) {
+    cc_id ** ids = cc_pool_merge(gen->pool, task->pool);
+    cc_code * code = 0;
+    int i = 0;
+
+    for (code = task->codes; code; code = code->next) {
+        cc_par_rename(code, task->pool, ids);
+        *gen->tail = code;
+        gen->tail = &code->next;
+    }
+    for (i = 0; i < task->nadapters; ++i) {
+        cc_frame_adapter(gen, task->adapters[i]);
+    }
+    gen->tails += task->tails;
+    gen->blocks += task->blocks;
+    gen->inverted += task->inverted;
+    gen->tiled += task->tiled;
+    gen->ldiv |= task->ldiv;
+    gen->errors += task->errors;
+
+    free(ids);
+    task->codes = 0;
+    cc_gen_free(task);
+}
+
+/* Generates 'funcs' on 'gen->threads' threads, and appends their code to
+ * 'gen' in order */
+void cc_par_funcs(cc_gen * gen, cc_func ** funcs, int count) {
+    cc_par par;
+    pthread_mutex_t ids;
+    pthread_t * threads = 0;
+    int i = 0;
+
+    par.gen = gen;
+    par.funcs = funcs;
+    par.tasks = calloc(count + 1, sizeof(cc_gen *));
+    par.count = count;
+    par.next = 0;
+    par.threads = gen->threads < count ? gen->threads : count;
+    pthread_mutex_init(&par.lock, 0);
+    for (i = 0; i < count; ++i) {
+        par.tasks[i] = cc_par_fork(gen);
+    }
+
+    pthread_mutex_init(&ids, 0);
+    gen->env->lock = &ids;
+    threads = calloc(par.threads + 1, sizeof(pthread_t));
+    for (i = 0; i < par.threads; ++i) {
+        pthread_create(threads + i, 0, cc_par_work, &par);
+    }
+    for (i = 0; i < par.threads; ++i) {
+        pthread_join(threads[i], 0);
+    }
+    gen->env->lock = 0;
+    pthread_mutex_destroy(&ids);
+
+    for (i = 0; i < count; ++i) {
+        cc_par_join(gen, par.tasks[i]);
+    }
+    pthread_mutex_destroy(&par.lock);
+    free(threads);
+    free(par.tasks);
+}
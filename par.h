@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_PAR_H
+#define CC_PAR_H
+
+#include "gen.h"
+#include <pthread.h>
+
+/* Parallel code generation.  Each function with a body is a task, run by
+ * a cc_gen of its own that is forked from the program's: its instruction
+ * buffer, string pool, adapter list and counters are private, and the AST
+ * and environment are only read, except for the identifier table, which
+ * is locked while tasks run.  Workers take the tasks in source order from
+ * a shared index.
+ *
+ * Once every task is done, the results are stitched into the program's
+ * generator in source order: code buffers are appended, strings move into
+ * the program's pool and are renamed in the code that uses them, and
+ * adapters and counters are merged.  The program's generator ends up as
+ * if it had generated the functions itself, one after another, so the
+ * output doesn't depend on the number of threads.  Addresses and the
+ * fixups between functions are resolved when the code is assembled, as
+ * before. */
+typedef struct cc_par {
+    cc_gen * gen;
+    cc_func ** funcs; /* Functions to generate, in source order */
+    cc_gen ** tasks; /* Generator of each function, indexed like 'funcs' */
+    int count;
+    int next; /* Next function to generate */
+    int threads;
+    pthread_mutex_t lock; /* Guards 'next' */
+} cc_par;
+
+void cc_par_funcs(cc_gen * gen, cc_func ** funcs, int count);
+
+#endif
@@ -24,7 +24,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <assert.h>
 
 /* Creates a new lexer that will store the AST in 'env'. */
 cc_parser * cc_parser_init(cc_env * env, char const * file) {
@@ -35,6 +34,11 @@ cc_parser * cc_parser_init(cc_env * env, char const * file) {
     return self;
 }
 
+void cc_parser_free(cc_parser * self) {
+    cc_lexer_free(self->lexer);
+    free(self);
+}
+
 /* Parses the next global (either a function or global variable).  Since
  * globals and functions have the same prefix of tokens, this function parses
  * the prefix first and then parses either the remainder of the function
@@ -42,7 +46,21 @@ cc_parser * cc_parser_init(cc_env * env, char const * file) {
 void cc_parser_global(cc_parser * self) {
    
     cc_type * type = cc_parser_type(self);
-    cc_id * id = cc_parser_id(self); 
+    cc_id * id = 0;
+
+    if (type->record && !type->flags && ('{' == self->lexer->token
+        || ';' == self->lexer->token)) {
+        /* Parse a struct definition or declaration */
+        if ('{' == self->lexer->token) {
+            cc_parser_struct(self, type->record);
+        }
+        if (';' != self->lexer->token) {
+            cc_parser_err(self, self->lexer->line, "Missing ';'");
+        }
+        cc_lexer_next(self->lexer);
+        return;
+    }
+    id = cc_parser_id(self); 
     
     if ('(' == self->lexer->token) {
         /* Parse a function forward declaration or definition */
@@ -52,17 +70,44 @@ void cc_parser_global(cc_parser * self) {
         }
         self->env->funcs = func;
         
-    } else if (';' == self->lexer->token) {
-        assert(!"Not implemented");
-    } else if ('=' == self->lexer->token) {
-        assert(!"Not implemented");
+    } else if (';' == self->lexer->token || '=' == self->lexer->token) {
+        /* Parse a global variable, keeping the globals in source order */
+        cc_var ** tail = &self->env->vars;
+        while (*tail) {
+            tail = &(*tail)->next;
+        }
+        *tail = cc_parser_decl(self, type, id);
+    } else {
+        cc_parser_err(self, self->lexer->line, "Expected '(', '=' or ';'");
+        cc_lexer_next(self->lexer);
+    }
+}
+
+/* Parses the fields of a struct definition, between braces.  This function
+ * assumes that 'struct' and the name have already been parsed. */
+void cc_parser_struct(cc_parser * self, cc_struct * record) {
+    cc_var ** tail = &record->vars;
+    if (record->defined) {
+        cc_parser_err(self, self->lexer->line, "Struct is already defined");
+    }
+    record->node.line = self->lexer->line;
+    record->defined = 1;
+    cc_lexer_next(self->lexer); /* Consume '{' */
+    while ('}' != self->lexer->token && CC_TOK_EOF != self->lexer->token) {
+        *tail = cc_parser_var(self);
+        if ((*tail)->init) {
+            cc_parser_err(self, (*tail)->node.line,
+                "Fields can't have initializers");
+        }
+        tail = &(*tail)->next;
     }
+    cc_lexer_next(self->lexer); /* Consume '}' */
 }
 
 /* Parses a function.  This function assumes that the type and name of the
  * function have already been parsed. */
 cc_func * cc_parser_func(cc_parser * self, cc_type * type, cc_id * id) {
-    cc_func * func = calloc(1, sizeof(cc_func));
+    cc_func * func = cc_ast_alloc(sizeof(cc_func));
     cc_formal * formal = 0;
 
     func->node.type = CC_FUNC;
@@ -106,11 +151,11 @@ cc_func * cc_parser_func(cc_parser * self, cc_type * type, cc_id * id) {
  * So, this function recursively parses each part.  Note that since the
  * compiler does not support typedefs, things are a bit more simple.  We can
  * always identify a type right off the bat, because it will start with 'int',
- * 'char' or 'struct'.  If typedefs are implemented, then a symbol table lookup
- * would be needed to disambiguate the * operator (i.e., a * b could be an
- * expression or a definition). */
+ * 'char', 'long' or 'struct'.  If typedefs are implemented, then a symbol
+ * table lookup would be needed to disambiguate the * operator (i.e., a * b
+ * could be an expression or a definition). */
 cc_type * cc_parser_type(cc_parser * self) {
-    cc_type * type = calloc(1, sizeof(cc_type)); 
+    cc_type * type = cc_ast_alloc(sizeof(cc_type)); 
     type->line = self->lexer->line;
 
     /* Note: This doesn't handle function pointers yet. */
@@ -119,25 +164,45 @@ cc_type * cc_parser_type(cc_parser * self) {
         type->id = cc_env_id(self->env, "int");   
     } else if (CC_TOK_CHAR == self->lexer->token) {
         type->id = cc_env_id(self->env, "char");
+    } else if (CC_TOK_UNSIGNED == self->lexer->token) {
+        /* 'unsigned', 'unsigned int' and 'unsigned char' are all one word */
+        type->id = cc_env_id(self->env, "unsigned");
+        cc_lexer_next(self->lexer);
+        if (CC_TOK_INT != self->lexer->token
+            && CC_TOK_CHAR != self->lexer->token) {
+            return cc_parser_pointer(self, type);
+        }
+    } else if (CC_TOK_LONG == self->lexer->token) {
+        /* 'long' and 'long int' are two words */
+        type->id = cc_env_id(self->env, "long");
+        cc_lexer_next(self->lexer);
+        if (CC_TOK_INT != self->lexer->token) {
+            return cc_parser_pointer(self, type);
+        }
     } else if (CC_TOK_STRUCT == self->lexer->token) {
         cc_lexer_next(self->lexer);
         if (CC_TOK_ID != self->lexer->token) {
             cc_parser_err(self, self->lexer->line, "Expected an identifier");
         } else {
             type->id = cc_env_id(self->env, self->lexer->value);
+            type->record = cc_env_struct(self->env, type->id);
         }
     } 
     cc_lexer_next(self->lexer);
+    return cc_parser_pointer(self, type);
+}
 
+/* Parses the '*' and '[]' suffixes of a type whose base is 'type' */
+cc_type * cc_parser_pointer(cc_parser * self, cc_type * type) {
     while (1) {
         if ('*' == self->lexer->token) {
-            cc_type * temp = calloc(1, sizeof(cc_type));
+            cc_type * temp = cc_ast_alloc(sizeof(cc_type));
             temp->flags |= CC_TYPE_PTR;
             temp->nested = type;
             type = temp; 
             cc_lexer_next(self->lexer);
         } else if ('[' == self->lexer->token) {
-            cc_type * temp = calloc(1, sizeof(cc_type));
+            cc_type * temp = cc_ast_alloc(sizeof(cc_type));
             temp->flags |= CC_TYPE_ARRAY;
             temp->nested = type;
             type = temp; 
@@ -156,7 +221,7 @@ cc_type * cc_parser_type(cc_parser * self) {
 
 /* Parses a formal parameter to a function definition or declaration. */
 cc_formal * cc_parser_formal(cc_parser * self) {
-    cc_formal * formal = calloc(1, sizeof(cc_formal));
+    cc_formal * formal = cc_ast_alloc(sizeof(cc_formal));
     formal->type = cc_parser_type(self);
     formal->id = cc_parser_id(self);
     return formal;
@@ -178,7 +243,7 @@ cc_id * cc_parser_id(cc_parser * self) {
 
 /* Parses a block statement. */
 cc_block * cc_parser_block(cc_parser * self) {
-    cc_block * block = calloc(1, sizeof(cc_block));
+    cc_block * block = cc_ast_alloc(sizeof(cc_block));
     cc_stmt * stmt = 0;
     cc_var * var = 0;
     block->node.node.line = self->lexer->line;
@@ -193,6 +258,8 @@ cc_block * cc_parser_block(cc_parser * self) {
      * the variable declarations must be at the beginning of the block. */
     while ((CC_TOK_INT == self->lexer->token
         || CC_TOK_CHAR == self->lexer->token
+        || CC_TOK_UNSIGNED == self->lexer->token
+        || CC_TOK_LONG == self->lexer->token
         || CC_TOK_STRUCT == self->lexer->token)
         && ('}' != self->lexer->token)
         && (CC_TOK_EOF != self->lexer->token)) {
@@ -223,11 +290,19 @@ cc_block * cc_parser_block(cc_parser * self) {
 /* Parses a local variable definition, including the intiailizer expression if
  * present. */
 cc_var * cc_parser_var(cc_parser * self) {
-    cc_var * var = calloc(1, sizeof(cc_var));
+    cc_type * type = cc_parser_type(self);
+    cc_id * id = cc_parser_id(self);
+    return cc_parser_decl(self, type, id);
+}
+
+/* Parses the rest of a variable definition.  This function assumes that the
+ * type and name of the variable have already been parsed. */
+cc_var * cc_parser_decl(cc_parser * self, cc_type * type, cc_id * id) {
+    cc_var * var = cc_ast_alloc(sizeof(cc_var));
     var->node.line = self->lexer->line;
     var->node.type = CC_VAR;
-    var->type = cc_parser_type(self);
-    var->id = cc_parser_id(self);
+    var->type = type;
+    var->id = id;
 
     if ('=' == self->lexer->token) {
         cc_lexer_next(self->lexer);
@@ -254,19 +329,24 @@ cc_stmt * cc_parser_stmt(cc_parser * self) {
         return (cc_stmt *)cc_parser_if(self);
     } else if (CC_TOK_RETURN == self->lexer->token) {
         return (cc_stmt *)cc_parser_return(self);
+    } else if ('{' == self->lexer->token) {
+        return (cc_stmt *)cc_parser_block(self);
     } else {
         
-        cc_simple * stmt = calloc(1, sizeof(cc_simple));
+        cc_simple * stmt = cc_ast_alloc(sizeof(cc_simple));
         stmt->node.node.line = self->lexer->line;
         stmt->node.node.type = CC_SIMPLE; 
         stmt->expr = cc_parser_expr(self);
+        if (';' != self->lexer->token) {
+            cc_parser_err(self, self->lexer->line, "Missing ';'");
+        }
         cc_lexer_next(self->lexer);
         return (cc_stmt *)stmt;
     }
 }
 
 cc_return * cc_parser_return(cc_parser * self) {
-    cc_return * ret = calloc(1, sizeof(cc_return));
+    cc_return * ret = cc_ast_alloc(sizeof(cc_return));
     ret->node.node.line = self->lexer->line;
     ret->node.node.type = CC_RETURN;
     cc_lexer_next(self->lexer);
@@ -280,15 +360,55 @@ cc_return * cc_parser_return(cc_parser * self) {
     return ret;
 }
 
+/* Parses an if statement, with an optional else clause */
 cc_if * cc_parser_if(cc_parser * self) {
+    cc_if * stmt = cc_ast_alloc(sizeof(cc_if));
+    stmt->node.node.line = self->lexer->line;
+    stmt->node.node.type = CC_IF;
+    cc_lexer_next(self->lexer);
+    stmt->guard = cc_parser_guard(self);
+    stmt->yes = cc_parser_stmt(self);
+    if (CC_TOK_ELSE == self->lexer->token) {
+        cc_lexer_next(self->lexer);
+        stmt->no = cc_parser_stmt(self);
+    }
+    return stmt;
+}
 
-    return 0;
+/* Parses the parenthesized guard expression of an if or while statement */
+cc_expr * cc_parser_guard(cc_parser * self) {
+    cc_expr * expr = 0;
+    if ('(' != self->lexer->token) {
+        cc_parser_err(self, self->lexer->line, "Expected '('");
+    }
+    cc_lexer_next(self->lexer);
+    expr = cc_parser_expr(self);
+    if (')' != self->lexer->token) {
+        cc_parser_err(self, self->lexer->line, "Expected ')'");
+    }
+    cc_lexer_next(self->lexer);
+    return expr;
+}
+
+/* Parses the body of a loop.  A single statement is wrapped in a block. */
+cc_block * cc_parser_body(cc_parser * self) {
+    cc_block * block = 0;
+    if ('{' == self->lexer->token) {
+        return cc_parser_block(self);
+    }
+    block = cc_block_init(self->lexer->line);
+    if (';' == self->lexer->token) {
+        cc_lexer_next(self->lexer);
+    } else {
+        block->stmts = cc_parser_stmt(self);
+    }
+    return block;
 }
 
 /* Parses a for loop.  Only C90 is supported, so no variables may be declared
  * in the initialization expression of the for loop. */
 cc_loop * cc_parser_for(cc_parser * self) {
-    cc_loop * loop = calloc(1, sizeof(cc_loop));
+    cc_loop * loop = cc_ast_alloc(sizeof(cc_loop));
     loop->node.node.line = self->lexer->line;
     loop->node.node.type = CC_FOR;
     cc_lexer_next(self->lexer);
@@ -322,14 +442,18 @@ cc_loop * cc_parser_for(cc_parser * self) {
     }
     cc_lexer_next(self->lexer);
 
-    if (';' != self->lexer->token) {
-        loop->block = cc_parser_block(self);
-    }
+    loop->block = cc_parser_body(self);
     return loop;
 }
 
 cc_loop * cc_parser_while(cc_parser * self) {
-    return 0;
+    cc_loop * loop = cc_ast_alloc(sizeof(cc_loop));
+    loop->node.node.line = self->lexer->line;
+    loop->node.node.type = CC_WHILE;
+    cc_lexer_next(self->lexer);
+    loop->guard = cc_parser_guard(self);
+    loop->block = cc_parser_body(self);
+    return loop;
 }
 
 cc_expr * cc_parser_expr(cc_parser * self) {
@@ -338,29 +462,37 @@ cc_expr * cc_parser_expr(cc_parser * self) {
 
 /* Parses an expression.   This parser uses a precedence parsing table to parse
  * binary expressions, and then calls out to the unary expression parser for
- * the base case. */
+ * the base case.  Operators on the same row of the table have the same
+ * precedence and are left-associative, except for '=', which is
+ * right-associative. */
 cc_expr * cc_parser_expr2(cc_parser * self, int i) {
-    static cc_token table[] = { '=', CC_TOK_OR, CC_TOK_AND, '|', '&', CC_TOK_EQ, 
-        CC_TOK_NE, '<', '>', CC_TOK_LE, CC_TOK_GE, CC_TOK_RSHIFT, 
-        CC_TOK_LSHIFT, '+', '-', '*', '/', '%'
+    static cc_token table[][4] = { 
+        { '=' }, { CC_TOK_OR }, { CC_TOK_AND }, { '|' }, { '^' }, { '&' },
+        { CC_TOK_EQ, CC_TOK_NE }, { '<', '>', CC_TOK_LE, CC_TOK_GE },
+        { CC_TOK_RSHIFT, CC_TOK_LSHIFT }, { '+', '-' }, { '*', '/', '%' }
     };
-    cc_token token = table[i];
     cc_expr * expr = 0;
+    int j = 0;
 
-    if (i * sizeof(cc_token) > sizeof(table)) {
+    if (i >= sizeof(table)/sizeof(table[0])) {
         return cc_parser_unary(self);
     }
 
     expr = cc_parser_expr2(self, i+1);
-    while (token == self->lexer->token) {
-        cc_binary * binary = calloc(1, sizeof(cc_binary)); 
-        binary->node.node.line = self->lexer->line;
-        binary->node.node.type = CC_BINARY;
-        binary->op = token;
-        binary->left = expr;
-        cc_lexer_next(self->lexer);
-        binary->right = cc_parser_expr2(self, i+1);
-        expr = (cc_expr *)binary;
+    for (j = 0; j < 4 && table[i][j]; ++j) {
+        if (table[i][j] != self->lexer->token) {
+            continue;
+        } else {
+            cc_binary * binary = cc_ast_alloc(sizeof(cc_binary)); 
+            binary->node.node.line = self->lexer->line;
+            binary->node.node.type = CC_BINARY;
+            binary->op = self->lexer->token;
+            binary->left = expr;
+            cc_lexer_next(self->lexer);
+            binary->right = cc_parser_expr2(self, ('=' == binary->op) ? i : i+1);
+            expr = (cc_expr *)binary;
+            j = -1; /* Look for another operator at this level */
+        }
     }
     return expr;
 }
@@ -374,7 +506,7 @@ cc_expr * cc_parser_unary(cc_parser * self) {
         || '!' == self->lexer->token || '*' == self->lexer->token
         || '&' == self->lexer->token) {
 
-        cc_unary * unary = calloc(1, sizeof(cc_unary));
+        cc_unary * unary = cc_ast_alloc(sizeof(cc_unary));
         unary->node.node.line = self->lexer->line;
         unary->node.node.type = CC_UNARY;
         unary->op = self->lexer->token;
@@ -392,7 +524,7 @@ cc_expr * cc_parser_unary(cc_parser * self) {
 cc_expr * cc_parser_call(cc_parser * self) {
     cc_expr * expr = cc_parser_member(self);
     while ('(' == self->lexer->token) {
-        cc_call * call = calloc(1, sizeof(cc_call));
+        cc_call * call = cc_ast_alloc(sizeof(cc_call));
         cc_expr * arg = 0;
         call->node.node.line = self->lexer->line;
         call->node.node.type = CC_CALL;
@@ -422,20 +554,21 @@ cc_expr * cc_parser_call(cc_parser * self) {
 cc_expr * cc_parser_member(cc_parser * self) {
     cc_expr * expr = cc_parser_ref(self);
     while ('.' == self->lexer->token || CC_TOK_ARROW == self->lexer->token) {
-        cc_member * member = calloc(1, sizeof(cc_binary));
+        cc_member * member = cc_ast_alloc(sizeof(cc_member));
+        int arrow = (CC_TOK_ARROW == self->lexer->token);
         member->node.node.line = self->lexer->line;
-        member->node.node.type = CC_BINARY;
+        member->node.node.type = CC_MEMBER;
         cc_lexer_next(self->lexer);
-        if (CC_TOK_ARROW == self->lexer->token) {
-            /* Translate x->y into  (*x)->y */
-            cc_unary * unary = calloc(1, sizeof(cc_unary));
+        if (arrow) {
+            /* Translate x->y into (*x).y */
+            cc_unary * unary = cc_ast_alloc(sizeof(cc_unary));
             unary->node.node.line = self->lexer->line;
             unary->node.node.type = CC_UNARY;
             unary->op = '*';
             unary->expr = expr;
             expr = (cc_expr *)unary;
         }
-        member->expr = expr; 
+        member->expr = expr;
         member->id = cc_parser_id(self);
         expr = (cc_expr *)member;
     }
@@ -445,7 +578,7 @@ cc_expr * cc_parser_member(cc_parser * self) {
 /* Identifier reference (a.k.a. variable access) */
 cc_expr * cc_parser_ref(cc_parser * self) {
     if (CC_TOK_ID == self->lexer->token) {
-        cc_ref * ref = calloc(1, sizeof(cc_ref));
+        cc_ref * ref = cc_ast_alloc(sizeof(cc_ref));
         ref->node.node.line = self->lexer->line;
         ref->node.node.type = CC_REF;
         ref->id = cc_parser_id(self);
@@ -456,10 +589,10 @@ cc_expr * cc_parser_ref(cc_parser * self) {
 
 cc_expr * cc_parser_string(cc_parser * self) {
     if (CC_TOK_STRING == self->lexer->token) {
-        cc_string * string = calloc(1, sizeof(cc_string));
+        cc_string * string = cc_ast_alloc(sizeof(cc_string));
         string->node.node.line = self->lexer->line;
         string->node.node.type = CC_STRING;
-        string->value = strdup(self->lexer->value); 
+        string->value = cc_ast_strdup(self->lexer->value); 
         cc_lexer_next(self->lexer);
         return (cc_expr *)string;
     }
@@ -468,12 +601,14 @@ cc_expr * cc_parser_string(cc_parser * self) {
 
 cc_expr * cc_parser_number(cc_parser * self) {
     if (CC_TOK_NUMBER == self->lexer->token) {
-        cc_number * number = calloc(1, sizeof(cc_number));
+        cc_number * number = cc_ast_alloc(sizeof(cc_number));
         number->node.node.line = self->lexer->line;
         number->node.node.type = CC_NUMBER;
-        number->value = strdup(self->lexer->value);
+        number->value = cc_ast_strdup(self->lexer->value);
         cc_lexer_next(self->lexer);
         return (cc_expr *)number;
+    } else if ('(' == self->lexer->token) {
+        return cc_parser_paren(self);
     } else {
         cc_parser_err(self, self->lexer->line, "Expected an expression");
         cc_lexer_next(self->lexer);
@@ -482,6 +617,17 @@ cc_expr * cc_parser_number(cc_parser * self) {
 }
 
 
+/* Parses a parenthesized expression */
+cc_expr * cc_parser_paren(cc_parser * self) {
+    cc_expr * expr = 0;
+    cc_lexer_next(self->lexer); /* Consume '(' */
+    expr = cc_parser_expr(self);
+    if (')' != self->lexer->token) {
+        cc_parser_err(self, self->lexer->line, "Expected ')'");
+    }
+    cc_lexer_next(self->lexer);
+    return expr;
+}
 
 void cc_parser_err(cc_parser * self, int line, char const * msg) {
     fprintf(stderr, "%d: %s\n", line, msg);
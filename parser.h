@@ -34,16 +34,22 @@ typedef struct cc_parser {
 } cc_parser;
 
 cc_parser * cc_parser_init(cc_env * env, char const * file);
+void cc_parser_free(cc_parser * self);
 void cc_parser_global(cc_parser * self);
 cc_func * cc_parser_func(cc_parser * self, cc_type * type, cc_id * id);
+void cc_parser_struct(cc_parser * self, cc_struct * record);
 cc_var * cc_parser_var(cc_parser * self);
+cc_var * cc_parser_decl(cc_parser * self, cc_type * type, cc_id * id);
 cc_id * cc_parser_id(cc_parser * self);
 cc_type * cc_parser_type(cc_parser * self);
+cc_type * cc_parser_pointer(cc_parser * self, cc_type * type);
 cc_stmt * cc_parser_stmt(cc_parser * self);
 cc_block * cc_parser_block(cc_parser * self);
 cc_if * cc_parser_if(cc_parser * self);
 cc_loop * cc_parser_for(cc_parser * self);
 cc_loop * cc_parser_while(cc_parser * self);
+cc_expr * cc_parser_guard(cc_parser * self);
+cc_block * cc_parser_body(cc_parser * self);
 cc_return * cc_parser_return(cc_parser * self);
 cc_formal * cc_parser_formal(cc_parser * self);
 cc_expr * cc_parser_expr(cc_parser * self);
@@ -54,6 +60,7 @@ cc_expr * cc_parser_member(cc_parser * self);
 cc_expr * cc_parser_ref(cc_parser * self);
 cc_expr * cc_parser_number(cc_parser * self);
 cc_expr * cc_parser_string(cc_parser * self);
+cc_expr * cc_parser_paren(cc_parser * self);
 void cc_parser_err(cc_parser * self, int line, char const * msg);
 
 #endif
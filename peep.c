@@ -0,0 +1,616 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "peep.h"
+#include "emu.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Returns instruction 'i', or null past the end of the code or at a label */
+static cc_inst * cc_peep_at(cc_code * code, int i) {
+    if (i < 0 || i >= code->count || CC_INST_LABEL == code->insts[i].op) {
+        return 0;
+    }
+    return code->insts + i;
+}
+
+/* Returns non-zero if instruction 'i' only runs when the IF before it
+ * passes */
+static int cc_peep_conditional(cc_code * code, int i) {
+    for (--i; i >= 0 && CC_INST_LABEL == code->insts[i].op; --i) {
+    }
+    return i >= 0 && cc_op_isif(code->insts[i].op);
+}
+
+/* Returns non-zero for operands that don't move the stack pointer and
+ * aren't SP or PC */
+static int cc_peep_plain(cc_operand * opd) {
+    return CC_VAL_PUSHPOP != opd->mode && CC_VAL_SP != opd->mode
+        && CC_VAL_PC != opd->mode;
+}
+
+static int cc_peep_memory(cc_operand * opd) {
+    switch (opd->mode) {
+    case CC_VAL_IND:
+    case CC_VAL_OFF:
+    case CC_VAL_PEEK:
+    case CC_VAL_PICK:
+    case CC_VAL_MEM:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Returns non-zero if the operand reads register 'reg', as its value or to
+ * form an address */
+static int cc_peep_uses(cc_operand * opd, int reg) {
+    return (CC_VAL_REG == opd->mode || CC_VAL_IND == opd->mode
+        || CC_VAL_OFF == opd->mode) && reg == opd->reg;
+}
+
+/* Returns non-zero if 'inst' reads register 'reg' */
+static int cc_peep_reads(cc_inst * inst, int reg) {
+    if ((CC_OP_STI == inst->op || CC_OP_STD == inst->op)
+        && (CC_REG_I == reg || CC_REG_J == reg)) {
+        return 1;
+    }
+    if (cc_peep_uses(&inst->a, reg)) {
+        return 1;
+    }
+    if (inst->op > CC_OP_SPECIAL) {
+        return 0;
+    }
+    if (CC_VAL_REG == inst->b.mode) {
+        return CC_OP_SET != inst->op && reg == inst->b.reg;
+    }
+    return cc_peep_uses(&inst->b, reg);
+}
+
+/* Returns non-zero if a scan for the uses of a value must stop at 'inst':
+ * IFs, jumps, calls and the other special instructions */
+static int cc_peep_barrier(cc_inst * inst) {
+    return cc_op_isif(inst->op) || inst->op > CC_OP_SPECIAL
+        || CC_VAL_PC == inst->b.mode;
+}
+
+/* Returns non-zero for the instructions that set EX */
+static int cc_peep_setsex(int op) {
+    switch (op) {
+    case CC_OP_ADD:
+    case CC_OP_SUB:
+    case CC_OP_MUL:
+    case CC_OP_MLI:
+    case CC_OP_DIV:
+    case CC_OP_DVI:
+    case CC_OP_SHR:
+    case CC_OP_ASR:
+    case CC_OP_SHL:
+    case CC_OP_ADX:
+    case CC_OP_SBX:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* Returns non-zero if EX is set again before it is read after instruction
+ * 'i'.  The scan gives up at the first transfer of control. */
+static int cc_peep_exdead(cc_code * code, int i) {
+    for (++i; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        if (CC_INST_LABEL == inst->op) {
+            continue;
+        }
+        if (CC_OP_ADX == inst->op || CC_OP_SBX == inst->op
+            || CC_VAL_EX == inst->a.mode) {
+            return 0;
+        }
+        if (inst->op > CC_OP_SPECIAL || CC_VAL_PC == inst->b.mode) {
+            return 0;
+        }
+        if (CC_VAL_EX == inst->b.mode && CC_OP_SET != inst->op) {
+            return 0;
+        }
+        if ((CC_VAL_EX == inst->b.mode || cc_peep_setsex(inst->op))
+            && !cc_peep_conditional(code, i)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns non-zero for SET PC, label */
+static int cc_peep_isjump(cc_inst * inst) {
+    return CC_OP_SET == inst->op && CC_VAL_PC == inst->b.mode
+        && CC_VAL_LIT == inst->a.mode && inst->a.label;
+}
+
+/* Returns the index of the first instruction at or after the place of
+ * 'label', or -1 */
+static int cc_peep_target(cc_code * code, int label) {
+    int i = 0;
+    for (i = 0; i < code->count; ++i) {
+        if (CC_INST_LABEL == code->insts[i].op
+            && code->insts[i].a.label == label) {
+            break;
+        }
+    }
+    for (; i < code->count && CC_INST_LABEL == code->insts[i].op; ++i) {
+    }
+    return i < code->count ? i : -1;
+}
+
+/* SET x, x */
+static int cc_peep_self(cc_code * code, int i, int * count, cc_inst * out) {
+    cc_inst * inst = cc_peep_at(code, i);
+    if (!inst || CC_OP_SET != inst->op || !cc_peep_plain(&inst->b)
+        || !cc_operand_equal(&inst->a, &inst->b)) {
+        return -1;
+    }
+    *count = 1;
+    return 0;
+}
+
+/* Arithmetic by an identity: ADD, SUB, BOR, XOR and the shifts by 0, MUL
+ * and DIV by 1, and AND by 0xffff.  Those that set EX are only removed if
+ * EX is dead. */
+static int cc_peep_identity(cc_code * code, int i, int * count,
+    cc_inst * out) {
+
+    cc_inst * inst = cc_peep_at(code, i);
+    int ex = 1;
+    if (!inst || CC_VAL_LIT != inst->a.mode || inst->a.sym || inst->a.label
+        || !cc_peep_plain(&inst->b)) {
+        return -1;
+    }
+    switch (inst->op) {
+    case CC_OP_BOR:
+    case CC_OP_XOR:
+        ex = 0;
+        /* Fall through */
+    case CC_OP_ADD:
+    case CC_OP_SUB:
+    case CC_OP_SHL:
+    case CC_OP_SHR:
+    case CC_OP_ASR:
+        if (inst->a.value & 0xffff) {
+            return -1;
+        }
+        break;
+    case CC_OP_MUL:
+    case CC_OP_DIV:
+        if (1 != (inst->a.value & 0xffff)) {
+            return -1;
+        }
+        break;
+    case CC_OP_AND:
+        ex = 0;
+        if (0xffff != (inst->a.value & 0xffff)) {
+            return -1;
+        }
+        break;
+    default:
+        return -1;
+    }
+    if (ex && !cc_peep_exdead(code, i)) {
+        return -1;
+    }
+    *count = 1;
+    return 0;
+}
+
+/* SET a, b followed by SET b, a: the second copy changes nothing */
+static int cc_peep_copyback(cc_code * code, int i, int * count,
+    cc_inst * out) {
+
+    cc_inst * first = cc_peep_at(code, i);
+    cc_inst * second = cc_peep_at(code, i + 1);
+    if (!first || !second || CC_OP_SET != first->op
+        || CC_OP_SET != second->op || CC_VAL_LIT == first->a.mode) {
+        return -1;
+    }
+    if (!cc_operand_equal(&first->a, &second->b)
+        || !cc_operand_equal(&first->b, &second->a)) {
+        return -1;
+    }
+    if (!cc_peep_plain(&first->a) || !cc_peep_plain(&first->b)) {
+        return -1;
+    }
+    if (CC_VAL_REG == first->b.mode
+        && cc_peep_uses(&first->a, first->b.reg)) {
+        return -1; /* SET A, [A] moves the word A points to */
+    }
+    *count = 2;
+    out[0] = *first;
+    return 1;
+}
+
+/* SET PUSH, x followed by SET y, POP is SET y, x, or nothing if x is y */
+static int cc_peep_pushpop(cc_code * code, int i, int * count,
+    cc_inst * out) {
+
+    cc_inst * first = cc_peep_at(code, i);
+    cc_inst * second = cc_peep_at(code, i + 1);
+    if (!first || !second || CC_OP_SET != first->op
+        || CC_OP_SET != second->op || CC_VAL_PUSHPOP != first->b.mode
+        || CC_VAL_PUSHPOP != second->a.mode) {
+        return -1;
+    }
+    if (!cc_peep_plain(&first->a) || !cc_peep_plain(&second->b)) {
+        return -1;
+    }
+    *count = 2;
+    if (cc_operand_equal(&first->a, &second->b)) {
+        return 0;
+    }
+    out[0] = *second;
+    out[0].a = first->a;
+    return 1;
+}
+
+/* SET r, POP followed by SET PUSH, r leaves the stack as it was:
+ * SET r, PEEK */
+static int cc_peep_poppush(cc_code * code, int i, int * count,
+    cc_inst * out) {
+
+    cc_inst * first = cc_peep_at(code, i);
+    cc_inst * second = cc_peep_at(code, i + 1);
+    if (!first || !second || CC_OP_SET != first->op
+        || CC_OP_SET != second->op || CC_VAL_REG != first->b.mode
+        || CC_VAL_PUSHPOP != first->a.mode
+        || CC_VAL_PUSHPOP != second->b.mode
+        || !cc_operand_equal(&first->b, &second->a)) {
+        return -1;
+    }
+    *count = 2;
+    out[0] = *first;
+    out[0].a = cc_opd_pick(0);
+    return 1;
+}
+
+/* A store that is overwritten before it is read: a register set again by
+ * a later SET in the window, with no use in between, or the same memory
+ * word set twice in a row */
+static int cc_peep_dead(cc_code * code, int i, int * count, cc_inst * out) {
+    cc_inst * inst = cc_peep_at(code, i);
+    cc_inst * next = 0;
+    int k = 0;
+    if (!inst || CC_OP_SET != inst->op || CC_VAL_PUSHPOP == inst->a.mode) {
+        return -1;
+    }
+    if (CC_VAL_REG == inst->b.mode) {
+        for (k = 1; k < CC_PEEP_WINDOW; ++k) {
+            next = cc_peep_at(code, i + k);
+            if (!next || cc_peep_barrier(next)
+                || cc_peep_reads(next, inst->b.reg)) {
+                return -1;
+            }
+            if (CC_OP_SET == next->op && CC_VAL_REG == next->b.mode
+                && inst->b.reg == next->b.reg) {
+                break;
+            }
+        }
+        if (CC_PEEP_WINDOW == k) {
+            return -1;
+        }
+    } else if (cc_peep_memory(&inst->b)) {
+        next = cc_peep_at(code, i + 1);
+        if (!next || CC_OP_SET != next->op
+            || !cc_operand_equal(&inst->b, &next->b)
+            || (CC_VAL_REG != next->a.mode && CC_VAL_LIT != next->a.mode)) {
+            return -1;
+        }
+        k = 1;
+    } else {
+        return -1;
+    }
+    *count = k + 1;
+    memcpy(out, code->insts + i + 1, k * sizeof(cc_inst));
+    return k;
+}
+
+/* A jump to the next instruction, along with the IFs that guard it */
+static int cc_peep_next(cc_code * code, int i, int * count, cc_inst * out) {
+    cc_inst * inst = 0;
+    int k = i;
+    for (; (inst = cc_peep_at(code, k)) && cc_op_isif(inst->op); ++k) {
+        if (!cc_peep_plain(&inst->a) || !cc_peep_plain(&inst->b)) {
+            return -1;
+        }
+    }
+    if (!inst || !cc_peep_isjump(inst)) {
+        return -1;
+    }
+    *count = k - i + 1;
+    for (++k; k < code->count && CC_INST_LABEL == code->insts[k].op; ++k) {
+        if (code->insts[k].a.label == inst->a.label) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* A jump to a jump goes straight to the final target, or takes the
+ * final jump itself if that isn't to a label (such as SET PC, POP).  A
+ * cycle of jumps is left alone. */
+static int cc_peep_thread(cc_code * code, int i, int * count,
+    cc_inst * out) {
+
+    cc_inst * inst = cc_peep_at(code, i);
+    cc_inst * last = inst;
+    cc_inst * target = inst;
+    int hops = 0;
+    if (!inst || !cc_peep_isjump(inst)) {
+        return -1;
+    }
+    while (cc_peep_isjump(target)) {
+        int k = cc_peep_target(code, target->a.label);
+        if (k < 0 || ++hops > CC_PEEP_PASSES) {
+            return -1;
+        }
+        last = target;
+        target = code->insts + k;
+    }
+    *count = 1;
+    out[0] = *inst;
+    if (CC_OP_SET == target->op && CC_VAL_PC == target->b.mode) {
+        out[0].a = target->a;
+    } else if (hops > 1) {
+        out[0].a = last->a;
+    } else {
+        return -1;
+    }
+    return 1;
+}
+
+/* Instructions after an unconditional jump, up to the next label */
+static int cc_peep_unreachable(cc_code * code, int i, int * count,
+    cc_inst * out) {
+
+    cc_inst * inst = cc_peep_at(code, i);
+    int k = 1;
+    if (!inst || CC_OP_SET != inst->op || CC_VAL_PC != inst->b.mode
+        || cc_peep_conditional(code, i)) {
+        return -1;
+    }
+    while (k < CC_PEEP_WINDOW && cc_peep_at(code, i + k)) {
+        k++;
+    }
+    if (1 == k) {
+        return -1;
+    }
+    *count = k;
+    out[0] = *inst;
+    return 1;
+}
+
+static cc_peeprule const cc_peep_rules[CC_PEEP_RULES] = {
+    { "self moves", cc_peep_self },
+    { "identities", cc_peep_identity },
+    { "copies back", cc_peep_copyback },
+    { "pushes popped", cc_peep_pushpop },
+    { "pops pushed", cc_peep_poppush },
+    { "dead stores", cc_peep_dead },
+    { "jumps to the next instruction", cc_peep_next },
+    { "jumps to jumps", cc_peep_thread },
+    { "unreachable instructions", cc_peep_unreachable },
+};
+
+/* Removes the labels that nothing refers to, so that windows can span
+ * them */
+static int cc_peep_labels(cc_code * code) {
+    int * refs = calloc(code->labels + 1, sizeof(int));
+    int changes = 0;
+    int i = 0;
+    for (i = 0; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        if (CC_INST_LABEL != inst->op) {
+            refs[inst->a.label]++;
+            refs[inst->b.label]++;
+        }
+    }
+    for (i = 0; i < code->count;) {
+        cc_inst * inst = code->insts + i;
+        if (CC_INST_LABEL == inst->op && !refs[inst->a.label]) {
+            cc_code_remove(code, i);
+            changes++;
+        } else {
+            i++;
+        }
+    }
+    free(refs);
+    return changes;
+}
+
+/* Tries rule 'rule' at instruction 'i', and makes the replacement if the
+ * cost model finds it no worse in words and cycles.  Returns non-zero if
+ * the code changed. */
+static int cc_peep_apply(cc_peep * self, cc_code * code, int i, int rule) {
+    cc_inst out[CC_PEEP_WINDOW];
+    int count = 0;
+    int n = cc_peep_rules[rule].match(code, i, &count, out);
+    int words = 0;
+    int cycles = 0;
+    int k = 0;
+    if (n < 0) {
+        return 0;
+    }
+    if (cc_peep_conditional(code, i) && (1 != count || 1 != n)) {
+        return 0;
+    }
+    for (k = 0; k < count; ++k) {
+        words += cc_inst_words(code->insts + i + k);
+        cycles += cc_inst_cycles(code->insts + i + k);
+    }
+    for (k = 0; k < n; ++k) {
+        words -= cc_inst_words(out + k);
+        cycles -= cc_inst_cycles(out + k);
+    }
+    if (words < 0 || cycles < 0) {
+        self->rejected++;
+        return 0;
+    }
+    for (k = 0; k < count; ++k) {
+        cc_code_remove(code, i);
+    }
+    for (k = 0; k < n; ++k) {
+        *cc_code_insert(code, i + k, out[k].op, out[k].b, out[k].a) = out[k];
+    }
+    self->hits[rule]++;
+    self->words += words;
+    self->cycles += cycles;
+    return 1;
+}
+
+/* Applies the rules to 'code' until none of them matches.  Returns the
+ * number of rewrites. */
+int cc_peep_code(cc_peep * self, cc_code * code) {
+    int changes = 0;
+    int pass = 0;
+    int i = 0;
+    int r = 0;
+    for (pass = 0; pass < CC_PEEP_PASSES; ++pass) {
+        int rewrites = 0;
+        cc_peep_labels(code);
+        for (i = 0; i < code->count; ++i) {
+            for (r = 0; r < CC_PEEP_RULES; ++r) {
+                if (cc_peep_apply(self, code, i, r)) {
+                    rewrites++;
+                    r = -1; /* Try every rule on the new window */
+                }
+            }
+        }
+        if (!rewrites) {
+            break;
+        }
+        changes += rewrites;
+    }
+    return changes;
+}
+
+/* Returns a copy of the code buffers in 'codes' */
+static cc_code * cc_peep_copy(cc_code * codes) {
+    cc_code * head = 0;
+    cc_code ** tail = &head;
+    for (; codes; codes = codes->next) {
+        cc_code * copy = malloc(sizeof(cc_code));
+        *copy = *codes;
+        copy->capacity = codes->count + 1;
+        copy->insts = malloc(copy->capacity * sizeof(cc_inst));
+        memcpy(copy->insts, codes->insts, codes->count * sizeof(cc_inst));
+        copy->next = 0;
+        *tail = copy;
+        tail = &copy->next;
+    }
+    return head;
+}
+
+/* Runs the peephole pass over the whole program.  With -fpeephole-check,
+ * the code before the pass is kept for cc_peep_check. */
+void cc_peep_env(cc_gen * gen) {
+    cc_peep * self = calloc(1, sizeof(cc_peep));
+    cc_code * code = 0;
+    int changes = 0;
+    int r = 0;
+
+    self->gen = gen;
+    if (gen->check) {
+        gen->plain = cc_peep_copy(gen->codes);
+    }
+    for (code = gen->codes; code; code = code->next) {
+        changes += cc_peep_code(self, code);
+    }
+    if (gen->verbose) {
+        for (r = 0; r < CC_PEEP_RULES; ++r) {
+            if (self->hits[r]) {
+                fprintf(stderr, "peep: %d %s\n", self->hits[r],
+                    cc_peep_rules[r].name);
+            }
+        }
+        fprintf(stderr, "peep: %d rewrites, %d rejected by the cost model, "
+            "%d words and %d cycles saved\n", changes, self->rejected,
+            self->words, self->cycles);
+    }
+    free(self);
+}
+
+/* Links the program made of 'codes' and runs it in 'emu'.  Returns 0 if
+ * the program couldn't be linked. */
+static int cc_peep_run(cc_gen * gen, cc_code * codes, cc_emu * emu) {
+    cc_asm * as = cc_asm_init(gen->env);
+    cc_code * saved = gen->codes;
+    int i = 0;
+    gen->codes = codes;
+    cc_gen_assemble(gen, as);
+    gen->codes = saved;
+    cc_asm_link(as);
+    if (as->errors) {
+        cc_asm_free(as);
+        return 0;
+    }
+    for (i = 0; i < as->count && i < CC_DCPU_WORDS; ++i) {
+        emu->mem[i] = as->words[i];
+    }
+    cc_asm_free(as);
+    cc_emu_reset(emu);
+    cc_emu_run(emu, CC_PEEP_STEPS);
+    return 1;
+}
+
+/* Runs the program built with and without the peephole pass in the
+ * emulator, and compares the values main returns (-fpeephole-check).
+ * Returns 0 if they differ. */
+int cc_peep_check(cc_gen * gen) {
+    cc_emu * plain = 0;
+    cc_emu * peep = 0;
+    int ok = 1;
+    if (!gen->plain) {
+        fprintf(stderr, "peephole check: the pass didn't run\n");
+        return 1;
+    }
+    plain = cc_emu_init();
+    peep = cc_emu_init();
+    if (!cc_peep_run(gen, gen->plain, plain)
+        || !cc_peep_run(gen, gen->codes, peep)) {
+        ok = 0;
+    } else if (!plain->halted && !peep->halted) {
+        fprintf(stderr, "peephole check: no result within %d steps\n",
+            CC_PEEP_STEPS);
+    } else if (plain->halted != peep->halted || plain->fault != peep->fault
+        || plain->regs[CC_REG_A] != peep->regs[CC_REG_A]) {
+        fprintf(stderr, "peephole check failed: main returned %d%s without "
+            "the pass and %d%s with it\n", plain->regs[CC_REG_A],
+            plain->halted ? "" : " (still running)", peep->regs[CC_REG_A],
+            peep->halted ? "" : " (still running)");
+        ok = 0;
+    } else {
+        fprintf(stderr, "peephole check: main returned %d, %lu cycles "
+            "without the pass and %lu with it\n", plain->regs[CC_REG_A],
+            plain->cycles, peep->cycles);
+    }
+    cc_emu_free(plain);
+    cc_emu_free(peep);
+    return ok;
+}
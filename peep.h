@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_PEEP_H
+#define CC_PEEP_H
+
+#include "gen.h"
+
+/* Peephole pass for -O1 and up.  It runs over the finished code of every
+ * function, after the frames are laid out, and rewrites windows of at most
+ * CC_PEEP_WINDOW instructions that straightforward lowering leaves behind:
+ *
+ * - SET x, x and arithmetic by an identity such as ADD x, 0;
+ * - SET a, b followed by SET b, a, and SET PUSH, x followed by SET y, POP;
+ * - stores that are overwritten before they are read;
+ * - jumps to the next instruction, jumps to jumps and unreachable code.
+ *
+ * Each rule proposes a replacement, which is only made if it takes no more
+ * words and no more cycles than the window it replaces.  The rules are
+ * applied until none of them matches.  A window never contains a label
+ * after its first instruction, and a window that runs only if an IF
+ * passes is replaced by exactly one instruction, so that the IF still
+ * skips the same code. */
+
+/* Longest window a rule looks at, in instructions */
+#define CC_PEEP_WINDOW 4
+
+/* Passes over a function before the rules are assumed to disagree */
+#define CC_PEEP_PASSES 16
+
+/* Number of rules in the rule table */
+#define CC_PEEP_RULES 9
+
+/* Instructions run by each program in -fpeephole-check before giving up */
+#define CC_PEEP_STEPS 1000000000
+
+typedef struct cc_peep {
+    cc_gen * gen;
+    int hits[CC_PEEP_RULES]; /* Rewrites made by each rule */
+    int rejected; /* Matches that weren't cheaper than the window */
+    int words; /* Words saved */
+    int cycles; /* Cycles saved, counting each window once */
+} cc_peep;
+
+/* A rule looks at the window that starts at instruction 'i'.  On a match
+ * it stores the replacement in 'out', the number of instructions it
+ * replaces in 'count', and returns the number of instructions in 'out';
+ * otherwise it returns -1. */
+typedef int (*cc_peepfn)(cc_code * code, int i, int * count, cc_inst * out);
+
+typedef struct cc_peeprule {
+    char const * name;
+    cc_peepfn match;
+} cc_peeprule;
+
+void cc_peep_env(cc_gen * gen);
+int cc_peep_code(cc_peep * self, cc_code * code);
+int cc_peep_check(cc_gen * gen);
+
+#endif
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "pgo.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* Mixes 'value' into a FNV-1a hash */
+static unsigned long cc_pgo_mix(unsigned long hash, unsigned long value) {
+    int i = 0;
+    for (i = 0; i < 4; ++i) {
+        hash = ((hash ^ (value & 0xff)) * 16777619UL) & 0xffffffffUL;
+        value >>= 8;
+    }
+    return hash;
+}
+
+static unsigned long cc_pgo_str(unsigned long hash, char const * str) {
+    while (str && *str) {
+        hash = cc_pgo_mix(hash, (unsigned char)*str++);
+    }
+    return cc_pgo_mix(hash, 0);
+}
+
+static unsigned long cc_pgo_expr(unsigned long hash, cc_expr * expr) {
+    cc_expr * arg = 0;
+    if (!expr) {
+        return cc_pgo_mix(hash, 0xff);
+    }
+    hash = cc_pgo_mix(hash, expr->node.type);
+    switch (expr->node.type) {
+    case CC_MEMBER:
+        hash = cc_pgo_str(hash, ((cc_member *)expr)->id->str);
+        return cc_pgo_expr(hash, ((cc_member *)expr)->expr);
+    case CC_BINARY:
+        hash = cc_pgo_mix(hash, ((cc_binary *)expr)->op);
+        hash = cc_pgo_expr(hash, ((cc_binary *)expr)->left);
+        return cc_pgo_expr(hash, ((cc_binary *)expr)->right);
+    case CC_UNARY:
+        hash = cc_pgo_mix(hash, ((cc_unary *)expr)->op);
+        return cc_pgo_expr(hash, ((cc_unary *)expr)->expr);
+    case CC_CALL:
+        hash = cc_pgo_expr(hash, ((cc_call *)expr)->expr);
+        for (arg = ((cc_call *)expr)->args; arg; arg = arg->next) {
+            hash = cc_pgo_expr(hash, arg);
+        }
+        return hash;
+    case CC_REF:
+        return cc_pgo_str(hash, ((cc_ref *)expr)->id->str);
+    case CC_NUMBER:
+        return cc_pgo_str(hash, ((cc_number *)expr)->value);
+    case CC_STRING:
+        return cc_pgo_str(hash, ((cc_string *)expr)->value);
+    default:
+        return hash;
+    }
+}
+
+/* Numbers the counters of the statements in 'stmt' and the ones after it,
+ * and mixes their structure into '*hash' */
+static void cc_pgo_stmt(cc_pgo * self, cc_stmt * stmt, unsigned long * hash) {
+    for (; stmt; stmt = stmt->next) {
+        *hash = cc_pgo_mix(*hash, stmt->node.type);
+        switch (stmt->node.type) {
+        case CC_BLOCK: {
+            cc_var * var = 0;
+            for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+                *hash = cc_pgo_str(*hash, var->id->str);
+                *hash = cc_pgo_expr(*hash, var->init);
+            }
+            cc_pgo_stmt(self, ((cc_block *)stmt)->stmts, hash);
+            *hash = cc_pgo_mix(*hash, 0xfe);
+            break;
+        }
+        case CC_IF: {
+            cc_if * stmt_if = (cc_if *)stmt;
+            stmt_if->site = self->counters;
+            self->counters += 2;
+            *hash = cc_pgo_expr(*hash, stmt_if->guard);
+            cc_pgo_stmt(self, stmt_if->yes, hash);
+            *hash = cc_pgo_mix(*hash, 0xfd);
+            cc_pgo_stmt(self, stmt_if->no, hash);
+            *hash = cc_pgo_mix(*hash, 0xfe);
+            break;
+        }
+        case CC_FOR:
+        case CC_WHILE: {
+            cc_loop * loop = (cc_loop *)stmt;
+            loop->site = self->counters;
+            self->counters += 2;
+            *hash = cc_pgo_expr(*hash, loop->init);
+            *hash = cc_pgo_expr(*hash, loop->guard);
+            *hash = cc_pgo_expr(*hash, loop->update);
+            cc_pgo_stmt(self, (cc_stmt *)loop->block, hash);
+            *hash = cc_pgo_mix(*hash, 0xfe);
+            break;
+        }
+        case CC_SIMPLE:
+            *hash = cc_pgo_expr(*hash, ((cc_simple *)stmt)->expr);
+            break;
+        case CC_RETURN:
+            *hash = cc_pgo_expr(*hash, ((cc_return *)stmt)->expr);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/* Numbers the counters of every function with a body.  Must run before the
+ * optimizer changes the bodies, so that the numbering only depends on the
+ * source. */
+cc_pgo * cc_pgo_init(cc_env * env) {
+    cc_pgo * self = calloc(1, sizeof(cc_pgo));
+    cc_func * func = 0;
+    cc_formal * formal = 0;
+    int capfuncs = 0;
+    int i = 0;
+
+    self->env = env;
+    self->id = cc_env_id(env, "$profile");
+    self->counters = 1;
+    for (func = env->funcs; func; func = func->next) {
+        cc_pgofunc * entry = 0;
+        if (!func->block) {
+            continue;
+        }
+        if (self->nfuncs >= capfuncs) {
+            capfuncs = capfuncs ? capfuncs * 2 : 16;
+            self->funcs = realloc(self->funcs,
+                capfuncs * sizeof(cc_pgofunc));
+        }
+        entry = self->funcs + self->nfuncs++;
+        entry->func = func;
+        entry->first = self->counters++;
+        entry->hash = 2166136261UL;
+        for (formal = func->formals; formal; formal = formal->next) {
+            entry->hash = cc_pgo_str(entry->hash, formal->id->str);
+        }
+        cc_pgo_stmt(self, (cc_stmt *)func->block, &entry->hash);
+        entry->count = self->counters - entry->first;
+    }
+    self->counts = malloc(self->counters * sizeof(double));
+    for (i = 0; i < self->counters; ++i) {
+        self->counts[i] = -1;
+    }
+    return self;
+}
+
+void cc_pgo_free(cc_pgo * self) {
+    free(self->funcs);
+    free(self->counts);
+    free(self);
+}
+
+/* Reads the counts written by dcpu16run -P.  A function whose name is
+ * found but whose hash or number of counters differs has changed since
+ * the profile was taken; its counts are ignored, with a warning.  Returns
+ * zero if the file can't be read. */
+int cc_pgo_load(cc_pgo * self, char const * path) {
+    FILE * in = fopen(path, "r");
+    char name[256];
+    unsigned long hash = 0;
+    int version = 0;
+    int count = 0;
+    int i = 0;
+    int k = 0;
+
+    if (!in) {
+        return 0;
+    }
+    if (1 != fscanf(in, " dcpu16-profdata %d", &version) || 1 != version) {
+        fclose(in);
+        return 0;
+    }
+    while (3 == fscanf(in, " F %255s %lx %d", name, &hash, &count)) {
+        cc_pgofunc * func = 0;
+        for (i = 0; i < self->nfuncs; ++i) {
+            if (!strcmp(self->funcs[i].func->id->str, name)) {
+                func = self->funcs + i;
+            }
+        }
+        if (func && (func->hash != hash || func->count != count)) {
+            fprintf(stderr, "warning: profile of '%s' is stale, "
+                "ignored\n", name);
+            self->stale++;
+            func = 0;
+        } else if (func) {
+            self->matched++;
+        }
+        for (k = 0; k < count; ++k) {
+            double value = 0;
+            if (1 != fscanf(in, " %lf", &value)) {
+                break;
+            }
+            if (func) {
+                self->counts[func->first + k] = value;
+            }
+        }
+    }
+    fclose(in);
+    return 1;
+}
+
+/* Writes the map of the counter array in a linked image, which dcpu16run
+ * needs to write the .profdata file:
+ *
+ *   dcpu16-profmap 1 <address of the array>
+ *   F <name> <hash> <first counter> <counters>
+ *
+ * Each counter takes two words, low word first. */
+void cc_pgo_map(cc_pgo * self, cc_asm * as, FILE * out) {
+    int i = 0;
+    fprintf(out, "dcpu16-profmap 1 %d\n", cc_asm_lookup(as, self->id));
+    for (i = 0; i < self->nfuncs; ++i) {
+        cc_pgofunc * func = self->funcs + i;
+        fprintf(out, "F %s %08lx %d %d\n", func->func->id->str, func->hash,
+            func->first, func->count);
+    }
+}
+
+/* Returns the counters of 'func', or 0 */
+cc_pgofunc * cc_pgo_func(cc_pgo * self, cc_func * func) {
+    int i = 0;
+    for (i = 0; self && i < self->nfuncs; ++i) {
+        if (self->funcs[i].func == func) {
+            return self->funcs + i;
+        }
+    }
+    return 0;
+}
+
+/* Returns the count of a counter, or -1 if it isn't known */
+double cc_pgo_count(cc_pgo * self, int counter) {
+    if (!self || counter <= 0 || counter >= self->counters) {
+        return -1;
+    }
+    return self->counts[counter];
+}
+
+/* Returns the number of times the 'yes' arm or body of the statement with
+ * counters at 'site' ran per run of the statement: the fraction of the
+ * time an if statement's guard held, or the trip count of a loop.  A
+ * statement that never ran has ratio 0.  Returns -1 if not known. */
+double cc_pgo_ratio(cc_pgo * self, int site) {
+    double runs = cc_pgo_count(self, site);
+    double hits = cc_pgo_count(self, site + 1);
+    if (runs < 0 || hits < 0) {
+        return -1;
+    }
+    return runs > 0 ? hits / runs : 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_PGO_H
+#define CC_PGO_H
+
+#include "env.h"
+#include "asm.h"
+#include <stdio.h>
+
+/* Profile counters of one function.  Counter 'first' counts calls; then
+ * each if statement and loop, in source order, has two: the first counts
+ * the times the statement runs, the second the times its 'yes' arm or its
+ * body runs.  The hash covers the structure of the body as parsed, so a
+ * profile taken from a different version of the function is detected. */
+typedef struct cc_pgofunc {
+    cc_func * func;
+    int first;
+    int count;
+    unsigned long hash;
+} cc_pgofunc;
+
+/* Profile-guided optimization.  With -fprofile-generate, the generated
+ * code increments a 32-bit counter in the '$profile' array for each of
+ * the counters above, and a map of the array is written next to the
+ * image; dcpu16run -P writes the counters to a .profdata file after the
+ * run.  With -fprofile-use, the counts are read back from that file and
+ * guide the layout of if statements, the weights of register variables
+ * and the inliner.  Nothing is inlined while generating a profile, so
+ * that every function counts its own calls.  Counter 0 is unused, so that a site of 0 means that
+ * a statement has no counters. */
+typedef struct cc_pgo {
+    cc_env * env;
+    cc_id * id; /* Symbol of the counter array */
+    cc_pgofunc * funcs;
+    int nfuncs;
+    int counters;
+    double * counts; /* Count of each counter, or -1 if not known */
+    int generate; /* Emit the counters */
+    int matched; /* Functions whose profile was used */
+    int stale; /* Functions whose profile didn't match */
+} cc_pgo;
+
+cc_pgo * cc_pgo_init(cc_env * env);
+void cc_pgo_free(cc_pgo * self);
+int cc_pgo_load(cc_pgo * self, char const * path);
+void cc_pgo_map(cc_pgo * self, cc_asm * as, FILE * out);
+cc_pgofunc * cc_pgo_func(cc_pgo * self, cc_func * func);
+double cc_pgo_count(cc_pgo * self, int counter);
+double cc_pgo_ratio(cc_pgo * self, int site);
+
+#endif
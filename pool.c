@@ -0,0 +1,673 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "pool.h"
+#include "frame.h"
+#include "opt.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Creates an empty pool */
+cc_pool * cc_pool_init(cc_env * env) {
+    cc_pool * self = calloc(1, sizeof(cc_pool));
+    self->env = env;
+    return self;
+}
+
+/* Decodes the escape sequences in 'raw', as read by the lexer, into
+ * 'chars', which must have room for strlen(raw) + 1 characters.  Returns
+ * the number of characters, including the terminating zero. */
+static int cc_pool_decode(char const * raw, unsigned short * chars) {
+    int count = 0;
+    int c = 0;
+    int k = 0;
+    while (*raw) {
+        c = (unsigned char)*raw++;
+        if ('\\' == c && *raw) {
+            c = (unsigned char)*raw++;
+            switch (c) {
+            case 'n': c = '\n'; break;
+            case 't': c = '\t'; break;
+            case 'r': c = '\r'; break;
+            case 'a': c = '\a'; break;
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'v': c = '\v'; break;
+            case 'x':
+                for (c = 0; isxdigit((unsigned char)*raw); ++raw) {
+                    c = c * 16 + (isdigit((unsigned char)*raw) ? *raw - '0'
+                        : tolower((unsigned char)*raw) - 'a' + 10);
+                }
+                break;
+            default:
+                if (c >= '0' && c <= '7') {
+                    c -= '0';
+                    for (k = 1; k < 3 && *raw >= '0' && *raw <= '7'; ++k) {
+                        c = c * 8 + *raw++ - '0';
+                    }
+                }
+                break; /* Other characters stand for themselves */
+            }
+        }
+        chars[count++] = c & 0xff;
+    }
+    chars[count++] = 0;
+    return count;
+}
+
+/* Returns the literal with the characters 'chars', adding it to the pool
+ * if it is new.  The pool takes 'chars', which are freed if the literal
+ * is already there. */
+static cc_literal * cc_pool_intern(cc_pool * self, unsigned short * chars,
+    int count) {
+
+    cc_literal * literal = 0;
+    char name[32];
+    int i = 0;
+
+    for (i = 0; i < self->count; ++i) {
+        literal = self->literals[i];
+        if (literal->nchars == count && !memcmp(literal->chars, chars,
+            count * sizeof(unsigned short))) {
+            literal->refs++;
+            free(chars);
+            return literal;
+        }
+    }
+    literal = calloc(1, sizeof(cc_literal));
+    sprintf(name, "$s%d", self->count);
+    literal->id = cc_env_id(self->env, name);
+    literal->chars = chars;
+    literal->nchars = count;
+    literal->refs = 1;
+    literal->owner = literal;
+    if (self->count >= self->capacity) {
+        self->capacity = self->capacity ? self->capacity * 2 : 16;
+        self->literals = realloc(self->literals,
+            self->capacity * sizeof(cc_literal *));
+    }
+    self->literals[self->count++] = literal;
+    return literal;
+}
+
+/* Adds a string literal to the pool, and returns its address.  'raw' is
+ * the text between the quotes.  An identical string already in the pool is
+ * reused. */
+cc_operand cc_pool_add(cc_pool * self, char const * raw) {
+    unsigned short * chars = calloc(strlen(raw) + 1, sizeof(unsigned short));
+    int count = cc_pool_decode(raw, chars);
+    return cc_opd_sym(cc_pool_intern(self, chars, count)->id);
+}
+
+/* Adds the literals of 'other', a pool filled by one task (see par.h), in
+ * their order of first occurrence, so that this pool ends up as if their
+ * strings had been added here.  Returns the ids of the literals in this
+ * pool, indexed like other->literals. */
+cc_id ** cc_pool_merge(cc_pool * self, cc_pool * other) {
+    cc_id ** ids = calloc(other->count + 1, sizeof(cc_id *));
+    int i = 0;
+    for (i = 0; i < other->count; ++i) {
+        cc_literal * literal = other->literals[i];
+        unsigned short * chars = malloc(literal->nchars
+            * sizeof(unsigned short));
+        cc_literal * merged = 0;
+        memcpy(chars, literal->chars, literal->nchars
+            * sizeof(unsigned short));
+        merged = cc_pool_intern(self, chars, literal->nchars);
+        merged->refs += literal->refs - 1;
+        ids[i] = merged->id;
+    }
+    return ids;
+}
+
+/* Frees the pool and its literals, but not their ids */
+void cc_pool_free(cc_pool * self) {
+    int i = 0;
+    for (i = 0; i < self->count; ++i) {
+        cc_literal * literal = self->literals[i];
+        if (literal->words != literal->chars) {
+            free(literal->words);
+        }
+        free(literal->chars);
+        free(literal);
+    }
+    free(self->literals);
+    free(self);
+}
+
+/* Compares the words of two literals from the end, so that a string sorts
+ * just before the strings it is the tail of */
+static int cc_pool_compare(void const * a, void const * b) {
+    cc_literal const * x = *(cc_literal * const *)a;
+    cc_literal const * y = *(cc_literal * const *)b;
+    int i = x->nwords;
+    int j = y->nwords;
+    while (i > 0 && j > 0) {
+        --i;
+        --j;
+        if (x->words[i] != y->words[j]) {
+            return x->words[i] < y->words[j] ? -1 : 1;
+        }
+    }
+    return (i > 0) - (j > 0);
+}
+
+/* Encodes the strings as words, and stores each string that is the tail of
+ * another inside it.  After sorting the strings by their reversed words,
+ * a string can be merged with the one that follows it if it is any string's
+ * tail at all.  Must be called once every literal has been added. */
+void cc_pool_layout(cc_pool * self) {
+    cc_literal ** sorted = calloc(self->count + 1, sizeof(cc_literal *));
+    long unpooled = 0;
+    int i = 0;
+    int k = 0;
+
+    for (i = 0; i < self->count; ++i) {
+        cc_literal * literal = self->literals[i];
+        if (self->packed) {
+            literal->nwords = (literal->nchars + 1) / 2;
+            literal->words = calloc(literal->nwords, sizeof(unsigned short));
+            for (k = 0; k < literal->nchars; ++k) {
+                literal->words[k / 2] |= literal->chars[k] << (k % 2 ? 0 : 8);
+            }
+        } else {
+            literal->nwords = literal->nchars;
+            literal->words = literal->chars;
+        }
+        unpooled += (long)literal->refs * literal->nchars;
+        sorted[i] = literal;
+    }
+
+    qsort(sorted, self->count, sizeof(cc_literal *), cc_pool_compare);
+    for (i = self->count - 2; i >= 0; --i) {
+        cc_literal * literal = sorted[i];
+        cc_literal * next = sorted[i + 1];
+        int offset = next->nwords - literal->nwords;
+        if (offset >= 0 && !memcmp(literal->words, next->words + offset,
+            literal->nwords * sizeof(unsigned short))) {
+            literal->owner = next->owner;
+            literal->offset = next->offset + offset;
+        }
+    }
+    free(sorted);
+
+    self->words = 0;
+    for (i = 0; i < self->count; ++i) {
+        if (self->literals[i]->owner == self->literals[i]) {
+            self->words += self->literals[i]->nwords;
+        }
+    }
+    self->saved = unpooled - self->words;
+}
+
+/* Prints words 'start' up to 'end' of a string as a DAT directive.
+ * Printable characters are quoted, unless the string is packed. */
+static void cc_pool_dat(cc_pool * self, cc_literal * literal, int start,
+    int end, FILE * out) {
+    int quoted = 0;
+    int k = 0;
+    fprintf(out, "    DAT ");
+    for (k = start; k < end; ++k) {
+        int word = literal->words[k];
+        int text = !self->packed && word >= ' ' && word <= '~'
+            && '"' != word && '\\' != word;
+        if (text && !quoted) {
+            fprintf(out, "%s\"", k > start ? ", " : "");
+        } else if (!text && quoted) {
+            fprintf(out, "\"");
+        }
+        if (text) {
+            fputc(word, out);
+        } else {
+            fprintf(out, self->packed ? "%s0x%04x" : "%s%d",
+                k > start ? ", " : "", word);
+        }
+        quoted = text;
+    }
+    fprintf(out, quoted ? "\"\n" : "\n");
+}
+
+/* Prints the pool as assembly text.  Merged strings are labels inside the
+ * string that holds them. */
+void cc_pool_print(cc_pool * self, FILE * out) {
+    int i = 0;
+    int j = 0;
+    int k = 0;
+    for (i = 0; i < self->count; ++i) {
+        cc_literal * owner = self->literals[i];
+        int start = 0;
+        if (owner->owner != owner) {
+            continue;
+        }
+        for (k = 0; k < owner->nwords; ++k) {
+            for (j = 0; j < self->count; ++j) {
+                cc_literal * literal = self->literals[j];
+                if (literal->owner != owner || literal->offset != k) {
+                    continue;
+                }
+                if (k > start) {
+                    cc_pool_dat(self, owner, start, k, out);
+                    start = k;
+                }
+                fprintf(out, ":%s\n", literal->id->str);
+            }
+        }
+        cc_pool_dat(self, owner, start, owner->nwords, out);
+    }
+}
+
+/* Appends the pool to the image, and defines the address of every string.
+ * Tail merging shares words between literals, so the pool is one
+ * section. */
+void cc_pool_assemble(cc_pool * self, cc_asm * out) {
+    cc_literal * literal = 0;
+    int i = 0;
+    if (self->count) {
+        cc_asm_section(out, CC_OBJ_DATA);
+    }
+    for (i = 0; i < self->count; ++i) {
+        literal = self->literals[i];
+        if (literal->owner == literal) {
+            cc_asm_data(out, literal->id, literal->words, literal->nwords);
+        }
+    }
+    for (i = 0; i < self->count; ++i) {
+        literal = self->literals[i];
+        if (literal->owner != literal) {
+            cc_asm_define(out, literal->id,
+                cc_asm_lookup(out, literal->owner->id) + literal->offset);
+        }
+    }
+}
+
+/* Returns non-zero if 'call' is a call to packed_get(s, i) or
+ * packed_put(s, i, c), which read and write character i of string s */
+int cc_pool_builtin(cc_gen * self, cc_call * call) {
+    return cc_gen_calls(self, call, "packed_get", 2)
+        || cc_gen_calls(self, call, "packed_put", 3);
+}
+
+/* Generates an inline call to packed_get or packed_put.  If strings aren't
+ * packed, these are plain indexed loads and stores.  Otherwise character i
+ * is in word i/2, in the high byte if i is even.  packed_get returns the
+ * character, and packed_put returns 0. */
+cc_operand cc_pool_call(cc_gen * self, cc_call * call) {
+    cc_operand s = cc_gen_load(self, cc_gen_expr(self, call->args));
+    cc_operand i = cc_gen_expr(self, call->args->next);
+    cc_operand c = cc_opd_lit(0);
+    cc_operand at;
+    cc_operand r;
+    int get = !call->args->next->next;
+    int fixed = CC_VAL_LIT == i.mode && !i.sym && !i.label;
+    int odd = fixed && (i.value & 1);
+
+    if (!get) {
+        c = cc_gen_expr(self, call->args->next->next);
+    }
+    if (!self->pool->packed) {
+        at = fixed ? cc_opd_off(s.reg, i.value) : cc_opd_ind(s.reg);
+        if (!fixed) {
+            cc_gen_emit(self, CC_OP_ADD, s, i);
+            cc_gen_release(self, i);
+        }
+        if (get) {
+            return at;
+        }
+        cc_gen_emit(self, CC_OP_SET, at, c);
+        cc_gen_release(self, c);
+        cc_gen_release(self, s);
+        return cc_opd_lit(0);
+    }
+
+    /* Packed: find the word, then the byte within it */
+    r = cc_opd_reg(cc_gen_alloc(self));
+    if (fixed) {
+        at = cc_opd_off(s.reg, i.value / 2);
+    } else {
+        cc_gen_emit(self, CC_OP_SET, r, i);
+        cc_gen_emit(self, CC_OP_SHR, r, cc_opd_lit(1));
+        cc_gen_emit(self, CC_OP_ADD, s, r);
+        at = cc_opd_ind(s.reg);
+    }
+    if (get) {
+        cc_gen_emit(self, CC_OP_SET, r, at);
+        if (!fixed) {
+            cc_gen_emit(self, CC_OP_IFC, i, cc_opd_lit(1));
+        }
+        if (!fixed || !odd) {
+            cc_gen_emit(self, CC_OP_SHR, r, cc_opd_lit(8));
+        }
+        if (!fixed || odd) {
+            cc_gen_emit(self, CC_OP_AND, r, cc_opd_lit(0xff));
+        }
+        cc_gen_release(self, i);
+        cc_gen_release(self, s);
+        return r;
+    }
+    if (fixed && CC_VAL_LIT == c.mode && !c.sym && !c.label) {
+        c = cc_opd_lit((c.value & 0xff) << (odd ? 0 : 8));
+    } else {
+        c = cc_gen_load(self, c);
+        cc_gen_emit(self, CC_OP_AND, c, cc_opd_lit(0xff));
+        if (!fixed) {
+            cc_gen_emit(self, CC_OP_IFC, i, cc_opd_lit(1));
+        }
+        if (!fixed || !odd) {
+            cc_gen_emit(self, CC_OP_SHL, c, cc_opd_lit(8));
+        }
+    }
+    if (fixed) {
+        cc_gen_emit(self, CC_OP_AND, at, cc_opd_lit(odd ? 0xff00 : 0x00ff));
+    } else {
+        cc_gen_emit(self, CC_OP_SET, r, cc_opd_lit(0xff00));
+        cc_gen_emit(self, CC_OP_IFC, i, cc_opd_lit(1));
+        cc_gen_emit(self, CC_OP_SET, r, cc_opd_lit(0x00ff));
+        cc_gen_emit(self, CC_OP_AND, at, r);
+    }
+    cc_gen_emit(self, CC_OP_BOR, at, c);
+    cc_gen_release(self, r);
+    cc_gen_release(self, c);
+    cc_gen_release(self, i);
+    cc_gen_release(self, s);
+    return cc_opd_lit(0);
+}
+
+/* Function seen by cc_pool_check */
+typedef struct cc_packfunc {
+    cc_func * func;
+    cc_idset locals; /* Formals and variables declared in 'func' */
+    cc_idset packed; /* Those that may hold the address of a literal */
+    int returns; /* 'func' may return the address of a literal */
+} cc_packfunc;
+
+typedef struct cc_pack {
+    cc_gen * gen;
+    cc_packfunc * funcs; /* Functions with a body */
+    int nfuncs;
+    cc_packfunc * func; /* Function being scanned, or 0 for globals */
+    cc_idset globals; /* Globals that may hold the address of a literal */
+    int changed; /* A set grew during this pass */
+    int warn; /* Last pass: report the misuses */
+} cc_pack;
+
+static cc_packfunc * cc_pack_func(cc_pack * self, cc_id * id) {
+    int i = 0;
+    for (i = 0; i < self->nfuncs; ++i) {
+        if (self->funcs[i].func->id == id) {
+            return self->funcs + i;
+        }
+    }
+    return 0;
+}
+
+/* Returns the set that would hold 'id' in the function being scanned */
+static cc_idset * cc_pack_set(cc_pack * self, cc_id * id) {
+    if (self->func && cc_idset_has(&self->func->locals, id)) {
+        return &self->func->packed;
+    }
+    return &self->globals;
+}
+
+static void cc_pack_taint(cc_pack * self, cc_id * id) {
+    cc_idset * set = cc_pack_set(self, id);
+    if (!cc_idset_has(set, id)) {
+        cc_idset_add(set, id);
+        self->changed = 1;
+    }
+}
+
+static void cc_pack_warn(cc_pack * self, int line, char const * msg) {
+    if (self->warn) {
+        fprintf(stderr, "%d: warning: %s\n", line, msg);
+    }
+}
+
+static int cc_pack_expr(cc_pack * self, cc_expr * expr);
+
+static int cc_pack_binary(cc_pack * self, cc_binary * expr) {
+    int right = cc_pack_expr(self, expr->right);
+    int left = 0;
+    if ('=' == expr->op && CC_REF == expr->left->node.type) {
+        if (right) {
+            cc_pack_taint(self, ((cc_ref *)expr->left)->id);
+        }
+        return right;
+    }
+    left = cc_pack_expr(self, expr->left);
+    if ('=' == expr->op && right) {
+        cc_pack_warn(self, expr->node.node.line,
+            "Packed string stored where it may be read as plain chars");
+    }
+    switch (expr->op) {
+    case '=':
+    case ',':
+        return right;
+    case '+':
+        return left || right;
+    case '-':
+        return left && !right;
+    default:
+        return 0;
+    }
+}
+
+/* The string arguments of packed_get and packed_put are fine.  A string
+ * passed to a function with a body here marks the formal; any other
+ * callee might read it as plain chars. */
+static int cc_pack_call(cc_pack * self, cc_call * call) {
+    cc_packfunc * callee = 0;
+    cc_formal * formal = 0;
+    cc_expr * arg = call->args;
+    if (cc_pool_builtin(self->gen, call)) {
+        for (; arg; arg = arg->next) {
+            cc_pack_expr(self, arg);
+        }
+        return 0;
+    }
+    if (cc_frame_direct(self->gen, call->expr)) {
+        callee = cc_pack_func(self, ((cc_ref *)call->expr)->id);
+    } else {
+        cc_pack_expr(self, call->expr);
+    }
+    formal = callee ? callee->func->formals : 0;
+    for (; arg; arg = arg->next) {
+        int packed = cc_pack_expr(self, arg);
+        if (packed && formal && !cc_idset_has(&callee->packed, formal->id)) {
+            cc_idset_add(&callee->packed, formal->id);
+            self->changed = 1;
+        } else if (packed && !formal) {
+            cc_pack_warn(self, call->node.node.line, "Packed string "
+                "passed to a function that may read it as plain chars");
+        }
+        formal = formal ? formal->next : 0;
+    }
+    return callee && callee->returns;
+}
+
+/* Returns non-zero if 'expr' may yield the address of a literal, and
+ * follows the addresses in its operands */
+static int cc_pack_expr(cc_pack * self, cc_expr * expr) {
+    cc_unary * unary = 0;
+    if (!expr) {
+        return 0;
+    }
+    switch (expr->node.type) {
+    case CC_STRING:
+        return 1;
+    case CC_REF:
+        return cc_idset_has(cc_pack_set(self, ((cc_ref *)expr)->id),
+            ((cc_ref *)expr)->id);
+    case CC_MEMBER:
+        cc_pack_expr(self, ((cc_member *)expr)->expr);
+        return 0;
+    case CC_UNARY:
+        unary = (cc_unary *)expr;
+        if (cc_pack_expr(self, unary->expr) && '*' == unary->op) {
+            cc_pack_warn(self, expr->node.line, "Packed string accessed "
+                "as plain chars (use packed_get or packed_put)");
+        }
+        return 0;
+    case CC_BINARY:
+        return cc_pack_binary(self, (cc_binary *)expr);
+    case CC_CALL:
+        return cc_pack_call(self, (cc_call *)expr);
+    default:
+        return 0;
+    }
+}
+
+static void cc_pack_block(cc_pack * self, cc_block * block);
+
+static void cc_pack_stmt(cc_pack * self, cc_stmt * stmt) {
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        cc_pack_block(self, (cc_block *)stmt);
+        break;
+    case CC_IF:
+        cc_pack_expr(self, ((cc_if *)stmt)->guard);
+        cc_pack_stmt(self, ((cc_if *)stmt)->yes);
+        cc_pack_stmt(self, ((cc_if *)stmt)->no);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_pack_expr(self, ((cc_loop *)stmt)->init);
+        cc_pack_expr(self, ((cc_loop *)stmt)->guard);
+        cc_pack_expr(self, ((cc_loop *)stmt)->update);
+        cc_pack_stmt(self, (cc_stmt *)((cc_loop *)stmt)->block);
+        break;
+    case CC_SIMPLE:
+        cc_pack_expr(self, ((cc_simple *)stmt)->expr);
+        break;
+    case CC_RETURN:
+        if (cc_pack_expr(self, ((cc_return *)stmt)->expr)
+            && !self->func->returns) {
+            self->func->returns = 1;
+            self->changed = 1;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_pack_block(cc_pack * self, cc_block * block) {
+    cc_var * var = 0;
+    cc_stmt * stmt = 0;
+    for (var = block->vars; var; var = var->next) {
+        if (cc_pack_expr(self, var->init)) {
+            cc_pack_taint(self, var->id);
+        }
+    }
+    for (stmt = block->stmts; stmt; stmt = stmt->next) {
+        cc_pack_stmt(self, stmt);
+    }
+}
+
+/* Adds the variables declared in 'stmt' to 'locals' */
+static void cc_pack_decls(cc_idset * locals, cc_stmt * stmt) {
+    cc_var * var = 0;
+    if (!stmt) {
+        return;
+    }
+    switch (stmt->node.type) {
+    case CC_BLOCK:
+        for (var = ((cc_block *)stmt)->vars; var; var = var->next) {
+            cc_idset_add(locals, var->id);
+        }
+        for (stmt = ((cc_block *)stmt)->stmts; stmt; stmt = stmt->next) {
+            cc_pack_decls(locals, stmt);
+        }
+        break;
+    case CC_IF:
+        cc_pack_decls(locals, ((cc_if *)stmt)->yes);
+        cc_pack_decls(locals, ((cc_if *)stmt)->no);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        cc_pack_decls(locals, (cc_stmt *)((cc_loop *)stmt)->block);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Warns where a packed string may be read or written as plain chars,
+ * which would see two characters in one word.  The variables, formals and
+ * results that may hold the address of a literal are followed through
+ * assignments, pointer arithmetic, calls and returns until none are
+ * added; then a last pass reports dereferences of them, stores of them
+ * into memory, and calls that pass them where they can't be followed. */
+void cc_pool_check(cc_gen * gen) {
+    cc_pack self;
+    cc_func * func = 0;
+    cc_formal * formal = 0;
+    cc_var * var = 0;
+    int i = 0;
+
+    memset(&self, 0, sizeof(self));
+    self.gen = gen;
+    for (func = gen->env->funcs; func; func = func->next) {
+        i += 0 != func->block;
+    }
+    /* The list is newest first; warn in source order */
+    self.funcs = calloc(i + 1, sizeof(cc_packfunc));
+    self.nfuncs = i;
+    for (func = gen->env->funcs; func; func = func->next) {
+        cc_packfunc * entry = 0;
+        if (!func->block) {
+            continue;
+        }
+        entry = self.funcs + --i;
+        entry->func = func;
+        for (formal = func->formals; formal; formal = formal->next) {
+            cc_idset_add(&entry->locals, formal->id);
+        }
+        cc_pack_decls(&entry->locals, (cc_stmt *)func->block);
+    }
+    for (;;) {
+        self.changed = 0;
+        self.func = 0;
+        for (var = gen->env->vars; var; var = var->next) {
+            if (cc_pack_expr(&self, var->init)) {
+                cc_pack_taint(&self, var->id);
+            }
+        }
+        for (i = 0; i < self.nfuncs; ++i) {
+            self.func = self.funcs + i;
+            cc_pack_block(&self, self.func->func->block);
+        }
+        if (self.warn) {
+            break;
+        }
+        self.warn = !self.changed;
+    }
+    for (i = 0; i < self.nfuncs; ++i) {
+        free(self.funcs[i].locals.ids);
+        free(self.funcs[i].packed.ids);
+    }
+    free(self.funcs);
+    free(self.globals.ids);
+}
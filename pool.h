@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_POOL_H
+#define CC_POOL_H
+
+#include "gen.h"
+
+/* String literal in the pool.  'words' holds the decoded characters and the
+ * terminating zero, two characters to a word if the pool is packed.  A
+ * string that is the tail of another is stored inside it, 'offset' words
+ * past the start of 'owner'; otherwise 'owner' is the string itself. */
+typedef struct cc_literal {
+    cc_id * id;
+    unsigned short * chars;
+    int nchars; /* Including the terminating zero */
+    unsigned short * words;
+    int nwords;
+    int refs; /* Number of occurrences in the program */
+    struct cc_literal * owner;
+    int offset;
+} cc_literal;
+
+/* Pool of string literals.  Identical strings share one copy, and strings
+ * that are the tail of another share its storage.  If 'packed' is set, two
+ * 8-bit characters are stored per word, the first in the high byte; such
+ * strings are read and written with packed_get and packed_put. */
+typedef struct cc_pool {
+    cc_env * env;
+    cc_literal ** literals; /* In order of first occurrence */
+    int count;
+    int capacity;
+    int packed;
+    int words; /* Words taken by the pool in the image */
+    int saved; /* Words saved over one unpacked copy per occurrence */
+} cc_pool;
+
+cc_pool * cc_pool_init(cc_env * env);
+cc_operand cc_pool_add(cc_pool * self, char const * raw);
+cc_id ** cc_pool_merge(cc_pool * self, cc_pool * other);
+void cc_pool_free(cc_pool * self);
+void cc_pool_layout(cc_pool * self);
+void cc_pool_print(cc_pool * self, FILE * out);
+void cc_pool_assemble(cc_pool * self, cc_asm * out);
+int cc_pool_builtin(cc_gen * self, cc_call * call);
+void cc_pool_check(cc_gen * gen);
+cc_operand cc_pool_call(cc_gen * self, cc_call * call);
+
+#endif
@@ -0,0 +1,430 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "prof.h"
+#include <stdlib.h>
+#include <string.h>
+
+cc_prof * cc_prof_init() {
+    cc_prof * self = calloc(1, sizeof(cc_prof));
+    self->funcs = calloc(1, sizeof(cc_proffunc));
+    self->funcs[0].name = "?";
+    self->nfuncs = 1;
+    self->capnodes = 64;
+    self->nodes = calloc(self->capnodes, sizeof(cc_profnode));
+    self->nodes[0].func = -1;
+    self->nodes[0].sp = CC_DCPU_WORDS;
+    self->nnodes = 1;
+    return self;
+}
+
+/* Reads the line table written by dcpu16cc -g.  Returns zero if it can't
+ * be read. */
+int cc_prof_load(cc_prof * self, char const * path) {
+    FILE * in = fopen(path, "r");
+    char text[512];
+    char name[256];
+    int version = 0;
+    int caplines = 0;
+    int capfuncs = 1;
+    int a = 0;
+    int b = 0;
+    int i = 0;
+
+    if (!in) {
+        return 0;
+    }
+    if (!fgets(text, sizeof(text), in)
+        || 2 != sscanf(text, "dcpu16-lines %d %255s", &version, name)
+        || 1 != version) {
+        fclose(in);
+        return 0;
+    }
+    self->source = malloc(strlen(name) + 1);
+    strcpy(self->source, name);
+    while (fgets(text, sizeof(text), in)) {
+        if (3 == sscanf(text, "F %d %d %255s", &a, &b, name)) {
+            cc_proffunc * func = 0;
+            if (self->nfuncs >= capfuncs) {
+                capfuncs *= 2;
+                self->funcs = realloc(self->funcs,
+                    capfuncs * sizeof(cc_proffunc));
+            }
+            func = self->funcs + self->nfuncs;
+            memset(func, 0, sizeof(cc_proffunc));
+            func->name = malloc(strlen(name) + 1);
+            strcpy(func->name, name);
+            func->start = a;
+            func->end = b;
+            for (i = a; i < b && i < CC_DCPU_WORDS; ++i) {
+                self->owner[i] = (unsigned short)self->nfuncs;
+            }
+            self->nfuncs++;
+        } else if (2 == sscanf(text, "L %d %d", &a, &b)) {
+            if (self->nlines >= caplines) {
+                caplines = caplines ? caplines * 2 : 256;
+                self->lines = realloc(self->lines,
+                    caplines * sizeof(cc_profline));
+            }
+            self->lines[self->nlines].addr = a;
+            self->lines[self->nlines].line = b;
+            self->nlines++;
+        }
+    }
+    fclose(in);
+    return 1;
+}
+
+/* Returns the child of 'parent' for function 'func', adding it if this
+ * call stack hasn't been seen yet */
+static int cc_prof_child(cc_prof * self, int parent, int func) {
+    cc_profnode * node = 0;
+    int i = 0;
+    for (i = self->nodes[parent].child; i; i = self->nodes[i].sibling) {
+        if (self->nodes[i].func == func) {
+            return i;
+        }
+    }
+    if (self->nnodes >= self->capnodes) {
+        self->capnodes *= 2;
+        self->nodes = realloc(self->nodes,
+            self->capnodes * sizeof(cc_profnode));
+    }
+    i = self->nnodes++;
+    node = self->nodes + i;
+    memset(node, 0, sizeof(cc_profnode));
+    node->func = func;
+    node->parent = parent;
+    node->sp = self->nodes[parent].sp;
+    node->sibling = self->nodes[parent].child;
+    self->nodes[parent].child = i;
+    return i;
+}
+
+/* Charges the cycles since the last transfer to the current node */
+static void cc_prof_charge(cc_prof * self, unsigned long cycles) {
+    self->nodes[self->node].self += cycles - self->mark;
+    self->mark = cycles;
+}
+
+/* Called when the emulator starts running at 'pc' */
+void cc_prof_start(cc_prof * self, unsigned pc, unsigned long cycles) {
+
+    if (!self->node) {
+        self->node = cc_prof_child(self, 0, self->owner[pc]);
+        self->nodes[self->node].calls++;
+    }
+    self->mark = cycles;
+    self->entries[pc]++;
+}
+
+/* Called when the emulator stops; the instruction at the PC hasn't run */
+void cc_prof_stop(cc_prof * self, unsigned long cycles) {
+    cc_prof_charge(self, cycles);
+}
+
+/* Returns the stack pointer as a depth that decreases as the stack grows;
+ * the empty stack has SP 0, above every other value */
+static int cc_prof_top(unsigned sp) {
+    return sp ? (int)sp : CC_DCPU_WORDS;
+}
+
+/* Called after a call to 'to' that left the return address at 'sp' */
+void cc_prof_call(cc_prof * self, unsigned to, unsigned sp,
+    unsigned long cycles) {
+
+    cc_prof_charge(self, cycles);
+    self->node = cc_prof_child(self, self->node, self->owner[to]);
+    self->nodes[self->node].sp = cc_prof_top(sp);
+    self->nodes[self->node].calls++;
+}
+
+/* Called after a return to 'to' that left the stack pointer at 'sp' */
+void cc_prof_return(cc_prof * self, unsigned to, unsigned sp,
+    unsigned long cycles) {
+
+    cc_prof_charge(self, cycles);
+    while (self->node && self->nodes[self->node].sp < cc_prof_top(sp)) {
+        self->node = self->nodes[self->node].parent;
+    }
+    if (!self->node || self->nodes[self->node].func != self->owner[to]) {
+        cc_prof_jump(self, to, cycles);
+    }
+}
+
+/* Called after a jump into another function, which replaces the current
+ * one on the stack, like a tail call */
+void cc_prof_jump(cc_prof * self, unsigned to, unsigned long cycles) {
+    int sp = self->nodes[self->node].sp;
+    cc_prof_charge(self, cycles);
+    self->node = cc_prof_child(self, self->nodes[self->node].parent,
+        self->owner[to]);
+    self->nodes[self->node].sp = sp;
+    self->nodes[self->node].calls++;
+}
+
+/* Returns the number of next words used by an operand */
+static int cc_prof_next(int value) {
+    return (value >= CC_VAL_OFF && value < CC_VAL_PUSHPOP)
+        || CC_VAL_PICK == value || CC_VAL_MEM == value
+        || CC_VAL_LIT == value;
+}
+
+/* Returns the length of the instruction at 'addr', and its cycles when it
+ * runs in '*cycles' */
+static int cc_prof_decode(unsigned short * mem, unsigned addr, int * cycles) {
+    int word = mem[addr & 0xffff];
+    int op = word & 0x1f;
+    int b = (word >> 5) & 0x1f;
+    int words = 1 + cc_prof_next(word >> 10);
+    if (op) {
+        words += cc_prof_next(b);
+    } else {
+        op = CC_OP_SPECIAL + b;
+    }
+    *cycles = cc_op_name(op) ? cc_op_cycles(op) + words - 1 : 0;
+    return words;
+}
+
+/* Returns the source line of the code at 'addr', or 0 */
+static int cc_prof_line(cc_prof * self, int addr) {
+    int lo = 0;
+    int hi = self->nlines;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (self->lines[mid].addr <= addr) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo ? self->lines[lo - 1].line : 0;
+}
+
+/* Sums the cycles of each node and function */
+static void cc_prof_sum(cc_prof * self) {
+    int i = 0;
+    int k = 0;
+    for (i = 0; i < self->nfuncs; ++i) {
+        self->funcs[i].self = 0;
+        self->funcs[i].total = 0;
+        self->funcs[i].calls = 0;
+    }
+    for (i = 0; i < self->nnodes; ++i) {
+        self->nodes[i].total = self->nodes[i].self;
+    }
+    for (i = self->nnodes - 1; i > 0; --i) {
+        self->nodes[self->nodes[i].parent].total += self->nodes[i].total;
+    }
+    for (i = 1; i < self->nnodes; ++i) {
+        cc_profnode * node = self->nodes + i;
+        cc_proffunc * func = self->funcs + node->func;
+        func->self += node->self;
+        func->calls += node->calls;
+        /* A recursive call is already part of the outer call's total */
+        for (k = node->parent; k; k = self->nodes[k].parent) {
+            if (self->nodes[k].func == node->func) {
+                break;
+            }
+        }
+        if (!k) {
+            func->total += node->total;
+        }
+    }
+}
+
+/* Returns the cycles spent on each source line, found by counting how many
+ * times each instruction ran.  An instruction runs as many times as the
+ * one before it, less the times control left that one, plus the times
+ * control arrived at it from elsewhere. */
+static unsigned long * cc_prof_bylines(cc_prof * self, cc_emu * emu,
+    int * count) {
+
+    unsigned long * cycles = 0;
+    int max = 0;
+    int i = 0;
+    for (i = 0; i < self->nlines; ++i) {
+        if (self->lines[i].line > max) {
+            max = self->lines[i].line;
+        }
+    }
+    *count = max + 1;
+    cycles = calloc(max + 1, sizeof(unsigned long));
+    for (i = 1; i < self->nfuncs; ++i) {
+        cc_proffunc * func = self->funcs + i;
+        long execs = 0;
+        int addr = func->start;
+        int prev = -1;
+        while (addr < func->end && addr < CC_DCPU_WORDS) {
+            int cost = 0;
+            int len = cc_prof_decode(emu->mem, addr, &cost);
+            execs += self->entries[addr] - (prev < 0 ? 0 : self->exits[prev]);
+            cycles[cc_prof_line(self, addr)] += execs * cost
+                + self->extra[addr];
+            prev = addr;
+            addr += len;
+        }
+    }
+    return cycles;
+}
+
+/* Prints the cycles of each function, then of each source line next to
+ * its text */
+void cc_prof_flat(cc_prof * self, cc_emu * emu, FILE * out) {
+    FILE * in = 0;
+    char text[256];
+    unsigned long * lines = 0;
+    double total = 0;
+    int nlines = 0;
+    int number = 1;
+    int fresh = 1; /* At the start of a source line */
+    int i = 0;
+
+    cc_prof_sum(self);
+    total = self->nodes[0].total ? (double)self->nodes[0].total : 1;
+    fprintf(out, "; Flat profile: %lu cycles\n", self->nodes[0].total);
+    fprintf(out, "; %7s %12s %12s %10s  %s\n", "self %", "self", "total",
+        "calls", "function");
+    for (i = 0; i < self->nfuncs; ++i) {
+        cc_proffunc * func = self->funcs + i;
+        if (!func->calls && !func->self) {
+            continue;
+        }
+        fprintf(out, "; %7.2f %12lu %12lu %10lu  %s\n",
+            100 * func->self / total, func->self, func->total, func->calls,
+            func->name);
+    }
+
+    lines = cc_prof_bylines(self, emu, &nlines);
+    fprintf(out, "\n; Cycles per source line\n");
+    fprintf(out, ";       cycles  self %% | %s\n", self->source);
+    in = fopen(self->source, "r");
+    while (in && fgets(text, sizeof(text), in)) {
+        if (fresh && number < nlines && lines[number]) {
+            fprintf(out, "%14lu %7.2f | %s", lines[number],
+                100 * lines[number] / total, text);
+        } else if (fresh) {
+            fprintf(out, "%22s | %s", "", text);
+        } else {
+            fputs(text, out);
+        }
+        fresh = !!strchr(text, '\n');
+        number += fresh;
+    }
+    if (!fresh) {
+        fputc('\n', out);
+    }
+    if (lines[0]) {
+        fprintf(out, "%14lu %7.2f | (startup code)\n", lines[0],
+            100 * lines[0] / total);
+    }
+    if (in) {
+        fclose(in);
+    } else {
+        for (i = 1; i < nlines; ++i) {
+            if (lines[i]) {
+                fprintf(out, "%14lu %7.2f | line %d\n", lines[i],
+                    100 * lines[i] / total, i);
+            }
+        }
+    }
+    free(lines);
+}
+
+/* Prints one line per call stack with the cycles spent in its innermost
+ * function, in the collapsed format that flame graph tools read */
+void cc_prof_folded(cc_prof * self, FILE * out) {
+    int * path = calloc(self->nnodes, sizeof(int));
+    int i = 0;
+    int k = 0;
+    for (i = 1; i < self->nnodes; ++i) {
+        int depth = 0;
+        if (!self->nodes[i].self) {
+            continue;
+        }
+        for (k = i; k; k = self->nodes[k].parent) {
+            path[depth++] = k;
+        }
+        while (depth--) {
+            cc_profnode * node = self->nodes + path[depth];
+            fprintf(out, "%s%s", self->funcs[node->func].name,
+                depth ? ";" : "");
+        }
+        fprintf(out, " %lu\n", self->nodes[i].self);
+    }
+    free(path);
+}
+
+void cc_prof_free(cc_prof * self) {
+    int i = 0;
+    for (i = 1; i < self->nfuncs; ++i) {
+        free(self->funcs[i].name);
+    }
+    free(self->funcs);
+    free(self->lines);
+    free(self->nodes);
+    free(self->source);
+    free(self);
+}
+
+/* Writes the profile counters of an image built with -fprofile-generate,
+ * located with the map that dcpu16cc wrote next to it (see pgo.h), in the
+ * format that -fprofile-use reads:
+ *
+ *   dcpu16-profdata 1
+ *   F <name> <hash> <counters> <count>...
+ *
+ * Returns zero if the map can't be read. */
+int cc_prof_counters(cc_emu * emu, char const * map, FILE * out) {
+    FILE * in = fopen(map, "r");
+    char name[256];
+    char hash[32];
+    int version = 0;
+    int base = 0;
+    int first = 0;
+    int count = 0;
+    int i = 0;
+
+    if (!in) {
+        return 0;
+    }
+    if (2 != fscanf(in, " dcpu16-profmap %d %d", &version, &base)
+        || 1 != version) {
+        fclose(in);
+        return 0;
+    }
+    fprintf(out, "dcpu16-profdata 1\n");
+    while (4 == fscanf(in, " F %255s %31s %d %d", name, hash, &first,
+        &count)) {
+        fprintf(out, "F %s %s %d", name, hash, count);
+        for (i = first; i < first + count; ++i) {
+            unsigned addr = (unsigned)(base + 2 * i);
+            unsigned long value = emu->mem[addr & 0xffff]
+                | (unsigned long)emu->mem[(addr + 1) & 0xffff] << 16;
+            fprintf(out, " %lu", value);
+        }
+        fprintf(out, "\n");
+    }
+    fclose(in);
+    return 1;
+}
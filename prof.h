@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_PROF_H
+#define CC_PROF_H
+
+#include "emu.h"
+#include <stdio.h>
+
+/* Function of the profiled image, from the line table */
+typedef struct cc_proffunc {
+    char * name;
+    int start;
+    int end;
+    unsigned long self; /* Cycles, excluding callees */
+    unsigned long total; /* Cycles, including callees */
+    unsigned long calls;
+} cc_proffunc;
+
+/* Node of the calling-context tree: one per distinct call stack.  'sp' is
+ * the stack pointer just after the call pushed its return address; the
+ * node is left when a return pops above it. */
+typedef struct cc_profnode {
+    int func;
+    int parent;
+    int child;
+    int sibling;
+    int sp;
+    unsigned long self;
+    unsigned long total;
+    unsigned long calls;
+} cc_profnode;
+
+/* Row of the line table */
+typedef struct cc_profline {
+    int addr;
+    int line;
+} cc_profline;
+
+/* Cycle profile of one emulator run.  The emulator only counts control
+ * transfers: for every taken jump, call, return or failed IF it bumps
+ * 'exits' at the source and 'entries' at the target, so the cost is per
+ * basic block rather than per instruction.  The number of times each
+ * instruction ran is recovered afterwards by walking the code in address
+ * order, and multiplied by its cycles to attribute every cycle to a
+ * source line.  Calls and returns, and jumps between functions, also move
+ * through the calling-context tree, which splits the cycles of each
+ * function into exclusive and inclusive. */
+typedef struct cc_prof {
+    char * source;
+    cc_proffunc * funcs; /* Function 0 is code outside any function */
+    int nfuncs;
+    cc_profline * lines;
+    int nlines;
+    unsigned short owner[CC_DCPU_WORDS]; /* Function of each address */
+    long entries[CC_DCPU_WORDS];
+    long exits[CC_DCPU_WORDS];
+    unsigned long extra[CC_DCPU_WORDS]; /* Cycles of skips after an IF */
+    cc_profnode * nodes; /* Node 0 is the root, above every function */
+    int nnodes;
+    int capnodes;
+    int node; /* Current node */
+    unsigned long mark; /* Cycles already attributed */
+} cc_prof;
+
+cc_prof * cc_prof_init();
+int cc_prof_load(cc_prof * self, char const * path);
+void cc_prof_start(cc_prof * self, unsigned pc, unsigned long cycles);
+void cc_prof_stop(cc_prof * self, unsigned long cycles);
+void cc_prof_call(cc_prof * self, unsigned to, unsigned sp,
+    unsigned long cycles);
+void cc_prof_return(cc_prof * self, unsigned to, unsigned sp,
+    unsigned long cycles);
+void cc_prof_jump(cc_prof * self, unsigned to, unsigned long cycles);
+void cc_prof_flat(cc_prof * self, cc_emu * emu, FILE * out);
+void cc_prof_folded(cc_prof * self, FILE * out);
+void cc_prof_free(cc_prof * self);
+int cc_prof_counters(cc_emu * emu, char const * map, FILE * out);
+
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#include "report.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+
+static char const * cc_phase_names[CC_PHASES] = {
+    "parse", "check", "opt", "gen", "emit"
+};
+
+static char const * cc_asttype_names[CC_ASTTYPES] = {
+    "func", "block", "member", "binary", "unary", "call", "if", "for",
+    "while", "simple", "ref", "number", "string", "return", "var", "struct"
+};
+
+cc_report * cc_report_init() {
+    cc_report * self = calloc(1, sizeof(cc_report));
+    self->phase = -1;
+    return self;
+}
+
+/* Returns the monotonic clock, in seconds */
+double cc_report_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Returns the bytes of heap in use, in every arena, or 0 if the C library
+ * can't tell */
+static long cc_report_heap() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    struct mallinfo2 info = mallinfo2();
+    return (long)(info.uordblks + info.hblkhd);
+#else
+    return 0;
+#endif
+}
+
+/* Ends the phase being timed, if any, and begins 'phase', or nothing if
+ * 'phase' is -1 */
+void cc_report_phase(cc_report * self, int phase) {
+    double now = cc_report_now();
+    long used = cc_report_heap();
+    if (self->phase >= 0) {
+        self->seconds[self->phase] += now - self->start;
+        self->bytes[self->phase] += used - self->used;
+    }
+    self->phase = phase;
+    self->start = now;
+    self->used = used;
+}
+
+static void cc_report_expr(cc_expr * self, long * counts);
+
+static void cc_report_var(cc_var * self, long * counts) {
+    for (; self; self = self->next) {
+        counts[CC_VAR]++;
+        cc_report_expr(self->init, counts);
+    }
+}
+
+static void cc_report_expr(cc_expr * self, long * counts) {
+    cc_expr * arg = 0;
+    if (!self) {
+        return;
+    }
+    counts[self->node.type]++;
+    switch (self->node.type) {
+    case CC_MEMBER:
+        cc_report_expr(((cc_member *)self)->expr, counts);
+        break;
+    case CC_BINARY:
+        cc_report_expr(((cc_binary *)self)->left, counts);
+        cc_report_expr(((cc_binary *)self)->right, counts);
+        break;
+    case CC_UNARY:
+        cc_report_expr(((cc_unary *)self)->expr, counts);
+        break;
+    case CC_CALL:
+        cc_report_expr(((cc_call *)self)->expr, counts);
+        for (arg = ((cc_call *)self)->args; arg; arg = arg->next) {
+            cc_report_expr(arg, counts);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void cc_report_stmt(cc_stmt * self, long * counts) {
+    cc_block * block = 0;
+    cc_loop * loop = 0;
+    cc_stmt * stmt = 0;
+    if (!self) {
+        return;
+    }
+    counts[self->node.type]++;
+    switch (self->node.type) {
+    case CC_BLOCK:
+        block = (cc_block *)self;
+        cc_report_var(block->vars, counts);
+        for (stmt = block->stmts; stmt; stmt = stmt->next) {
+            cc_report_stmt(stmt, counts);
+        }
+        break;
+    case CC_IF:
+        cc_report_expr(((cc_if *)self)->guard, counts);
+        cc_report_stmt(((cc_if *)self)->yes, counts);
+        cc_report_stmt(((cc_if *)self)->no, counts);
+        break;
+    case CC_FOR:
+    case CC_WHILE:
+        loop = (cc_loop *)self;
+        cc_report_expr(loop->init, counts);
+        cc_report_expr(loop->guard, counts);
+        cc_report_expr(loop->update, counts);
+        cc_report_stmt((cc_stmt *)loop->block, counts);
+        break;
+    case CC_SIMPLE:
+        cc_report_expr(((cc_simple *)self)->expr, counts);
+        break;
+    case CC_RETURN:
+        cc_report_expr(((cc_return *)self)->expr, counts);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Adds the nodes of each type in 'env' to the counts after the parse, or
+ * after optimization if 'optimized' is set */
+void cc_report_nodes(cc_report * self, cc_env * env, int optimized) {
+    long * counts = optimized ? self->optimized : self->parsed;
+    cc_struct * record = 0;
+    cc_func * func = 0;
+    for (record = env->structs; record; record = record->next) {
+        counts[CC_STRUCT]++;
+        cc_report_var(record->vars, counts);
+    }
+    cc_report_var(env->vars, counts);
+    for (func = env->funcs; func; func = func->next) {
+        counts[CC_FUNC]++;
+        cc_report_stmt((cc_stmt *)func->block, counts);
+    }
+}
+
+static double cc_report_percent(double part, double whole) {
+    return whole > 0 ? 100 * part / whole : 0;
+}
+
+static void cc_report_table(cc_report * self, FILE * out) {
+    double total = 0;
+    long bytes = 0;
+    int i = 0;
+
+    for (i = 0; i < CC_PHASES; ++i) {
+        total += self->seconds[i];
+        bytes += self->bytes[i];
+    }
+    if (self->time) {
+        fprintf(out, "time report (%d files)\n", self->units);
+        fprintf(out, "  %-8s %10s %6s\n", "phase", "ms", "%");
+        for (i = 0; i < CC_PHASES; ++i) {
+            fprintf(out, "  %-8s %10.3f %6.1f\n", cc_phase_names[i],
+                self->seconds[i] * 1e3,
+                cc_report_percent(self->seconds[i], total));
+            if (CC_PHASE_PARSE == i) {
+                fprintf(out, "    %-6s %10.3f %6.1f\n", "lex",
+                    self->lex * 1e3, cc_report_percent(self->lex, total));
+            }
+        }
+        fprintf(out, "  %-8s %10.3f\n", "total", total * 1e3);
+        fprintf(out, "  %ld tokens, %ld lines, %.0f tokens/s lexed\n",
+            self->tokens, self->lines,
+            self->lex > 0 ? self->tokens / self->lex : 0);
+    }
+    if (self->mem) {
+        fprintf(out, "memory report (%d files)\n", self->units);
+        fprintf(out, "  %-8s %12s %6s\n", "phase", "bytes", "%");
+        for (i = 0; i < CC_PHASES; ++i) {
+            fprintf(out, "  %-8s %12ld %6.1f\n", cc_phase_names[i],
+                self->bytes[i], cc_report_percent(self->bytes[i], bytes));
+        }
+        fprintf(out, "  %-8s %12ld\n", "total", bytes);
+        fprintf(out, "  %ld identifier lookups, %ld hits (%.1f%%), "
+            "%ld interned\n", self->lookups, self->hits,
+            cc_report_percent(self->hits, self->lookups),
+            self->lookups - self->hits);
+        fprintf(out, "  %-8s %10s %10s\n", "node", "parsed", "optimized");
+        for (i = 0; i < CC_ASTTYPES; ++i) {
+            fprintf(out, "  %-8s %10ld %10ld\n", cc_asttype_names[i],
+                self->parsed[i], self->optimized[i]);
+        }
+    }
+}
+
+static void cc_report_json(cc_report * self, FILE * out) {
+    int i = 0;
+
+    fprintf(out, "{\n  \"files\": %d", self->units);
+    if (self->time) {
+        fprintf(out, ",\n  \"time\": {\"phases\": {");
+        for (i = 0; i < CC_PHASES; ++i) {
+            fprintf(out, "%s\"%s\": %.6f", i ? ", " : "", cc_phase_names[i],
+                self->seconds[i]);
+        }
+        fprintf(out, "},\n    \"lex\": %.6f, \"tokens\": %ld, "
+            "\"lines\": %ld}", self->lex, self->tokens, self->lines);
+    }
+    if (self->mem) {
+        fprintf(out, ",\n  \"memory\": {\"phases\": {");
+        for (i = 0; i < CC_PHASES; ++i) {
+            fprintf(out, "%s\"%s\": %ld", i ? ", " : "", cc_phase_names[i],
+                self->bytes[i]);
+        }
+        fprintf(out, "},\n    \"lookups\": %ld, \"hits\": %ld,\n"
+            "    \"nodes\": {", self->lookups, self->hits);
+        for (i = 0; i < CC_ASTTYPES; ++i) {
+            fprintf(out, "%s\n      \"%s\": {\"parsed\": %ld, "
+                "\"optimized\": %ld}", i ? "," : "", cc_asttype_names[i],
+                self->parsed[i], self->optimized[i]);
+        }
+        fprintf(out, "\n    }}");
+    }
+    fprintf(out, "\n}\n");
+}
+
+/* Prints the report as tables, or as JSON if 'json' is set.  Times are in
+ * seconds in the JSON, and in milliseconds in the tables. */
+void cc_report_print(cc_report * self, FILE * out) {
+    if (self->json) {
+        cc_report_json(self, out);
+    } else {
+        cc_report_table(self, out);
+    }
+}
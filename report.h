@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+
+#ifndef CC_REPORT_H
+#define CC_REPORT_H
+
+#include "env.h"
+#include <stdio.h>
+
+/* Phases of a compilation, in order.  Lexing happens during the parse, and
+ * is timed on its own as well. */
+typedef enum cc_phase {
+    CC_PHASE_PARSE,
+    CC_PHASE_CHECK,
+    CC_PHASE_OPT,
+    CC_PHASE_GEN,
+    CC_PHASE_EMIT, /* Assembly, objects, images and listings */
+    CC_PHASES
+} cc_phase;
+
+#define CC_ASTTYPES (CC_STRUCT + 1)
+
+/* Where the time and memory of a compilation go, for -ftime-report and
+ * -fmem-report.  The report is only allocated when one of them is given;
+ * otherwise 'env->report' is 0 and the hooks in the lexer and in
+ * cc_env_id cost one test each.  Phase times come from the monotonic clock.
+ * The bytes of a phase are the growth of the heap in use over it, which
+ * includes the other threads with -j.  A batch of files adds up into one
+ * report. */
+typedef struct cc_report {
+    int time; /* -ftime-report */
+    int mem; /* -fmem-report */
+    int json; /* Print JSON instead of tables */
+    int units; /* Files compiled */
+    int phase; /* Phase being timed, or -1 */
+    double start; /* Time at which 'phase' began */
+    long used; /* Heap in use when 'phase' began */
+    double seconds[CC_PHASES];
+    long bytes[CC_PHASES];
+    double lex; /* Time in cc_lexer_next, which is part of the parse */
+    long tokens;
+    long lines;
+    long parsed[CC_ASTTYPES]; /* Nodes of each type after the parse */
+    long optimized[CC_ASTTYPES]; /* Nodes of each type after cc_opt_env */
+    long lookups; /* Calls to cc_env_id */
+    long hits; /* Calls that found the identifier already interned */
+} cc_report;
+
+cc_report * cc_report_init();
+double cc_report_now();
+void cc_report_phase(cc_report * self, int phase);
+void cc_report_nodes(cc_report * self, cc_env * env, int optimized);
+void cc_report_print(cc_report * self, FILE * out);
+
+#endif
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "emu.h"
+#include "farm.h"
+#include "prof.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+void usage() {
+    printf("Usage: dcpu16run [-v] [-n steps] [-j threads] [-c copies] "
+        "[-s slice] [-p] [-F folded] [-l lines] [-P profdata] file...\n");
+}
+
+/* Options of a profiled run */
+typedef struct profopts {
+    int flat; /* Print the flat profile */
+    char const * folded; /* File for the collapsed stacks, or 0 */
+    char const * lines; /* Line table, or 0 for the image's */
+    char const * counters; /* File for the counters (-P), or 0 */
+} profopts;
+
+/* Runs a single image, profiling it if asked to */
+static int run(char const * file, unsigned long limit, int verbose,
+    profopts * opts) {
+
+    cc_emu * emu = cc_emu_init();
+    clock_t start = 0;
+    double seconds = 0;
+
+    if (!cc_emu_load(emu, file)) {
+        fprintf(stderr, "Could not open %s\n", file);
+        return 1;
+    }
+    if (opts->flat || opts->folded) {
+        char * name = malloc(strlen(file) + 7);
+        sprintf(name, "%s.lines", file);
+        emu->prof = cc_prof_init();
+        if (!cc_prof_load(emu->prof, opts->lines ? opts->lines : name)) {
+            fprintf(stderr, "Could not read line table %s\n",
+                opts->lines ? opts->lines : name);
+            return 1;
+        }
+        free(name);
+    }
+    start = clock();
+    cc_emu_run(emu, limit);
+    seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    cc_emu_print(emu, stdout);
+    if (opts->flat) {
+        printf("\n");
+        cc_prof_flat(emu->prof, emu, stdout);
+    }
+    if (opts->folded) {
+        FILE * out = fopen(opts->folded, "w");
+        if (!out) {
+            fprintf(stderr, "Could not open %s\n", opts->folded);
+            return 1;
+        }
+        cc_prof_folded(emu->prof, out);
+        fclose(out);
+    }
+    if (opts->counters) {
+        /* The counters of an image built with -fprofile-generate */
+        char * map = malloc(strlen(file) + 9);
+        FILE * out = fopen(opts->counters, "w");
+        sprintf(map, "%s.profmap", file);
+        if (!out) {
+            fprintf(stderr, "Could not open %s\n", opts->counters);
+            return 1;
+        }
+        if (!cc_prof_counters(emu, map, out)) {
+            fprintf(stderr, "Could not read counter map %s\n", map);
+            fclose(out);
+            return 1;
+        }
+        fclose(out);
+        free(map);
+    }
+    if (verbose) {
+        fprintf(stderr, "run: %.3f s, %.1f M instructions/s\n", seconds,
+            seconds > 0 ? emu->steps / seconds / 1e6 : 0);
+    }
+    if (!emu->halted) {
+        fprintf(stderr, "Stopped after %lu instructions\n", emu->steps);
+        return 2;
+    }
+    return emu->fault ? 3 : 0;
+}
+
+int main(int argc, char ** argv) {
+    char const ** files = calloc(argc, sizeof(char const *));
+    int nfiles = 0;
+    unsigned long limit = (unsigned long)-1;
+    unsigned long slice = CC_FARM_SLICE;
+    int threads = 0;
+    int copies = 1;
+    int verbose = 0;
+    int status = 0;
+    profopts opts;
+    int i = 0;
+    int k = 0;
+    cc_farm * farm = 0;
+
+    memset(&opts, 0, sizeof(opts));
+    for (i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-v")) {
+            verbose = 1;
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            limit = strtoul(argv[++i], 0, 10);
+        } else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-c") && i + 1 < argc) {
+            copies = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            slice = strtoul(argv[++i], 0, 10);
+        } else if (!strcmp(argv[i], "-p")) {
+            opts.flat = 1;
+        } else if (!strcmp(argv[i], "-F") && i + 1 < argc) {
+            opts.folded = argv[++i];
+        } else if (!strcmp(argv[i], "-l") && i + 1 < argc) {
+            opts.lines = argv[++i];
+        } else if (!strcmp(argv[i], "-P") && i + 1 < argc) {
+            opts.counters = argv[++i];
+        } else {
+            files[nfiles++] = argv[i];
+        }
+    }
+    if (!nfiles || copies < 1 || !slice) {
+        usage();
+        return 1;
+    }
+    if (1 == nfiles && 1 == copies && !threads) {
+        return run(files[0], limit, verbose, &opts);
+    }
+    if (opts.flat || opts.folded || opts.counters) {
+        fprintf(stderr, "Profiling needs a single run of one image\n");
+        return 1;
+    }
+
+    /* Farm: one instance per copy of each image, on one thread per core
+     * unless told otherwise */
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    farm = cc_farm_init(threads);
+    farm->limit = limit;
+    farm->slice = slice;
+    for (i = 0; i < nfiles; ++i) {
+        for (k = 0; k < copies; ++k) {
+            cc_emu * emu = cc_emu_init();
+            if (!cc_emu_load(emu, files[i])) {
+                fprintf(stderr, "Could not open %s\n", files[i]);
+                return 1;
+            }
+            cc_farm_add(farm, emu);
+        }
+    }
+    cc_farm_run(farm);
+
+    for (i = 0; i < farm->count; ++i) {
+        cc_emu * emu = farm->emus[i];
+        printf("%s#%d cycles %lu steps %lu A %u%s\n", files[i / copies],
+            i % copies, emu->cycles, emu->steps, emu->regs[CC_REG_A],
+            emu->fault ? " fault" : emu->halted ? "" : " stopped");
+        if (!emu->halted) {
+            status = 2;
+        } else if (emu->fault && !status) {
+            status = 3;
+        }
+    }
+    if (verbose) {
+        unsigned long cycles = 0;
+        unsigned long slices = 0;
+        unsigned long steals = 0;
+        unsigned long steps = cc_farm_steps(farm);
+        for (i = 0; i < farm->count; ++i) {
+            cycles += farm->emus[i]->cycles;
+        }
+        for (i = 0; i < farm->threads; ++i) {
+            slices += farm->workers[i]->slices;
+            steals += farm->workers[i]->steals;
+        }
+        fprintf(stderr, "farm: %d instances, %d threads, %lu slices, "
+            "%lu steals\n", farm->count, farm->threads, slices, steals);
+        fprintf(stderr, "farm: %lu instructions, %lu cycles, %.3f s, "
+            "%.1f M instructions/s\n", steps, cycles, farm->seconds,
+            farm->seconds > 0 ? steps / farm->seconds / 1e6 : 0);
+    }
+    cc_farm_free(farm);
+    return status;
+}
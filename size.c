@@ -0,0 +1,682 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#include "size.h"
+#include "frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Candidate sequence for outlining: 'count' instructions at 'start' */
+typedef struct cc_window {
+    unsigned long hash;
+    int code;
+    int start;
+} cc_window;
+
+/* Returns non-zero if instruction 'i' only runs when the IF before it
+ * passes */
+static int cc_size_conditional(cc_code * code, int i) {
+    for (--i; i >= 0 && CC_INST_LABEL == code->insts[i].op; --i) {
+    }
+    return i >= 0 && cc_op_isif(code->insts[i].op);
+}
+
+static int cc_size_writes_pc(cc_inst * inst) {
+    return CC_OP_RFI == inst->op
+        || (inst->op < CC_OP_SPECIAL && CC_INST_LABEL != inst->op
+            && CC_VAL_PC == inst->b.mode);
+}
+
+/* Returns non-zero if control never falls through instruction 'i' */
+static int cc_size_ends(cc_code * code, int i) {
+    return cc_size_writes_pc(code->insts + i) && !cc_size_conditional(code, i);
+}
+
+/* Returns non-zero for SET PC, label */
+static int cc_size_isjump(cc_inst * inst) {
+    return CC_OP_SET == inst->op && CC_VAL_PC == inst->b.mode
+        && inst->a.label;
+}
+
+static int cc_size_same(cc_inst * inst, cc_inst * other) {
+    return inst->op == other->op && cc_operand_equal(&inst->a, &other->a)
+        && cc_operand_equal(&inst->b, &other->b);
+}
+
+/* Returns the index where 'label' is placed, or -1 */
+static int cc_size_place(cc_code * code, int label) {
+    int i = 0;
+    for (i = 0; i < code->count; ++i) {
+        if (CC_INST_LABEL == code->insts[i].op
+            && code->insts[i].a.label == label) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Returns non-zero for SET reg, POP and SET PC, POP */
+static int cc_size_pop(cc_inst * inst, int mode) {
+    return CC_OP_SET == inst->op && mode == inst->b.mode
+        && CC_VAL_PUSHPOP == inst->a.mode;
+}
+
+/* Runs the size passes over every function */
+void cc_size_env(cc_gen * gen) {
+    cc_size * self = calloc(1, sizeof(cc_size));
+    cc_code * code = 0;
+    int before = 0;
+    int after = 0;
+
+    self->gen = gen;
+    for (code = gen->codes; code; code = code->next) {
+        before += cc_code_words(code);
+    }
+    cc_size_epilogues(self);
+    for (code = gen->codes; code; code = code->next) {
+        while (cc_size_jumps(self, code) || cc_size_crossjump(self, code)) {
+        }
+    }
+    while (cc_size_outline(self)) {
+    }
+    for (code = gen->codes; code; code = code->next) {
+        after += cc_code_words(code);
+    }
+    self->words = before - after;
+    if (gen->verbose) {
+        fprintf(stderr, "size: %d epilogues shared through %d chains, "
+            "%d jumps, %d dead, %d tails merged\n", self->shared,
+            self->chains, self->jumps, self->dead, self->merged);
+        fprintf(stderr, "size: %d sequences outlined at %d sites, "
+            "%d words saved\n", self->outlined, self->calls, self->words);
+    }
+    free(self);
+}
+
+/* Appends a new code buffer named '<prefix><n>' to the program */
+static cc_code * cc_size_code(cc_size * self, char const * prefix, int n) {
+    char name[32];
+    cc_code * code = 0;
+    sprintf(name, "%s%d", prefix, n);
+    code = cc_code_init(cc_env_id(self->gen->env, name));
+    *self->gen->tail = code;
+    self->gen->tail = &code->next;
+    return code;
+}
+
+/* Epilogue that restores the registers in 'mask' */
+typedef struct cc_epilogue {
+    cc_code * code;
+    int start;
+    int mask;
+    int count;
+    int chain;
+} cc_epilogue;
+
+static int cc_size_count(int mask) {
+    int count = 0;
+    for (; mask; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
+
+static int cc_size_compare(void const * left, void const * right) {
+    int l = ((cc_epilogue const *)left)->count;
+    int r = ((cc_epilogue const *)right)->count;
+    return r - l;
+}
+
+/* Shares the epilogues that pop at least two registers.  Registers are
+ * popped from J down to A, so a chain that restores a set of registers
+ * also restores any set made of its lowest ones, entered part way: the
+ * chain for {X, Y, Z} serves {X, Y} from its second word.  A chain is only
+ * built if it saves more words than it takes. */
+void cc_size_epilogues(cc_size * self) {
+    cc_epilogue * runs = 0;
+    cc_epilogue * sorted = 0;
+    int * chains = 0;
+    int nruns = 0;
+    int nchains = 0;
+    cc_code * code = 0;
+    int i = 0;
+    int k = 0;
+
+    for (code = self->gen->codes; code; code = code->next) {
+        for (i = 0; i < code->count; ++i) {
+            int start = i;
+            int mask = 0;
+            int last = -1;
+            if (!cc_size_pop(code->insts + i, CC_VAL_PC)
+                || cc_size_conditional(code, i)) {
+                continue;
+            }
+            while (start > 0 && cc_size_pop(code->insts + start - 1,
+                CC_VAL_REG) && code->insts[start - 1].b.reg > last) {
+                last = code->insts[--start].b.reg;
+                mask |= 1 << last;
+            }
+            while (start < i && cc_size_conditional(code, start)) {
+                mask &= ~(1 << code->insts[start++].b.reg);
+            }
+            if (i - start < 2) {
+                continue;
+            }
+            runs = realloc(runs, (nruns + 1) * sizeof(cc_epilogue));
+            runs[nruns].code = code;
+            runs[nruns].start = start;
+            runs[nruns].mask = mask;
+            runs[nruns].count = i - start;
+            runs[nruns].chain = -1;
+            nruns++;
+        }
+    }
+    if (!nruns) {
+        return;
+    }
+
+    /* Assign the largest sets first, so that they start the chains */
+    sorted = malloc(nruns * sizeof(cc_epilogue));
+    memcpy(sorted, runs, nruns * sizeof(cc_epilogue));
+    qsort(sorted, nruns, sizeof(cc_epilogue), cc_size_compare);
+    chains = calloc(nruns, sizeof(int));
+    for (i = 0; i < nruns; ++i) {
+        int mask = sorted[i].mask;
+        int low = 0;
+        while (mask >> low > 1) {
+            low++;
+        }
+        low = (2 << low) - 1;
+        for (k = 0; k < nchains && (chains[k] & low) != mask; ++k) {
+        }
+        if (k == nchains) {
+            chains[nchains++] = mask;
+        }
+    }
+    for (i = 0; i < nruns; ++i) {
+        for (k = 0; k < nchains; ++k) {
+            int low = 0;
+            while (runs[i].mask >> low > 1) {
+                low++;
+            }
+            if ((chains[k] & ((2 << low) - 1)) == runs[i].mask) {
+                runs[i].chain = k;
+                break;
+            }
+        }
+    }
+
+    for (k = 0; k < nchains; ++k) {
+        int length = cc_size_count(chains[k]);
+        int saving = -(length + 1);
+        cc_code * chain = 0;
+        int reg = 0;
+        for (i = 0; i < nruns; ++i) {
+            if (runs[i].chain == k) {
+                saving += runs[i].count - 1;
+            }
+        }
+        if (saving <= 0) {
+            continue;
+        }
+        chain = cc_size_code(self, "$ret", self->chains++);
+        for (reg = CC_REG_J; reg >= CC_REG_A; --reg) {
+            if (chains[k] & (1 << reg)) {
+                cc_code_emit(chain, CC_OP_SET, cc_opd_reg(reg),
+                    cc_opd_special(CC_VAL_PUSHPOP));
+            }
+        }
+        cc_code_emit(chain, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+            cc_opd_special(CC_VAL_PUSHPOP));
+
+        /* Runs were found in order, so rewriting from the last one keeps
+         * the indexes of the others valid */
+        for (i = nruns - 1; i >= 0; --i) {
+            cc_operand target = cc_opd_sym(chain->id);
+            cc_inst first;
+            cc_inst * jump = 0;
+            int j = 0;
+            if (runs[i].chain != k) {
+                continue;
+            }
+            first = runs[i].code->insts[runs[i].start];
+            for (j = 0; j <= runs[i].count; ++j) {
+                cc_code_remove(runs[i].code, runs[i].start);
+            }
+            target.value = length - runs[i].count;
+            jump = cc_code_insert(runs[i].code, runs[i].start, CC_OP_SET,
+                cc_opd_special(CC_VAL_PC), target);
+            jump->line = first.line;
+            jump->weight = first.weight;
+            self->shared++;
+        }
+    }
+    free(chains);
+    free(sorted);
+    free(runs);
+}
+
+/* Removes unreachable instructions and labels nothing refers to */
+static int cc_size_dead(cc_size * self, cc_code * code) {
+    int * refs = calloc(code->labels + 1, sizeof(int));
+    int changes = 0;
+    int live = 1;
+    int i = 0;
+    for (i = 0; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        if (CC_INST_LABEL != inst->op) {
+            refs[inst->a.label]++;
+            refs[inst->b.label]++;
+        }
+    }
+    for (i = 0; i < code->count;) {
+        cc_inst * inst = code->insts + i;
+        if (CC_INST_LABEL == inst->op) {
+            if (refs[inst->a.label]) {
+                live = 1;
+                i++;
+            } else {
+                cc_code_remove(code, i);
+            }
+        } else if (!live) {
+            cc_code_remove(code, i);
+            self->dead++;
+            changes++;
+        } else {
+            live = !cc_size_ends(code, i);
+            i++;
+        }
+    }
+    free(refs);
+    return changes;
+}
+
+/* Removes jumps to the next instruction, and replaces jumps to a tail of
+ * at most two words by a copy of the tail.  A conditional jump can only be
+ * replaced by a single instruction.  Tails that end in a jump to a label
+ * aren't copied, so that a cycle of jumps can't be unrolled forever. */
+int cc_size_jumps(cc_size * self, cc_code * code) {
+    int changes = 0;
+    int i = 0;
+    int k = 0;
+    for (i = 0; i < code->count; ++i) {
+        cc_inst * inst = code->insts + i;
+        cc_inst tail[2];
+        int conditional = 0;
+        int target = 0;
+        int words = 0;
+        int count = 0;
+        if (!cc_size_isjump(inst)) {
+            continue;
+        }
+        conditional = cc_size_conditional(code, i);
+        target = cc_size_place(code, inst->a.label);
+        for (k = i + 1; k < target && CC_INST_LABEL == code->insts[k].op;
+            ++k) {
+        }
+        if (target > i && k == target && !conditional) {
+            cc_code_remove(code, i--);
+            self->jumps++;
+            changes++;
+            continue;
+        }
+        for (k = target + 1; k < code->count && words <= 2; ++k) {
+            if (CC_INST_LABEL != code->insts[k].op) {
+                words += cc_inst_words(code->insts + k);
+                count++;
+                if (cc_size_ends(code, k)) {
+                    break;
+                }
+            }
+        }
+        if (target < 0 || k >= code->count || words > 2
+            || (conditional && count > 1) || (i >= target && i <= k)
+            || code->insts[k].a.label || CC_OP_SET != code->insts[k].op) {
+            continue;
+        }
+        for (k = target + 1, count = 0; k < code->count && words > 0; ++k) {
+            if (CC_INST_LABEL != code->insts[k].op) {
+                tail[count++] = code->insts[k];
+                words -= cc_inst_words(code->insts + k);
+            }
+        }
+        for (k = 0; k < count; ++k) {
+            tail[k].weight = code->insts[i].weight;
+        }
+        cc_code_remove(code, i);
+        for (k = 0; k < count; ++k) {
+            *cc_code_insert(code, i + k, tail[k].op, tail[k].b, tail[k].a)
+                = tail[k];
+        }
+        i += count - 1;
+        self->jumps++;
+        changes++;
+    }
+    return changes + cc_size_dead(self, code);
+}
+
+/* Merges the instructions that come before two jumps to the same label,
+ * or before a jump and the fall through into the label: the second copy is
+ * replaced by a jump to the first.  A copy can't start right after an IF,
+ * which would then skip the jump instead.  Returns non-zero if anything
+ * was merged. */
+int cc_size_crossjump(cc_size * self, cc_code * code) {
+    int first = 0;
+    int second = 0;
+    for (second = 0; second < code->count; ++second) {
+        cc_inst * jump = code->insts + second;
+        if (!cc_size_isjump(jump) || cc_size_conditional(code, second)) {
+            continue;
+        }
+        for (first = 0; first < code->count; ++first) {
+            cc_inst * site = code->insts + first;
+            int words = 0;
+            int label = 0;
+            int n = 0;
+            int k = 0;
+            if (first == second) {
+                continue;
+            } else if (CC_INST_LABEL == site->op) {
+                if (site->a.label != jump->a.label || !first
+                    || cc_size_ends(code, first - 1)) {
+                    continue;
+                }
+            } else if (!cc_size_isjump(site) || site->a.label != jump->a.label
+                || cc_size_conditional(code, first)) {
+                continue;
+            }
+            while (n < first && n < second && first - 1 - n != second
+                && second - 1 - n != first
+                && CC_INST_LABEL != code->insts[first - 1 - n].op
+                && CC_INST_LABEL != code->insts[second - 1 - n].op
+                && cc_size_same(code->insts + first - 1 - n,
+                    code->insts + second - 1 - n)) {
+                n++;
+            }
+            while (n > 0 && cc_size_conditional(code, second - n)) {
+                n--;
+            }
+            for (k = second - n; k < second; ++k) {
+                words += cc_inst_words(code->insts + k);
+            }
+            if (!words) {
+                continue;
+            }
+            label = cc_code_label(code);
+            cc_code_insert(code, first - n, CC_INST_LABEL, cc_opd_lit(0),
+                cc_opd_label(label));
+            if (second > first) {
+                second++;
+            }
+            code->insts[second].a = cc_opd_label(label);
+            for (k = 0; k < n; ++k) {
+                cc_code_remove(code, second - n);
+            }
+            self->merged++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Returns non-zero if 'inst' means the same thing wherever it runs, so
+ * that it can be moved into a subroutine: it doesn't use the stack, the
+ * PC or a local label */
+static int cc_size_movable(cc_inst * inst) {
+    cc_operand * opds[2];
+    int i = 0;
+    if (CC_INST_LABEL == inst->op || CC_OP_RFI == inst->op) {
+        return 0;
+    }
+    opds[0] = &inst->a;
+    opds[1] = &inst->b;
+    for (i = inst->op > CC_OP_SPECIAL; i < 2; ++i) {
+        switch (opds[i]->mode) {
+        case CC_VAL_PUSHPOP:
+        case CC_VAL_PEEK:
+        case CC_VAL_PICK:
+        case CC_VAL_SP:
+        case CC_VAL_PC:
+            return 0;
+        default:
+            if (opds[i]->label) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static unsigned long cc_size_hash(cc_inst * inst) {
+    cc_operand * opds[2];
+    unsigned long hash = inst->op;
+    int i = 0;
+    opds[0] = &inst->a;
+    opds[1] = &inst->b;
+    for (i = 0; i < 2; ++i) {
+        hash = hash * 31 + opds[i]->mode;
+        hash = hash * 31 + opds[i]->reg;
+        hash = hash * 31 + (unsigned long)opds[i]->value;
+        hash = hash * 31 + (unsigned long)opds[i]->sym;
+    }
+    return hash;
+}
+
+/* Returns non-zero if the 'count' instructions at 'start' can be replaced
+ * by a call */
+static int cc_size_window(cc_code * code, int start, int count) {
+    int i = 0;
+    if (start + count > code->count || cc_size_conditional(code, start)
+        || cc_op_isif(code->insts[start + count - 1].op)) {
+        return 0;
+    }
+    for (i = start; i < start + count; ++i) {
+        if (!cc_size_movable(code->insts + i)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Returns non-zero if one of the 'count' instructions at 'start' calls code
+ * that may read arguments from the stack above its return address, where
+ * the JSR to an outlined copy would put a second return address: a
+ * function with stack arguments, an adapter reached through a pointer, or
+ * a helper such as long$div */
+static int cc_size_stacked(cc_size * self, cc_code * code, int start,
+    int count) {
+
+    cc_func * func = 0;
+    cc_formal * formal = 0;
+    int args = 0;
+    int i = 0;
+    for (i = start; i < start + count; ++i) {
+        cc_inst * inst = code->insts + i;
+        if (CC_OP_JSR != inst->op) {
+            continue;
+        }
+        func = CC_VAL_LIT == inst->a.mode && inst->a.sym
+            ? cc_env_func(self->gen->env, inst->a.sym) : 0;
+        if (!func) {
+            return 1;
+        }
+        args = 0;
+        for (formal = func->formals; formal; formal = formal->next) {
+            args++;
+        }
+        if (args > CC_FRAME_ARGS) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int cc_size_match(cc_code * code, int start, cc_inst * seq,
+    int count) {
+    int i = 0;
+    for (i = 0; i < count; ++i) {
+        if (!cc_size_same(code->insts + start + i, seq + i)) {
+            return 0;
+        }
+    }
+    return cc_size_window(code, start, count);
+}
+
+static int cc_size_order(void const * left, void const * right) {
+    cc_window const * l = (cc_window const *)left;
+    cc_window const * r = (cc_window const *)right;
+    if (l->hash != r->hash) {
+        return l->hash < r->hash ? -1 : 1;
+    } else if (l->code != r->code) {
+        return l->code - r->code;
+    }
+    return l->start - r->start;
+}
+
+/* Returns the words saved by outlining 'seq', given the windows with its
+ * hash, sorted by position: each non-overlapping copy becomes a two-word
+ * JSR, and the subroutine takes the sequence and a SET PC, POP */
+static int cc_size_gain(cc_code ** codes, cc_window * windows, int n,
+    cc_inst * seq, int count) {
+    int words = 0;
+    int copies = 0;
+    int code = -1;
+    int end = 0;
+    int i = 0;
+    for (i = 0; i < count; ++i) {
+        words += cc_inst_words(seq + i);
+    }
+    for (i = 0; i < n; ++i) {
+        if ((windows[i].code == code && windows[i].start < end)
+            || !cc_size_match(codes[windows[i].code], windows[i].start, seq,
+                count)) {
+            continue;
+        }
+        code = windows[i].code;
+        end = windows[i].start + count;
+        copies++;
+    }
+    return (copies - 1) * words - 2 * copies - 1;
+}
+
+/* Replaces the non-overlapping copies of 'seq' by calls to 'call' */
+static void cc_size_replace(cc_size * self, cc_inst * seq, int count,
+    cc_id * call) {
+    cc_code * code = 0;
+    cc_inst first;
+    cc_inst * jsr = 0;
+    int i = 0;
+    int k = 0;
+    for (code = self->gen->codes; code; code = code->next) {
+        for (i = 0; i + count <= code->count; ++i) {
+            if (!cc_size_match(code, i, seq, count)) {
+                continue;
+            }
+            first = code->insts[i];
+            for (k = 0; k < count; ++k) {
+                cc_code_remove(code, i);
+            }
+            jsr = cc_code_insert(code, i, CC_OP_JSR, cc_opd_lit(0),
+                cc_opd_sym(call));
+            jsr->line = first.line;
+            jsr->weight = first.weight;
+            self->calls++;
+        }
+    }
+}
+
+/* Outlines the repeated sequence that saves the most words, if any.  Every
+ * window of each length is hashed; windows with equal hashes are sorted
+ * next to each other, and the copies of each distinct sequence counted. */
+int cc_size_outline(cc_size * self) {
+    cc_code ** codes = 0;
+    cc_window * windows = 0;
+    cc_inst best[CC_SIZE_OUTLINE];
+    cc_code * code = 0;
+    int saving = 0;
+    int length = 0;
+    int ncodes = 0;
+    int total = 0;
+    int count = 0;
+    int i = 0;
+    int k = 0;
+
+    for (code = self->gen->codes; code; code = code->next) {
+        codes = realloc(codes, (ncodes + 1) * sizeof(cc_code *));
+        codes[ncodes++] = code;
+        total += code->count;
+    }
+    windows = malloc((total + 1) * sizeof(cc_window));
+    for (count = 2; count <= CC_SIZE_OUTLINE; ++count) {
+        int nwindows = 0;
+        for (k = 0; k < ncodes; ++k) {
+            for (i = 0; i + count <= codes[k]->count; ++i) {
+                int j = 0;
+                if (!cc_size_window(codes[k], i, count)
+                    || cc_size_stacked(self, codes[k], i, count)) {
+                    continue;
+                }
+                windows[nwindows].hash = 0;
+                for (j = 0; j < count; ++j) {
+                    windows[nwindows].hash = windows[nwindows].hash * 65599
+                        + cc_size_hash(codes[k]->insts + i + j);
+                }
+                windows[nwindows].code = k;
+                windows[nwindows].start = i;
+                nwindows++;
+            }
+        }
+        qsort(windows, nwindows, sizeof(cc_window), cc_size_order);
+        for (i = 0; i < nwindows; i = k) {
+            cc_inst * seq = codes[windows[i].code]->insts + windows[i].start;
+            int gain = 0;
+            for (k = i + 1; k < nwindows && windows[k].hash == windows[i].hash;
+                ++k) {
+            }
+            if (k - i < 2) {
+                continue;
+            }
+            gain = cc_size_gain(codes, windows + i, k - i, seq, count);
+            if (gain > saving) {
+                saving = gain;
+                length = count;
+                memcpy(best, seq, count * sizeof(cc_inst));
+            }
+        }
+    }
+    free(windows);
+    free(codes);
+    if (saving <= 0) {
+        return 0;
+    }
+
+    code = cc_size_code(self, "$out", self->outlined++);
+    cc_size_replace(self, best, length, code->id);
+    for (i = 0; i < length; ++i) {
+        cc_code_emit(code, best[i].op, best[i].b, best[i].a)->line
+            = best[i].line;
+    }
+    cc_code_emit(code, CC_OP_SET, cc_opd_special(CC_VAL_PC),
+        cc_opd_special(CC_VAL_PUSHPOP));
+    return 1;
+}
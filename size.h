@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+#ifndef CC_SIZE_H
+#define CC_SIZE_H
+
+#include "gen.h"
+
+/* Size passes for -Os.  They run over the finished code of the whole
+ * program, after every frame is laid out, and trade cycles for words:
+ *
+ * - Epilogues that restore the same registers are shared.  A chain of
+ *   pops ending in SET PC, POP serves every set of registers that are the
+ *   lowest ones of the chain, by entering it part way.
+ * - Jumps to the next instruction are removed, and a jump to a tail of at
+ *   most two words (such as a short epilogue) is replaced by the tail.
+ * - Identical instructions before jumps to the same label are merged
+ *   (cross-jumping), which shares the tails of return statements.
+ * - Repeated instruction sequences are outlined into subroutines.
+ *
+ * Sequences that use the stack or the PC are never moved, since a call
+ * or a jump would change their meaning. */
+
+/* Longest sequence considered for outlining, in instructions */
+#define CC_SIZE_OUTLINE 16
+
+typedef struct cc_size {
+    cc_gen * gen;
+    int chains; /* Shared epilogues */
+    int shared; /* Epilogues replaced by a jump to a shared one */
+    int jumps; /* Jumps removed or replaced by their target */
+    int dead; /* Unreachable instructions removed */
+    int merged; /* Tails merged by cross-jumping */
+    int outlined; /* Sequences outlined */
+    int calls; /* Calls to outlined sequences */
+    int words; /* Words saved */
+} cc_size;
+
+void cc_size_env(cc_gen * gen);
+void cc_size_epilogues(cc_size * self);
+int cc_size_jumps(cc_size * self, cc_code * code);
+int cc_size_crossjump(cc_size * self, cc_code * code);
+int cc_size_outline(cc_size * self);
+
+#endif
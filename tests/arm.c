@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Loops that are the unbraced arm of an if, out of which invariants are
+ * hoisted.
+ * expect: 307
+ */
+int then(int n, int a, int b) {
+    int s = 0;
+    int i = 0;
+    if (n > 0) for (i = 0; i < n; i = i + 1) s = s + a * b + i * 7;
+    return s;
+}
+
+int otherwise(int n, int a, int b) {
+    int s = 1;
+    int i = 0;
+    if (n < 0) s = 2;
+    else if (n > 10) s = 3;
+    else while (i < n) { s = s + a * b; i = i + 1; }
+    return s;
+}
+
+int main() {
+    return then(3, 4, 5) + then(0, 4, 5) + otherwise(4, 5, 6)
+        + otherwise(-1, 5, 6) + otherwise(20, 5, 6) + then(5, 2, 3);
+}
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Block fills and copies of constant and variable lengths, overlapping
+ * and at offsets.
+ * expect: 57196
+ */
+int memcpy(int * d, int * s, int n);
+int memset(int * d, int v, int n);
+int sum(int * p, int n) {
+    int s = 0;
+    int i = 0;
+    for (i = 0; i < n; i = i + 1) {
+        s = s * 3 + *(p + i);
+    }
+    return s;
+}
+int fill(int * p, int n) {
+    int i = 0;
+    for (i = 0; i < n; i = i + 1) {
+        *(p + i) = i * 7 + 1;
+    }
+    return 0;
+}
+int test(int * a, int * b, int n, int v) {
+    int t = 0;
+    memset(b, 0, 64);
+    fill(a, 64);
+    memcpy(b, a, 1);
+    t = t + sum(b, 64);
+    memcpy(b + 1, a, 3);
+    t = t + sum(b, 64);
+    memcpy(b + 5, a + 2, 8);
+    t = t + sum(b, 64);
+    memcpy(b + 3, a + 7, 40);
+    t = t + sum(b, 64);
+    memset(b + 1, v, 5);
+    t = t + sum(b, 64);
+    memset(b + 9, 12, 37);
+    t = t + sum(b, 64);
+    memcpy(b, a + 11, n);
+    t = t + sum(b, 64);
+    memset(b + 2, v + 1, n - 3);
+    t = t + sum(b, 64);
+    memset(b, 0, 0);
+    memcpy(b, a, n - n);
+    return t + sum(b, 64);
+}
+int main() {
+    int * a = 32768;
+    int * b = 36864;
+    return test(a, b, 21, 5);
+}
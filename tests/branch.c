@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Conditions lowered to IF* skip chains: compound guards, signed and
+ * unsigned comparisons, bit tests, comparisons against constants at the
+ * ends of the range, and conditions used as values.
+ * expect: 2721
+ */
+int collatz(int n) {
+    int steps;
+    steps = 0;
+    while (n != 1 && steps < 1000) {
+        if (n & 1)
+            n = n * 3 + 1;
+        else
+            n = n >> 1;
+        steps = steps + 1;
+    }
+    return steps;
+}
+int count(int lo, int hi) {
+    int i;
+    int c;
+    c = 0;
+    for (i = lo; i <= hi; i = i + 1) {
+        if (i > 10 && i < 90 || i == 95)
+            c = c + 1;
+        if (!(i >= 20) && !(i & 3))
+            c = c + 2;
+    }
+    return c;
+}
+int order(int a, int b, unsigned u, unsigned v) {
+    int c;
+    c = 0;
+    if (a < b) c = c + 1;
+    if (a >= b) c = c + 2;
+    if (u < v) c = c + 4;
+    if (u >= v) c = c + 8;
+    if (a <= 32767 && a >= -32768) c = c + 16;
+    if (u <= 0) c = c + 32;
+    if (!(a & 256) || (b & 3) == 3) c = c + 64;
+    return c + (a == b) * 128 + (u > v || a != 0) * 256;
+}
+int main() {
+    int t;
+    int k;
+    t = 0;
+    for (k = 1; k < 60; k = k + 1) {
+        t = t + collatz(k);
+    }
+    t = t + order(-5, 3, 65531, 3) + order(3, 3, 0, 0);
+    return t + order(300, -1, 300, 65535) + count(0, 100);
+}
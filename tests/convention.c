@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Arguments passed in registers and on the stack, reordered between
+ * callers and callees and passed through a function pointer.
+ * expect: 57423
+ */
+int five(int a, int b, int c, int d, int e) {
+    return a * 10000 - b * 1000 + c * 100 + d * 10 + e;
+}
+int swap(int a, int b, int c) {
+    return a * 100 + b * 10 + c;
+}
+int rot(int a, int b, int c) {
+    return swap(b, c, a);
+}
+int sib(int a, int b, int c, int d, int e) {
+    return five(e, d, c, b, a);
+}
+int call5(int f) {
+    return f(1, 2, 3, 4, 5);
+}
+int call3(int f) {
+    return f(7, 8, 9);
+}
+int inner(int a, int b, int c) {
+    int k = 0;
+    int s = 0;
+    for (k = 0; k < 3; k = k + 1) {
+        s = s + swap(c, a, b) + rot(a, b, c);
+    }
+    return s;
+}
+int main() {
+    return sib(1, 2, 3, 4, 5) + call5(five) + call3(rot) + rot(1, 2, 3) + inner(1, 2, 3);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Functions, globals and strings that are never used, which are left out
+ * of the image at -O1 and above.
+ * expect: 765
+ */
+int lib_b(int x);
+int table = 40;
+int zeros;
+char * name = "helper";
+int dead(int x) { return x * 9; }
+int helper(int x, int y) { zeros = zeros + 1; return x * y + table + zeros + *name; }
+int unused_a(int x) { return x + 1; }
+int counter;
+int main() {
+    int i = 0;
+    int t = 0;
+    for (i = 0; i < 5; i = i + 1) { t = t + helper(i, 3); }
+    counter = counter + t;
+    return counter;
+}
+int lib_a(int x) { return lib_b(x) * 3; }
+int lib_b(int x) { char * m = "library message"; return x + *m; }
+int lib_tab = 5;
+int * lib_ptr = &lib_tab;
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Division and modulo by constants, which are lowered to shifts, masks or
+ * the single instruction, checked against a variable divisor for every
+ * 16-bit dividend, signed and unsigned.  Returns 1 on a mismatch, and a
+ * checksum of the quotients otherwise.
+ * expect: 19657
+ */
+int v3 = 3;
+int v7 = 7;
+int v10 = 10;
+int v16 = 16;
+int v641 = 641;
+
+int check(unsigned u) {
+    int x = u;
+    unsigned d = 0;
+    int s = 0;
+    d = (u / 3 - u / v3) | (u % 3 - u % v3)
+        | (u / 7 - u / v7) | (u % 7 - u % v7)
+        | (u / 10 - u / v10) | (u % 10 - u % v10)
+        | (u / 16 - u / v16) | (u % 16 - u % v16)
+        | (u / 641 - u / v641) | (u % 641 - u % v641);
+    s = (x / 3 - x / v3) | (x % 3 - x % v3)
+        | (x / 7 - x / v7) | (x % 7 - x % v7)
+        | (x / 10 - x / v10) | (x % 10 - x % v10)
+        | (x / 16 - x / v16) | (x % 16 - x % v16)
+        | (x / 641 - x / v641) | (x % 641 - x % v641);
+    return d | s;
+}
+
+int main() {
+    unsigned hi;
+    unsigned lo;
+    unsigned sum;
+    sum = 0;
+    for (hi = 0; hi < 256; hi = hi + 1) {
+        for (lo = 0; lo < 256; lo = lo + 1) {
+            if (check(hi * 256 + lo)) {
+                return 1;
+            }
+            sum = sum + (hi * 256 + lo) / 10 + (hi * 256 + lo) % 7;
+        }
+    }
+    return sum;
+}
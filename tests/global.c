@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Initialized and uninitialized globals, string and pointer
+ * initializers and a function pointer in a global.
+ * expect: 4043
+ */
+int count;
+int total = 0;
+int seed = 12345;
+char * msg = "hello";
+char * tail = "world" + 2;
+int * pseed = &seed;
+int big1;
+int big2;
+int big3;
+int twice(int x) { return x * 2; }
+int fn = twice;
+int bump(int n) {
+    count = count + 1;
+    total = total + n;
+    return total;
+}
+int rand() {
+    seed = seed * 31421 + 6927;
+    return seed;
+}
+int main() {
+    int i = 0;
+    for (i = 0; i < 10; i = i + 1) {
+        bump(rand() & 255);
+    }
+    *pseed = *pseed + 1;
+    big2 = *msg + *tail;
+    return total * 3 + count + seed + big2 + big1 + big3 + fn(5);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Small functions inlined into their callers at -O2, including ones that
+ * take the address of a local, and recursive ones that are not.
+ * expect: 793
+ */
+int get(int * p) {
+    return *p;
+}
+int sq(int x) {
+    return x * x;
+}
+int clamp(int v, int lo, int hi) {
+    int r;
+    r = v;
+    if (v < lo) r = lo;
+    if (v > hi) r = hi;
+    return r;
+}
+int fact(int n) {
+    if (n < 2) return 1;
+    return n * fact(n - 1);
+}
+int ping(int n);
+int pong(int n) {
+    return ping(n - 1);
+}
+int ping(int n) {
+    if (n < 1) return 0;
+    return pong(n);
+}
+int bump(int * p) {
+    *p = *p + 1;
+    return 0;
+}
+int main() {
+    int a;
+    int s;
+    int i;
+    a = 5;
+    s = 0;
+    for (i = 0; i < 10; i = i + 1) {
+        s = s + sq(i) + clamp(i * 7, 10, 40) + get(&a);
+        bump(&a);
+    }
+    return s + fact(5) + ping(4) + a;
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Decimal literals above 32767 are longs, as in C90 with 16-bit ints, so
+ * they keep their value when negated or stored in a long.  Each check
+ * that passes adds one.
+ * expect: 10
+ */
+long g = -40000;
+long h = 65535;
+
+int main() {
+    long c = -40000;
+    long d = 40000;
+    long e = 0;
+    unsigned u = 40000;
+    int t = 0;
+    e = -32768;
+    if (c == -40000L) t = t + 1;
+    if (g == -40000L) t = t + 1;
+    if (d == 40000L) t = t + 1;
+    if (h == 65535L) t = t + 1;
+    if (h > 0) t = t + 1;
+    if (e == -32768L) t = t + 1;
+    if (c + 40000 == 0) t = t + 1;
+    if (u == 40000) t = t + 1;
+    if (-c == d) t = t + 1;
+    if (c / 4 == -10000) t = t + 1;
+    return t;
+}
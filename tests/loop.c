@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Loop optimizations: invariant code motion, strength reduction of the
+ * index arithmetic in a 16x16 matrix-vector product, and unrolling of
+ * loops with a constant trip count.
+ * expect: 25035
+ */
+int * mat = 32768;
+int * vec = 33024;
+int * out = 33040;
+
+void fill(int n, int k) {
+    int i;
+    int j;
+    for (i = 0; i < n; i = i + 1) {
+        for (j = 0; j < n; j = j + 1) {
+            *(mat + i * n + j) = (i * 7 + j * 3 + k * k) & 15;
+        }
+        *(vec + i) = i + 1;
+    }
+}
+
+void product(int n) {
+    int i;
+    int j;
+    int s;
+    for (i = 0; i < n; i = i + 1) {
+        s = 0;
+        for (j = 0; j < n; j = j + 1) {
+            s = s + *(mat + i * n + j) * *(vec + j);
+        }
+        *(out + i) = s;
+    }
+}
+
+int weigh(int x) {
+    int i;
+    int s;
+    s = 0;
+    for (i = 0; i < 4; i = i + 1) {
+        s = s + x * i;
+    }
+    for (i = 0; i < 12; i = i + 1) {
+        s = s + (s >> 3) + i * 5;
+    }
+    return s;
+}
+
+int main() {
+    int i;
+    int k;
+    int sum;
+    sum = 0;
+    for (k = 0; k < 3; k = k + 1) {
+        fill(16, k);
+        product(16);
+        for (i = 0; i < 16; i = i + 1) {
+            sum = sum * 3 + *(out + i) + weigh(i);
+        }
+    }
+    return sum;
+}
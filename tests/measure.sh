@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Prints the cycles and then the image size in words of each program at
+# each optimization level, as used in the measurements in the commit log.
+# Measures the regression programs in this directory and bench.c unless
+# programs are given.  LEVELS overrides the levels, and FLAGS adds
+# compiler flags, e.g. FLAGS=-fselect=simple for the old selector.
+
+dir=`dirname "$0"`
+bin=${BIN:-$dir/..}
+tmp=${TMPDIR:-/tmp}/dcpu16-measure.$$
+levels=${LEVELS:--O0 -O1 -O2 -Os}
+
+mkdir -p "$tmp" || exit 1
+trap 'rm -rf "$tmp"' 0
+trap 'exit 1' 1 2 13 15
+
+if [ $# -eq 0 ]; then
+    set -- "$dir"/*.c "$dir/../bench.c"
+fi
+
+printf '%-12s' program
+for level in $levels; do
+    printf ' %16s' "$level"
+done
+echo
+
+for test in "$@"; do
+    printf '%-12s' `basename "$test" .c`
+    for level in $levels; do
+        image=$tmp/image.bin
+        if "$bin/dcpu16cc" $level $FLAGS -o "$image" "$test" 2>/dev/null; then
+            cycles=`"$bin/dcpu16run" "$image" | sed -n 1p | cut -d' ' -f2`
+            words=`wc -c < "$image"`
+            printf ' %9s %6s' $cycles `expr $words / 2`
+        else
+            printf ' %16s' error
+        fi
+    done
+    echo
+done
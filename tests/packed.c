@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Packed strings passed to functions and returned from them, which must
+ * build without warnings about plain char accesses.
+ * flags: -fpack-strings
+ * expect: 286
+ */
+int packed_get(char * s, int i);
+int packed_put(char * s, int i, int c);
+char * name = "packed";
+int count(char * s, int c) {
+    int n = 0;
+    int i = 0;
+    for (i = 0; packed_get(s, i); i = i + 1) {
+        if (packed_get(s, i) == c) {
+            n = n + 1;
+        }
+    }
+    return n;
+}
+char * pick(int i) {
+    if (i) {
+        return "letters";
+    }
+    return name;
+}
+int main() {
+    char * s = pick(1);
+    packed_put(s, 0, 76);
+    return count(s, 116) * 100 + count(pick(0), 101) * 10 + packed_get(s, 0);
+}
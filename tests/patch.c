@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Self-modifying code: the literal returned by a function is patched
+ * before each call, so every cached decode of it must be dropped.  At -O2
+ * the function is inlined and no longer reads the patched word.
+ * expect: 42052
+ * levels: -O0 -O1 -Os
+ */
+int get() {
+    return 1234;
+}
+
+int main() {
+    int * q = 0;
+    int i = 0;
+    int s = 0;
+    q = get;
+    while (*q != 1234) {
+        q = q + 1;
+    }
+    for (i = 0; i < 3000; i = i + 1) {
+        *q = i;
+        s = s + get();
+    }
+    return s;
+}
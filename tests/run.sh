@@ -0,0 +1,108 @@
+#!/bin/sh
+#
+# Runs the regression programs in this directory under dcpu16run.  Each
+# program states what it checks in comment lines of the form
+#
+#   * expect: N       value of A when the program halts
+#   * levels: ...     optimization levels to build at (default: all)
+#   * flags: ...      extra compiler flags
+#   * depth: N        most words the program may keep on the stack
+#
+# Every program is built both directly and through dcpu16cc -c and
+# dcpu16ld.  The short programs are then run together on the thread pool,
+# enough copies of each for 1200 instances, and every instance must give
+# the expected value.  Prints the failures and exits non-zero if there are
+# any.
+
+dir=`dirname "$0"`
+bin=${BIN:-$dir/..}
+tmp=${TMPDIR:-/tmp}/dcpu16-tests.$$
+steps=50000000
+instances=1200
+fail=0
+pass=0
+
+mkdir -p "$tmp/farm" || exit 1
+trap 'rm -rf "$tmp"' 0
+trap 'exit 1' 1 2 13 15
+
+field() {
+    sed -n "s/^ \* $1: *//p" "$2" | head -1
+}
+
+check() {
+    label=$1
+    out=`"$bin/dcpu16run" -n $steps "$2" 2>&1`
+    ran=`echo "$out" | sed -n 1p | cut -d' ' -f4`
+    a=`echo "$out" | sed -n 2p | cut -d' ' -f2`
+    used=`echo "$out" | sed -n 3p | sed 's/.*depth //'`
+    if [ "$a" != "$expect" ]; then
+        echo "FAIL $label: A is $a, expected $expect"
+        fail=`expr $fail + 1`
+    elif [ -n "$depth" ] && [ "$used" -gt "$depth" ]; then
+        echo "FAIL $label: stack depth is $used, expected at most $depth"
+        fail=`expr $fail + 1`
+    else
+        pass=`expr $pass + 1`
+    fi
+}
+
+for test in "$dir"/*.c; do
+    name=`basename "$test" .c`
+    expect=`field expect "$test"`
+    levels=`field levels "$test"`
+    flags=`field flags "$test"`
+    depth=`field depth "$test"`
+    for level in ${levels:--O0 -O1 -O2 -Os}; do
+        image=$tmp/$name.bin
+        if ! "$bin/dcpu16cc" $level $flags -o "$image" "$test"; then
+            echo "FAIL $name $level: compile error"
+            fail=`expr $fail + 1`
+            continue
+        fi
+        check "$name $level" "$image"
+        if [ "$level" = -O1 ] && [ "${ran:-$steps}" -lt 1000000 ]; then
+            cp "$image" "$tmp/farm/$name.bin"
+            echo "$tmp/farm/$name.bin $expect" >> "$tmp/farm.expect"
+        fi
+        if ! "$bin/dcpu16cc" $level $flags -c -o "$tmp/$name.o" "$test" \
+            || ! "$bin/dcpu16ld" -o "$image" "$tmp/$name.o"; then
+            echo "FAIL $name $level: separate compile or link error"
+            fail=`expr $fail + 1`
+            continue
+        fi
+        check "$name $level linked" "$image"
+    done
+done
+
+images=`ls "$tmp"/farm/*.bin 2>/dev/null | wc -l`
+if [ $images -gt 0 ]; then
+    copies=`expr \( $instances + $images - 1 \) / $images`
+    "$bin/dcpu16run" -j 4 -s 1000 -c $copies "$tmp"/farm/*.bin \
+        > "$tmp/farm.out"
+    if awk -v want=`expr $images \* $copies` '
+        NR == FNR { expect[$1] = $2; next }
+        {
+            seen++
+            image = $1
+            sub(/#[0-9]+$/, "", image)
+            if ($7 != expect[image]) {
+                print "FAIL farm " $1 ": A is " $7 ", expected " expect[image]
+                bad = 1
+            }
+        }
+        END {
+            if (seen != want) {
+                print "FAIL farm: " seen " of " want " instances finished"
+                bad = 1
+            }
+            exit bad
+        }' "$tmp/farm.expect" - < "$tmp/farm.out"; then
+        pass=`expr $pass + 1`
+    else
+        fail=`expr $fail + 1`
+    fi
+fi
+
+echo "$pass passed, $fail failed"
+[ $fail -eq 0 ]
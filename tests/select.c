@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Memory operands chosen by the bottom-up selector: indexing into a
+ * global struct, constant offsets from a pointer and fields reached
+ * through p + i.
+ * expect: 209
+ */
+struct pt { int x; int y; int z; };
+struct blk { int a; int b; int c; int d; int e; int f; int g; int h; };
+struct blk tab;
+struct quad { struct pt p0; struct pt p1; struct pt p2; struct pt p3; };
+struct quad pts;
+int sum(int * p, int n) {
+    int s = 0;
+    int i = 0;
+    for (i = 0; i + 3 < n; i = i + 4) {
+        s = s + *(p + i) + *(p + i + 1) + *(p + i + 2) + *(p + (i + 3));
+    }
+    return s;
+}
+int glob(int n) {
+    int s = 0;
+    int i = 0;
+    for (i = 0; i < n; i = i + 1) {
+        *(&tab.a + i) = i * 3;
+    }
+    for (i = 0; i < n; i = i + 1) {
+        s = s + *(&tab.a + i);
+    }
+    return s;
+}
+int fields(struct pt * p, int n) {
+    int s = 0;
+    int i = 0;
+    for (i = 0; i < n; i = i + 1) {
+        (p + i)->y = i + 1;
+        (p + i)->z = (p + i)->y * 2;
+        s = s + (p + i)->z;
+    }
+    return s;
+}
+int main() {
+    int t = glob(8);
+    t = t + sum(&tab.a, 8);
+    t = t + fields(&pts.p0, 4);
+    return t + *(&tab.a + 5) + pts.p2.z;
+}
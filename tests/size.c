@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Size passes at -Os: similar functions whose epilogues are shared and
+ * whose repeated sequences are outlined, and returns whose tails are
+ * merged by cross-jumping.
+ * expect: 24946
+ */
+int f0(int a, int b, int c) {
+    int x = a * 2;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 2; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f1(int a, int b, int c) {
+    int x = a * 3;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 3; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f2(int a, int b, int c) {
+    int x = a * 4;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 4; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f3(int a, int b, int c) {
+    int x = a * 5;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 5; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f4(int a, int b, int c) {
+    int x = a * 6;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 6; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f5(int a, int b, int c) {
+    int x = a * 7;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 7; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f6(int a, int b, int c) {
+    int x = a * 8;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 8; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int f7(int a, int b, int c) {
+    int x = a * 9;
+    int y = b + x;
+    int z = c - y;
+    int k = 0;
+    for (k = 0; k < 9; k = k + 1) { x = x + y * z; y = y + 1; z = z ^ x; }
+    if (x > 100) { return x + y; }
+    return x - z;
+}
+int pick(int a, int b) {
+    if (a > b) { return a * 5 + b - 7; }
+    if (a == b) { return a * 5 + b - 7 + a; }
+    if (b > 1000) { return b * 5 + a - 7; }
+    return a * 5 + b - 7;
+}
+int main() {
+    int t = 0;
+    t = t + f0(0, 0, 0);
+    t = t + f1(1, 3, 5);
+    t = t + f2(2, 6, 10);
+    t = t + f3(3, 9, 15);
+    t = t + f4(4, 12, 20);
+    t = t + f5(5, 15, 25);
+    t = t + f6(6, 18, 30);
+    t = t + f7(7, 21, 35);
+    t = t + pick(9, 2) + pick(4, 4) + pick(1, 2000) + pick(1, 2);
+    return t;
+}
@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Many live locals across calls with stack arguments, and locals whose
+ * address is taken.
+ * expect: 46154
+ */
+int add3(int a, int b, int c) {
+    return a + b + c;
+}
+int six(int a, int b, int c, int d, int e, int f) {
+    return a - b + c - d + e - f;
+}
+int set(int * p, int v) {
+    *p = *p + v;
+    return v;
+}
+int work(int n, int m, int k, int q, int r) {
+    int a = 1;
+    int b = 2;
+    int c = 3;
+    int d = 4;
+    int e = 5;
+    int f = 6;
+    int i = 0;
+    for (i = 0; i < n; i = i + 1) {
+        a = a + add3(b, c + six(d, e, f, a, q, r), add3(i, m, k));
+        set(&b, a + six(c, d, e, f, r, q));
+        c = c + d * e - f + b;
+        d = d + set(&e, 3) + e;
+        f = f + q - r;
+    }
+    return a + b + c + d + e + f;
+}
+int main() {
+    return work(7, 2, 3, 40, 50);
+}
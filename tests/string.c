@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Packed strings, escapes in string literals and the packed access
+ * builtins.
+ * expect: 30935
+ */
+int packed_get(char * s, int i);
+int packed_put(char * s, int i, int c);
+char * greet = "hello world";
+int len(char * s) {
+    int n = 0;
+    while (packed_get(s, n)) {
+        n = n + 1;
+    }
+    return n;
+}
+int hash(char * s) {
+    int h = 0;
+    int i = 0;
+    for (i = 0; packed_get(s, i); i = i + 1) {
+        h = h * 31 + packed_get(s, i);
+    }
+    return h;
+}
+int main() {
+    char * a = "world";
+    char * b = "hello world";
+    char * c = "ld";
+    char * d = "tab\there\n\x41\101\"q\\";
+    int t = 0;
+    packed_put(b, 0, 72);
+    packed_put(b, 3, 76);
+    t = hash(greet) + hash(a) * 3 + len(b) + len(c) * 7 + hash(d) + packed_get(b, 0) + packed_get(d, 3);
+    packed_put(d, len(d) - 1, 47);
+    return t + hash(d) + hash("world");
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Nested structs, struct assignment and fields through pointers.
+ * expect: 2268
+ */
+struct point { int x; int y; };
+struct rect { struct point lo; struct point hi; int tag; };
+struct rect box;
+struct point origin;
+int area(struct rect * r) {
+    return (r->hi.x - r->lo.x) * (r->hi.y - r->lo.y);
+}
+int shift(struct point * p, int d) {
+    p->x = p->x + d;
+    p->y = p->y + d;
+    return p->x;
+}
+int main() {
+    struct rect r;
+    struct point q;
+    int * px;
+    r.lo.x = 1; r.lo.y = 2; r.hi.x = 11; r.hi.y = 22; r.tag = 7;
+    box = r;
+    q = box.hi;
+    px = &q.y;
+    *px = *px + 100;
+    shift(&box.lo, 3);
+    origin.x = 5;
+    return area(&r) * 10 + area(&box) + q.y + q.x + box.tag + box.lo.x + origin.x + origin.y;
+}
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Tail calls: self recursion, mutual recursion and calls through a wrapper.
+ * expect: 45087
+ */
+
+int sum(int n, int acc) {
+    if (n == 0) return acc;
+    return sum(n - 1, acc + n);
+}
+int gcd(int a, int b) {
+    if (b == 0) return a;
+    return gcd(b, a % b);
+}
+int even(int n, int pad);
+int odd(int n, int pad) {
+    if (n == 0) return 0;
+    return even(n - 1, pad);
+}
+int even(int n, int pad) {
+    if (n == 0) return 1;
+    return odd(n - 1, pad);
+}
+int twice(int x) {
+    return x + x;
+}
+int wrap(int x, int y) {
+    return twice(x + y);
+}
+int main() {
+    return sum(3000, 0) + gcd(1071, 462) + even(2001, 0) + wrap(3, 4);
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Deep mutual tail recursion, which must run in constant stack space once
+ * tail calls are generated.  At -O0 the recursion overflows the stack.
+ * expect: 11956
+ * levels: -O1 -O2 -Os
+ * depth: 16
+ */
+
+int even(int n);
+int odd(int n) {
+    if (n == 0) return 0;
+    return even(n - 1);
+}
+int even(int n) {
+    if (n == 0) return 1;
+    return odd(n - 1);
+}
+int count(int n, int acc) {
+    if (n == 0) return acc;
+    return count(n - 1, acc + 3);
+}
+int ping(int n, int a, int b, int c, int d);
+int pong(int n, int a, int b, int c, int d) {
+    if (n == 0) return a + b + c + d;
+    return ping(n - 1, b, c, d, a + 1);
+}
+int ping(int n, int a, int b, int c, int d) {
+    if (n == 0) return a - b - c - d;
+    return pong(n - 1, d, a, b, c);
+}
+int main() {
+    return even(30001) + count(30000, 0) + ping(25000, 1, 2, 3, 4);
+}
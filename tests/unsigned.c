@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Loops with constant bounds over unsigned induction variables, whose trip
+ * counts decide unrolling and whether the first test is skipped.  The
+ * comparisons must be unsigned, also across the wrap at 65535.
+ * expect: 10
+ */
+unsigned big() {
+    unsigned i;
+    unsigned s = 0;
+    for (i = 0; i < 40000; i = i + 1) s = s + 1;
+    return s;
+}
+
+unsigned wrap() {
+    unsigned i;
+    unsigned s = 0;
+    for (i = 65530; i > 5; i = i + 1) s = s + 1;
+    return s;
+}
+
+unsigned never() {
+    unsigned i;
+    unsigned s = 0;
+    for (i = 40000; i < 5; i = i + 1) s = s + 1;
+    return s;
+}
+
+unsigned across() {
+    unsigned i;
+    unsigned s = 0;
+    for (i = 65533; i != 2; i = i + 1) s = s + i;
+    return s;
+}
+
+unsigned down() {
+    unsigned i;
+    unsigned s = 0;
+    for (i = 3; i <= 3; i = i - 1) s = s + 1;
+    return s;
+}
+
+int signedwrap() {
+    int i;
+    int s = 0;
+    for (i = 32765; i > 0; i = i + 1) s = s + 1;
+    return s;
+}
+
+int main() {
+    int t = 0;
+    if (big() == 40000) t = t + 1;
+    if (wrap() == 6) t = t + 1;
+    if (never() == 0) t = t + 1;
+    if (across() == 65531) t = t + 1;
+    if (down() == 4) t = t + 1;
+    if (signedwrap() == 3) t = t + 1;
+    return t + 4;
+}
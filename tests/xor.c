@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2012 Matt Fichman
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, APEXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */  
+
+/* Exclusive or on ints, unsigned and longs: in place, as a value, with
+ * constants on either side and folded at compile time.  Its precedence
+ * lies between '&' and '|'.
+ * expect: 59903
+ */
+long lg = 305419896L;
+long la = 124076833L;
+
+int mix(int a, int b) {
+    int x = a ^ b;
+    x = x ^ 4080;
+    x = 21845 ^ x;
+    return x ^ (a & b) ^ (3 ^ 5);
+}
+
+unsigned hash(unsigned h, int n) {
+    int i;
+    for (i = 0; i < n; i = i + 1) {
+        h = h ^ (h << 5) ^ (h >> 3) ^ i;
+    }
+    return h;
+}
+
+int longs() {
+    long b = la ^ 252645135L;
+    b = b ^ lg;
+    b = 65537L ^ b;
+    return (b >> 16) + b;
+}
+
+int main() {
+    int t = mix(1234, -99) + hash(7, 20) + longs();
+    t = t + (1 | 6 ^ 3 & 5) * 100;
+    return t;
+}